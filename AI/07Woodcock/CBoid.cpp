@@ -30,7 +30,7 @@
 
 // visible friends list (work space reused by each flock boid)
 
-CBoid * CBoid::VisibleFriendsList[] = {NULL};
+thread_local CBoid * CBoid::VisibleFriendsList[] = {NULL};
 
 //
 // constructor and destructor methods
@@ -91,6 +91,13 @@ CBoid::CBoid (short id_v)
 
    m_next = m_prev = NULL;
 
+   // seed our private jitter generator and let
+   // the other boids see where we start out
+
+   m_seed = (unsigned int) rand();
+
+   Publish();
+
 #ifdef BOID_DEBUG
    PrintData();
 #endif
@@ -127,6 +134,13 @@ CBoid::CBoid (short id_v,
 
    m_next = m_prev = NULL;
 
+   // seed our private jitter generator and let
+   // the other boids see where we start out
+
+   m_seed = (unsigned int) rand();
+
+   Publish();
+
 #ifdef BOID_DEBUG
    PrintData();
 #endif
@@ -319,7 +333,7 @@ vector CBoid::Cruising (void)
    // This will also get us moving if we happen to start
    // things standing perfectly still (which is sorta boring).
 
-   float jitter = RAND();
+   float jitter = Jitter();
 
    if (jitter < 0.45f) {
       change.x += MinUrgency * SIGN(diff);
@@ -366,7 +380,7 @@ vector CBoid::FleeEnemies (void)
 
       // yep...compute vector away from enemy
 
-      change = m_pos - m_nearest_enemy->m_pos;
+      change = m_pos - m_nearest_enemy->m_pub_pos;
 
    }
 
@@ -391,7 +405,7 @@ vector CBoid::KeepDistance (void)
 
    // compute vector towards our nearest buddy
 
-   vector change = m_nearest_flockmate->m_pos - m_pos;   
+   vector change = m_nearest_flockmate->m_pub_pos - m_pos;   
 
 #ifdef BOID_DEBUG
    myprintf("\nInside KeepDistance\n");
@@ -458,7 +472,7 @@ vector CBoid::MatchHeading (void)
 
    // copy the heading of our nearest buddy
 
-   vector change = m_nearest_flockmate->m_vel;
+   vector change = m_nearest_flockmate->m_pub_vel;
 
 #ifdef BOID_DEBUG
    myprintf("\nInside MatchHeading\n");
@@ -635,7 +649,7 @@ vector CBoid::SteerToCenter (void)
    // walk down the visibility list and sum up their position vectors
 
    for (int i = 0; i < m_num_flockmates_seen; i++) {
-      if (VisibleFriendsList[i] != NULL) center += VisibleFriendsList[i]->m_pos;
+      if (VisibleFriendsList[i] != NULL) center += VisibleFriendsList[i]->m_pub_pos;
    }
 
 #ifdef BOID_DEBUG
@@ -817,7 +831,7 @@ float CBoid::CanISee (CBoid *ptr)
 
    // figure out distance
 
-   float dist = (m_pos.GetDist(m_pos, ptr->m_pos));
+   float dist = (m_pos.GetDist(m_pos, ptr->m_pub_pos));
 
 #ifdef VISIBILITY_DEBUG
    myprintf("   dist between %x and %x = %f\n",this,ptr,dist);
@@ -837,6 +851,20 @@ float CBoid::CanISee (CBoid *ptr)
 
 }
 
+// Jitter.
+// Returns a random number in [0,1] drawn from this boid's own seed.
+// Keeping the generator per boid means the result doesn't depend on
+// the order (or the thread) in which the boids get updated.
+
+float CBoid::Jitter (void)
+{
+
+   m_seed = m_seed * 1103515245 + 12345;
+
+   return ((float) ((m_seed >> 8) & 0xffff) / 65535.0f);
+
+}
+
 // ComputeRPY.
 // Computes the roll/pitch/yaw of the flock boid based on its
 // latest velocity vector changes.  Roll/pitch/yaw are stored in
@@ -952,6 +980,21 @@ vector * CBoid::GetPos (void)
 
 }
 
+// Publish.
+// Copies our current position and velocity into the state the
+// other boids read.  CFlock::Update publishes each boid right after
+// it flocks, so later boids see the new values just as they always
+// have; CFlock::UpdateBuffered publishes everyone before anybody
+// moves, so the whole frame reads last frame's state.
+
+void CBoid::Publish (void)
+{
+
+   m_pub_pos = m_pos;
+   m_pub_vel = m_vel;
+
+}
+
 // LinkOut.
 // Removes a boid from a list.
 
@@ -37,9 +37,10 @@ class CBoid {
       // static variables
       ///////////////////
 
-      // visible friends list (work space reused by each boid)
+      // visible friends list (work space reused by each boid);
+      // one per thread so boids can be flocked in parallel
 
-      static CBoid * VisibleFriendsList[Max_Friends_Visible];
+      static thread_local CBoid * VisibleFriendsList[Max_Friends_Visible];
 
       ///////////////////////////////
       // constructors and destructors
@@ -115,6 +116,12 @@ class CBoid {
 
       void PrintData (void);
 
+      // Publish.
+      // Copies the member's current position and velocity into the
+      // state its neighbours read when they flock.
+
+      void Publish (void);
+
       // SetNext.
       // Set the "next" pointer of an individual member.
 
@@ -161,6 +168,11 @@ class CBoid {
       vector   m_oldpos;                     // last position
       vector   m_oldvel;                     // last velocity
 
+      vector   m_pub_pos;                    // position other boids see
+      vector   m_pub_vel;                    // velocity other boids see
+
+      unsigned int m_seed;                   // private jitter RNG state
+
       CBoid    *m_next;                      // pointer to next flockmate
       CBoid    *m_prev;                      // pointer to previous flockmate
 
@@ -234,6 +246,12 @@ class CBoid {
 
       float CBoid::CanISee (CBoid *ptr);
 
+      // Jitter.
+      // Returns a random number in [0,1] from the boid's own seed, so
+      // the result doesn't depend on the order boids are updated in.
+
+      float CBoid::Jitter (void);
+
       // ComputeRPY.
       // Computes the roll/pitch/yaw of the flock boid based on its
       // latest velocity vector changes.  Roll/pitch/yaw are stored in
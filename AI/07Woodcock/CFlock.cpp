@@ -17,7 +17,12 @@
 // includes
 //
 
+#include <algorithm>
+#include <vector>
+
+#include "CBox.h"
 #include "CFlock.h" 
+#include "CThreadPool.h"
 #include "glut.h"
 #include "mtxlib.h"
 
@@ -38,6 +43,46 @@ int CFlock::FlockCount = 0;
 
 CFlock * CFlock::ListOfFlocks[] = {NULL};
 
+//
+// buffered update work space
+//
+
+// one entry per boid, sorted by the grid cell the boid is in
+
+struct BoidWork
+{
+   unsigned int   cell;                  // spatial sort key
+   int            flock_id;              // flock the boid belongs to
+   CBoid          *boid;                 // the boid itself
+   CBoid          *first_member;         // first member of its flock
+};
+
+static bool CellLess (const BoidWork &a, const BoidWork &b)
+{
+   return (a.cell < b.cell);
+}
+
+static std::vector<BoidWork> WorkList;
+
+// CellOf.
+// Returns the grid cell (along one axis) a coordinate falls in.
+// Boids can be briefly outside the world box, so clamp.
+
+static unsigned int CellOf (float v, float min, float cell_size, unsigned int cells)
+{
+   float c = (v - min)/cell_size;
+
+   if (c < 0.0f) return (0);
+   if (c >= (float) cells) return (cells - 1);
+
+   return ((unsigned int) c);
+}
+
+// # of chunks handed out per thread; a few per thread
+// keeps everybody busy when some cells are more crowded
+
+#define ChunksPerThread  4
+
 //
 // constructor and destructor methods
 //
@@ -120,12 +165,115 @@ void CFlock::Update (void)
 
       ptr->FlockIt(m_id,m_first_member);
 
+      // let the rest of the flock see where it went
+
+      ptr->Publish();
+
       // get next boid
 
       ptr = ptr->GetNext();
    }
 }
 
+// FlockTask.
+// Flocks the boids in one chunk of the work list.
+
+static void FlockTask (void *context, int first, int last)
+{
+
+   BoidWork *work = (BoidWork *) context;
+
+   for (int i = first; i < last; i++) {
+      work[i].boid->FlockIt(work[i].flock_id, work[i].first_member);
+   }
+
+}
+
+// UpdateBuffered.
+// Updates every boid in every flock against last frame's state.
+
+void CFlock::UpdateBuffered (CThreadPool *pool)
+{
+
+   CBoid *ptr;
+
+   BoidWork work;
+
+   int i, n, chunk, threads;
+
+   // the grid is one perception range on a side, so a boid's
+   // neighbours mostly live in its own chunk or the next one over
+
+   float cell_size = Default_Perception_Range;
+
+   float minX = -CBox::WorldPtr->GetBoxWidth()/2;
+   float minY = -CBox::WorldPtr->GetBoxHeight()/2;
+   float minZ = -CBox::WorldPtr->GetBoxLength()/2;
+
+   unsigned int cellsX = (unsigned int) (CBox::WorldPtr->GetBoxWidth()/cell_size) + 1;
+   unsigned int cellsY = (unsigned int) (CBox::WorldPtr->GetBoxHeight()/cell_size) + 1;
+   unsigned int cellsZ = (unsigned int) (CBox::WorldPtr->GetBoxLength()/cell_size) + 1;
+
+   // Step 1:  Publish.
+   // Freeze everybody's state from the last frame; this is
+   // what all the boids will look at while they flock.
+
+   WorkList.clear();
+
+   for (i = 0; i < FlockCount; i++) {
+
+      ptr = ListOfFlocks[i]->m_first_member;
+
+      while (ptr != NULL) {
+
+         vector *pos = ptr->GetPos();
+
+         unsigned int cx = CellOf(pos->x, minX, cell_size, cellsX);
+         unsigned int cy = CellOf(pos->y, minY, cell_size, cellsY);
+         unsigned int cz = CellOf(pos->z, minZ, cell_size, cellsZ);
+
+         work.cell         = (cx * cellsY + cy) * cellsZ + cz;
+         work.flock_id     = ListOfFlocks[i]->m_id;
+         work.boid         = ptr;
+         work.first_member = ListOfFlocks[i]->m_first_member;
+
+         WorkList.push_back(work);
+
+         ptr->Publish();
+
+         ptr = ptr->GetNext();
+      }
+   }
+
+   n = (int) WorkList.size();
+
+   if (n == 0) return;
+
+   // Step 2:  Spatial chunks.
+   // Sort the boids by grid cell so each chunk covers one
+   // patch of the world.  Nobody reads anything but the
+   // published state, so the order doesn't change the result.
+
+   std::sort(WorkList.begin(), WorkList.end(), CellLess);
+
+   // Step 3:  Flock.
+   // Each boid writes only its own state, so the chunks
+   // can run on as many threads as we've got.
+
+   threads = (pool != NULL) ? pool->GetThreadCount() : 1;
+
+   chunk = n / (threads * ChunksPerThread);
+
+   if (chunk < 1) chunk = 1;
+
+   if (pool != NULL) {
+      pool->ParallelFor(n, chunk, FlockTask, &WorkList[0]);
+   } else {
+      FlockTask(&WorkList[0], 0, n);
+   }
+
+}
+
 //////////////////////
 // rendering functions
 //////////////////////
@@ -25,6 +25,8 @@
 
 #include "CBoid.h"
 
+class CThreadPool;
+
 //
 // class definition
 //
@@ -68,6 +70,15 @@ class CFlock
 
       void Update (void);
 
+      // UpdateBuffered.
+      // Updates every boid in every flock against the state all of
+      // them had at the end of the previous frame, so the result does
+      // not depend on update order.  The boids are sorted into spatial
+      // chunks which are handed out to the threads in pool (pass NULL
+      // to do it all on the calling thread).
+
+      static void UpdateBuffered (CThreadPool *pool);
+
       //////////////////////
       // rendering functions
       //////////////////////
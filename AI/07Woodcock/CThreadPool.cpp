@@ -0,0 +1,175 @@
+//*********************************************************************
+// Name:     CThreadPool.cpp
+// Purpose:  Class methods for the pool of worker threads used to
+//           split the flock update.
+//*********************************************************************
+
+//
+// includes
+//
+
+#include "CThreadPool.h"
+
+//
+// constructor and destructor methods
+//
+
+// Constructor.
+// Creates a pool that runs jobs on num_threads threads in total.
+
+CThreadPool::CThreadPool (int num_threads)
+{
+
+   m_generation = 0;
+   m_busy       = 0;
+   m_quit       = false;
+
+   m_func       = NULL;
+   m_context    = NULL;
+   m_count      = 0;
+   m_chunk_size = 1;
+
+   m_next       = 0;
+
+   // the calling thread does its share of every job,
+   // so we only need to start num_threads - 1 workers
+
+   for (int i = 1; i < num_threads; i++) {
+      m_workers.push_back(std::thread(&CThreadPool::WorkerMain, this));
+   }
+
+}
+
+// Destructor.
+// Stops and joins the worker threads.
+
+CThreadPool::~CThreadPool (void)
+{
+
+   {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_quit = true;
+   }
+
+   m_wake.notify_all();
+
+   for (size_t i = 0; i < m_workers.size(); i++) {
+      m_workers[i].join();
+   }
+
+}
+
+///////////////////
+// public functions
+///////////////////
+
+// GetThreadCount.
+// Returns the # of threads that work on a job.
+
+int CThreadPool::GetThreadCount (void)
+{
+
+   return ((int) m_workers.size() + 1);
+
+}
+
+// ParallelFor.
+// Splits [0, count) into chunks and runs them on all threads.
+
+void CThreadPool::ParallelFor (int count, int chunk_size, TaskFunc func, void *context)
+{
+
+   if (count <= 0) return;
+
+   if (chunk_size < 1) chunk_size = 1;
+
+   // no workers (or only one chunk)...just do it here
+
+   if (m_workers.empty() || count <= chunk_size) {
+      func(context, 0, count);
+      return;
+   }
+
+   // post the job and wake everybody up
+
+   {
+      std::lock_guard<std::mutex> guard(m_lock);
+
+      m_func       = func;
+      m_context    = context;
+      m_count      = count;
+      m_chunk_size = chunk_size;
+      m_next       = 0;
+      m_busy       = (int) m_workers.size();
+
+      m_generation++;
+   }
+
+   m_wake.notify_all();
+
+   // pitch in ourselves
+
+   RunChunks();
+
+   // wait for the stragglers
+
+   std::unique_lock<std::mutex> guard(m_lock);
+
+   while (m_busy > 0) m_done.wait(guard);
+
+}
+
+////////////////////
+// private functions
+////////////////////
+
+// WorkerMain.
+// Sleeps until a job is posted, helps run it, and goes back to sleep.
+
+void CThreadPool::WorkerMain (void)
+{
+
+   unsigned int seen = 0;
+
+   for (;;) {
+
+      {
+         std::unique_lock<std::mutex> guard(m_lock);
+
+         while (!m_quit && m_generation == seen) m_wake.wait(guard);
+
+         if (m_quit) return;
+
+         seen = m_generation;
+      }
+
+      RunChunks();
+
+      {
+         std::lock_guard<std::mutex> guard(m_lock);
+
+         if (--m_busy == 0) m_done.notify_one();
+      }
+   }
+
+}
+
+// RunChunks.
+// Claims and runs chunks of the current job until none are left.
+
+void CThreadPool::RunChunks (void)
+{
+
+   int first, last;
+
+   while ((first = m_next.fetch_add(m_chunk_size)) < m_count) {
+
+      last = first + m_chunk_size;
+
+      if (last > m_count) last = m_count;
+
+      m_func(m_context, first, last);
+
+   }
+
+}
@@ -0,0 +1,95 @@
+//*********************************************************************
+// Name:     CThreadPool.h
+// Purpose:  Class definitions and method prototypes for a small pool
+//           of worker threads used to split the flock update.
+//*********************************************************************
+
+#ifndef _CTHREADPOOL_H
+#define _CTHREADPOOL_H
+
+//
+// includes
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// class definition
+//
+
+class CThreadPool
+{
+
+   public:
+
+      // work function; called with the items [first, last) of a job
+
+      typedef void (*TaskFunc) (void *context, int first, int last);
+
+      ///////////////////////////////
+      // constructors and destructors
+      ///////////////////////////////
+
+      // Constructor.
+      // Creates a pool that runs jobs on num_threads threads in total
+      // (the calling thread counts as one of them).
+
+      CThreadPool (int num_threads);
+
+      // Destructor.
+      // Stops and joins the worker threads.
+
+      ~CThreadPool (void);
+
+      ///////////////////
+      // public functions
+      ///////////////////
+
+      // GetThreadCount.
+      // Returns the # of threads that work on a job.
+
+      int GetThreadCount (void);
+
+      // ParallelFor.
+      // Splits [0, count) into chunks of chunk_size items and hands
+      // them out to the threads until they're all done.  Returns when
+      // every chunk has been processed.
+
+      void ParallelFor (int count, int chunk_size, TaskFunc func, void *context);
+
+   private:
+
+      // WorkerMain.
+      // Loop run by each worker thread.
+
+      void WorkerMain (void);
+
+      // RunChunks.
+      // Claims and runs chunks of the current job until none are left.
+
+      void RunChunks (void);
+
+      std::vector<std::thread>   m_workers;          // worker threads
+
+      std::mutex                 m_lock;             // guards the job fields
+      std::condition_variable    m_wake;             // signals a new job
+      std::condition_variable    m_done;             // signals a finished job
+
+      unsigned int               m_generation;       // bumped for every job
+      int                        m_busy;             // workers still in the job
+      bool                       m_quit;             // set to stop the workers
+
+      TaskFunc                   m_func;             // current job
+      void                       *m_context;
+      int                        m_count;
+      int                        m_chunk_size;
+
+      std::atomic<int>           m_next;             // next unclaimed item
+
+};
+
+#endif
@@ -110,6 +110,14 @@ SOURCE=.\CFlock.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\CThreadPool.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\CThreadPool.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\defaults.h
 # End Source File
 # Begin Source File
@@ -0,0 +1,107 @@
+//*********************************************************************
+// Name:     flockbench.cpp
+// Purpose:  Headless benchmark for the flocking update.  Builds a big
+//           population, runs the in-place CFlock::Update and then the
+//           double-buffered CFlock::UpdateBuffered on 1 to N threads,
+//           and reports boids updated per millisecond for each.
+//
+//           usage:  flockbench [boids] [frames] [max threads] [seed]
+//*********************************************************************
+
+//
+// includes
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <thread>
+
+#include "CThreadPool.h"
+#include "headless.h"
+
+// RunFrames.
+// Steps the world and returns the elapsed time in milliseconds.
+// threads == 0 means the original in-place update.
+
+double RunFrames (int frames, int threads)
+{
+
+   CThreadPool *pool = (threads > 0) ? new CThreadPool(threads) : NULL;
+
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+   for (int f = 0; f < frames; f++) {
+
+      if (threads == 0) {
+         for (int i = 0; i < CFlock::FlockCount; i++) {
+            CFlock::ListOfFlocks[i]->Update();
+         }
+      } else {
+         CFlock::UpdateBuffered(pool);
+      }
+   }
+
+   std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+   delete pool;
+
+   return (elapsed.count());
+
+}
+
+// main
+// Makes it go.
+
+int main (int argc, char *argv[])
+{
+
+   int          num_boids   = (argc > 1) ? atoi(argv[1]) : 2000;
+   int          frames      = (argc > 2) ? atoi(argv[2]) : 50;
+   int          max_threads = (argc > 3) ? atoi(argv[3]) : (int) std::thread::hardware_concurrency();
+   unsigned int seed        = (argc > 4) ? (unsigned int) atoi(argv[4]) : 1;
+
+   double       ms;
+
+   unsigned int reference = 0;
+
+   if (max_threads < 1) max_threads = 1;
+
+   printf("%d boids, %d flocks, %d frames, seed %u\n\n", num_boids, MaxFlocks, frames, seed);
+   printf("%-12s %8s %10s %12s  %s\n", "mode", "threads", "ms", "boids/ms", "checksum");
+
+   // in-place update, the way the demo does it
+
+   BuildWorld(num_boids, seed);
+
+   ms = RunFrames(frames, 0);
+
+   printf("%-12s %8d %10.1f %12.1f  %08x\n", "in-place", 1, ms,
+          (num_boids * (double) frames) / ms, WorldChecksum());
+
+   DestroyWorld();
+
+   // double-buffered update on 1..N threads; every
+   // thread count has to come up with the same answer
+
+   for (int threads = 1; threads <= max_threads; threads++) {
+
+      BuildWorld(num_boids, seed);
+
+      ms = RunFrames(frames, threads);
+
+      unsigned int sum = WorldChecksum();
+
+      if (threads == 1) reference = sum;
+
+      printf("%-12s %8d %10.1f %12.1f  %08x%s\n", "buffered", threads, ms,
+             (num_boids * (double) frames) / ms, sum,
+             (sum == reference) ? "" : "  MISMATCH");
+
+      DestroyWorld();
+   }
+
+   return (0);
+
+}
@@ -0,0 +1,141 @@
+//*********************************************************************
+// Name:     flockregress.cpp
+// Purpose:  Headless, deterministic flocking run for regression and
+//           performance tracking.  Builds a population from a seed,
+//           steps it a fixed number of frames, prints a checksum of
+//           the final state and how long each phase took.  If an
+//           expected checksum is given the exit code says whether the
+//           run matched it.
+//
+//           usage:  flockregress [boids] [frames] [seed]
+//                                [inplace|buffered] [expected checksum]
+//*********************************************************************
+
+//
+// includes
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "headless.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Millisecs.
+// Returns the milliseconds between two clock readings.
+
+double Millisecs (Clock::time_point start, Clock::time_point end)
+{
+
+   return (std::chrono::duration<double, std::milli>(end - start).count());
+
+}
+
+// main
+// Makes it go.
+
+int main (int argc, char *argv[])
+{
+
+   int          num_boids = (argc > 1) ? atoi(argv[1]) : MaxBoids;
+   int          frames    = (argc > 2) ? atoi(argv[2]) : 1000;
+   unsigned int seed      = (argc > 3) ? (unsigned int) atoi(argv[3]) : 1;
+   bool         buffered  = (argc > 4) && (strcmp(argv[4], "buffered") == 0);
+
+   double       build_ms, update_ms, check_ms, destroy_ms;
+   double       frame_ms, min_ms = 0.0, max_ms = 0.0;
+
+   unsigned int sum;
+
+   Clock::time_point t0, t1;
+
+   // Phase 1:  build the population
+
+   t0 = Clock::now();
+
+   BuildWorld(num_boids, seed);
+
+   t1 = Clock::now();
+
+   build_ms = Millisecs(t0, t1);
+
+   // Phase 2:  step it
+
+   update_ms = 0.0;
+
+   for (int f = 0; f < frames; f++) {
+
+      t0 = Clock::now();
+
+      if (buffered) {
+         CFlock::UpdateBuffered(NULL);
+      } else {
+         for (int i = 0; i < CFlock::FlockCount; i++) {
+            CFlock::ListOfFlocks[i]->Update();
+         }
+      }
+
+      t1 = Clock::now();
+
+      frame_ms = Millisecs(t0, t1);
+
+      if (f == 0 || frame_ms < min_ms) min_ms = frame_ms;
+      if (f == 0 || frame_ms > max_ms) max_ms = frame_ms;
+
+      update_ms += frame_ms;
+   }
+
+   // Phase 3:  checksum the final state
+
+   t0 = Clock::now();
+
+   sum = WorldChecksum();
+
+   t1 = Clock::now();
+
+   check_ms = Millisecs(t0, t1);
+
+   // Phase 4:  tear it down
+
+   t0 = Clock::now();
+
+   DestroyWorld();
+
+   t1 = Clock::now();
+
+   destroy_ms = Millisecs(t0, t1);
+
+   // report
+
+   printf("boids %d  flocks %d  frames %d  seed %u  mode %s\n",
+          num_boids, MaxFlocks, frames, seed, buffered ? "buffered" : "inplace");
+   printf("checksum %08x\n\n", sum);
+
+   printf("%-10s %12s %12s %12s %12s\n", "phase", "total ms", "ave ms", "min ms", "max ms");
+   printf("%-10s %12.3f\n", "build", build_ms);
+   printf("%-10s %12.3f %12.4f %12.4f %12.4f\n", "update", update_ms,
+          (frames > 0) ? update_ms / frames : 0.0, min_ms, max_ms);
+   printf("%-10s %12.3f\n", "checksum", check_ms);
+   printf("%-10s %12.3f\n", "destroy", destroy_ms);
+
+   // compare against the expected answer, if we were given one
+
+   if (argc > 5) {
+
+      unsigned int expected = (unsigned int) strtoul(argv[5], NULL, 16);
+
+      if (sum != expected) {
+         printf("\nFAILED:  expected checksum %08x\n", expected);
+         return (1);
+      }
+
+      printf("\npassed\n");
+   }
+
+   return (0);
+
+}
@@ -0,0 +1,109 @@
+//*********************************************************************
+// Name:     headless.cpp
+// Purpose:  Helpers shared by the drivers that run the flock without
+//           a window.
+//*********************************************************************
+
+//
+// includes
+//
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "headless.h"
+
+// flocking debug globals (referenced by the draw code we link against)
+
+bool  gDrawAxes           = FALSE;
+bool  gDrawPerceptionDist = FALSE;
+bool  gDrawKeepawayDist   = FALSE;
+bool  gDrawSeparationDist = FALSE;
+
+// the population under test
+
+CBox   *Box1;
+CFlock *Flocks[MaxFlocks];
+CBoid  **Boids;
+int    NumBoids;
+
+// BuildWorld.
+// Creates a seeded population of num_boids boids.
+
+void BuildWorld (int num_boids, unsigned int seed)
+{
+
+   int i;
+
+   float side = 50.0f * (float) pow(num_boids / (float) MaxBoids, 1.0/3.0);
+
+   if (side < 50.0f) side = 50.0f;
+
+   srand(seed);
+
+   Box1 = new CBox(side, side, side);
+
+   NumBoids = num_boids;
+   Boids    = new CBoid * [num_boids];
+
+   for (i = 0; i < num_boids; i++) {
+      Boids[i] = new CBoid((short) i);
+   }
+
+   for (i = 0; i < MaxFlocks; i++) {
+      Flocks[i] = new CFlock();
+   }
+
+   for (i = 0; i < num_boids; i++) {
+      Flocks[i % MaxFlocks]->AddTo(Boids[i]);
+   }
+
+}
+
+// DestroyWorld.
+// Undoes BuildWorld.
+
+void DestroyWorld (void)
+{
+
+   int i;
+
+   for (i = MaxFlocks - 1; i >= 0; i--) {
+      delete Flocks[i];
+   }
+
+   for (i = 0; i < NumBoids; i++) {
+      delete Boids[i];
+   }
+
+   delete [] Boids;
+
+   delete Box1;
+
+}
+
+// WorldChecksum.
+// Hashes the position and orientation of every boid.
+
+unsigned int WorldChecksum (void)
+{
+
+   unsigned int hash = 2166136261u;
+
+   for (int i = 0; i < NumBoids; i++) {
+
+      vector *pos    = Boids[i]->GetPos();
+      vector *orient = Boids[i]->GetOrient();
+
+      float state[6] = { pos->x, pos->y, pos->z, orient->x, orient->y, orient->z };
+
+      unsigned char *bytes = (unsigned char *) state;
+
+      for (int j = 0; j < (int) sizeof(state); j++) {
+         hash = (hash ^ bytes[j]) * 16777619u;
+      }
+   }
+
+   return (hash);
+
+}
@@ -0,0 +1,52 @@
+//*********************************************************************
+// Name:     headless.h
+// Purpose:  Helpers shared by the drivers that run the flock without
+//           a window (flockbench, flockregress): building a seeded
+//           population, tearing it down and checksumming it.
+//
+//           Programming/14Rabin's flockregress uses these too.  This
+//           directory has no flocking headers of its own, so CBox.h,
+//           CBoid.h and CFlock.h come from whichever gem is being
+//           built (its directory must be on the include path), and the
+//           helpers are compiled against that gem's classes.
+//*********************************************************************
+
+#ifndef _HEADLESS_H
+#define _HEADLESS_H
+
+//
+// includes
+//
+
+#include "CBox.h"
+#include "CBoid.h"
+#include "CFlock.h"
+
+//
+// the population under test
+//
+
+extern CBox   *Box1;
+extern CFlock *Flocks[MaxFlocks];
+extern CBoid  **Boids;
+extern int    NumBoids;
+
+// BuildWorld.
+// Creates num_boids boids spread round-robin over MaxFlocks flocks,
+// with every random number drawn from seed.  The world grows with
+// the population so the density matches the demo's.
+
+void BuildWorld (int num_boids, unsigned int seed);
+
+// DestroyWorld.
+// Undoes BuildWorld.
+
+void DestroyWorld (void);
+
+// WorldChecksum.
+// Hashes the position and orientation of every boid (FNV-1a over
+// the raw bits), so runs that should agree can be compared exactly.
+
+unsigned int WorldChecksum (void);
+
+#endif
@@ -34,149 +34,7 @@
 #include <f2c.h>
 #endif
 
-//////////////////////////////////////////////////////////////////////////////
-//
-// CFuzzyRule: A Simple class to encapsulate a fuzzy logic rule.
-//
-// Each fuzzy logic rule is composed of four points: 
-// min 0%, min 100%, max 100%, and max 0%.  Together, these four points form
-// a sloped graph, which starts out at min 0%, hits 100% at min100%, continues
-// at 100% until max 100%, then tapers off, finally hitting 0% again at max
-// 0%.  So, if you were to graph these on a x/y plane, with y ranging from
-// 0 to 1 and x ranging from min0 to max0, you'd get a shape resembling a
-// trapezoid (or a triangle, if min100% = max100%).
-//
-// Yes, this is a relatively simplistic way to represent a fuzzy set.  Real
-// fuzzy set classes would be able to accurately model discrete points, 
-// and could have any number of key points on them.
-// 
-// but, the more complex your graph of a fuzzy set, the more complex your
-// calculations for trueness.  For the purposes of illustration, I've opted
-// to go with what I feel is the best compromise between simplicity and
-// flexibility.
-//
-//////////////////////////////////////////////////////////////////////////////
-class CFuzzyRule
-{
-public:
-  CFuzzyRule() { Init(); }
-  CFuzzyRule(char *name, float min0, float min100, float max100, float max0) {
-    Init();
-    Setup(name, min0, min100, max100, max0);
-  }
-
-  void Setup(char *name, float min0, float min100, float max100, float max0) {
-    Init();
-    m_min0percent   = min0;
-    m_min100percent = min100;
-    m_max0percent   = max0;
-    m_max100percent = max100;
-    if (strlen(name) < sizeof(m_name)) { strcpy(m_name, name); }
-  }
-    
-  ~CFuzzyRule() { }
-  float IsTrueToWhatDegree(float datapoint);
-  char *GetName(void) { return(m_name); }
-
-private:
-  void Init(void) { 
-    m_min100percent = m_max100percent = m_min0percent = m_max0percent = 0.0f; 
-    memset(m_name, 0, sizeof(m_name));
-  }
-  char  m_name[256];     // name of this fuzzy rule
-  float m_min100percent; // smallest number considered 100% true
-  float m_max100percent; // biggest number considered 100% true                                         
-  float m_min0percent;   // smallest number still considered within fuzzy rule
-  float m_max0percent;   // biggest number still considered within fuzzy rule
-};
-
-/****************************************************************************
-
- IsTrueToWhatDegree: determines to what degree a datapoint is "true" for this
- fuzzy rule.  A value of 1.0 means completely true, and a value of 0.0 means
- completely false.  Everything in between is "fuzzy."
-
- ****************************************************************************/
-float CFuzzyRule::IsTrueToWhatDegree(float datapoint)
-{
-  // four possibilities here:
-  // 1) it is completely outside the rule (0%)
-  // 2) it is completely inside the rule (100%)
-  // 3) it is partially inside the rule, on the min side
-  // 4) it is partially inside the rule, on the max side
-
-  if (datapoint < m_min0percent || datapoint > m_max0percent) {
-    // it's completely outside the rule!
-    return(0.0f);
-  }
-
-  if (datapoint >= m_min100percent && datapoint <= m_max100percent) {
-    // it's completely true!
-    return(1.0f);
-  }
-
-  if (datapoint >= m_min0percent && datapoint <= m_min100percent) {
-    // it's partially true, on the minimum side.
-    // evaluate the degree of "trueness."  note that this is a simple
-    // "scale" evaluation for the purposes of example only; your real fuzzy
-    // code would probably be more involved than this.
-
-    // assuming m_min0percent is zero and m_min100percent is 1, figure out 
-    // where datapoint is.
-
-    // figure out the "width" of our "grey area."
-    float widthofgreyarea = (float)fabs(m_min0percent - m_min100percent);
-
-    // determine what percentage of that width is "behind" (<) datapoint.
-    float relativedatapoint = datapoint-m_min0percent;
-
-    return((float)fabs(relativedatapoint / widthofgreyarea));
-  }
-
-  // note: this is cut/pasted to demonstrate the logic flow more clearly.
-  // eliminating this code duplication is left as an excercise for the reader. :)
-
-  if (datapoint >= m_max100percent && datapoint <= m_max0percent) {
-    // it's partially true, on the maximum side.
-    // evaluate the degree of "trueness."  note that this is a simple
-    // "scale" evaluation for the purposes of example only; your real fuzzy
-    // code would probably be more involved than this.
-
-    // assuming m_max0percent is zero and m_max100percent is 1, figure out 
-    // where datapoint is.
-
-    // figure out the "width" of our "grey area."
-    float widthofgreyarea = (float)fabs(m_max0percent - m_max100percent);
-
-    // determine what percentage of that width is "behind" (<) datapoint.
-    float relativedatapoint = datapoint-m_max0percent;
-
-    return((float)fabs(relativedatapoint / widthofgreyarea));
-  }
-
-  // we should never get here!
-  assert(0);
-  return(0);
-}
-
-/****************************************************************************
-
- FuzzyAND: ANDs two fuzzy datapoints / rules together.
-
- ****************************************************************************/
-float FuzzyAND(CFuzzyRule &rule1, float data1, CFuzzyRule &rule2, float data2)
-{
-  // a fuzzy and operation is only as true as the minimum trueness of both pairs.
-  // in other words, a fuzzy logic operation is only as true as its weakest trueness.
-  float true1 = rule1.IsTrueToWhatDegree(data1);
-  float true2 = rule2.IsTrueToWhatDegree(data2);
-
-#ifdef _WIN32
-  return(__min(true1, true2));
-#else
-  return(min(true1, true2));
-#endif
-}
+#include "fuzzyrule.h"
 
 /****************************************************************************
 
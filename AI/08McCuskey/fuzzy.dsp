@@ -87,10 +87,18 @@ LINK32=link.exe
 
 SOURCE=.\fuzzy.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\fuzzyrule.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
+# Begin Source File
+
+SOURCE=.\fuzzyrule.h
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 
@@ -0,0 +1,229 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// fuzzybatch.cpp : Runs the safe-driver rule base from fuzzy.cpp over a whole
+// crowd of agents, once the old way (IsTrueToWhatDegree / FuzzyAND, one
+// agent at a time) and once with CFuzzyEngine, then compares the answers
+// and the times.  Finally it samples the rule base into CFuzzyTables of a
+// few sizes and reports how fast and how accurate those are.
+//
+// usage: fuzzybatch [number of agents] [passes]
+//
+// How much faster the engine is depends heavily on the compiler and
+// flags, since they decide how well the one-at-a-time path is optimised:
+// anywhere from about 2x to 12x has been seen at -O2 and -O3.  Compare
+// both paths from the same build, and don't expect one figure.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "fuzzyrule.h"
+#include "fuzzyengine.h"
+#include "fuzzytable.h"
+
+// crisp values for the five courses of action, from -1 (brake hard) to
+// 1 (floor it), used when outputs are averaged together.
+static float actionvalue[5] = { -1.0f, -0.5f, 0.0f, 0.5f, 1.0f };
+
+// the action matrix from fuzzy.cpp (Table 1 in the Gem), by index:
+// 0 = brake hard, 1 = slow down, 2 = maintain speed, 3 = speed up,
+// 4 = floor it.  indexed [distance][distance delta].
+static int actionmatrix[5][5] = {
+  { 0, 0, 1, 1, 2 },
+  { 0, 1, 1, 2, 3 },
+  { 1, 1, 2, 3, 3 },
+  { 1, 2, 3, 3, 4 },
+  { 2, 3, 3, 4, 4 }
+};
+
+/****************************************************************************
+
+ EvaluateOneAgent: the fuzzy.cpp way.  builds the action matrix for one
+ agent, sums up the score for each action, then defuzzifies.
+
+ ****************************************************************************/
+void EvaluateOneAgent(CFuzzyRule *distancerule, CFuzzyRule *distancedeltarule,
+                      float distance, float distancedelta,
+                      float *outvalue, int *outaction)
+{
+  float actionscore[5] = { 0, 0, 0, 0, 0 };
+  int x, y;
+
+  for (x=0; x < 5; x++) {
+    for (y=0; y < 5; y++) {
+      actionscore[actionmatrix[x][y]] +=
+        FuzzyAND(distancerule[x], distance, distancedeltarule[y], distancedelta);
+    }
+  }
+
+  float numerator = 0.0f, denominator = 0.0f;
+  int maxindex = 0; float maxvalue = 0.0f;
+  for (x=0; x < 5; x++) {
+    numerator += actionscore[x] * actionvalue[x];
+    denominator += actionscore[x];
+    if (actionscore[x] > maxvalue) { maxindex = x; maxvalue = actionscore[x]; }
+  }
+
+  *outvalue = (denominator > 0.0f) ? numerator / denominator : 0.0f;
+  *outaction = maxindex;
+}
+
+/****************************************************************************
+
+ main: program execution starts here.
+
+ ****************************************************************************/
+int main(int argc, char* argv[])
+{
+  int numagents = (argc > 1) ? atoi(argv[1]) : 100000;
+  int passes    = (argc > 2) ? atoi(argv[2]) : 20;
+  int agent, pass;
+
+  // the same fuzzy sets fuzzy.cpp sets up.
+  CFuzzyRule distancerule[5];
+
+  distancerule[0].Setup("Very Small", -999999.0f, -999999.0f, 0.5f, 1.0f);
+  distancerule[1].Setup("Small", 0.5f, 1.0f, 1.0f, 2.0f);
+  distancerule[2].Setup("Perfect", 1.0f, 2.0f, 2.0f, 3.0f);
+  distancerule[3].Setup("Big", 2.0f, 3.0f, 3.0f, 4.0f);
+  distancerule[4].Setup("Very Big", 3.0, 5.0, 999999.0, 999999.0);
+
+  CFuzzyRule distancedeltarule[5];
+
+  distancedeltarule[0].Setup("Shrinking Fast", -999999.0f, -1.0f, -1.0f, -0.5f);
+  distancedeltarule[1].Setup("Shrinking", -1.0f, -0.5f, -0.5f, 0.0f);
+  distancedeltarule[2].Setup("Stable", -0.5f, 0.0f, 0.0f, 0.5f);
+  distancedeltarule[3].Setup("Growing", 0.0f, 0.5f, 0.5f, 1.0f);
+  distancedeltarule[4].Setup("Growing Fast", 0.5f, 1.0f, 1.0f, 999999.0f);
+
+  // compile them, and the action matrix, into an engine.
+  CFuzzyEngine engine;
+
+  engine.AddInput(distancerule, 5);
+  engine.AddInput(distancedeltarule, 5);
+
+  engine.AddAction("Brake Hard!", actionvalue[0]);
+  engine.AddAction("Slow Down!", actionvalue[1]);
+  engine.AddAction("Maintain Speed!", actionvalue[2]);
+  engine.AddAction("Speed up!", actionvalue[3]);
+  engine.AddAction("Floor it!", actionvalue[4]);
+
+  for (int x=0; x < 5; x++) {
+    for (int y=0; y < 5; y++) {
+      int setindex[2] = { x, y };
+      engine.AddRule(setindex, actionmatrix[x][y]);
+    }
+  }
+
+  engine.Compile();
+
+  // a crowd of drivers.  some of them land exactly on the set boundaries,
+  // since that's where the two methods are most likely to disagree.
+  float *distance      = new float[numagents];
+  float *distancedelta = new float[numagents];
+  float *refvalue      = new float[numagents];
+  int   *refaction     = new int[numagents];
+  float *batchvalue    = new float[numagents];
+  int   *batchaction   = new int[numagents];
+
+  srand(1);
+  for (agent=0; agent < numagents; agent++) {
+    if (agent % 16 == 0) {
+      distance[agent]      = (float)(rand() % 13) * 0.5f;
+      distancedelta[agent] = (float)(rand() % 7) * 0.5f - 1.5f;
+    } else {
+      distance[agent]      = 6.0f * rand() / (float)RAND_MAX;
+      distancedelta[agent] = 3.0f * rand() / (float)RAND_MAX - 1.5f;
+    }
+  }
+
+  const float *inputs[2] = { distance, distancedelta };
+
+  printf("Fuzzy rule base: %d inputs, %d actions, %d rules, %d agents, %d passes\n\n",
+    engine.GetNumInputs(), engine.GetNumActions(), engine.GetNumRules(), numagents, passes);
+
+  // time the one-agent-at-a-time way.
+  clock_t start = clock();
+  for (pass=0; pass < passes; pass++) {
+    for (agent=0; agent < numagents; agent++) {
+      EvaluateOneAgent(distancerule, distancedeltarule, distance[agent], distancedelta[agent],
+        &refvalue[agent], &refaction[agent]);
+    }
+  }
+  double refseconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  // time the batch way.
+  start = clock();
+  for (pass=0; pass < passes; pass++) {
+    engine.Evaluate(inputs, numagents, batchvalue, batchaction);
+  }
+  double batchseconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  // compare.
+  float maxerror = 0.0f;
+  int mismatches = 0;
+  for (agent=0; agent < numagents; agent++) {
+    float error = (float)fabs(refvalue[agent] - batchvalue[agent]);
+    if (error > maxerror) { maxerror = error; }
+    if (refaction[agent] != batchaction[agent]) { mismatches++; }
+  }
+
+  double total = (double)numagents * passes;
+
+  printf("one at a time : %8.3f sec  %10.1f agents/ms\n", refseconds,
+    refseconds > 0 ? total / (refseconds * 1000.0) : 0.0);
+  printf("batch engine  : %8.3f sec  %10.1f agents/ms\n", batchseconds,
+    batchseconds > 0 ? total / (batchseconds * 1000.0) : 0.0);
+  if (batchseconds > 0) { printf("speedup       : %8.2fx\n", refseconds / batchseconds); }
+
+  printf("\nlargest difference in output: %g\n", maxerror);
+  printf("agents with a different action: %d\n", mismatches);
+
+  // now the lookup tables.  the ranges cover every slope of every set, so
+  // clamping to them loses nothing.
+  static int tablesizes[] = { 8, 16, 32, 64, 128, 256 };
+
+  printf("\nlookup tables (distance 0..6, distance delta -1.5..1.5):\n");
+  printf("%9s %9s %12s %10s %10s %10s %10s  %s\n", "size", "bytes", "agents/ms",
+    "crowd max", "grid max", "grid mean", "grid rms", "worst at");
+
+  for (int t=0; t < (int)(sizeof(tablesizes) / sizeof(tablesizes[0])); t++) {
+    CFuzzyTable table;
+    int n = tablesizes[t];
+
+    table.Build(engine, 0.0f, 6.0f, n, -1.5f, 1.5f, n);
+
+    start = clock();
+    for (pass=0; pass < passes; pass++) {
+      table.Lookup(distance, distancedelta, numagents, batchvalue);
+    }
+    double tableseconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    // error against the crowd's exact answers, and against a dense grid.
+    float crowderror = 0.0f;
+    for (agent=0; agent < numagents; agent++) {
+      float error = (float)fabs(refvalue[agent] - batchvalue[agent]);
+      if (error > crowderror) { crowderror = error; }
+    }
+
+    FuzzyTableError griderror = table.MeasureError(engine, 1000);
+
+    printf("%4dx%-4d %9d %12.1f %10.5f %10.5f %10.5f %10.5f  (%.3f, %.3f)\n",
+      n, n, table.GetSizeInBytes(),
+      tableseconds > 0 ? total / (tableseconds * 1000.0) : 0.0,
+      crowderror, griderror.maxerror, griderror.meanerror, griderror.rmserror,
+      griderror.worstx, griderror.worsty);
+  }
+
+  delete [] distance;
+  delete [] distancedelta;
+  delete [] refvalue;
+  delete [] refaction;
+  delete [] batchvalue;
+  delete [] batchaction;
+
+  return((maxerror < 1.0e-4f && mismatches == 0) ? 0 : 1);
+}
@@ -0,0 +1,307 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// fuzzyengine.cpp : A batch fuzzy inference engine.  See fuzzyengine.h.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <assert.h>
+
+#include "fuzzyengine.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// FVec: four floats, one per agent.  With SSE these are __m128s; anywhere
+// else they're a little struct, and the compiler is on its own.  Either way
+// the evaluation code below is written once, with no branches on the data.
+//
+//////////////////////////////////////////////////////////////////////////////
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+
+#include <xmmintrin.h>
+
+typedef __m128 FVec;
+
+inline FVec  FVecSet(float f)                { return(_mm_set1_ps(f)); }
+inline FVec  FVecLoad(const float *p)        { return(_mm_loadu_ps(p)); }
+inline void  FVecStore(float *p, FVec a)     { _mm_storeu_ps(p, a); }
+inline FVec  FVecAdd(FVec a, FVec b)         { return(_mm_add_ps(a, b)); }
+inline FVec  FVecSub(FVec a, FVec b)         { return(_mm_sub_ps(a, b)); }
+inline FVec  FVecMul(FVec a, FVec b)         { return(_mm_mul_ps(a, b)); }
+inline FVec  FVecDiv(FVec a, FVec b)         { return(_mm_div_ps(a, b)); }
+inline FVec  FVecMin(FVec a, FVec b)         { return(_mm_min_ps(a, b)); }
+inline FVec  FVecMax(FVec a, FVec b)         { return(_mm_max_ps(a, b)); }
+
+// where a > b pick x, else pick y.
+inline FVec  FVecSelectGreater(FVec a, FVec b, FVec x, FVec y)
+{
+  FVec mask = _mm_cmpgt_ps(a, b);
+  return(_mm_or_ps(_mm_and_ps(mask, x), _mm_andnot_ps(mask, y)));
+}
+
+#else
+
+struct FVec { float v[4]; };
+
+inline FVec FVecSet(float f)
+{
+  FVec r; r.v[0] = r.v[1] = r.v[2] = r.v[3] = f; return(r);
+}
+inline FVec FVecLoad(const float *p)
+{
+  FVec r; memcpy(r.v, p, sizeof(r.v)); return(r);
+}
+inline void FVecStore(float *p, FVec a) { memcpy(p, a.v, sizeof(a.v)); }
+
+#define FVEC_OP(name, expr) \
+  inline FVec name(FVec a, FVec b) { \
+    FVec r; for (int i=0; i < 4; i++) { float x = a.v[i], y = b.v[i]; r.v[i] = (expr); } return(r); \
+  }
+FVEC_OP(FVecAdd, x + y)
+FVEC_OP(FVecSub, x - y)
+FVEC_OP(FVecMul, x * y)
+FVEC_OP(FVecDiv, x / y)
+FVEC_OP(FVecMin, x < y ? x : y)
+FVEC_OP(FVecMax, x > y ? x : y)
+#undef FVEC_OP
+
+inline FVec FVecSelectGreater(FVec a, FVec b, FVec x, FVec y)
+{
+  FVec r; for (int i=0; i < 4; i++) { r.v[i] = (a.v[i] > b.v[i]) ? x.v[i] : y.v[i]; } return(r);
+}
+
+#endif
+
+// slope used for a ramp of zero width (a vertical edge).  big enough that
+// anything past the edge saturates, small enough not to overflow when
+// multiplied by the +/-999999 "infinities" fuzzy.cpp uses.
+#define FUZZY_VERTICAL_SLOPE 1.0e30f
+
+/****************************************************************************
+
+ Init: empties the rule base.
+
+ ****************************************************************************/
+void CFuzzyEngine::Init(void)
+{
+  m_numinputs = m_numactions = m_numrules = m_nummembers = 0;
+  m_compiled = false;
+  memset(m_numsets, 0, sizeof(m_numsets));
+  memset(m_sets, 0, sizeof(m_sets));
+  memset(m_actionname, 0, sizeof(m_actionname));
+}
+
+/****************************************************************************
+
+ AddInput: adds an input variable, described by numsets fuzzy sets (the
+ engine keeps the pointer, so the sets must outlive it).  Returns the input's
+ index.
+
+ ****************************************************************************/
+int CFuzzyEngine::AddInput(CFuzzyRule *sets, int numsets)
+{
+  if (m_numinputs >= FUZZY_MAX_INPUTS || numsets > FUZZY_MAX_SETS) { return(-1); }
+
+  m_sets[m_numinputs] = sets;
+  m_numsets[m_numinputs] = numsets;
+  m_compiled = false;
+  return(m_numinputs++);
+}
+
+/****************************************************************************
+
+ AddAction: adds a possible course of action.  crispvalue is the number the
+ action stands for when outputs are averaged together (for a car, maybe
+ -1 for "brake hard" up to 1 for "floor it").  Returns the action's index.
+
+ ****************************************************************************/
+int CFuzzyEngine::AddAction(const char *name, float crispvalue)
+{
+  if (m_numactions >= FUZZY_MAX_ACTIONS) { return(-1); }
+
+  if (strlen(name) < sizeof(m_actionname[0])) { strcpy(m_actionname[m_numactions], name); }
+  m_actionvalue[m_numactions] = crispvalue;
+  m_compiled = false;
+  return(m_numactions++);
+}
+
+/****************************************************************************
+
+ AddRule: adds "IF input 0 is setindex[0] AND input 1 is setindex[1] ...
+ THEN action".  setindex needs one entry per input added so far.  Returns
+ the rule's index.
+
+ ****************************************************************************/
+int CFuzzyEngine::AddRule(const int *setindex, int action)
+{
+  if (m_numrules >= FUZZY_MAX_RULES) { return(-1); }
+
+  for (int i=0; i < m_numinputs; i++) {
+    assert(setindex[i] >= 0 && setindex[i] < m_numsets[i]);
+    m_ruleset[m_numrules][i] = setindex[i];
+  }
+  assert(action >= 0 && action < m_numactions);
+  m_ruleaction[m_numrules] = action;
+  m_compiled = false;
+  return(m_numrules++);
+}
+
+/****************************************************************************
+
+ Compile: builds the membership function and rule tables.
+
+ Each trapezoid from CFuzzyRule is split into a rising ramp from min0% to
+ min100% and a falling ramp from max100% to max0%.  Between those two
+ ramps the set is 100% true, so
+
+   trueness = clamp(min(rising, falling), 0, 1)
+
+ which is exactly what IsTrueToWhatDegree works out with its ifs.  A ramp
+ of zero width gets a huge slope plus a bias of 1, so a datapoint sitting
+ right on the edge still counts as 100% true, the same as the original.
+
+ ****************************************************************************/
+void CFuzzyEngine::Compile(void)
+{
+  int input, set, rule;
+
+  m_nummembers = 0;
+  for (input=0; input < m_numinputs; input++) {
+    m_setbase[input] = m_nummembers;
+    m_nummembers += m_numsets[input];
+
+    for (set=0; set < m_numsets[input]; set++) {
+      CFuzzyRule &fr = m_sets[input][set];
+      float leftwidth  = fr.GetMin100Percent() - fr.GetMin0Percent();
+      float rightwidth = fr.GetMax0Percent() - fr.GetMax100Percent();
+
+      m_leftstart[input][set] = fr.GetMin0Percent();
+      m_rightend[input][set]  = fr.GetMax0Percent();
+
+      if (leftwidth > 0.0f) {
+        m_leftslope[input][set] = 1.0f / leftwidth;
+        m_leftbias[input][set]  = 0.0f;
+      } else {
+        m_leftslope[input][set] = FUZZY_VERTICAL_SLOPE;
+        m_leftbias[input][set]  = 1.0f;
+      }
+
+      if (rightwidth > 0.0f) {
+        m_rightslope[input][set] = 1.0f / rightwidth;
+        m_rightbias[input][set]  = 0.0f;
+      } else {
+        m_rightslope[input][set] = FUZZY_VERTICAL_SLOPE;
+        m_rightbias[input][set]  = 1.0f;
+      }
+    }
+  }
+
+  for (rule=0; rule < m_numrules; rule++) {
+    for (input=0; input < m_numinputs; input++) {
+      m_rulemember[rule][input] = m_setbase[input] + m_ruleset[rule][input];
+    }
+  }
+
+  m_compiled = true;
+}
+
+/****************************************************************************
+
+ EvaluateBlock: runs the rule base for four agents.  in holds the four
+ agents' values of input 0, then the four values of input 1, and so on.
+
+ ****************************************************************************/
+void CFuzzyEngine::EvaluateBlock(const float *in, float *outvalue, int *outaction) const
+{
+  FVec member[FUZZY_MAX_INPUTS * FUZZY_MAX_SETS];
+  FVec score[FUZZY_MAX_ACTIONS];
+  FVec zero = FVecSet(0.0f), one = FVecSet(1.0f);
+  int input, set, rule, action;
+
+  // step 1: how true is each input for each of its fuzzy sets?
+  for (input=0; input < m_numinputs; input++) {
+    FVec x = FVecLoad(in + input*4);
+    FVec *m = member + m_setbase[input];
+
+    for (set=0; set < m_numsets[input]; set++) {
+      FVec rising  = FVecAdd(FVecMul(FVecSub(x, FVecSet(m_leftstart[input][set])),
+                                     FVecSet(m_leftslope[input][set])),
+                             FVecSet(m_leftbias[input][set]));
+      FVec falling = FVecAdd(FVecMul(FVecSub(FVecSet(m_rightend[input][set]), x),
+                                     FVecSet(m_rightslope[input][set])),
+                             FVecSet(m_rightbias[input][set]));
+
+      m[set] = FVecMin(FVecMax(FVecMin(rising, falling), zero), one);
+    }
+  }
+
+  // step 2: fire each rule (fuzzy AND = minimum) and add it to its action's score.
+  for (action=0; action < m_numactions; action++) { score[action] = zero; }
+
+  for (rule=0; rule < m_numrules; rule++) {
+    FVec strength = member[m_rulemember[rule][0]];
+    for (input=1; input < m_numinputs; input++) {
+      strength = FVecMin(strength, member[m_rulemember[rule][input]]);
+    }
+    score[m_ruleaction[rule]] = FVecAdd(score[m_ruleaction[rule]], strength);
+  }
+
+  // step 3: defuzzify.  the weighted average of the crisp values, plus the
+  // highest scoring action (first one wins a tie, same as fuzzy.cpp).
+  FVec numerator = zero, denominator = zero;
+  FVec best = zero, bestindex = zero;
+
+  for (action=0; action < m_numactions; action++) {
+    numerator   = FVecAdd(numerator, FVecMul(score[action], FVecSet(m_actionvalue[action])));
+    denominator = FVecAdd(denominator, score[action]);
+    bestindex   = FVecSelectGreater(score[action], best, FVecSet((float)action), bestindex);
+    best        = FVecMax(best, score[action]);
+  }
+
+  // nothing fired means a zero numerator too, so the output comes out 0.
+  FVecStore(outvalue, FVecDiv(numerator, FVecMax(denominator, FVecSet(1.0e-30f))));
+
+  if (outaction) {
+    float index[4];
+    FVecStore(index, bestindex);
+    for (int i=0; i < 4; i++) { outaction[i] = (int)index[i]; }
+  }
+}
+
+/****************************************************************************
+
+ Evaluate: runs the rule base for every agent, four at a time.  A partial
+ block at the end gets copied into a padded buffer first.
+
+ ****************************************************************************/
+void CFuzzyEngine::Evaluate(const float * const *inputs, int numagents,
+                            float *outvalue, int *outaction) const
+{
+  float in[FUZZY_MAX_INPUTS * 4];
+  float value[4];
+  int   action[4];
+  int   agent, input, i;
+
+  assert(m_compiled);
+
+  for (agent=0; agent + 4 <= numagents; agent += 4) {
+    for (input=0; input < m_numinputs; input++) {
+      memcpy(in + input*4, inputs[input] + agent, 4 * sizeof(float));
+    }
+    EvaluateBlock(in, outvalue + agent, outaction ? outaction + agent : NULL);
+  }
+
+  if (agent < numagents) {
+    int left = numagents - agent;
+
+    memset(in, 0, sizeof(in));
+    for (input=0; input < m_numinputs; input++) {
+      memcpy(in + input*4, inputs[input] + agent, left * sizeof(float));
+    }
+    EvaluateBlock(in, value, action);
+    for (i=0; i < left; i++) {
+      outvalue[agent + i] = value[i];
+      if (outaction) { outaction[agent + i] = action[i]; }
+    }
+  }
+}
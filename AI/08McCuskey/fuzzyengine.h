@@ -0,0 +1,105 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// fuzzyengine.h : A batch fuzzy inference engine.
+//
+// fuzzy.cpp evaluates one datapoint at a time: every call to
+// IsTrueToWhatDegree walks a chain of ifs, and the action matrix gets built
+// one agent at a time.  That's the right way to learn fuzzy logic, but not
+// the way to run a few thousand agents every frame.
+//
+// CFuzzyEngine takes the same CFuzzyRule sets and a rule base (IF input0 is
+// set a AND input1 is set b ... THEN action n), and "compiles" them into
+// flat tables:
+//
+//   - each fuzzy set becomes a left and a right ramp (start, slope, bias),
+//     so its degree of trueness is min(left, right) clamped to 0..1 with
+//     no branches at all.
+//   - each rule becomes a row of set indices and an action index.
+//
+// Evaluate() then runs the whole rule base over an array of agents, four
+// agents at a time with SSE (or plain floats where SSE isn't available).
+// Each rule fires with the AND (minimum) of its inputs' trueness, the
+// scores for each action get summed just like fuzzy.cpp does it, and the
+// result is defuzzified two ways:
+//
+//   - the score-weighted average of the actions' crisp values, and
+//   - the action with the highest score (the method fuzzy.cpp uses).
+//
+// Inputs are laid out structure-of-arrays: one array of floats per input
+// variable, indexed by agent.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef FUZZYENGINE_H
+#define FUZZYENGINE_H
+
+#include "fuzzyrule.h"
+
+// limits on the size of a rule base.
+#define FUZZY_MAX_INPUTS   4   // input variables per rule
+#define FUZZY_MAX_SETS     16  // fuzzy sets per input variable
+#define FUZZY_MAX_ACTIONS  16  // possible courses of action
+#define FUZZY_MAX_RULES    256 // rules in the rule base
+
+class CFuzzyEngine
+{
+public:
+  CFuzzyEngine() { Init(); }
+  ~CFuzzyEngine() { }
+
+  // building the rule base.  each of these returns the index of the thing
+  // added, or -1 if a limit was hit.
+  int AddInput(CFuzzyRule *sets, int numsets);
+  int AddAction(const char *name, float crispvalue);
+  int AddRule(const int *setindex, int action);
+
+  // Compile: turns the inputs, actions and rules into the tables that
+  // Evaluate works from.  Call it after the last Add and before Evaluate.
+  void Compile(void);
+
+  // Evaluate: runs the rule base for numagents agents.  inputs[i][agent]
+  // is the value of input variable i for that agent.  The weighted-average
+  // output goes in outvalue[agent]; if outaction isn't NULL, the index of
+  // the winning action goes in outaction[agent].
+  void Evaluate(const float * const *inputs, int numagents,
+                float *outvalue, int *outaction = NULL) const;
+
+  int GetNumInputs(void) const  { return(m_numinputs); }
+  int GetNumActions(void) const { return(m_numactions); }
+  int GetNumRules(void) const   { return(m_numrules); }
+  const char *GetActionName(int action) { return(m_actionname[action]); }
+
+private:
+  void Init(void);
+  void EvaluateBlock(const float *in, float *outvalue, int *outaction) const;
+
+  // rule base, as added.
+  int         m_numinputs;
+  int         m_numsets[FUZZY_MAX_INPUTS];
+  CFuzzyRule *m_sets[FUZZY_MAX_INPUTS];
+  int         m_numactions;
+  char        m_actionname[FUZZY_MAX_ACTIONS][32];
+  float       m_actionvalue[FUZZY_MAX_ACTIONS];
+  int         m_numrules;
+  int         m_ruleset[FUZZY_MAX_RULES][FUZZY_MAX_INPUTS];
+  int         m_ruleaction[FUZZY_MAX_RULES];
+
+  // compiled membership function tables, one entry per fuzzy set.
+  // trueness = clamp(min((x - m_leftstart) * m_leftslope + m_leftbias,
+  //                      (m_rightend - x) * m_rightslope + m_rightbias), 0, 1)
+  float       m_leftstart[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS];
+  float       m_leftslope[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS];
+  float       m_leftbias[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS];
+  float       m_rightend[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS];
+  float       m_rightslope[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS];
+  float       m_rightbias[FUZZY_MAX_INPUTS][FUZZY_MAX_SETS];
+
+  // compiled rules: which membership each rule ANDs together (as an index
+  // into the per-block membership array), and which action it scores.
+  int         m_rulemember[FUZZY_MAX_RULES][FUZZY_MAX_INPUTS];
+  int         m_setbase[FUZZY_MAX_INPUTS];
+  int         m_nummembers;
+  bool        m_compiled;
+};
+
+#endif
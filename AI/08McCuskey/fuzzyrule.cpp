@@ -0,0 +1,114 @@
+/* Copyright (C) Mason McCuskey, 2000. 
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Mason McCuskey, 2000"
+ */
+//////////////////////////////////////////////////////////////////////////////
+//
+// fuzzyrule.cpp : CFuzzyRule evaluation and the FuzzyAND operator.
+//
+// Written By: Mason McCuskey, Spin Studios, mason@spin-studios.com
+// Release   : 1.00 on 4/30/00
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <f2c.h>
+#endif
+
+#include "fuzzyrule.h"
+
+/****************************************************************************
+
+ IsTrueToWhatDegree: determines to what degree a datapoint is "true" for this
+ fuzzy rule.  A value of 1.0 means completely true, and a value of 0.0 means
+ completely false.  Everything in between is "fuzzy."
+
+ ****************************************************************************/
+float CFuzzyRule::IsTrueToWhatDegree(float datapoint)
+{
+  // four possibilities here:
+  // 1) it is completely outside the rule (0%)
+  // 2) it is completely inside the rule (100%)
+  // 3) it is partially inside the rule, on the min side
+  // 4) it is partially inside the rule, on the max side
+
+  if (datapoint < m_min0percent || datapoint > m_max0percent) {
+    // it's completely outside the rule!
+    return(0.0f);
+  }
+
+  if (datapoint >= m_min100percent && datapoint <= m_max100percent) {
+    // it's completely true!
+    return(1.0f);
+  }
+
+  if (datapoint >= m_min0percent && datapoint <= m_min100percent) {
+    // it's partially true, on the minimum side.
+    // evaluate the degree of "trueness."  note that this is a simple
+    // "scale" evaluation for the purposes of example only; your real fuzzy
+    // code would probably be more involved than this.
+
+    // assuming m_min0percent is zero and m_min100percent is 1, figure out 
+    // where datapoint is.
+
+    // figure out the "width" of our "grey area."
+    float widthofgreyarea = (float)fabs(m_min0percent - m_min100percent);
+
+    // determine what percentage of that width is "behind" (<) datapoint.
+    float relativedatapoint = datapoint-m_min0percent;
+
+    return((float)fabs(relativedatapoint / widthofgreyarea));
+  }
+
+  // note: this is cut/pasted to demonstrate the logic flow more clearly.
+  // eliminating this code duplication is left as an excercise for the reader. :)
+
+  if (datapoint >= m_max100percent && datapoint <= m_max0percent) {
+    // it's partially true, on the maximum side.
+    // evaluate the degree of "trueness."  note that this is a simple
+    // "scale" evaluation for the purposes of example only; your real fuzzy
+    // code would probably be more involved than this.
+
+    // assuming m_max0percent is zero and m_max100percent is 1, figure out 
+    // where datapoint is.
+
+    // figure out the "width" of our "grey area."
+    float widthofgreyarea = (float)fabs(m_max0percent - m_max100percent);
+
+    // determine what percentage of that width is "behind" (<) datapoint.
+    float relativedatapoint = datapoint-m_max0percent;
+
+    return((float)fabs(relativedatapoint / widthofgreyarea));
+  }
+
+  // we should never get here!
+  assert(0);
+  return(0);
+}
+
+/****************************************************************************
+
+ FuzzyAND: ANDs two fuzzy datapoints / rules together.
+
+ ****************************************************************************/
+float FuzzyAND(CFuzzyRule &rule1, float data1, CFuzzyRule &rule2, float data2)
+{
+  // a fuzzy and operation is only as true as the minimum trueness of both pairs.
+  // in other words, a fuzzy logic operation is only as true as its weakest trueness.
+  float true1 = rule1.IsTrueToWhatDegree(data1);
+  float true2 = rule2.IsTrueToWhatDegree(data2);
+
+#ifdef _WIN32
+  return(__min(true1, true2));
+#else
+  return(min(true1, true2));
+#endif
+}
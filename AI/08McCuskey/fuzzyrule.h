@@ -0,0 +1,95 @@
+/* Copyright (C) Mason McCuskey, 2000. 
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Mason McCuskey, 2000"
+ */
+//////////////////////////////////////////////////////////////////////////////
+//
+// fuzzyrule.h : The CFuzzyRule class and the FuzzyAND operator, split out of
+// fuzzy.cpp so the batch evaluator can share them.
+//
+// Written By: Mason McCuskey, Spin Studios, mason@spin-studios.com
+// Release   : 1.00 on 4/30/00
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef FUZZYRULE_H
+#define FUZZYRULE_H
+
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// CFuzzyRule: A Simple class to encapsulate a fuzzy logic rule.
+//
+// Each fuzzy logic rule is composed of four points: 
+// min 0%, min 100%, max 100%, and max 0%.  Together, these four points form
+// a sloped graph, which starts out at min 0%, hits 100% at min100%, continues
+// at 100% until max 100%, then tapers off, finally hitting 0% again at max
+// 0%.  So, if you were to graph these on a x/y plane, with y ranging from
+// 0 to 1 and x ranging from min0 to max0, you'd get a shape resembling a
+// trapezoid (or a triangle, if min100% = max100%).
+//
+// Yes, this is a relatively simplistic way to represent a fuzzy set.  Real
+// fuzzy set classes would be able to accurately model discrete points, 
+// and could have any number of key points on them.
+// 
+// but, the more complex your graph of a fuzzy set, the more complex your
+// calculations for trueness.  For the purposes of illustration, I've opted
+// to go with what I feel is the best compromise between simplicity and
+// flexibility.
+//
+//////////////////////////////////////////////////////////////////////////////
+class CFuzzyRule
+{
+public:
+  CFuzzyRule() { Init(); }
+  CFuzzyRule(const char *name, float min0, float min100, float max100, float max0) {
+    Init();
+    Setup(name, min0, min100, max100, max0);
+  }
+
+  void Setup(const char *name, float min0, float min100, float max100, float max0) {
+    Init();
+    m_min0percent   = min0;
+    m_min100percent = min100;
+    m_max0percent   = max0;
+    m_max100percent = max100;
+    if (strlen(name) < sizeof(m_name)) { strcpy(m_name, name); }
+  }
+    
+  ~CFuzzyRule() { }
+  float IsTrueToWhatDegree(float datapoint);
+  char *GetName(void) { return(m_name); }
+
+  // the four key points, for code that wants to precompute things
+  // from the rule (see fuzzyengine.h).
+  float GetMin0Percent(void) const   { return(m_min0percent); }
+  float GetMin100Percent(void) const { return(m_min100percent); }
+  float GetMax100Percent(void) const { return(m_max100percent); }
+  float GetMax0Percent(void) const   { return(m_max0percent); }
+
+private:
+  void Init(void) { 
+    m_min100percent = m_max100percent = m_min0percent = m_max0percent = 0.0f; 
+    memset(m_name, 0, sizeof(m_name));
+  }
+  char  m_name[256];     // name of this fuzzy rule
+  float m_min100percent; // smallest number considered 100% true
+  float m_max100percent; // biggest number considered 100% true                                         
+  float m_min0percent;   // smallest number still considered within fuzzy rule
+  float m_max0percent;   // biggest number still considered within fuzzy rule
+};
+
+/****************************************************************************
+
+ FuzzyAND: ANDs two fuzzy datapoints / rules together.
+
+ ****************************************************************************/
+float FuzzyAND(CFuzzyRule &rule1, float data1, CFuzzyRule &rule2, float data2);
+
+#endif
@@ -0,0 +1,150 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// fuzzytable.cpp : A precomputed lookup table for two-input fuzzy
+// controllers.  See fuzzytable.h.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+
+#include "fuzzytable.h"
+
+/****************************************************************************
+
+ Init / Clear: set up an empty table, and free a full one.
+
+ ****************************************************************************/
+void CFuzzyTable::Init(void)
+{
+  m_table = NULL;
+  m_xsamples = m_ysamples = m_rowstride = 0;
+  m_xmin = m_ymin = m_xmax = m_ymax = 0.0f;
+  m_xscale = m_yscale = m_xlast = m_ylast = 0.0f;
+}
+
+void CFuzzyTable::Clear(void)
+{
+  delete [] m_table;
+  Init();
+}
+
+/****************************************************************************
+
+ Build: samples the engine onto the grid.
+
+ The grid gets one extra row and column, copies of the last real ones, so
+ a lookup that lands exactly on the far edge can still read its right and
+ bottom neighbours without a special case.
+
+ ****************************************************************************/
+bool CFuzzyTable::Build(const CFuzzyEngine &engine,
+                        float xmin, float xmax, int xsamples,
+                        float ymin, float ymax, int ysamples)
+{
+  if (engine.GetNumInputs() != 2 || xsamples < 2 || ysamples < 2 ||
+      !(xmax > xmin) || !(ymax > ymin)) {
+    return(false);
+  }
+
+  Clear();
+
+  m_xsamples  = xsamples;
+  m_ysamples  = ysamples;
+  m_rowstride = xsamples + 1;
+  m_xmin = xmin; m_xmax = xmax;
+  m_ymin = ymin; m_ymax = ymax;
+  m_xscale = (xsamples - 1) / (xmax - xmin);
+  m_yscale = (ysamples - 1) / (ymax - ymin);
+  m_xlast  = (float)(xsamples - 1);
+  m_ylast  = (float)(ysamples - 1);
+
+  m_table = new float[m_rowstride * (ysamples + 1)];
+
+  // evaluate a whole row at a time, so the engine gets to batch.
+  float *x = new float[xsamples];
+  float *y = new float[xsamples];
+  const float *inputs[2] = { x, y };
+  int ix, iy;
+
+  for (ix=0; ix < xsamples; ix++) { x[ix] = xmin + ix / m_xscale; }
+  x[xsamples - 1] = xmax;
+
+  for (iy=0; iy < ysamples; iy++) {
+    float rowy = (iy == ysamples - 1) ? ymax : ymin + iy / m_yscale;
+    float *row = m_table + iy * m_rowstride;
+
+    for (ix=0; ix < xsamples; ix++) { y[ix] = rowy; }
+    engine.Evaluate(inputs, xsamples, row);
+    row[xsamples] = row[xsamples - 1];
+  }
+  memcpy(m_table + ysamples * m_rowstride, m_table + (ysamples - 1) * m_rowstride,
+         m_rowstride * sizeof(float));
+
+  delete [] x;
+  delete [] y;
+  return(true);
+}
+
+/****************************************************************************
+
+ Lookup: the batch version.
+
+ ****************************************************************************/
+void CFuzzyTable::Lookup(const float *x, const float *y, int count, float *out) const
+{
+  for (int i=0; i < count; i++) { out[i] = Lookup(x[i], y[i]); }
+}
+
+/****************************************************************************
+
+ MeasureError: compares the table against the exact evaluation.  The
+ sample points are spaced so they mostly fall between grid lines, which is
+ where interpolation is at its worst.
+
+ ****************************************************************************/
+FuzzyTableError CFuzzyTable::MeasureError(const CFuzzyEngine &engine, int samplesperaxis) const
+{
+  FuzzyTableError result;
+  memset(&result, 0, sizeof(result));
+
+  if (!m_table || samplesperaxis < 1) { return(result); }
+
+  float *x     = new float[samplesperaxis];
+  float *y     = new float[samplesperaxis];
+  float *exact = new float[samplesperaxis];
+  const float *inputs[2] = { x, y };
+  double sum = 0.0, sumsquares = 0.0;
+  int i, j;
+
+  for (j=0; j < samplesperaxis; j++) {
+    float rowy = m_ymin + (m_ymax - m_ymin) * (j + 0.5f) / samplesperaxis;
+
+    for (i=0; i < samplesperaxis; i++) {
+      x[i] = m_xmin + (m_xmax - m_xmin) * (i + 0.5f) / samplesperaxis;
+      y[i] = rowy;
+    }
+    engine.Evaluate(inputs, samplesperaxis, exact);
+
+    for (i=0; i < samplesperaxis; i++) {
+      float error = (float)fabs(Lookup(x[i], y[i]) - exact[i]);
+
+      sum += error;
+      sumsquares += error * error;
+      if (error > result.maxerror) {
+        result.maxerror = error;
+        result.worstx = x[i];
+        result.worsty = y[i];
+      }
+    }
+  }
+
+  result.numsamples = samplesperaxis * samplesperaxis;
+  result.meanerror  = (float)(sum / result.numsamples);
+  result.rmserror   = (float)sqrt(sumsquares / result.numsamples);
+
+  delete [] x;
+  delete [] y;
+  delete [] exact;
+  return(result);
+}
@@ -0,0 +1,100 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// fuzzytable.h : A precomputed lookup table for two-input fuzzy controllers.
+//
+// Lots of fuzzy controllers only ever look at two inputs, like the
+// distance / distance delta driver in fuzzy.cpp.  For those, the whole rule
+// base boils down to a smooth-ish surface over the input plane, so instead
+// of evaluating every rule every time we can sample that surface once onto
+// a grid, and then answer each query with four loads and three lerps
+// (bilinear interpolation).
+//
+// The table is built from a compiled CFuzzyEngine (so it samples exactly
+// what the engine would compute) and only stores the defuzzified output;
+// winning-action lookups still need the engine.  Inputs outside the
+// sampled range are clamped to its edges, which costs nothing as long as
+// the range covers every fuzzy set's slopes.
+//
+// MeasureError compares the table against the exact evaluation at points
+// between the grid lines, so you can pick a resolution that's good enough.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef FUZZYTABLE_H
+#define FUZZYTABLE_H
+
+#include "fuzzyengine.h"
+
+// how far a table is from the exact evaluation.
+struct FuzzyTableError
+{
+  float maxerror;    // biggest absolute difference seen
+  float meanerror;   // average absolute difference
+  float rmserror;    // root mean square difference
+  float worstx;      // where the biggest difference was
+  float worsty;
+  int   numsamples;  // how many points were compared
+};
+
+class CFuzzyTable
+{
+public:
+  CFuzzyTable() { Init(); }
+  ~CFuzzyTable() { Clear(); }
+
+  // Build: samples engine (which must have exactly two inputs and be
+  // compiled) on an xsamples by ysamples grid covering [xmin, xmax] by
+  // [ymin, ymax].  Returns false if the engine or the sizes won't do.
+  bool Build(const CFuzzyEngine &engine,
+             float xmin, float xmax, int xsamples,
+             float ymin, float ymax, int ysamples);
+
+  // Lookup: the controller's output for one pair of inputs.
+  float Lookup(float x, float y) const
+  {
+    float fx = (x - m_xmin) * m_xscale;
+    float fy = (y - m_ymin) * m_yscale;
+
+    // clamp to the table (written so that it also catches NaNs).
+    if (!(fx > 0.0f)) { fx = 0.0f; }
+    if (!(fy > 0.0f)) { fy = 0.0f; }
+    if (fx > m_xlast) { fx = m_xlast; }
+    if (fy > m_ylast) { fy = m_ylast; }
+
+    int ix = (int)fx;
+    int iy = (int)fy;
+    float tx = fx - ix;
+    float ty = fy - iy;
+
+    const float *p = m_table + iy * m_rowstride + ix;
+    float top    = p[0] + (p[1] - p[0]) * tx;
+    float bottom = p[m_rowstride] + (p[m_rowstride + 1] - p[m_rowstride]) * tx;
+
+    return(top + (bottom - top) * ty);
+  }
+
+  // Lookup: the same for count pairs of inputs at once.
+  void Lookup(const float *x, const float *y, int count, float *out) const;
+
+  // MeasureError: compares the table with engine at samplesperaxis^2
+  // points spread over the table's range, deliberately off the grid.
+  FuzzyTableError MeasureError(const CFuzzyEngine &engine, int samplesperaxis) const;
+
+  int GetXSamples(void) const { return(m_xsamples); }
+  int GetYSamples(void) const { return(m_ysamples); }
+  int GetSizeInBytes(void) const { return(m_rowstride * (m_ysamples + 1) * sizeof(float)); }
+
+private:
+  void Init(void);
+  void Clear(void);
+
+  float *m_table;      // (xsamples + 1) by (ysamples + 1) outputs, row by row
+  int    m_xsamples, m_ysamples;
+  int    m_rowstride;  // floats per row
+  float  m_xmin, m_ymin;
+  float  m_xmax, m_ymax;
+  float  m_xscale, m_yscale; // grid cells per unit of input
+  float  m_xlast, m_ylast;   // largest index we can interpolate from
+};
+
+#endif
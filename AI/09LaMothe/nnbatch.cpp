@@ -0,0 +1,264 @@
+// NEURAL NET BATCH BENCHMARK ////////////////////////////////////////////////////
+
+// trains a hebbian and a hopfield net on a few thousand random bipolar
+// patterns and runs them all back through, once with the one-vector-at-a-time
+// loops from nnlist2.cpp/nnlist3.cpp and once with the batched kernels in
+// nncore.cpp, then reports patterns/ms for each and the largest difference
+//
+// usage: nnbatch [patterns] [inputs] [outputs] [threads]
+
+// INCLUDES //////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <chrono>
+
+#include "nncore.h"
+
+// MACROS ////////////////////////////////////////////////////////////////////////
+
+// used to retrieve the i,jth element of a linear, row major, matrix
+
+#define MAT(mat,width,i,j) (mat[((width)*i)+(j)])
+
+// GLOBALS ///////////////////////////////////////////////////////////////////////
+
+std::chrono::steady_clock::time_point timer_start;
+
+// FUNCTIONS /////////////////////////////////////////////////////////////////////
+
+void Start_Timer(void)
+{
+timer_start = std::chrono::steady_clock::now();
+} // end Start_Timer
+
+//////////////////////////////////////////////////////////////////////////////////
+
+double Stop_Timer(void)
+{
+// returns the milliseconds since Start_Timer
+
+std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - timer_start;
+return(elapsed.count());
+
+} // end Stop_Timer
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void Random_Bipolar(float *vec, int count)
+{
+for (int index=0; index<count; index++)
+	vec[index] = (rand() & 1) ? 1.0f : -1.0f;
+} // end Random_Bipolar
+
+//////////////////////////////////////////////////////////////////////////////////
+
+float Max_Error(const float *a, const float *b, int count)
+{
+float error = 0.0f;
+
+for (int index=0; index<count; index++)
+	if (fabs(a[index]-b[index]) > error)
+		error = (float)fabs(a[index]-b[index]);
+
+return(error);
+
+} // end Max_Error
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void Ref_Train(float *weight_matrix, float *bias, int num_inputs, int num_outputs,
+			   const float *patterns, const float *targets, int num_patterns, int hopfield)
+{
+// the training loops from the simulators, a pattern at a time
+
+for (int p=0; p<num_patterns; p++)
+	{
+	const float *input_i  = patterns + p*num_inputs;
+	const float *output_i = targets  + p*num_outputs;
+
+	for (int index_i=0; index_i<num_inputs; index_i++)
+		for (int index_j=0; index_j<num_outputs; index_j++)
+			{
+			if (hopfield && index_i==index_j)
+				continue;
+
+			MAT(weight_matrix,num_outputs,index_i,index_j) += input_i[index_i]*output_i[index_j];
+			} // end for index_j
+
+	if (bias)
+		for (int index_j=0; index_j<num_outputs; index_j++)
+			bias[index_j] += output_i[index_j];
+
+	} // end for p
+
+} // end Ref_Train
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void Ref_Run(const float *weight_matrix, const float *bias, int num_inputs, int num_outputs,
+			 const float *patterns, int num_patterns, float *outputs, const NN_ACTIVATION *act)
+{
+// the Run_Net loops from the simulators, a pattern at a time, with the real exp()
+
+for (int p=0; p<num_patterns; p++)
+	{
+	const float *input_i  = patterns + p*num_inputs;
+	float		*output_y = outputs  + p*num_outputs;
+
+	for (int index_j=0; index_j<num_outputs; index_j++)
+		{
+		float input_act = bias ? bias[index_j] : 0.0f;
+
+		for (int index_i=0; index_i<num_inputs; index_i++)
+			input_act += MAT(weight_matrix,num_outputs,index_i,index_j)*input_i[index_i];
+
+		if (act->func==NN_ACTF_STEP)
+			output_y[index_j] = (input_act>=0.0f) ? act->step_high : act->step_low;
+		else
+		if (act->func==NN_ACTF_LINEAR)
+			output_y[index_j] = input_act;
+		else
+			output_y[index_j] = (float)(1.0/(1.0+exp(-act->alpha*input_act)));
+
+		} // end for index_j
+
+	} // end for p
+
+} // end Ref_Run
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void Report(const char *name, int num_patterns, double ref_ms, double batch_ms, float error)
+{
+printf("%-22s %10.1f %10.1f %10.1f %10.1f %7.1fx  %g\n", name,
+	   ref_ms, num_patterns/ref_ms, batch_ms, num_patterns/batch_ms, ref_ms/batch_ms, error);
+} // end Report
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void Bench(const char *name, int hopfield, int num_patterns, int num_inputs, int num_outputs)
+{
+// trains and runs one net both ways
+
+NN_ACTIVATION act;
+double	ref_ms, batch_ms;
+char	label[64];
+
+float	*patterns	= (float *)malloc(num_patterns*num_inputs*sizeof(float)),
+		*targets	= hopfield ? patterns : (float *)malloc(num_patterns*num_outputs*sizeof(float)),
+		*ref_w		= (float *)calloc(num_inputs*num_outputs,sizeof(float)),
+		*batch_w	= (float *)calloc(num_inputs*num_outputs,sizeof(float)),
+		*ref_b		= hopfield ? NULL : (float *)calloc(num_outputs,sizeof(float)),
+		*batch_b	= hopfield ? NULL : (float *)calloc(num_outputs,sizeof(float)),
+		*ref_out	= (float *)malloc(num_patterns*num_outputs*sizeof(float)),
+		*batch_out	= (float *)malloc(num_patterns*num_outputs*sizeof(float));
+
+Random_Bipolar(patterns,num_patterns*num_inputs);
+if (!hopfield)
+	Random_Bipolar(targets,num_patterns*num_outputs);
+
+// training
+Start_Timer();
+Ref_Train(ref_w,ref_b,num_inputs,num_outputs,patterns,targets,num_patterns,hopfield);
+ref_ms = Stop_Timer();
+
+Start_Timer();
+if (hopfield)
+	NN_Train_Hopfield(batch_w,num_inputs,patterns,num_patterns);
+else
+	NN_Train_Hebb(batch_w,batch_b,num_inputs,num_outputs,patterns,targets,num_patterns);
+batch_ms = Stop_Timer();
+
+float error = Max_Error(ref_w,batch_w,num_inputs*num_outputs);
+if (!hopfield)
+	{
+	float bias_error = Max_Error(ref_b,batch_b,num_outputs);
+	if (bias_error > error)
+		error = bias_error;
+	} // end if
+
+sprintf(label,"%s train",name);
+Report(label,num_patterns,ref_ms,batch_ms,error);
+
+// recall with the step function, the way the simulators run
+act.func		= NN_ACTF_STEP;
+act.alpha		= 1.0f;
+act.step_high	= 1.0f;
+act.step_low	= hopfield ? 0.0f : -1.0f;
+
+Start_Timer();
+Ref_Run(ref_w,ref_b,num_inputs,num_outputs,patterns,num_patterns,ref_out,&act);
+ref_ms = Stop_Timer();
+
+Start_Timer();
+NN_Forward(batch_w,batch_b,num_inputs,num_outputs,patterns,num_patterns,NULL,batch_out,&act);
+batch_ms = Stop_Timer();
+
+sprintf(label,"%s step",name);
+Report(label,num_patterns,ref_ms,batch_ms,Max_Error(ref_out,batch_out,num_patterns*num_outputs));
+
+// and with the exponential, scaled so the activations land on the slope
+act.func	= NN_ACTF_EXP;
+act.alpha	= 1.0f/(float)sqrt((double)num_patterns*num_inputs);
+
+Start_Timer();
+Ref_Run(ref_w,ref_b,num_inputs,num_outputs,patterns,num_patterns,ref_out,&act);
+ref_ms = Stop_Timer();
+
+Start_Timer();
+NN_Forward(batch_w,batch_b,num_inputs,num_outputs,patterns,num_patterns,NULL,batch_out,&act);
+batch_ms = Stop_Timer();
+
+sprintf(label,"%s exp",name);
+Report(label,num_patterns,ref_ms,batch_ms,Max_Error(ref_out,batch_out,num_patterns*num_outputs));
+
+free(patterns);
+if (!hopfield)
+	{
+	free(targets);
+	free(ref_b);
+	free(batch_b);
+	} // end if
+free(ref_w);
+free(batch_w);
+free(ref_out);
+free(batch_out);
+
+} // end Bench
+
+// MAIN //////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+int num_patterns	= (argc > 1) ? atoi(argv[1]) : 4096,
+	num_inputs		= (argc > 2) ? atoi(argv[2]) : 256,
+	num_outputs		= (argc > 3) ? atoi(argv[3]) : 64,
+	num_threads		= (argc > 4) ? atoi(argv[4]) : 1;
+
+if (num_patterns<1 || num_inputs<1 || num_outputs<1)
+	{
+	printf("\nusage: nnbatch [patterns] [inputs] [outputs] [threads]\n");
+	return(1);
+	} // end if
+
+srand(1);
+NN_Set_Threads(num_threads);
+
+printf("\n%d patterns, %d inputs, %d outputs, %d thread(s)\n\n",
+	   num_patterns,num_inputs,num_outputs,num_threads);
+
+printf("%-22s %10s %10s %10s %10s %8s  %s\n","",
+	   "loop ms","pat/ms","batch ms","pat/ms","speedup","max error");
+
+Bench("hebbian",0,num_patterns,num_inputs,num_outputs);
+Bench("hopfield",1,num_patterns,num_inputs,num_inputs);
+
+NN_Set_Threads(0);
+
+return(0);
+
+} // end main
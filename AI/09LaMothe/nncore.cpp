@@ -0,0 +1,628 @@
+// NEURAL NET CORE ///////////////////////////////////////////////////////////////
+
+// batched inference and training kernels for the hebbian and hopfield
+// simulators, see nncore.h
+
+// INCLUDES //////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nncore.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NN_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// DEFINES ///////////////////////////////////////////////////////////////////////
+
+// cache tiling, the forward kernel works on a NN_TILE_K x NN_TILE_N block of
+// the weight matrix (64K) at a time, against NN_ROWS_PER_JOB patterns
+
+#define NN_TILE_K		128		// rows of the weight matrix per tile
+#define NN_TILE_N		128		// columns of the weight matrix per tile
+#define NN_ROWS_PER_JOB	64		// patterns handed to a thread at a time
+
+// exp() approximation, e^x = 2^(x*log2(e)) = 2^n * 2^f with f in [-.5,.5]
+// and 2^f from its taylor series (ln2^k/k!), good to about 2e-6
+
+#define NN_LOG2E		1.44269504f
+#define NN_EXP_LIMIT	87.0f		// keeps 2^n inside a float
+#define NN_EXP_C1		0.693147181f
+#define NN_EXP_C2		0.240226507f
+#define NN_EXP_C3		0.0555041087f
+#define NN_EXP_C4		0.00961812911f
+#define NN_EXP_C5		0.00133335581f
+
+// TYPES /////////////////////////////////////////////////////////////////////////
+
+// a piece of work, run on rows [first,last) of some job
+
+typedef void (*NN_JOB_FUNC)(void *data, int first, int last);
+
+// everything a forward pass needs
+
+typedef struct NN_FORWARD_JOB_TYP
+	{
+	const float *weight_matrix;
+	const float *bias;
+	int			num_inputs, num_outputs;
+	const float *patterns;
+	float		*net;			// where the summed activations go
+	float		*outputs;
+	const NN_ACTIVATION *activation;
+
+	} NN_FORWARD_JOB, *NN_FORWARD_JOB_PTR;
+
+// everything a hebbian training pass needs
+
+typedef struct NN_TRAIN_JOB_TYP
+	{
+	float		*weight_matrix;
+	int			num_inputs, num_outputs;
+	const float *patterns;
+	const float *targets;
+	int			num_patterns;
+
+	} NN_TRAIN_JOB, *NN_TRAIN_JOB_PTR;
+
+// GLOBALS ///////////////////////////////////////////////////////////////////////
+
+// the thread pool, the calling thread always works on a job too so there
+// are nn_num_threads-1 workers
+
+static int						nn_num_threads = 1;
+static std::vector<std::thread>	nn_workers;
+static std::mutex				nn_lock;
+static std::condition_variable	nn_wake, nn_done;
+static unsigned int				nn_generation = 0;	// bumped for each job
+static int						nn_busy = 0;		// workers still on the job
+static bool						nn_quit = false;
+static NN_JOB_FUNC				nn_job_func = NULL;
+static void						*nn_job_data = NULL;
+static int						nn_job_count = 0, nn_job_grain = 1;
+static std::atomic<int>			nn_job_next(0);		// next unclaimed row
+
+// THREAD POOL ///////////////////////////////////////////////////////////////////
+
+static void NN_Run_Chunks(void)
+{
+// claims rows of the current job a grain at a time until they are all gone
+
+int first;
+
+while ((first = nn_job_next.fetch_add(nn_job_grain)) < nn_job_count)
+	{
+	int last = first + nn_job_grain;
+	if (last > nn_job_count)
+		last = nn_job_count;
+
+	nn_job_func(nn_job_data, first, last);
+
+	} // end while
+
+} // end NN_Run_Chunks
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Worker(unsigned int seen)
+{
+// each worker sleeps until a job is posted, helps finish it, and sleeps again.
+// seen is the generation when the worker was made, so a job from before a
+// restart isn't taken for a new one
+
+while(1)
+	{
+		{
+		std::unique_lock<std::mutex> guard(nn_lock);
+		while (!nn_quit && nn_generation==seen)
+			nn_wake.wait(guard);
+
+		if (nn_quit)
+			return;
+
+		seen = nn_generation;
+		}
+
+	NN_Run_Chunks();
+
+		{
+		std::lock_guard<std::mutex> guard(nn_lock);
+		if (--nn_busy==0)
+			nn_done.notify_one();
+		}
+
+	} // end while
+
+} // end NN_Worker
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Stop_Workers(void)
+{
+// tells the workers to quit and waits for them
+
+	{
+	std::lock_guard<std::mutex> guard(nn_lock);
+	nn_quit = true;
+	}
+
+nn_wake.notify_all();
+
+for (int index=0; index<(int)nn_workers.size(); index++)
+	nn_workers[index].join();
+
+nn_workers.clear();
+nn_quit = false;
+
+} // end NN_Stop_Workers
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Set_Threads(int num_threads)
+{
+// (re)starts the pool with num_threads threads in total
+
+static int registered = 0;
+
+NN_Stop_Workers();
+
+if (num_threads < 1)
+	{
+	nn_num_threads = 1;
+	return;
+	} // end if
+
+if (!registered)
+	{
+	// make sure nobody is left running when the program exits
+	atexit(NN_Stop_Workers);
+	registered = 1;
+	} // end if
+
+nn_num_threads = num_threads;
+
+// no job can be posted until we return, so the generation can't move
+// before every worker has been given it
+for (int index=1; index<num_threads; index++)
+	nn_workers.push_back(std::thread(NN_Worker, nn_generation));
+
+} // end NN_Set_Threads
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Parallel(NN_JOB_FUNC func, void *data, int count, int grain)
+{
+// runs func over [0,count) in pieces of grain rows on every thread we have
+
+if (count<=0)
+	return;
+
+if (nn_workers.empty() || count<=grain)
+	{
+	func(data,0,count);
+	return;
+	} // end if
+
+	{
+	std::lock_guard<std::mutex> guard(nn_lock);
+	nn_job_func  = func;
+	nn_job_data  = data;
+	nn_job_count = count;
+	nn_job_grain = grain;
+	nn_job_next  = 0;
+	nn_busy      = (int)nn_workers.size();
+	nn_generation++;
+	}
+
+nn_wake.notify_all();
+
+NN_Run_Chunks();
+
+std::unique_lock<std::mutex> guard(nn_lock);
+while (nn_busy > 0)
+	nn_done.wait(guard);
+
+} // end NN_Parallel
+
+// SIGMOID ///////////////////////////////////////////////////////////////////////
+
+static float NN_Fast_Exp(float x)
+{
+// scalar version of the exp() approximation, used for the odd elements the
+// SIMD version can't take 4 at a time
+
+if (x > NN_EXP_LIMIT)
+	x = NN_EXP_LIMIT;
+else
+if (x < -NN_EXP_LIMIT)
+	x = -NN_EXP_LIMIT;
+
+float u = x*NN_LOG2E;
+int   n = (int)floorf(u + 0.5f);
+float f = u - (float)n;
+
+float p = 1.0f + f*(NN_EXP_C1 + f*(NN_EXP_C2 + f*(NN_EXP_C3 + f*(NN_EXP_C4 + f*NN_EXP_C5))));
+
+// build 2^n straight into the exponent bits
+int   bits = (n + 127) << 23;
+float scale;
+memcpy(&scale,&bits,sizeof(scale));
+
+return(p*scale);
+
+} // end NN_Fast_Exp
+
+#ifdef NN_USE_SSE
+
+static inline __m128 NN_Fast_Exp4(__m128 x)
+{
+// the same approximation, 4 at a time
+
+x = _mm_min_ps(_mm_max_ps(x,_mm_set1_ps(-NN_EXP_LIMIT)),_mm_set1_ps(NN_EXP_LIMIT));
+
+__m128  u = _mm_mul_ps(x,_mm_set1_ps(NN_LOG2E));
+__m128i n = _mm_cvtps_epi32(u);					// round to nearest
+__m128  f = _mm_sub_ps(u,_mm_cvtepi32_ps(n));
+
+__m128 p = _mm_set1_ps(NN_EXP_C5);
+p = _mm_add_ps(_mm_mul_ps(p,f),_mm_set1_ps(NN_EXP_C4));
+p = _mm_add_ps(_mm_mul_ps(p,f),_mm_set1_ps(NN_EXP_C3));
+p = _mm_add_ps(_mm_mul_ps(p,f),_mm_set1_ps(NN_EXP_C2));
+p = _mm_add_ps(_mm_mul_ps(p,f),_mm_set1_ps(NN_EXP_C1));
+p = _mm_add_ps(_mm_mul_ps(p,f),_mm_set1_ps(1.0f));
+
+__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n,_mm_set1_epi32(127)),23));
+
+return(_mm_mul_ps(p,scale));
+
+} // end NN_Fast_Exp4
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Sigmoid(const float *x, float *y, int count, float alpha)
+{
+// y = 1/(1+exp(-alpha*x)) for a whole array
+
+int index = 0;
+
+#ifdef NN_USE_SSE
+__m128 one    = _mm_set1_ps(1.0f);
+__m128 nalpha = _mm_set1_ps(-alpha);
+
+for (; index+4<=count; index+=4)
+	{
+	__m128 e = NN_Fast_Exp4(_mm_mul_ps(_mm_loadu_ps(x+index),nalpha));
+	_mm_storeu_ps(y+index,_mm_div_ps(one,_mm_add_ps(one,e)));
+	} // end for index
+#endif
+
+for (; index<count; index++)
+	y[index] = 1.0f/(1.0f + NN_Fast_Exp(-alpha*x[index]));
+
+} // end NN_Sigmoid
+
+// FORWARD KERNELS ///////////////////////////////////////////////////////////////
+
+// each kernel adds x*W into y for a small block of patterns and neurodes,
+// over kcount inputs. w points at W[k0,j0], x at pattern[p0,k0], y at
+// net[p0,j0]; ldw, ldx and ldy are the row widths of each matrix
+
+#ifdef NN_USE_SSE
+
+static void NN_Kernel_4x8(const float *w, int ldw, const float *x, int ldx,
+						  float *y, int ldy, int kcount)
+{
+// 4 patterns by 8 neurodes, all 8 accumulators stay in registers
+
+__m128	y00 = _mm_loadu_ps(y),         y01 = _mm_loadu_ps(y+4),
+		y10 = _mm_loadu_ps(y+ldy),     y11 = _mm_loadu_ps(y+ldy+4),
+		y20 = _mm_loadu_ps(y+2*ldy),   y21 = _mm_loadu_ps(y+2*ldy+4),
+		y30 = _mm_loadu_ps(y+3*ldy),   y31 = _mm_loadu_ps(y+3*ldy+4);
+
+for (int k=0; k<kcount; k++)
+	{
+	__m128 w0 = _mm_loadu_ps(w+k*ldw);
+	__m128 w1 = _mm_loadu_ps(w+k*ldw+4);
+	__m128 xk;
+
+	xk  = _mm_set1_ps(x[k]);
+	y00 = _mm_add_ps(y00,_mm_mul_ps(xk,w0));
+	y01 = _mm_add_ps(y01,_mm_mul_ps(xk,w1));
+
+	xk  = _mm_set1_ps(x[ldx+k]);
+	y10 = _mm_add_ps(y10,_mm_mul_ps(xk,w0));
+	y11 = _mm_add_ps(y11,_mm_mul_ps(xk,w1));
+
+	xk  = _mm_set1_ps(x[2*ldx+k]);
+	y20 = _mm_add_ps(y20,_mm_mul_ps(xk,w0));
+	y21 = _mm_add_ps(y21,_mm_mul_ps(xk,w1));
+
+	xk  = _mm_set1_ps(x[3*ldx+k]);
+	y30 = _mm_add_ps(y30,_mm_mul_ps(xk,w0));
+	y31 = _mm_add_ps(y31,_mm_mul_ps(xk,w1));
+
+	} // end for k
+
+_mm_storeu_ps(y,y00);         _mm_storeu_ps(y+4,y01);
+_mm_storeu_ps(y+ldy,y10);     _mm_storeu_ps(y+ldy+4,y11);
+_mm_storeu_ps(y+2*ldy,y20);   _mm_storeu_ps(y+2*ldy+4,y21);
+_mm_storeu_ps(y+3*ldy,y30);   _mm_storeu_ps(y+3*ldy+4,y31);
+
+} // end NN_Kernel_4x8
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Kernel_1x8(const float *w, int ldw, const float *x,
+						  float *y, int kcount)
+{
+// 1 pattern by 8 neurodes, for the patterns left over after the 4x8 blocks
+
+__m128 y0 = _mm_loadu_ps(y), y1 = _mm_loadu_ps(y+4);
+
+for (int k=0; k<kcount; k++)
+	{
+	__m128 xk = _mm_set1_ps(x[k]);
+	y0 = _mm_add_ps(y0,_mm_mul_ps(xk,_mm_loadu_ps(w+k*ldw)));
+	y1 = _mm_add_ps(y1,_mm_mul_ps(xk,_mm_loadu_ps(w+k*ldw+4)));
+	} // end for k
+
+_mm_storeu_ps(y,y0);
+_mm_storeu_ps(y+4,y1);
+
+} // end NN_Kernel_1x8
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Kernel_Scalar(const float *w, int ldw, const float *x, int ldx,
+							 float *y, int ldy, int rows, int cols, int kcount)
+{
+// any size block, one multiply at a time, for whatever the SIMD kernels
+// can't cover (and for everything when there is no SIMD)
+
+for (int p=0; p<rows; p++)
+	for (int k=0; k<kcount; k++)
+		{
+		float xk = x[p*ldx+k];
+		for (int j=0; j<cols; j++)
+			y[p*ldy+j] += xk*w[k*ldw+j];
+		} // end for k
+
+} // end NN_Kernel_Scalar
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Activate(float *net, float *outputs, int count, const NN_ACTIVATION *activation)
+{
+// applies the activation function to count summed activations
+
+int index;
+
+switch(activation->func)
+	{
+	case NN_ACTF_STEP:
+		{
+		for (index=0; index<count; index++)
+			outputs[index] = (net[index]>=0.0f) ? activation->step_high : activation->step_low;
+		} break;
+
+	case NN_ACTF_LINEAR:
+		{
+		if (outputs!=net)
+			memcpy(outputs,net,count*sizeof(float));
+		} break;
+
+	default:
+		{
+		NN_Sigmoid(net,outputs,count,activation->alpha);
+		} break;
+
+	} // end switch
+
+} // end NN_Activate
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Forward_Rows(void *data, int first, int last)
+{
+// runs patterns [first,last) through the net, a tile at a time
+
+NN_FORWARD_JOB_PTR job = (NN_FORWARD_JOB_PTR)data;
+
+int ni = job->num_inputs,
+	no = job->num_outputs,
+	p, j;
+
+float		*net = job->net + first*no;
+const float	*x   = job->patterns + first*ni;
+int			rows = last - first;
+
+// start every sum off at the bias
+for (p=0; p<rows; p++)
+	{
+	if (job->bias)
+		memcpy(net+p*no,job->bias,no*sizeof(float));
+	else
+		memset(net+p*no,0,no*sizeof(float));
+	} // end for p
+
+// walk the weight matrix a tile at a time so it stays in cache while
+// all the patterns go by
+for (int j0=0; j0<no; j0+=NN_TILE_N)
+	{
+	int jcount = (no-j0 < NN_TILE_N) ? no-j0 : NN_TILE_N;
+
+	for (int k0=0; k0<ni; k0+=NN_TILE_K)
+		{
+		int kcount = (ni-k0 < NN_TILE_K) ? ni-k0 : NN_TILE_K;
+		const float *w = job->weight_matrix + k0*no + j0;
+
+		p = 0;
+#ifdef NN_USE_SSE
+		for (; p+4<=rows; p+=4)
+			{
+			for (j=0; j+8<=jcount; j+=8)
+				NN_Kernel_4x8(w+j,no,x+p*ni+k0,ni,net+p*no+j0+j,no,kcount);
+
+			if (j<jcount)
+				NN_Kernel_Scalar(w+j,no,x+p*ni+k0,ni,net+p*no+j0+j,no,4,jcount-j,kcount);
+			} // end for p
+
+		for (; p<rows; p++)
+			{
+			for (j=0; j+8<=jcount; j+=8)
+				NN_Kernel_1x8(w+j,no,x+p*ni+k0,net+p*no+j0+j,kcount);
+
+			if (j<jcount)
+				NN_Kernel_Scalar(w+j,no,x+p*ni+k0,ni,net+p*no+j0+j,no,1,jcount-j,kcount);
+			} // end for p
+#endif
+		if (p<rows)
+			NN_Kernel_Scalar(w,no,x+p*ni+k0,ni,net+p*no+j0,no,rows-p,jcount,kcount);
+
+		} // end for k0
+
+	} // end for j0
+
+NN_Activate(net,job->outputs+first*no,rows*no,job->activation);
+
+} // end NN_Forward_Rows
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Forward(const float *weight_matrix, const float *bias,
+				int num_inputs, int num_outputs,
+				const float *patterns, int num_patterns,
+				float *input_act, float *outputs,
+				const NN_ACTIVATION *activation)
+{
+// runs a batch of input vectors through the net, see nncore.h
+
+NN_FORWARD_JOB job;
+
+job.weight_matrix = weight_matrix;
+job.bias          = bias;
+job.num_inputs    = num_inputs;
+job.num_outputs   = num_outputs;
+job.patterns      = patterns;
+job.net           = input_act ? input_act : outputs;	// no separate sums? work in place
+job.outputs       = outputs;
+job.activation    = activation;
+
+NN_Parallel(NN_Forward_Rows,&job,num_patterns,NN_ROWS_PER_JOB);
+
+} // end NN_Forward
+
+// TRAINING KERNELS //////////////////////////////////////////////////////////////
+
+static void NN_Train_Rows(void *data, int first, int last)
+{
+// adds transpose(patterns)*targets into rows [first,last) of the weight
+// matrix; each thread owns its own rows, so no locking is needed
+
+NN_TRAIN_JOB_PTR job = (NN_TRAIN_JOB_PTR)data;
+
+int ni = job->num_inputs,
+	no = job->num_outputs,
+	i, j;
+
+for (int j0=0; j0<no; j0+=NN_TILE_N)
+	{
+	int jcount = (no-j0 < NN_TILE_N) ? no-j0 : NN_TILE_N;
+
+	for (int p0=0; p0<job->num_patterns; p0+=NN_TILE_K)
+		{
+		int pcount = (job->num_patterns-p0 < NN_TILE_K) ? job->num_patterns-p0 : NN_TILE_K;
+		const float *x = job->patterns + p0*ni;
+		const float *t = job->targets + p0*no + j0;
+
+		for (i=first; i<last; i++)
+			{
+			float *w = job->weight_matrix + i*no + j0;
+
+			j = 0;
+#ifdef NN_USE_SSE
+			for (; j+8<=jcount; j+=8)
+				{
+				__m128 w0 = _mm_loadu_ps(w+j), w1 = _mm_loadu_ps(w+j+4);
+
+				for (int p=0; p<pcount; p++)
+					{
+					__m128 xi = _mm_set1_ps(x[p*ni+i]);
+					w0 = _mm_add_ps(w0,_mm_mul_ps(xi,_mm_loadu_ps(t+p*no+j)));
+					w1 = _mm_add_ps(w1,_mm_mul_ps(xi,_mm_loadu_ps(t+p*no+j+4)));
+					} // end for p
+
+				_mm_storeu_ps(w+j,w0);
+				_mm_storeu_ps(w+j+4,w1);
+				} // end for j
+#endif
+			for (; j<jcount; j++)
+				{
+				float sum = w[j];
+				for (int p=0; p<pcount; p++)
+					sum += x[p*ni+i]*t[p*no+j];
+				w[j] = sum;
+				} // end for j
+
+			} // end for i
+
+		} // end for p0
+
+	} // end for j0
+
+} // end NN_Train_Rows
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Train_Hebb(float *weight_matrix, float *bias,
+				   int num_inputs, int num_outputs,
+				   const float *patterns, const float *targets, int num_patterns)
+{
+// hebbian learning on a whole batch, see nncore.h
+
+NN_TRAIN_JOB job;
+
+job.weight_matrix = weight_matrix;
+job.num_inputs    = num_inputs;
+job.num_outputs   = num_outputs;
+job.patterns      = patterns;
+job.targets       = targets;
+job.num_patterns  = num_patterns;
+
+NN_Parallel(NN_Train_Rows,&job,num_inputs,4);
+
+// b = b + output
+if (bias)
+	for (int p=0; p<num_patterns; p++)
+		for (int j=0; j<num_outputs; j++)
+			bias[j] += targets[p*num_outputs+j];
+
+} // end NN_Train_Hebb
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Train_Hopfield(float *weight_matrix, int num_neurodes,
+					   const float *patterns, int num_patterns)
+{
+// hopfield learning is hebbian learning with the pattern as its own target,
+// and no neurode connected to itself
+
+NN_Train_Hebb(weight_matrix,NULL,num_neurodes,num_neurodes,patterns,patterns,num_patterns);
+
+for (int index=0; index<num_neurodes; index++)
+	weight_matrix[index*num_neurodes+index] = 0.0f;
+
+} // end NN_Train_Hopfield
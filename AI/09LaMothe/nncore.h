@@ -0,0 +1,72 @@
+// NEURAL NET CORE ///////////////////////////////////////////////////////////////
+
+// batched inference and training kernels for the hebbian and hopfield
+// simulators (nnlist2.cpp and nnlist3.cpp). the simulators push one vector
+// at a time through a pair of nested loops; these functions take a whole
+// array of patterns per call and run them through cache tiled, SIMD
+// matrix kernels, optionally spread across a few worker threads
+
+// all matrices are linear and row major, just like the simulators use them:
+//
+//	weight_matrix	num_inputs x num_outputs, W[i,j] connects input i to neurode j
+//	patterns		num_patterns x num_inputs, one input vector per row
+//	outputs			num_patterns x num_outputs, one output vector per row
+
+#ifndef NNCORE_H
+#define NNCORE_H
+
+// DEFINES ///////////////////////////////////////////////////////////////////////
+
+#define NN_ACTF_STEP	0	// binary step activation function fs(x)
+#define NN_ACTF_LINEAR	1	// linear activation function fl(x)
+#define NN_ACTF_EXP		2	// inverse exponential (sigmoid) activation function fe(x)
+
+// TYPES /////////////////////////////////////////////////////////////////////////
+
+// describes the activation function applied to each neurode's summed input
+
+typedef struct NN_ACTIVATION_TYP
+	{
+	int		func;		// one of the NN_ACTF_* values above
+	float	alpha;		// slope for the exponential function
+	float	step_high;	// step output for activations >= 0 (usually 1)
+	float	step_low;	// step output for activations < 0 (-1 for hebb, 0 for hopfield)
+
+	} NN_ACTIVATION, *NN_ACTIVATION_PTR;
+
+// PROTOTYPES ////////////////////////////////////////////////////////////////////
+
+// sets the number of threads the kernels may use, 1 (the default) runs
+// everything on the calling thread. call with 0 to shut the workers down
+
+void NN_Set_Threads(int num_threads);
+
+// runs num_patterns input vectors through the net. input_act receives the
+// summed activations (pass NULL if you don't need them), outputs receives
+// the activated outputs. bias may be NULL for nets without one (hopfield)
+
+void NN_Forward(const float *weight_matrix, const float *bias,
+				int num_inputs, int num_outputs,
+				const float *patterns, int num_patterns,
+				float *input_act, float *outputs,
+				const NN_ACTIVATION *activation);
+
+// hebbian training on a batch of input/output pairs:
+// w[i,j] = w[i,j] + sum over patterns of input[i]*output[j], b[j] = b[j] + sum of output[j]
+
+void NN_Train_Hebb(float *weight_matrix, float *bias,
+				   int num_inputs, int num_outputs,
+				   const float *patterns, const float *targets, int num_patterns);
+
+// hopfield training on a batch of bipolar patterns:
+// w = w + transpose(input)*input, with the diagonal forced back to 0
+
+void NN_Train_Hopfield(float *weight_matrix, int num_neurodes,
+					   const float *patterns, int num_patterns);
+
+// vectorised approximation of y = 1/(1+exp(-alpha*x)), good to a few parts
+// in a million; x and y may be the same array
+
+void NN_Sigmoid(const float *x, float *y, int count, float alpha);
+
+#endif
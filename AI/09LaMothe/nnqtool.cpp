@@ -0,0 +1,192 @@
+// NEURAL NET QUANTISATION TOOL //////////////////////////////////////////////////
+
+// trains a hebbian and a hopfield net on random bipolar patterns, quantises
+// them to 8 bits with nnquant.cpp and reports how much accuracy each
+// activation function loses against the float net on noisy copies of the
+// training patterns, along with the time per pattern for both
+//
+// usage: nnqtool [train patterns] [test patterns] [inputs] [outputs] [noise %]
+
+// INCLUDES //////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <chrono>
+
+#include "nncore.h"
+#include "nnquant.h"
+
+// FUNCTIONS /////////////////////////////////////////////////////////////////////
+
+void Random_Bipolar(float *vec, int count)
+{
+for (int index=0; index<count; index++)
+	vec[index] = (rand() & 1) ? 1.0f : -1.0f;
+} // end Random_Bipolar
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void Noisy_Copies(const float *train, int num_train, int width, float *test, int num_test, int noise)
+{
+// each test pattern is a training pattern with noise% of its bits flipped
+
+for (int p=0; p<num_test; p++)
+	{
+	memcpy(test+p*width,train+(p%num_train)*width,width*sizeof(float));
+
+	for (int index=0; index<width; index++)
+		if (rand()%100 < noise)
+			test[p*width+index] = -test[p*width+index];
+
+	} // end for p
+
+} // end Noisy_Copies
+
+//////////////////////////////////////////////////////////////////////////////////
+
+float Largest_Output(const float *weight_matrix, const float *bias, int num_inputs, int num_outputs,
+					 const float *patterns, int num_patterns)
+{
+// calibrates the linear output range by running the float net
+
+NN_ACTIVATION act = { NN_ACTF_LINEAR, 1.0f, 1.0f, -1.0f };
+float *outputs = (float *)malloc(num_patterns*num_outputs*sizeof(float));
+float largest = 0.0f;
+
+NN_Forward(weight_matrix,bias,num_inputs,num_outputs,patterns,num_patterns,NULL,outputs,&act);
+
+for (int index=0; index<num_patterns*num_outputs; index++)
+	if (fabs(outputs[index]) > largest)
+		largest = (float)fabs(outputs[index]);
+
+free(outputs);
+
+return(largest);
+
+} // end Largest_Output
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void Time_Nets(const NN_QNET *qnet, const float *weight_matrix, const float *bias,
+			   const float *patterns, int num_patterns)
+{
+// times the float and the integer forward pass over the same patterns
+
+int ni = qnet->num_inputs,
+	no = qnet->num_outputs;
+
+float		*fout = (float *)malloc(num_patterns*no*sizeof(float));
+signed char	*qin  = (signed char *)malloc(num_patterns*qnet->stride),
+			*qout = (signed char *)malloc(num_patterns*no);
+
+NN_Quant_Inputs(qnet,patterns,num_patterns,qin);
+
+std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+NN_Forward(weight_matrix,bias,ni,no,patterns,num_patterns,NULL,fout,&qnet->activation);
+std::chrono::duration<double, std::milli> float_ms = std::chrono::steady_clock::now() - start;
+
+start = std::chrono::steady_clock::now();
+NN_Quant_Forward(qnet,qin,num_patterns,qout);
+std::chrono::duration<double, std::milli> quant_ms = std::chrono::steady_clock::now() - start;
+
+printf("  time             %.2f ms float, %.2f ms int8 (%.1f and %.1f patterns/ms)\n",
+	   float_ms.count(),quant_ms.count(),
+	   num_patterns/float_ms.count(),num_patterns/quant_ms.count());
+
+free(fout);
+free(qin);
+free(qout);
+
+} // end Time_Nets
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void Quantize_And_Report(const char *name, const float *weight_matrix, const float *bias,
+						 int num_inputs, int num_outputs, const NN_ACTIVATION *act,
+						 const float *test, int num_test)
+{
+NN_QNET			qnet;
+NN_QUANT_REPORT	report;
+
+float output_range = Largest_Output(weight_matrix,bias,num_inputs,num_outputs,test,num_test);
+
+if (!NN_Quantize(&qnet,weight_matrix,bias,num_inputs,num_outputs,act,1.0f,output_range))
+	{
+	printf("\n%s: out of memory\n",name);
+	return;
+	} // end if
+
+NN_Quant_Compare(&qnet,weight_matrix,bias,test,num_test,&report);
+NN_Quant_Print_Report(stdout,name,&report);
+Time_Nets(&qnet,weight_matrix,bias,test,num_test);
+
+NN_Quant_Free(&qnet);
+
+} // end Quantize_And_Report
+
+// MAIN //////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+int num_train	= (argc > 1) ? atoi(argv[1]) : 24,
+	num_test	= (argc > 2) ? atoi(argv[2]) : 8192,
+	num_inputs	= (argc > 3) ? atoi(argv[3]) : 256,
+	num_outputs	= (argc > 4) ? atoi(argv[4]) : 64,
+	noise		= (argc > 5) ? atoi(argv[5]) : 10;
+
+if (num_train<1 || num_test<1 || num_inputs<1 || num_outputs<1)
+	{
+	printf("\nusage: nnqtool [train patterns] [test patterns] [inputs] [outputs] [noise %%]\n");
+	return(1);
+	} // end if
+
+srand(1);
+
+float	*train_in	= (float *)malloc(num_train*num_inputs*sizeof(float)),
+		*train_out	= (float *)malloc(num_train*num_outputs*sizeof(float)),
+		*test		= (float *)malloc(num_test*num_inputs*sizeof(float)),
+		*hebb_w		= (float *)calloc(num_inputs*num_outputs,sizeof(float)),
+		*hebb_b		= (float *)calloc(num_outputs,sizeof(float)),
+		*hop_w		= (float *)calloc(num_inputs*num_inputs,sizeof(float));
+
+Random_Bipolar(train_in,num_train*num_inputs);
+Random_Bipolar(train_out,num_train*num_outputs);
+Noisy_Copies(train_in,num_train,num_inputs,test,num_test,noise);
+
+NN_Train_Hebb(hebb_w,hebb_b,num_inputs,num_outputs,train_in,train_out,num_train);
+NN_Train_Hopfield(hop_w,num_inputs,train_in,num_train);
+
+printf("\n%d training patterns, %d test patterns with %d%% noise, %d inputs, %d outputs\n",
+	   num_train,num_test,noise,num_inputs,num_outputs);
+
+NN_ACTIVATION act;
+act.alpha		= 4.0f/num_inputs;	// a clean pattern drives the sigmoid well into saturation
+act.step_high	= 1.0f;
+act.step_low	= -1.0f;
+
+act.func = NN_ACTF_STEP;
+Quantize_And_Report("hebbian, step",hebb_w,hebb_b,num_inputs,num_outputs,&act,test,num_test);
+
+act.func = NN_ACTF_LINEAR;
+Quantize_And_Report("hebbian, linear",hebb_w,hebb_b,num_inputs,num_outputs,&act,test,num_test);
+
+act.func = NN_ACTF_EXP;
+Quantize_And_Report("hebbian, exp",hebb_w,hebb_b,num_inputs,num_outputs,&act,test,num_test);
+
+act.func		= NN_ACTF_STEP;
+act.step_low	= 0.0f;
+Quantize_And_Report("hopfield, step",hop_w,NULL,num_inputs,num_inputs,&act,test,num_test);
+
+free(train_in);
+free(train_out);
+free(test);
+free(hebb_w);
+free(hebb_b);
+free(hop_w);
+
+return(0);
+
+} // end main
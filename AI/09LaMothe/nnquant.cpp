@@ -0,0 +1,479 @@
+// NEURAL NET QUANTISER //////////////////////////////////////////////////////////
+
+// 8 bit integer inference for the hebbian and hopfield nets, see nnquant.h
+
+// INCLUDES //////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "nnquant.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NN_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// MACROS ////////////////////////////////////////////////////////////////////////
+
+#define MAT(mat,width,i,j) (mat[((width)*i)+(j)])
+
+// FUNCTIONS /////////////////////////////////////////////////////////////////////
+
+static int NN_Saturate8(float x)
+{
+// rounds to the nearest integer in [-127,127]
+
+if (x >= 127.0f)
+	return(127);
+if (x <= -127.0f)
+	return(-127);
+
+return((int)floorf(x + 0.5f));
+
+} // end NN_Saturate8
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Fixed_Multiplier(double m, int *mult, int *shift)
+{
+// expresses m as mult/2^shift, with mult a 31 bit fraction in [.5,1)
+
+int e;
+double f = frexp(m,&e);
+
+long long q = (long long)floor(f*2147483648.0 + 0.5);
+if (q==2147483648LL)
+	{
+	q /= 2;
+	e++;
+	} // end if
+
+*mult  = (int)q;
+*shift = 31 - e;
+
+// anything scaled down this far rounds to 0 anyway
+if (*shift > 62)
+	*shift = 62;
+
+} // end NN_Fixed_Multiplier
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static inline int NN_Requantize(int acc, int mult, int shift)
+{
+// acc*mult/2^shift, rounded and saturated to 8 bits, no floats involved
+
+long long v = (long long)acc*mult;
+
+if (shift > 0)
+	v = (v + (1LL << (shift-1))) >> shift;
+else
+	{
+	// scaling up, so anything past the range saturates before the shift
+	if (v > 127)  v = 127;
+	if (v < -127) v = -127;
+	v <<= -shift;
+	} // end else
+
+if (v > 127)
+	return(127);
+if (v < -127)
+	return(-127);
+
+return((int)v);
+
+} // end NN_Requantize
+
+//////////////////////////////////////////////////////////////////////////////////
+
+int NN_Quantize(NN_QNET_PTR qnet, const float *weight_matrix, const float *bias,
+				int num_inputs, int num_outputs, const NN_ACTIVATION *activation,
+				float input_range, float output_range)
+{
+// builds the quantised net, see nnquant.h
+
+int index_i, index_j;
+
+memset(qnet,0,sizeof(NN_QNET));
+
+qnet->num_inputs  = num_inputs;
+qnet->num_outputs = num_outputs;
+qnet->stride      = (num_inputs + NN_QUANT_ALIGN-1) & ~(NN_QUANT_ALIGN-1);
+qnet->activation  = *activation;
+qnet->input_scale = (input_range > 0.0f) ? input_range/127.0f : 1.0f/127.0f;
+
+qnet->qweights     = (signed char *)calloc(num_outputs*qnet->stride,1);
+qnet->weight_scale = (float *)malloc(num_outputs*sizeof(float));
+qnet->qbias        = (int *)malloc(num_outputs*sizeof(int));
+qnet->mult         = (int *)malloc(num_outputs*sizeof(int));
+qnet->shift        = (int *)malloc(num_outputs*sizeof(int));
+
+if (!qnet->qweights || !qnet->weight_scale || !qnet->qbias || !qnet->mult || !qnet->shift)
+	{
+	NN_Quant_Free(qnet);
+	return(0);
+	} // end if
+
+// what the rescaled sum is measured in, for the functions that need it
+float target_scale = 1.0f;
+
+switch(activation->func)
+	{
+	case NN_ACTF_STEP:
+		{
+		float range = (float)fabs(activation->step_high);
+		if (fabs(activation->step_low) > range)
+			range = (float)fabs(activation->step_low);
+
+		qnet->output_scale = (range > 0.0f) ? range/127.0f : 1.0f;
+		qnet->qstep_high   = (signed char)NN_Saturate8(activation->step_high/qnet->output_scale);
+		qnet->qstep_low    = (signed char)NN_Saturate8(activation->step_low/qnet->output_scale);
+		} break;
+
+	case NN_ACTF_LINEAR:
+		{
+		qnet->output_scale = (output_range > 0.0f) ? output_range/127.0f : 1.0f/127.0f;
+		target_scale       = qnet->output_scale;
+		} break;
+
+	default:
+		{
+		// the sum is rescaled so +-127 covers alpha*x = +-NN_QUANT_EXP_RANGE,
+		// past that the sigmoid is flat to within half an output step
+		float alpha = (activation->alpha > 0.0f) ? activation->alpha : 1.0f;
+
+		target_scale       = (NN_QUANT_EXP_RANGE/alpha)/127.0f;
+		qnet->output_scale = 1.0f/127.0f;
+
+		for (int index=-128; index<128; index++)
+			qnet->sigmoid_table[index+128] =
+				(signed char)NN_Saturate8(127.0f/(1.0f + (float)exp(-alpha*index*target_scale)));
+		} break;
+
+	} // end switch
+
+// quantise each neurode's weights against its own largest weight
+for (index_j=0; index_j<num_outputs; index_j++)
+	{
+	float largest = 0.0f;
+
+	for (index_i=0; index_i<num_inputs; index_i++)
+		if (fabs(MAT(weight_matrix,num_outputs,index_i,index_j)) > largest)
+			largest = (float)fabs(MAT(weight_matrix,num_outputs,index_i,index_j));
+
+	float scale = (largest > 0.0f) ? largest/127.0f : 1.0f;
+	signed char *row = qnet->qweights + index_j*qnet->stride;
+
+	for (index_i=0; index_i<num_inputs; index_i++)
+		row[index_i] = (signed char)NN_Saturate8(MAT(weight_matrix,num_outputs,index_i,index_j)/scale);
+
+	qnet->weight_scale[index_j] = scale;
+
+	// the bias goes straight into the integer sum, so it takes the sum's scale
+	double sum_scale = (double)scale*qnet->input_scale;
+	double qbias     = bias ? floor(bias[index_j]/sum_scale + 0.5) : 0.0;
+
+	if (qbias > 1.0e9)  qbias = 1.0e9;
+	if (qbias < -1.0e9) qbias = -1.0e9;
+
+	qnet->qbias[index_j] = (int)qbias;
+
+	NN_Fixed_Multiplier(sum_scale/target_scale,&qnet->mult[index_j],&qnet->shift[index_j]);
+
+	} // end for index_j
+
+return(1);
+
+} // end NN_Quantize
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Quant_Free(NN_QNET_PTR qnet)
+{
+free(qnet->qweights);
+free(qnet->weight_scale);
+free(qnet->qbias);
+free(qnet->mult);
+free(qnet->shift);
+
+memset(qnet,0,sizeof(NN_QNET));
+
+} // end NN_Quant_Free
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Quant_Inputs(const NN_QNET *qnet, const float *patterns, int num_patterns,
+					 signed char *qpatterns)
+{
+// quantises inputs against the fixed input scale, padding each row with 0s
+
+float inv_scale = 1.0f/qnet->input_scale;
+
+for (int p=0; p<num_patterns; p++)
+	{
+	const float	*x  = patterns + p*qnet->num_inputs;
+	signed char	*qx = qpatterns + p*qnet->stride;
+
+	int index;
+	for (index=0; index<qnet->num_inputs; index++)
+		qx[index] = (signed char)NN_Saturate8(x[index]*inv_scale);
+
+	for (; index<qnet->stride; index++)
+		qx[index] = 0;
+
+	} // end for p
+
+} // end NN_Quant_Inputs
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static void NN_Dot4(const signed char *w, int stride, const signed char *x, int count, int *sums)
+{
+// dot products of x with 4 consecutive weight rows, count a multiple of 16
+
+#ifdef NN_USE_SSE
+__m128i zero = _mm_setzero_si128();
+__m128i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+
+for (int k=0; k<count; k+=16)
+	{
+	// sign extend 16 inputs to two sets of 8 shorts, once for all 4 rows
+	__m128i xv = _mm_loadu_si128((const __m128i *)(x+k));
+	__m128i xs = _mm_cmpgt_epi8(zero,xv);
+	__m128i xl = _mm_unpacklo_epi8(xv,xs), xh = _mm_unpackhi_epi8(xv,xs);
+	__m128i wv, ws;
+
+#define NN_DOT_ROW(s,r) \
+	wv = _mm_loadu_si128((const __m128i *)(w+(r)*stride+k)); \
+	ws = _mm_cmpgt_epi8(zero,wv); \
+	s  = _mm_add_epi32(s,_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(wv,ws),xl), \
+										_mm_madd_epi16(_mm_unpackhi_epi8(wv,ws),xh)));
+
+	NN_DOT_ROW(s0,0)
+	NN_DOT_ROW(s1,1)
+	NN_DOT_ROW(s2,2)
+	NN_DOT_ROW(s3,3)
+
+#undef NN_DOT_ROW
+
+	} // end for k
+
+// horizontal sums: transpose the 4 partial sums and add down the columns
+__m128i t0 = _mm_unpacklo_epi32(s0,s1), t1 = _mm_unpackhi_epi32(s0,s1),
+		t2 = _mm_unpacklo_epi32(s2,s3), t3 = _mm_unpackhi_epi32(s2,s3);
+
+__m128i total = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi64(t0,t2),_mm_unpackhi_epi64(t0,t2)),
+							  _mm_add_epi32(_mm_unpacklo_epi64(t1,t3),_mm_unpackhi_epi64(t1,t3)));
+
+_mm_storeu_si128((__m128i *)sums,total);
+#else
+for (int r=0; r<4; r++)
+	{
+	int sum = 0;
+	for (int k=0; k<count; k++)
+		sum += w[r*stride+k]*x[k];
+	sums[r] = sum;
+	} // end for r
+#endif
+
+} // end NN_Dot4
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static int NN_Dot1(const signed char *w, const signed char *x, int count)
+{
+int sum = 0;
+
+for (int k=0; k<count; k++)
+	sum += w[k]*x[k];
+
+return(sum);
+
+} // end NN_Dot1
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Quant_Forward(const NN_QNET *qnet, const signed char *qpatterns, int num_patterns,
+					  signed char *outputs)
+{
+// integer forward pass, one pattern at a time, 4 neurodes per dot product
+
+int no = qnet->num_outputs,
+	stride = qnet->stride,
+	sums[4];
+
+for (int p=0; p<num_patterns; p++)
+	{
+	const signed char *x = qpatterns + p*stride;
+	signed char *out = outputs + p*no;
+
+	for (int j0=0; j0<no; j0+=4)
+		{
+		int count = (no-j0 < 4) ? no-j0 : 4;
+
+		if (count==4)
+			NN_Dot4(qnet->qweights + j0*stride,stride,x,stride,sums);
+		else
+			for (int r=0; r<count; r++)
+				sums[r] = NN_Dot1(qnet->qweights + (j0+r)*stride,x,stride);
+
+		for (int r=0; r<count; r++)
+			{
+			int j   = j0 + r;
+			int acc = sums[r] + qnet->qbias[j];
+
+			switch(qnet->activation.func)
+				{
+				case NN_ACTF_STEP:
+					out[j] = (acc >= 0) ? qnet->qstep_high : qnet->qstep_low;
+					break;
+
+				case NN_ACTF_LINEAR:
+					out[j] = (signed char)NN_Requantize(acc,qnet->mult[j],qnet->shift[j]);
+					break;
+
+				default:
+					out[j] = qnet->sigmoid_table[NN_Requantize(acc,qnet->mult[j],qnet->shift[j]) + 128];
+					break;
+
+				} // end switch
+
+			} // end for r
+
+		} // end for j0
+
+	} // end for p
+
+} // end NN_Quant_Forward
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Quant_Dequantize(const NN_QNET *qnet, const signed char *qoutputs, int count,
+						 float *outputs)
+{
+for (int index=0; index<count; index++)
+	outputs[index] = qoutputs[index]*qnet->output_scale;
+} // end NN_Quant_Dequantize
+
+//////////////////////////////////////////////////////////////////////////////////
+
+static int NN_Winner(const float *outputs, int count)
+{
+// index of the strongest output, the first one wins a tie
+
+int best = 0;
+
+for (int index=1; index<count; index++)
+	if (outputs[index] > outputs[best])
+		best = index;
+
+return(best);
+
+} // end NN_Winner
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Quant_Compare(const NN_QNET *qnet, const float *weight_matrix, const float *bias,
+					  const float *patterns, int num_patterns, NN_QUANT_REPORT_PTR report)
+{
+// runs both nets on the same patterns and measures the damage
+
+int ni = qnet->num_inputs,
+	no = qnet->num_outputs,
+	index_i, index_j;
+
+float		*fout = (float *)malloc(num_patterns*no*sizeof(float)),
+			*qout = (float *)malloc(num_patterns*no*sizeof(float));
+signed char	*qin  = (signed char *)malloc(num_patterns*qnet->stride),
+			*q8   = (signed char *)malloc(num_patterns*no);
+
+memset(report,0,sizeof(NN_QUANT_REPORT));
+report->num_patterns = num_patterns;
+report->num_outputs  = no;
+report->float_bytes  = (ni*no + (bias ? no : 0))*(int)sizeof(float);
+report->quant_bytes  = no*qnet->stride + no*3*(int)sizeof(int);
+
+for (index_i=0; index_i<ni; index_i++)
+	for (index_j=0; index_j<no; index_j++)
+		{
+		float w = qnet->qweights[index_j*qnet->stride+index_i]*qnet->weight_scale[index_j];
+		float e = (float)fabs(MAT(weight_matrix,no,index_i,index_j) - w);
+
+		if (e > report->weight_error)
+			report->weight_error = e;
+		} // end for index_j
+
+if (!fout || !qout || !qin || !q8)
+	{
+	free(fout); free(qout); free(qin); free(q8);
+	return;
+	} // end if
+
+NN_Forward(weight_matrix,bias,ni,no,patterns,num_patterns,NULL,fout,&qnet->activation);
+
+NN_Quant_Inputs(qnet,patterns,num_patterns,qin);
+NN_Quant_Forward(qnet,qin,num_patterns,q8);
+NN_Quant_Dequantize(qnet,q8,num_patterns*no,qout);
+
+double	sum = 0.0, sum2 = 0.0;
+float	changed = 0.1f*127.0f*qnet->output_scale;
+
+for (int p=0; p<num_patterns; p++)
+	{
+	for (index_j=0; index_j<no; index_j++)
+		{
+		float e = (float)fabs(fout[p*no+index_j] - qout[p*no+index_j]);
+
+		sum  += e;
+		sum2 += e*e;
+
+		if (e > report->max_error)
+			report->max_error = e;
+
+		if (e > changed)
+			report->outputs_changed++;
+
+		} // end for index_j
+
+	// the quantised net's pick only counts as a change if the float net
+	// rates it at least one output step below its own pick
+	int fwin = NN_Winner(fout+p*no,no),
+		qwin = NN_Winner(qout+p*no,no);
+
+	if (fout[p*no+qwin] < fout[p*no+fwin] - qnet->output_scale)
+		report->winners_changed++;
+
+	} // end for p
+
+report->mean_error = (float)(sum/((double)num_patterns*no));
+report->rms_error  = (float)sqrt(sum2/((double)num_patterns*no));
+
+free(fout);
+free(qout);
+free(qin);
+free(q8);
+
+} // end NN_Quant_Compare
+
+//////////////////////////////////////////////////////////////////////////////////
+
+void NN_Quant_Print_Report(FILE *fp, const char *name, const NN_QUANT_REPORT *report)
+{
+int outputs = report->num_patterns*report->num_outputs;
+
+fprintf(fp,"\n%s: %d patterns x %d outputs",name,report->num_patterns,report->num_outputs);
+fprintf(fp,"\n  weights          %d bytes float, %d bytes int8 (%.1fx smaller)",
+		report->float_bytes,report->quant_bytes,
+		(float)report->float_bytes/(float)report->quant_bytes);
+fprintf(fp,"\n  weight error     %g max",report->weight_error);
+fprintf(fp,"\n  output error     %g max, %g mean, %g rms",
+		report->max_error,report->mean_error,report->rms_error);
+fprintf(fp,"\n  outputs changed  %d of %d (%.3f%%)",report->outputs_changed,outputs,
+		outputs ? 100.0f*report->outputs_changed/outputs : 0.0f);
+fprintf(fp,"\n  winners changed  %d of %d (%.3f%%)\n",report->winners_changed,report->num_patterns,
+		report->num_patterns ? 100.0f*report->winners_changed/report->num_patterns : 0.0f);
+
+} // end NN_Quant_Print_Report
@@ -0,0 +1,108 @@
+// NEURAL NET QUANTISER //////////////////////////////////////////////////////////
+
+// converts a trained float net (weight_matrix plus optional bias, laid out
+// the way the simulators and nncore.h use them) into an 8 bit integer net
+// for running lots of small nets in not much cache
+//
+// the quantised weights are stored transposed, one row per neurode, each
+// row with its own scale so a neurode with small weights doesn't lose its
+// precision to one with big ones:
+//
+//	w[i,j] ~= qweights[j,i] * weight_scale[j]
+//
+// inputs get a single fixed scale (input_range/127), so the summed input
+// activation of neurode j is a plain integer dot product plus an integer
+// bias, and the activation functions saturate the result back to 8 bits:
+//
+//	step	the sign of the integer sum picks step_high or step_low
+//	linear	the sum rescaled to output_range/127 and clamped to +-127
+//	exp		the sum rescaled and clamped to +-127, then run through a
+//			256 entry table of the sigmoid; outputs are 0..127 for 0..1
+
+#ifndef NNQUANT_H
+#define NNQUANT_H
+
+#include <stdio.h>
+
+#include "nncore.h"
+
+// DEFINES ///////////////////////////////////////////////////////////////////////
+
+#define NN_QUANT_ALIGN		16		// qweight and qpattern rows are padded to this
+#define NN_QUANT_EXP_RANGE	8.0f	// the sigmoid table covers alpha*x in [-8,8]
+
+// TYPES /////////////////////////////////////////////////////////////////////////
+
+typedef struct NN_QNET_TYP
+	{
+	int			num_inputs, num_outputs;
+	int			stride;			// row width of qweights, num_inputs padded to NN_QUANT_ALIGN
+
+	signed char	*qweights;		// num_outputs x stride, zero padded
+	float		*weight_scale;	// per neurode (row) weight scale
+	int			*qbias;			// per neurode bias, scaled by weight_scale*input_scale
+	int			*mult, *shift;	// per neurode fixed point rescale of the sum, mult/2^shift
+
+	float		input_scale;	// float input = qinput*input_scale
+	float		output_scale;	// float output = qoutput*output_scale
+
+	NN_ACTIVATION activation;
+	signed char	qstep_high, qstep_low;	// step outputs
+	signed char	sigmoid_table[256];		// exp outputs, indexed by rescaled sum+128
+
+	} NN_QNET, *NN_QNET_PTR;
+
+// how far the quantised net is from the float one
+
+typedef struct NN_QUANT_REPORT_TYP
+	{
+	int		num_patterns, num_outputs;
+	float	weight_error;		// largest |w - dequantised w|
+	float	max_error;			// largest |float output - dequantised output|
+	float	mean_error;
+	float	rms_error;
+	int		outputs_changed;	// outputs off by more than a tenth of the output range
+	int		winners_changed;	// patterns whose strongest neurode changed (by more than an output step)
+	int		float_bytes;		// weights and bias as floats
+	int		quant_bytes;		// weights, scales and bias quantised
+
+	} NN_QUANT_REPORT, *NN_QUANT_REPORT_PTR;
+
+// PROTOTYPES ////////////////////////////////////////////////////////////////////
+
+// builds qnet from a float net. input_range is the largest input magnitude
+// the net will see (1 for binary and bipolar nets), output_range is the
+// largest output magnitude the linear activation should represent. returns
+// 0 if it couldn't allocate the tables
+
+int NN_Quantize(NN_QNET_PTR qnet, const float *weight_matrix, const float *bias,
+				int num_inputs, int num_outputs, const NN_ACTIVATION *activation,
+				float input_range, float output_range);
+
+void NN_Quant_Free(NN_QNET_PTR qnet);
+
+// quantises num_patterns input vectors into qpatterns, num_patterns x stride,
+// saturating anything outside +-input_range
+
+void NN_Quant_Inputs(const NN_QNET *qnet, const float *patterns, int num_patterns,
+					 signed char *qpatterns);
+
+// runs quantised inputs through the net, outputs is num_patterns x num_outputs
+
+void NN_Quant_Forward(const NN_QNET *qnet, const signed char *qpatterns, int num_patterns,
+					  signed char *outputs);
+
+// turns quantised outputs back into floats
+
+void NN_Quant_Dequantize(const NN_QNET *qnet, const signed char *qoutputs, int count,
+						 float *outputs);
+
+// runs patterns through both the float net (with NN_Forward) and the
+// quantised one and measures the difference
+
+void NN_Quant_Compare(const NN_QNET *qnet, const float *weight_matrix, const float *bias,
+					  const float *patterns, int num_patterns, NN_QUANT_REPORT_PTR report);
+
+void NN_Quant_Print_Report(FILE *fp, const char *name, const NN_QUANT_REPORT *report);
+
+#endif
@@ -0,0 +1,298 @@
+/* Copyright (C) Scott Bilas, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Scott Bilas, 2000"
+ */
+#include <atomic>
+#include <cassert>
+
+// ConcurrentHandleMgr is HandleMgr for several threads at once. Acquire and
+// Release may be called from any thread without a lock, and Dereference is
+// wait-free (a couple of loads and a compare, no loops).
+//
+// Differences from HandleMgr:
+//
+//  - storage is a fixed table of chunks of CHUNK_SIZE slots. chunks are
+//    allocated as needed and never move or go away until the manager does,
+//    so a DATA pointer stays put no matter what other threads acquire.
+//
+//  - free slots are kept on a lock-free stack (a Treiber stack). the head
+//    is a tagged index, slot index + 1 in the low 32 bits and a counter in
+//    the high 32 that changes on every push and pop, so a head that was
+//    popped and pushed back between our read and our compare-exchange
+//    (the ABA problem) doesn't fool us.
+//
+//  - each slot's magic number is atomic, 0 while the slot is free. magic
+//    numbers come from an atomic counter in the manager instead of the
+//    static one in Handle::Init.
+//
+// As with HandleMgr, a reused slot still holds whatever DATA the previous
+// owner left in it. Dereference checks that the handle was valid when it
+// looked; keeping a handle from being released while another thread uses
+// what it points at is up to the client.
+
+template <typename DATA, typename HANDLE>
+class ConcurrentHandleMgr
+{
+private:
+    // private constants
+    enum
+    {
+        CHUNK_BITS = 8,
+        CHUNK_SIZE = 1 << CHUNK_BITS,
+        CHUNK_MASK = CHUNK_SIZE - 1,
+    };
+
+    // private types
+    typedef unsigned long long TaggedIndex;
+
+    struct Chunk
+    {
+        DATA                      m_UserData    [ CHUNK_SIZE ];  // data we're going to get to
+        std::atomic<unsigned int> m_MagicNumbers[ CHUNK_SIZE ];  // corresponding magic numbers
+        std::atomic<unsigned int> m_NextFree    [ CHUNK_SIZE ];  // free stack links (index + 1)
+
+        Chunk( void )
+        {
+            for ( unsigned int i = 0 ; i < CHUNK_SIZE ; ++i )
+            {
+                m_MagicNumbers[ i ].store( 0, std::memory_order_relaxed );
+                m_NextFree    [ i ].store( 0, std::memory_order_relaxed );
+            }
+        }
+    };
+
+    typedef std::atomic <Chunk*> ChunkPtr;
+
+    // private data
+    ChunkPtr*                 m_Chunks;      // fixed table, enough chunks for every index
+    unsigned int              m_MaxChunks;   // entries in m_Chunks
+    std::atomic<unsigned int> m_SlotCount;   // slots ever handed out (high water mark)
+    std::atomic<unsigned int> m_UsedCount;   // slots currently acquired
+    std::atomic<unsigned int> m_AutoMagic;   // source of magic numbers
+    std::atomic<TaggedIndex>  m_FreeHead;    // top of the free stack
+
+    // private methods
+    Chunk* GetChunk ( unsigned int index );
+    void   PushFree ( unsigned int index );
+    bool   PopFree  ( unsigned int& index );
+
+    static unsigned int GetTagIndex( TaggedIndex t )  {  return ( (unsigned int)( t & 0xFFFFFFFF ) );  }
+    static unsigned int GetTagCount( TaggedIndex t )  {  return ( (unsigned int)( t >> 32 ) );  }
+    static TaggedIndex  MakeTag( unsigned int index, unsigned int count )
+        {  return ( ( (TaggedIndex)count << 32 ) | index );  }
+
+    // no copying
+    ConcurrentHandleMgr( const ConcurrentHandleMgr& );
+    ConcurrentHandleMgr& operator = ( const ConcurrentHandleMgr& );
+
+public:
+
+// Lifetime.
+
+    ConcurrentHandleMgr( void );
+   ~ConcurrentHandleMgr( void );
+
+// Handle methods.
+
+    // acquisition - Acquire returns 0 if every index is in use
+    DATA* Acquire( HANDLE& handle );
+    void  Release( HANDLE  handle );
+
+    // dereferencing
+    DATA*       Dereference( HANDLE handle );
+    const DATA* Dereference( HANDLE handle ) const;
+
+    // other query - only a snapshot when other threads are busy
+    unsigned int GetUsedHandleCount( void ) const
+        {  return ( m_UsedCount.load( std::memory_order_relaxed ) );  }
+    bool HasUsedHandles( void ) const
+        {  return ( !!GetUsedHandleCount() );  }
+};
+
+template <typename DATA, typename HANDLE>
+ConcurrentHandleMgr <DATA, HANDLE> :: ConcurrentHandleMgr( void )
+    : m_SlotCount( 0 ), m_UsedCount( 0 ), m_AutoMagic( 0 ), m_FreeHead( 0 )
+{
+    // one table entry per chunk the handle's index bits can reach
+    m_MaxChunks = ( HANDLE::GetMaxIndex() + CHUNK_SIZE ) / CHUNK_SIZE;
+    m_Chunks = new ChunkPtr[ m_MaxChunks ];
+    for ( unsigned int i = 0 ; i < m_MaxChunks ; ++i )
+    {
+        m_Chunks[ i ].store( 0, std::memory_order_relaxed );
+    }
+}
+
+template <typename DATA, typename HANDLE>
+ConcurrentHandleMgr <DATA, HANDLE> :: ~ConcurrentHandleMgr( void )
+{
+    // nobody else may be using us by now
+    for ( unsigned int i = 0 ; i < m_MaxChunks ; ++i )
+    {
+        delete ( m_Chunks[ i ].load( std::memory_order_relaxed ) );
+    }
+    delete [] ( m_Chunks );
+}
+
+template <typename DATA, typename HANDLE>
+typename ConcurrentHandleMgr <DATA, HANDLE>::Chunk*
+ConcurrentHandleMgr <DATA, HANDLE> :: GetChunk( unsigned int index )
+{
+    // find the chunk for a new slot, creating it if we're first there.
+    // two threads can race to create the same chunk; the loser frees its
+    // copy and uses the winner's.
+
+    ChunkPtr& entry = m_Chunks[ index >> CHUNK_BITS ];
+    Chunk* chunk = entry.load( std::memory_order_acquire );
+    if ( chunk == 0 )
+    {
+        Chunk* fresh = new Chunk;
+        if ( entry.compare_exchange_strong( chunk, fresh,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire ) )
+        {
+            chunk = fresh;
+        }
+        else
+        {
+            delete ( fresh );
+        }
+    }
+    return ( chunk );
+}
+
+template <typename DATA, typename HANDLE>
+void ConcurrentHandleMgr <DATA, HANDLE> :: PushFree( unsigned int index )
+{
+    Chunk* chunk = m_Chunks[ index >> CHUNK_BITS ].load( std::memory_order_relaxed );
+    TaggedIndex head = m_FreeHead.load( std::memory_order_relaxed );
+    TaggedIndex top;
+
+    do
+    {
+        chunk->m_NextFree[ index & CHUNK_MASK ].store( GetTagIndex( head ), std::memory_order_relaxed );
+        top = MakeTag( index + 1, GetTagCount( head ) + 1 );
+    }
+    while ( !m_FreeHead.compare_exchange_weak( head, top,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed ) );
+}
+
+template <typename DATA, typename HANDLE>
+bool ConcurrentHandleMgr <DATA, HANDLE> :: PopFree( unsigned int& index )
+{
+    // the next link we read may be stale if someone else pops this slot
+    // first, but then the head's tag has moved on and the exchange fails.
+    // chunks are never freed, so the read itself is always safe.
+
+    TaggedIndex head = m_FreeHead.load( std::memory_order_acquire );
+    TaggedIndex next;
+
+    do
+    {
+        if ( GetTagIndex( head ) == 0 )
+        {
+            return ( false );
+        }
+
+        index = GetTagIndex( head ) - 1;
+        Chunk* chunk = m_Chunks[ index >> CHUNK_BITS ].load( std::memory_order_relaxed );
+        next = MakeTag( chunk->m_NextFree[ index & CHUNK_MASK ].load( std::memory_order_relaxed ),
+                        GetTagCount( head ) + 1 );
+    }
+    while ( !m_FreeHead.compare_exchange_weak( head, next,
+                                               std::memory_order_acquire,
+                                               std::memory_order_acquire ) );
+
+    return ( true );
+}
+
+template <typename DATA, typename HANDLE>
+DATA* ConcurrentHandleMgr <DATA, HANDLE> :: Acquire( HANDLE& handle )
+{
+    // if free stack is empty, take a new slot otherwise reuse the top one
+
+    unsigned int index;
+    if ( !PopFree( index ) )
+    {
+        index = m_SlotCount.fetch_add( 1, std::memory_order_relaxed );
+        if ( index > HANDLE::GetMaxIndex() )
+        {
+            // out of indices - leave the count pinned past the end
+            m_SlotCount.store( HANDLE::GetMaxIndex() + 1, std::memory_order_relaxed );
+            return ( 0 );
+        }
+    }
+
+    Chunk* chunk = GetChunk( index );
+
+    // 0 is used for "null handle"
+    unsigned int magic = ( m_AutoMagic.fetch_add( 1, std::memory_order_relaxed ) % HANDLE::GetMaxMagic() ) + 1;
+    handle.Init( index, magic );
+
+    // publishing the magic number is what makes the handle valid
+    chunk->m_MagicNumbers[ index & CHUNK_MASK ].store( magic, std::memory_order_release );
+    m_UsedCount.fetch_add( 1, std::memory_order_relaxed );
+
+    return ( chunk->m_UserData + ( index & CHUNK_MASK ) );
+}
+
+template <typename DATA, typename HANDLE>
+void ConcurrentHandleMgr <DATA, HANDLE> :: Release( HANDLE handle )
+{
+    // which one?
+    unsigned int index = handle.GetIndex();
+
+    // make sure it's valid
+    assert( index < m_SlotCount.load( std::memory_order_relaxed ) );
+    Chunk* chunk = m_Chunks[ index >> CHUNK_BITS ].load( std::memory_order_acquire );
+
+    // ok remove it - tag as unused (only one releaser can win this) and
+    // add to free stack
+    unsigned int magic = handle.GetMagic();
+    bool released = chunk->m_MagicNumbers[ index & CHUNK_MASK ].compare_exchange_strong(
+                        magic, 0, std::memory_order_acq_rel );
+    assert( released );
+    if ( released )
+    {
+        m_UsedCount.fetch_sub( 1, std::memory_order_relaxed );
+        PushFree( index );
+    }
+}
+
+template <typename DATA, typename HANDLE>
+inline DATA* ConcurrentHandleMgr <DATA, HANDLE>
+:: Dereference( HANDLE handle )
+{
+    if ( handle.IsNull() )  return ( 0 );
+
+    // check handle validity - the chunk must exist and the slot's magic
+    // number must match
+    unsigned int index = handle.GetIndex();
+    Chunk* chunk = ( ( index >> CHUNK_BITS ) < m_MaxChunks )
+                 ? m_Chunks[ index >> CHUNK_BITS ].load( std::memory_order_acquire )
+                 : 0;
+    if (   ( chunk == 0 )
+        || ( chunk->m_MagicNumbers[ index & CHUNK_MASK ].load( std::memory_order_acquire )
+             != handle.GetMagic() ) )
+    {
+        // no good! invalid handle == client programming error
+        assert( 0 );
+        return ( 0 );
+    }
+
+    return ( chunk->m_UserData + ( index & CHUNK_MASK ) );
+}
+
+template <typename DATA, typename HANDLE>
+inline const DATA* ConcurrentHandleMgr <DATA, HANDLE>
+:: Dereference( HANDLE handle ) const
+{
+    // this lazy cast is ok - non-const version does not modify anything
+    typedef ConcurrentHandleMgr <DATA, HANDLE> ThisType;
+    return ( const_cast <ThisType*> ( this )->Dereference( handle ) );
+}
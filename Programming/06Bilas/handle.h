@@ -12,19 +12,19 @@
 template <typename TAG>
 class Handle
 {
-    union
+    enum
     {
-        enum
-        {
-            // sizes to use for bit fields
-            MAX_BITS_INDEX = 16,
-            MAX_BITS_MAGIC = 16,
+        // sizes to use for bit fields
+        MAX_BITS_INDEX = 16,
+        MAX_BITS_MAGIC = 16,
 
-            // sizes to compare against for asserting dereferences
-            MAX_INDEX = ( 1 << MAX_BITS_INDEX) - 1,
-            MAX_MAGIC = ( 1 << MAX_BITS_MAGIC) - 1,
-        };
+        // sizes to compare against for asserting dereferences
+        MAX_INDEX = ( 1 << MAX_BITS_INDEX) - 1,
+        MAX_MAGIC = ( 1 << MAX_BITS_MAGIC) - 1,
+    };
 
+    union
+    {
         struct
         {
             unsigned m_Index : MAX_BITS_INDEX;  // index into resource array
@@ -40,6 +40,7 @@ public:
     Handle( void ) : m_Handle( 0 )  {  }
 
     void Init( unsigned int index );
+    void Init( unsigned int index, unsigned int magic );
 
 // Query.
 
@@ -49,6 +50,11 @@ public:
     bool         IsNull   ( void ) const  {  return ( !m_Handle );  }
 
     operator unsigned int ( void ) const  {  return (  m_Handle );  }
+
+// Limits.
+
+    static unsigned int GetMaxIndex( void )  {  return ( MAX_INDEX );  }
+    static unsigned int GetMaxMagic( void )  {  return ( MAX_MAGIC );  }
 };
 
 template <typename TAG>
@@ -67,6 +73,20 @@ void Handle <TAG> :: Init( unsigned int index )
     m_Magic = s_AutoMagic;
 }
 
+template <typename TAG>
+void Handle <TAG> :: Init( unsigned int index, unsigned int magic )
+{
+    // for managers that hand out their own magic numbers (the shared
+    // s_AutoMagic above is not thread safe)
+
+    assert( IsNull() );             // don't allow reassignment
+    assert( index <= MAX_INDEX );   // verify range
+    assert( ( magic != 0 ) && ( magic <= MAX_MAGIC ) );
+
+    m_Index = index;
+    m_Magic = magic;
+}
+
 template <typename TAG>
 inline bool operator != ( Handle <TAG> l, Handle <TAG> r )
     {  return ( l.GetHandle() != r.GetHandle() );  }
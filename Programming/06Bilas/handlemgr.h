@@ -10,17 +10,140 @@
 #include <vector>
 #include <cassert>
 
-template <typename DATA, typename HANDLE>
+// Storage policies. HandleMgr keeps its DATA in one of these:
+//
+//   unsigned int GetSlotCount( void ) const;   slots created so far
+//   void  AddSlot( void );                     add slot GetSlotCount()
+//   DATA* Use    ( unsigned int index );       slot is being acquired
+//   void  Unuse  ( unsigned int index );       slot has been released
+//   DATA* Get    ( unsigned int index );       slot is in use
+
+// HandleVecStorage: one std::vector, the original layout. cheapest to
+// dereference, but growing it copies every DATA and moves them all, so
+// any DATA* a caller is holding goes bad on the next Acquire.
+
+template <typename DATA>
+class HandleVecStorage
+{
+    std::vector <DATA> m_UserData;
+
+public:
+    unsigned int GetSlotCount( void ) const
+        {  return ( m_UserData.size() );  }
+    void  AddSlot( void )
+        {  m_UserData.push_back( DATA() );  }
+    DATA* Use  ( unsigned int index )
+        {  return ( &m_UserData[ index ] );  }
+    void  Unuse( unsigned int /*index*/ )
+        {  }
+    DATA* Get  ( unsigned int index )
+        {  return ( &m_UserData[ index ] );  }
+};
+
+// HandlePagedStorage: fixed pages of 2^PAGE_BITS DATA reached through a
+// page table. growing only adds a page pointer to the table, so nothing
+// is ever copied and a DATA* stays good until its handle is released.
+// each page counts its used slots and is freed when the count drops to
+// zero; one empty page is kept back as a spare so a single handle
+// acquired and released over and over doesn't allocate every time.
+
+template <typename DATA, unsigned int PAGE_BITS = 8>
+class HandlePagedStorage
+{
+    enum
+    {
+        PAGE_SIZE = 1 << PAGE_BITS,
+        PAGE_MASK = PAGE_SIZE - 1,
+    };
+
+    struct Page
+    {
+        DATA         m_UserData[ PAGE_SIZE ];
+        unsigned int m_UsedCount;
+
+        Page( void ) : m_UsedCount( 0 )  {  }
+    };
+
+    typedef std::vector <Page*> PageVec;
+
+    PageVec      m_Pages;       // page table, 0 for a reclaimed page
+    Page*        m_SparePage;   // last page to empty, kept for reuse
+    unsigned int m_SlotCount;   // slots created so far
+
+    // no copying
+    HandlePagedStorage( const HandlePagedStorage& );
+    HandlePagedStorage& operator = ( const HandlePagedStorage& );
+
+public:
+    HandlePagedStorage( void ) : m_SparePage( 0 ), m_SlotCount( 0 )  {  }
+   ~HandlePagedStorage( void )
+    {
+        for ( unsigned int i = 0 ; i < m_Pages.size() ; ++i )
+        {
+            delete ( m_Pages[ i ] );
+        }
+        delete ( m_SparePage );
+    }
+
+    unsigned int GetSlotCount( void ) const
+        {  return ( m_SlotCount );  }
+
+    void AddSlot( void )
+    {
+        // start a new page table entry, the page itself waits for Use
+        if ( ( m_SlotCount & PAGE_MASK ) == 0 )
+        {
+            m_Pages.push_back( 0 );
+        }
+        ++m_SlotCount;
+    }
+
+    DATA* Use( unsigned int index )
+    {
+        Page*& page = m_Pages[ index >> PAGE_BITS ];
+        if ( page == 0 )
+        {
+            if ( m_SparePage != 0 )
+            {
+                page = m_SparePage;
+                m_SparePage = 0;
+            }
+            else
+            {
+                page = new Page;
+            }
+        }
+        ++page->m_UsedCount;
+        return ( page->m_UserData + ( index & PAGE_MASK ) );
+    }
+
+    void Unuse( unsigned int index )
+    {
+        Page*& page = m_Pages[ index >> PAGE_BITS ];
+        assert( ( page != 0 ) && ( page->m_UsedCount > 0 ) );
+        if ( --page->m_UsedCount == 0 )
+        {
+            // whole page is empty - reclaim it
+            delete ( m_SparePage );
+            m_SparePage = page;
+            page = 0;
+        }
+    }
+
+    DATA* Get( unsigned int index )
+        {  return ( m_Pages[ index >> PAGE_BITS ]->m_UserData + ( index & PAGE_MASK ) );  }
+};
+
+template <typename DATA, typename HANDLE, typename STORAGE = HandleVecStorage <DATA> >
 class HandleMgr
 {
 private:
     // private types
-    typedef std::vector <DATA>         UserVec;
     typedef std::vector <unsigned int> MagicVec;
     typedef std::vector <unsigned int> FreeVec;
 
     // private data
-    UserVec  m_UserData;     // data we're going to get to
+    STORAGE  m_UserData;     // data we're going to get to
     MagicVec m_MagicNumbers; // corresponding magic numbers
     FreeVec  m_FreeSlots;    // keeps track of free slots in the db
 
@@ -48,8 +171,8 @@ public:
         {  return ( !!GetUsedHandleCount() );  }
 };
 
-template <typename DATA, typename HANDLE>
-DATA* HandleMgr <DATA, HANDLE> :: Acquire( HANDLE& handle )
+template <typename DATA, typename HANDLE, typename STORAGE>
+DATA* HandleMgr <DATA, HANDLE, STORAGE> :: Acquire( HANDLE& handle )
 {
     // if free list is empty, add a new one otherwise use first one found
 
@@ -58,7 +181,7 @@ DATA* HandleMgr <DATA, HANDLE> :: Acquire( HANDLE& handle )
     {
         index = m_MagicNumbers.size();
         handle.Init( index );
-        m_UserData.push_back( DATA() );
+        m_UserData.AddSlot();
         m_MagicNumbers.push_back( handle.GetMagic() );
     }
     else
@@ -68,26 +191,27 @@ DATA* HandleMgr <DATA, HANDLE> :: Acquire( HANDLE& handle )
         m_FreeSlots.pop_back();
         m_MagicNumbers[ index ] = handle.GetMagic();
     }
-    return ( m_UserData.begin() + index );
+    return ( m_UserData.Use( index ) );
 }
 
-template <typename DATA, typename HANDLE>
-void HandleMgr <DATA, HANDLE> :: Release( HANDLE handle )
+template <typename DATA, typename HANDLE, typename STORAGE>
+void HandleMgr <DATA, HANDLE, STORAGE> :: Release( HANDLE handle )
 {
     // which one?
     unsigned int index = handle.GetIndex();
 
     // make sure it's valid
-    assert( index < m_UserData.size() );
+    assert( index < m_MagicNumbers.size() );
     assert( m_MagicNumbers[ index ] == handle.GetMagic() );
 
     // ok remove it - tag as unused and add to free list
     m_MagicNumbers[ index ] = 0;
     m_FreeSlots.push_back( index );
+    m_UserData.Unuse( index );
 }
 
-template <typename DATA, typename HANDLE>
-inline DATA* HandleMgr <DATA, HANDLE>
+template <typename DATA, typename HANDLE, typename STORAGE>
+inline DATA* HandleMgr <DATA, HANDLE, STORAGE>
 :: Dereference( HANDLE handle )
 {
     if ( handle.IsNull() )  return ( 0 );
@@ -95,7 +219,7 @@ inline DATA* HandleMgr <DATA, HANDLE>
     // check handle validity - $ this check can be removed for speed
     // if you can assume all handle references are always valid.
     unsigned int index = handle.GetIndex();
-    if (   ( index >= m_UserData.size() )
+    if (   ( index >= m_MagicNumbers.size() )
         || ( m_MagicNumbers[ index ] != handle.GetMagic() ) )
     {
         // no good! invalid handle == client programming error
@@ -103,14 +227,14 @@ inline DATA* HandleMgr <DATA, HANDLE>
         return ( 0 );
     }
 
-    return ( m_UserData.begin() + index );
+    return ( m_UserData.Get( index ) );
 }
 
-template <typename DATA, typename HANDLE>
-inline const DATA* HandleMgr <DATA, HANDLE>
+template <typename DATA, typename HANDLE, typename STORAGE>
+inline const DATA* HandleMgr <DATA, HANDLE, STORAGE>
 :: Dereference( HANDLE handle ) const
 {
     // this lazy cast is ok - non-const version does not modify anything
-    typedef HandleMgr <DATA, HANDLE> ThisType;
+    typedef HandleMgr <DATA, HANDLE, STORAGE> ThisType;
     return ( const_cast <ThisType*> ( this )->Dereference( handle ) );
 }
@@ -0,0 +1,214 @@
+/* Copyright (C) Scott Bilas, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Scott Bilas, 2000"
+ */
+
+// handlestress: hammers one ConcurrentHandleMgr from several threads.
+// each thread keeps a few handles, and at random acquires another,
+// dereferences or releases one it holds, or swaps one with another thread
+// through a shared mailbox, so handles are often released by a different
+// thread than acquired them.
+//
+// every slot records its current owner. acquiring a slot that still has
+// an owner, dereferencing to a slot owned by someone else, or releasing a
+// slot whose owner changed under us means two live handles shared a slot,
+// and is counted as an error. at the end every handle is released and the
+// manager must be empty. exits non-zero on any error.
+//
+//   g++ -O2 -std=c++11 -pthread -o handlestress handlestress.cpp
+//   handlestress [threads] [operations per thread]
+//
+// worth running under -fsanitize=thread as well.
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "handle.h"
+#include "concurrenthandlemgr.h"
+
+struct tagStress  {  };
+typedef Handle <tagStress> HStress;
+
+struct Slot
+{
+    std::atomic<unsigned long long> m_Owner;    // token of the holder, 0 if none
+
+    Slot( void ) : m_Owner( 0 )  {  }
+};
+
+typedef ConcurrentHandleMgr <Slot, HStress> StressMgr;
+
+enum
+{
+    MAX_HELD  = 64,     // handles each thread keeps at most
+    MAILBOXES = 16,     // for passing handles between threads
+};
+
+static StressMgr                 s_Mgr;
+static std::atomic<unsigned int> s_Mailboxes[ MAILBOXES ];  // raw handles, 0 if empty
+static std::atomic<unsigned int> s_Errors( 0 );
+
+// the owner token for a handle: unique while the handle is live
+static unsigned long long Token( HStress handle )
+    {  return ( ( (unsigned long long)handle.GetHandle() << 16 ) | 1 );  }
+
+static HStress FromRaw( unsigned int raw )
+{
+    HStress handle;
+    handle.Init( raw & HStress::GetMaxIndex(), raw >> 16 );
+    return ( handle );
+}
+
+static void Fail( const char* what, HStress handle )
+{
+    if ( s_Errors.fetch_add( 1 ) < 10 )
+    {
+        printf( "error: %s (index %u, magic %u)\n", what, handle.GetIndex(), handle.GetMagic() );
+    }
+}
+
+static bool Acquire( HStress& handle )
+{
+    handle = HStress();     // Init wants a null handle
+    Slot* slot = s_Mgr.Acquire( handle );
+    if ( slot == 0 )
+    {
+        return ( false );
+    }
+
+    if ( slot->m_Owner.exchange( Token( handle ) ) != 0 )
+    {
+        Fail( "acquired a slot that was still owned", handle );
+    }
+    return ( true );
+}
+
+static void Check( HStress handle )
+{
+    Slot* slot = s_Mgr.Dereference( handle );
+    if ( ( slot == 0 ) || ( slot->m_Owner.load() != Token( handle ) ) )
+    {
+        Fail( "dereferenced to someone else's slot", handle );
+    }
+}
+
+static void Release( HStress handle )
+{
+    Slot* slot = s_Mgr.Dereference( handle );
+    unsigned long long token = Token( handle );
+    if ( ( slot == 0 ) || !slot->m_Owner.compare_exchange_strong( token, 0 ) )
+    {
+        Fail( "slot changed owner before release", handle );
+    }
+    s_Mgr.Release( handle );
+}
+
+static void Worker( unsigned int seed, int operations )
+{
+    HStress held[ MAX_HELD ];
+    int     numHeld = 0;
+
+    for ( int i = 0 ; i < operations ; ++i )
+    {
+        seed = seed * 1103515245 + 12345;
+        unsigned int r = seed >> 8;
+        int pick = numHeld ? (int)( ( r >> 4 ) % numHeld ) : 0;
+
+        switch ( r % 8 )
+        {
+            case 0:
+            case 1:
+            case 2:
+                if ( ( numHeld < MAX_HELD ) && Acquire( held[ numHeld ] ) )
+                {
+                    ++numHeld;
+                }
+                break;
+
+            case 3:
+            case 4:
+                if ( numHeld )  Check( held[ pick ] );
+                break;
+
+            case 5:
+            case 6:
+                if ( numHeld )
+                {
+                    Release( held[ pick ] );
+                    held[ pick ] = held[ --numHeld ];
+                }
+                break;
+
+            case 7:
+            {
+                // leave one of ours (or nothing) and take whatever was there
+                unsigned int ours = numHeld ? held[ pick ].GetHandle() : 0;
+                unsigned int theirs = s_Mailboxes[ ( r >> 12 ) % MAILBOXES ].exchange( ours );
+                if ( numHeld )
+                {
+                    held[ pick ] = held[ --numHeld ];
+                }
+                if ( theirs != 0 )
+                {
+                    held[ numHeld ] = FromRaw( theirs );
+                    Check( held[ numHeld++ ] );
+                }
+                break;
+            }
+        }
+    }
+
+    while ( numHeld )
+    {
+        Release( held[ --numHeld ] );
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    int threads    = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 8;
+    int operations = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 1000000;
+
+    for ( int i = 0 ; i < MAILBOXES ; ++i )
+    {
+        s_Mailboxes[ i ].store( 0 );
+    }
+
+    std::vector <std::thread> workers;
+    for ( int i = 0 ; i < threads ; ++i )
+    {
+        workers.push_back( std::thread( Worker, (unsigned int)i + 1, operations ) );
+    }
+    for ( int i = 0 ; i < threads ; ++i )
+    {
+        workers[ i ].join();
+    }
+
+    // what's left in the mailboxes has no holder
+    for ( int i = 0 ; i < MAILBOXES ; ++i )
+    {
+        unsigned int raw = s_Mailboxes[ i ].load();
+        if ( raw != 0 )
+        {
+            Release( FromRaw( raw ) );
+        }
+    }
+
+    if ( s_Mgr.HasUsedHandles() )
+    {
+        printf( "error: %u handles still in use at the end\n", s_Mgr.GetUsedHandleCount() );
+        s_Errors.fetch_add( 1 );
+    }
+
+    printf( "%d threads, %d operations each: %u errors\n",
+            threads, operations, s_Errors.load() );
+    return ( s_Errors.load() ? 1 : 0 );
+}
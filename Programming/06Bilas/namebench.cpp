@@ -0,0 +1,185 @@
+/* Copyright (C) Scott Bilas, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Scott Bilas, 2000"
+ */
+
+// namebench: times name lookups three ways over 100k asset names -
+// the std::map + stricmp index TextureMgr used to have, HashedNameIndex
+// hashing the name on every lookup, and HashedNameIndex with the hashes
+// worked out up front. Lookups use differently-cased copies of the names
+// and the benchmark counts heap allocations made while looking up.
+//
+// Build it with NDEBUG: otherwise HashedNameIndex checks every name it
+// finds against the stored one, and "hash each time" times that instead.
+//
+//   g++ -O2 -DNDEBUG -o namebench namebench.cpp
+//   namebench [names] [lookup passes]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <new>
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "nameindex.h"
+
+// count every allocation so we can see which lookups make them
+static unsigned long long s_AllocCount = 0;
+
+void* operator new ( size_t size )
+{
+    ++s_AllocCount;
+    void* p = malloc( size ? size : 1 );
+    if ( p == 0 )  throw std::bad_alloc();
+    return ( p );
+}
+
+void operator delete ( void* p ) noexcept
+    {  free( p );  }
+
+void operator delete ( void* p, size_t ) noexcept
+    {  free( p );  }
+
+// case-insensitive compare, portable stand-in for stricmp
+static int CompareNoCase( const char* l, const char* r )
+{
+    for ( ; *l && ( tolower( (unsigned char)*l ) == tolower( (unsigned char)*r ) ) ; ++l, ++r )
+        {  }
+    return ( tolower( (unsigned char)*l ) - tolower( (unsigned char)*r ) );
+}
+
+struct istring_less
+{
+    bool operator () ( const std::string& l, const std::string& r ) const
+        {  return ( CompareNoCase( l.c_str(), r.c_str() ) < 0 );  }
+};
+
+typedef std::map <std::string, unsigned int, istring_less> MapIndex;
+typedef std::vector <std::string> StringVec;
+typedef std::chrono::steady_clock Clock;
+
+static double Elapsed( Clock::time_point start )
+{
+    return ( std::chrono::duration <double, std::milli> ( Clock::now() - start ).count() );
+}
+
+static void Report( const char* name, double ms, unsigned long long lookups,
+                    unsigned long long allocs, unsigned long long found )
+{
+    printf( "%-28s %9.2f ms %8.1f ns/op %10llu allocs  %llu found\n",
+            name, ms, ms * 1.0e6 / lookups, allocs, found );
+}
+
+int main( int argc, char* argv[] )
+{
+    unsigned int count  = ( argc > 1 ) ? atoi( argv[ 1 ] ) : 100000;
+    unsigned int passes = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 10;
+    unsigned int i, pass;
+    char buffer[ 128 ];
+
+    // asset names the way a game would have them, and upper-cased copies
+    // to look them up by
+    StringVec names, lookups;
+    srand( 1 );
+    for ( i = 0 ; i < count ; ++i )
+    {
+        sprintf( buffer, "art/textures/%s/region_%02d/tile_%05u_%c.raw",
+                 ( i & 1 ) ? "world" : "characters", rand() % 64, i, 'a' + rand() % 26 );
+        names.push_back( buffer );
+        for ( char* c = buffer ; *c ; ++c )  *c = (char)toupper( (unsigned char)*c );
+        lookups.push_back( buffer );
+    }
+
+    // lookup order is shuffled so neither index gets an easy ride
+    std::vector <unsigned int> order( count );
+    for ( i = 0 ; i < count ; ++i )  order[ i ] = i;
+    for ( i = count ; i > 1 ; --i )  std::swap( order[ i - 1 ], order[ rand() % i ] );
+
+    std::vector <NameHash> hashes( count );
+    for ( i = 0 ; i < count ; ++i )  hashes[ i ] = HashName( lookups[ i ].c_str() );
+
+    unsigned long long total = (unsigned long long)count * passes;
+    unsigned long long found, allocs;
+    Clock::time_point start;
+
+    printf( "%u names, %u lookup passes\n\n", count, passes );
+
+    // the old index - GetTexture built a std::string for every call
+    MapIndex map;
+    allocs = s_AllocCount;
+    start = Clock::now();
+    for ( i = 0 ; i < count ; ++i )  map.insert( std::make_pair( names[ i ], i ) );
+    Report( "map build", Elapsed( start ), count, s_AllocCount - allocs, map.size() );
+
+    found = 0;
+    allocs = s_AllocCount;
+    start = Clock::now();
+    for ( pass = 0 ; pass < passes ; ++pass )
+    {
+        for ( i = 0 ; i < count ; ++i )
+        {
+            MapIndex::iterator it = map.find( lookups[ order[ i ] ].c_str() );
+            found += ( it != map.end() ) && ( it->second == order[ i ] );
+        }
+    }
+    Report( "map find", Elapsed( start ), total, s_AllocCount - allocs, found );
+
+    // the hashed index
+    HashedNameIndex <unsigned int> index;
+    allocs = s_AllocCount;
+    start = Clock::now();
+    for ( i = 0 ; i < count ; ++i )
+    {
+        *index.Insert( HashName( names[ i ].c_str() ), names[ i ].c_str() ).first = i;
+    }
+    Report( "hash build", Elapsed( start ), count, s_AllocCount - allocs, index.GetCount() );
+
+    found = 0;
+    allocs = s_AllocCount;
+    start = Clock::now();
+    for ( pass = 0 ; pass < passes ; ++pass )
+    {
+        for ( i = 0 ; i < count ; ++i )
+        {
+            const char* name = lookups[ order[ i ] ].c_str();
+            unsigned int* value = index.Find( HashName( name ), name );
+            found += ( value != 0 ) && ( *value == order[ i ] );
+        }
+    }
+    Report( "hash find (hash each time)", Elapsed( start ), total, s_AllocCount - allocs, found );
+
+    found = 0;
+    allocs = s_AllocCount;
+    start = Clock::now();
+    for ( pass = 0 ; pass < passes ; ++pass )
+    {
+        for ( i = 0 ; i < count ; ++i )
+        {
+            unsigned int* value = index.Find( hashes[ order[ i ] ] );
+            found += ( value != 0 ) && ( *value == order[ i ] );
+        }
+    }
+    Report( "hash find (pre-hashed)", Elapsed( start ), total, s_AllocCount - allocs, found );
+
+    // erase every other name and make sure the rest are still reachable
+    for ( i = 0 ; i < count ; i += 2 )  index.Erase( hashes[ i ] );
+    found = 0;
+    for ( i = 0 ; i < count ; ++i )
+    {
+        unsigned int* value = index.Find( hashes[ i ] );
+        found += ( i & 1 ) ? ( ( value != 0 ) && ( *value == i ) ) : ( value == 0 );
+    }
+    printf( "\nafter erasing half: %u left, %s\n", index.GetCount(),
+            ( found == count ) ? "all lookups correct" : "LOOKUP MISMATCH" );
+
+    return ( found == count ? 0 : 1 );
+}
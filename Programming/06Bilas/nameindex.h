@@ -0,0 +1,248 @@
+/* Copyright (C) Scott Bilas, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Scott Bilas, 2000"
+ */
+#include <string>
+#include <vector>
+#include <cassert>
+
+// Hashed, case-insensitive name index. A name is identified by a 64-bit
+// FNV-1a hash of its lower-cased characters, which the caller can compute
+// once (or at build time) and pass around instead of the string. With 64
+// bits a collision between real asset names is not a practical concern,
+// so lookups compare hashes only - no strings, no allocation. Debug builds
+// check that a name handed in along with its hash really matches the
+// entry it found.
+//
+// The table is open addressing with linear probing, kept at most half
+// full, and erases by shifting later entries back so there are no
+// tombstones to slow down later probes. Pointers to values are only good
+// until the next Insert.
+
+typedef unsigned long long NameHash;
+
+inline NameHash HashName( const char* name )
+{
+    NameHash hash = 14695981039346656037ULL;
+    for ( ; *name ; ++name )
+    {
+        unsigned char c = (unsigned char)*name;
+        if ( ( c >= 'A' ) && ( c <= 'Z' ) )
+        {
+            c += 'a' - 'A';
+        }
+        hash = ( hash ^ c ) * 1099511628211ULL;
+    }
+
+    // 0 marks an empty slot
+    return ( hash ? hash : 1 );
+}
+
+template <typename VALUE>
+class HashedNameIndex
+{
+public:
+
+    struct Entry
+    {
+        NameHash    m_Hash;     // 0 for an empty slot
+        VALUE       m_Value;
+        std::string m_Name;     // for reconstruction and checking
+
+        Entry( void ) : m_Hash( 0 )  {  }
+    };
+
+private:
+    // private types
+    typedef std::vector <Entry> EntryVec;
+
+    // private data
+    EntryVec     m_Entries;     // capacity is always a power of 2
+    unsigned int m_Count;       // used entries
+
+    // private methods
+    unsigned int GetMask( void ) const
+        {  return ( m_Entries.size() - 1 );  }
+    unsigned int FindSlot( NameHash hash ) const;
+    void         Grow    ( void );
+
+    static bool SameName( const std::string& l, const char* r );
+
+public:
+
+// Lifetime.
+
+    HashedNameIndex( unsigned int capacity = 64 );
+   ~HashedNameIndex( void )  {  }
+
+// Index methods.
+
+    // returns the entry's value, or 0 if it isn't there
+    VALUE* Find( NameHash hash, const char* name = 0 );
+
+    // finds or adds the entry, the bool is true if it was added (with a
+    // default VALUE)
+    std::pair <VALUE*, bool> Insert( NameHash hash, const char* name );
+
+    // removes the entry, returns false if it wasn't there
+    bool Erase( NameHash hash );
+
+    void Clear( void );
+
+// Query.
+
+    unsigned int GetCount   ( void ) const  {  return ( m_Count );  }
+    unsigned int GetCapacity( void ) const  {  return ( m_Entries.size() );  }
+
+    // raw slot access for walking every entry, skip the ones with a 0 hash
+    const Entry& GetSlot( unsigned int slot ) const  {  return ( m_Entries[ slot ] );  }
+};
+
+template <typename VALUE>
+HashedNameIndex <VALUE> :: HashedNameIndex( unsigned int capacity )
+    : m_Count( 0 )
+{
+    // round up to a power of 2
+    unsigned int size = 16;
+    while ( size < capacity )
+    {
+        size <<= 1;
+    }
+    m_Entries.resize( size );
+}
+
+template <typename VALUE>
+bool HashedNameIndex <VALUE> :: SameName( const std::string& l, const char* r )
+{
+    const char* c = l.c_str();
+    for ( ; *c && *r ; ++c, ++r )
+    {
+        char lc = ( ( *c >= 'A' ) && ( *c <= 'Z' ) ) ? (char)( *c + 'a' - 'A' ) : *c;
+        char rc = ( ( *r >= 'A' ) && ( *r <= 'Z' ) ) ? (char)( *r + 'a' - 'A' ) : *r;
+        if ( lc != rc )  return ( false );
+    }
+    return ( *c == *r );
+}
+
+template <typename VALUE>
+unsigned int HashedNameIndex <VALUE> :: FindSlot( NameHash hash ) const
+{
+    // walk from the home slot to the entry or the first empty slot
+    unsigned int mask = GetMask();
+    unsigned int slot = (unsigned int)hash & mask;
+    while ( ( m_Entries[ slot ].m_Hash != 0 ) && ( m_Entries[ slot ].m_Hash != hash ) )
+    {
+        slot = ( slot + 1 ) & mask;
+    }
+    return ( slot );
+}
+
+template <typename VALUE>
+void HashedNameIndex <VALUE> :: Grow( void )
+{
+    EntryVec old( m_Entries.size() * 2 );
+    old.swap( m_Entries );
+
+    for ( typename EntryVec::iterator i = old.begin() ; i != old.end() ; ++i )
+    {
+        if ( i->m_Hash != 0 )
+        {
+            Entry& entry = m_Entries[ FindSlot( i->m_Hash ) ];
+            entry.m_Hash  = i->m_Hash;
+            entry.m_Value = i->m_Value;
+            entry.m_Name.swap( i->m_Name );
+        }
+    }
+}
+
+template <typename VALUE>
+VALUE* HashedNameIndex <VALUE> :: Find( NameHash hash, const char* name )
+{
+    Entry& entry = m_Entries[ FindSlot( hash ) ];
+    if ( entry.m_Hash == 0 )
+    {
+        return ( 0 );
+    }
+
+    // two names with one hash - practically never, but say so if it does
+    assert( ( name == 0 ) || SameName( entry.m_Name, name ) );
+    (void)name;     // only the assert uses it
+    return ( &entry.m_Value );
+}
+
+template <typename VALUE>
+std::pair <VALUE*, bool> HashedNameIndex <VALUE> :: Insert( NameHash hash, const char* name )
+{
+    assert( hash != 0 );
+
+    unsigned int slot = FindSlot( hash );
+    if ( m_Entries[ slot ].m_Hash != 0 )
+    {
+        assert( SameName( m_Entries[ slot ].m_Name, name ) );
+        return ( std::make_pair( &m_Entries[ slot ].m_Value, false ) );
+    }
+
+    // keep it no more than half full so probes stay short
+    if ( ( m_Count + 1 ) * 2 > m_Entries.size() )
+    {
+        Grow();
+        slot = FindSlot( hash );
+    }
+
+    Entry& entry = m_Entries[ slot ];
+    entry.m_Hash  = hash;
+    entry.m_Value = VALUE();
+    entry.m_Name  = name;
+    ++m_Count;
+
+    return ( std::make_pair( &entry.m_Value, true ) );
+}
+
+template <typename VALUE>
+bool HashedNameIndex <VALUE> :: Erase( NameHash hash )
+{
+    unsigned int mask = GetMask();
+    unsigned int hole = FindSlot( hash );
+    if ( m_Entries[ hole ].m_Hash == 0 )
+    {
+        return ( false );
+    }
+
+    // shift back any later entry in the run that can legally sit in the
+    // hole (its home slot isn't between the hole and where it is now)
+    for ( unsigned int slot = ( hole + 1 ) & mask ; m_Entries[ slot ].m_Hash != 0 ; slot = ( slot + 1 ) & mask )
+    {
+        unsigned int home = (unsigned int)m_Entries[ slot ].m_Hash & mask;
+        if ( ( ( slot - home ) & mask ) >= ( ( slot - hole ) & mask ) )
+        {
+            m_Entries[ hole ].m_Hash  = m_Entries[ slot ].m_Hash;
+            m_Entries[ hole ].m_Value = m_Entries[ slot ].m_Value;
+            m_Entries[ hole ].m_Name.swap( m_Entries[ slot ].m_Name );
+            hole = slot;
+        }
+    }
+
+    m_Entries[ hole ].m_Hash  = 0;
+    m_Entries[ hole ].m_Value = VALUE();
+    m_Entries[ hole ].m_Name.erase();
+    --m_Count;
+
+    return ( true );
+}
+
+template <typename VALUE>
+void HashedNameIndex <VALUE> :: Clear( void )
+{
+    for ( typename EntryVec::iterator i = m_Entries.begin() ; i != m_Entries.end() ; ++i )
+    {
+        i->m_Hash  = 0;
+        i->m_Value = VALUE();
+        i->m_Name.erase();
+    }
+    m_Count = 0;
+}
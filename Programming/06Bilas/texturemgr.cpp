@@ -1,4 +1,4 @@
-/* Copyright (C) Scott Bilas, 2000. 
+/* Copyright (C) Scott Bilas, 2000.
  * All rights reserved worldwide.
  *
  * This software is provided "as is" without express or implied
@@ -9,11 +9,18 @@
  */
 #include <ddraw.h>
 #include <vector>
-#include <map>
+#include <queue>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <cassert>
 
 #include "handle.h"
 #include "handlemgr.h"
+#include "nameindex.h"
 
 // ... [ platform-specific surface handle type here ]
 typedef LPDIRECTDRAWSURFACE7 OsHandle;
@@ -23,6 +30,58 @@ typedef Handle <tagTexture> HTexture;
 
 class TextureMgr
 {
+public:
+
+// Public types.
+
+    enum eState
+    {
+        STATE_PENDING,      // queued or decoding, not usable yet
+        STATE_READY,        // loaded, surfaces available
+        STATE_FAILED,       // load failed, handle stays valid but empty
+    };
+
+    enum ePriority
+    {
+        PRIORITY_LOW,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH,
+    };
+
+private:
+
+// Decoded image, built off the main thread.
+
+    struct Image
+    {
+        typedef std::vector <unsigned char> Bits;
+        typedef std::vector <Bits> MipVec;
+
+        unsigned int m_Width;       // mip 0 width
+        unsigned int m_Height;      // mip 0 height
+        MipVec       m_Mips;        // pixels for each mip level
+
+        Image( void ) : m_Width( 0 ), m_Height( 0 )  {  }
+    };
+
+// Async load request - shared by the queue entries and the texture.
+
+    struct LoadJob
+    {
+        std::string       m_Name;       // what to load
+        HTexture          m_Handle;     // where it goes
+        ePriority         m_Priority;   // highest priority asked for so far
+        std::atomic<bool> m_Claimed;    // a worker has taken it
+        std::atomic<bool> m_Cancelled;  // texture deleted before it finished
+        bool              m_Success;    // Decode result
+        Image             m_Image;      // Decode output
+
+        LoadJob( const std::string& name, HTexture handle, ePriority priority )
+            : m_Name( name ), m_Handle( handle ), m_Priority( priority ),
+              m_Claimed( false ), m_Cancelled( false ), m_Success( false )  {  }
+    };
+
+    typedef std::shared_ptr <LoadJob> LoadJobPtr;
 
 // Texture object data and db.
 
@@ -31,53 +90,125 @@ class TextureMgr
         typedef std::vector <OsHandle> HandleVec;
 
         std::string  m_Name;        // for reconstruction
+        NameHash     m_NameHash;    // key in the name index
         unsigned int m_Width;       // mip 0 width
         unsigned int m_Height;      // mip 1 width
         HandleVec    m_Handles;     // handles to mip surfaces
+        eState       m_State;       // where the load is at
+        LoadJobPtr   m_Job;         // outstanding async load, if any
+
+        Texture( void ) : m_NameHash( 0 ), m_Width( 0 ), m_Height( 0 ), m_State( STATE_PENDING )  {  }
 
         OsHandle GetOsHandle( unsigned int mip ) const
         {
+            assert( m_State == STATE_READY );
             assert( mip < m_Handles.size() );
             return ( m_Handles[ mip ] );
         }
 
         bool Load  ( const std::string& name );
         void Unload( void );
+
+        // Load split in two for async mode: Decode reads and unpacks the
+        // file and is safe on any thread, Create makes the surfaces and
+        // runs on the main thread.
+        static bool Decode( const std::string& name, Image& image );
+        bool        Create( const std::string& name, const Image& image );
     };
 
-    typedef HandleMgr <Texture, HTexture> HTextureMgr;
+    // paged so loading more textures never copies the ones we have
+    typedef HandleMgr <Texture, HTexture, HandlePagedStorage <Texture> > HTextureMgr;
 
 // Index by name into db.
 
-    // case-insensitive string comparison predicate
-    struct istring_less
+    // keyed by case-folded name hash, see nameindex.h
+    typedef HashedNameIndex <HTexture> NameIndex;
+
+// Load queues.
+
+    // an entry in a priority queue - highest priority first, then oldest
+    // first. a job whose priority gets raised is queued again, and the
+    // older entry is skipped when it comes up.
+    struct QueueEntry
     {
-        bool operator () ( const std::string& l, const std::string& r ) const
-            {  return ( ::stricmp( l.c_str(), r.c_str() ) < 0 );  }
+        ePriority    m_Priority;
+        unsigned int m_Serial;
+        LoadJobPtr   m_Job;
+
+        bool operator < ( const QueueEntry& r ) const
+        {
+            if ( m_Priority != r.m_Priority )  return ( m_Priority < r.m_Priority );
+            return ( m_Serial > r.m_Serial );
+        }
     };
 
-    typedef std::map <std::string, HTexture, istring_less > NameIndex;
-    typedef std::pair <NameIndex::iterator, bool> NameIndexInsertRc;
+    typedef std::priority_queue <QueueEntry> JobQueue;
+    typedef std::vector <LoadJobPtr> JobVec;
+    typedef std::vector <std::thread> ThreadVec;
+
+    enum
+    {
+        MAX_QUEUED_JOBS = 32,       // worker queue bound, the rest wait in the backlog
+    };
 
 // Private data.
 
     HTextureMgr m_Textures;
     NameIndex   m_NameIndex;
 
+    // main thread only
+    JobQueue     m_Backlog;         // requests waiting for room in m_Queue
+    unsigned int m_NextSerial;      // request order, for fifo within a priority
+
+    // shared with the workers, guarded by m_Lock
+    std::mutex              m_Lock;
+    std::condition_variable m_Wake;
+    JobQueue                m_Queue;        // bounded, workers pull from here
+    JobVec                  m_Done;         // decoded, waiting for Update
+    bool                    m_Quit;
+    ThreadVec               m_Workers;
+
+// Private methods.
+
+    void Submit    ( const LoadJobPtr& job, ePriority priority );
+    void Pump      ( void );
+    void WorkerProc( void );
+
 public:
 
 // Lifetime.
 
-    TextureMgr( void )  {  /* ... */  }
+    // workers == 0 loads synchronously inside GetTexture, like always.
+    // anything else starts that many loader threads and GetTexture
+    // returns pending handles that become ready in Update.
+    TextureMgr( unsigned int workers = 0 );
    ~TextureMgr( void );
 
 // Texture management.
 
-    HTexture GetTexture   ( const char* name );
+    HTexture GetTexture   ( const char* name, ePriority priority = PRIORITY_NORMAL )
+        {  return ( GetTexture( HashName( name ), name, priority ) );  }
     void     DeleteTexture( HTexture htex );
 
+    // pre-hashed versions - hash = HashName( name ), worked out once by
+    // the caller. FindTexture never loads anything, it returns a null
+    // handle for a name that hasn't been asked for.
+    HTexture GetTexture   ( NameHash hash, const char* name, ePriority priority = PRIORITY_NORMAL );
+    HTexture FindTexture  ( NameHash hash ) const;
+
+    // publishes finished async loads - call once a frame at a safe point,
+    // when nothing is rendering with the textures. maxCreate limits how
+    // many get their surfaces created this call, to spread the cost;
+    // loads cancelled by DeleteTexture don't count.
+    void Update( unsigned int maxCreate = ~0U );
+
 // Texture query.
 
+    eState GetState( HTexture htex ) const
+        {  return ( m_Textures.Dereference( htex )->m_State );  }
+    bool IsReady( HTexture htex ) const
+        {  return ( GetState( htex ) == STATE_READY );  }
+
     const std::string& GetName( HTexture htex ) const
         {  return ( m_Textures.Dereference( htex )->m_Name );  }
     int GetWidth( HTexture htex ) const
@@ -88,32 +219,84 @@ public:
         {  return ( m_Textures.Dereference( htex )->GetOsHandle( mip ) );  }
 };
 
+TextureMgr :: TextureMgr( unsigned int workers )
+    : m_NextSerial( 0 ), m_Quit( false )
+{
+    for ( unsigned int i = 0 ; i < workers ; ++i )
+    {
+        m_Workers.push_back( std::thread( &TextureMgr::WorkerProc, this ) );
+    }
+}
+
 TextureMgr :: ~TextureMgr( void )
 {
+    // stop the loaders - anything still queued is just dropped
+    {
+        std::lock_guard <std::mutex> lock( m_Lock );
+        m_Quit = true;
+    }
+    m_Wake.notify_all();
+    for ( ThreadVec::iterator t = m_Workers.begin() ; t != m_Workers.end() ; ++t )
+    {
+        t->join();
+    }
+
     // release all our remaining textures before we go
-    NameIndex::iterator i, begin = m_NameIndex.begin(), end = m_NameIndex.end();
-    for ( i = begin ; i != end ; ++i )
+    for ( unsigned int i = 0 ; i < m_NameIndex.GetCapacity() ; ++i )
     {
-        m_Textures.Dereference( i->second )->Unload();
+        const NameIndex::Entry& entry = m_NameIndex.GetSlot( i );
+        if ( ( entry.m_Hash != 0 ) && !entry.m_Value.IsNull() )
+        {
+            m_Textures.Dereference( entry.m_Value )->Unload();
+        }
     }
 }
 
-HTexture TextureMgr :: GetTexture( const char* name )
+HTexture TextureMgr :: GetTexture( NameHash hash, const char* name, ePriority priority )
 {
-    // insert/find
-    NameIndexInsertRc rc =
-        m_NameIndex.insert( std::make_pair( name, HTexture() ) );
-    if ( rc.second )
-    {
-        // this is a new insertion
-        Texture* tex = m_Textures.Acquire( rc.first->second );
-        if ( !tex->Load( rc.first->first ) )
+    // find - the common case, no strings touched
+    HTexture* found = m_NameIndex.Find( hash, name );
+    if ( found != 0 )
+    {
+        // a repeat request - same handle, but it may want the load sooner
+        Texture* tex = m_Textures.Dereference( *found );
+        if ( tex->m_Job && ( priority > tex->m_Job->m_Priority ) )
         {
-            DeleteTexture( rc.first->second );
-            rc.first->second = HTexture();
+            tex->m_Job->m_Priority = priority;
+            Submit( tex->m_Job, priority );
         }
+        return ( *found );
     }
-    return ( rc.first->second );
+
+    // this is a new insertion
+    HTexture htex;
+    Texture* tex = m_Textures.Acquire( htex );
+    tex->m_Name     = name;
+    tex->m_NameHash = hash;
+    *m_NameIndex.Insert( hash, name ).first = htex;
+
+    if ( m_Workers.empty() )
+    {
+        if ( !tex->Load( name ) )
+        {
+            DeleteTexture( htex );
+            htex = HTexture();
+        }
+    }
+    else
+    {
+        // hand it to the loaders, the handle stays pending until Update
+        tex->m_State = STATE_PENDING;
+        tex->m_Job.reset( new LoadJob( name, htex, priority ) );
+        Submit( tex->m_Job, priority );
+    }
+    return ( htex );
+}
+
+HTexture TextureMgr :: FindTexture( NameHash hash ) const
+{
+    const HTexture* found = const_cast <NameIndex&> ( m_NameIndex ).Find( hash );
+    return ( found ? *found : HTexture() );
 }
 
 void TextureMgr :: DeleteTexture( HTexture htex )
@@ -122,7 +305,14 @@ void TextureMgr :: DeleteTexture( HTexture htex )
     if ( tex != 0 )
     {
         // delete from index
-        m_NameIndex.erase( m_NameIndex.find( tex->m_Name ) );
+        m_NameIndex.Erase( tex->m_NameHash );
+
+        // forget any load in progress - Update throws its result away
+        if ( tex->m_Job )
+        {
+            tex->m_Job->m_Cancelled = true;
+            tex->m_Job.reset();
+        }
 
         // delete from db
         tex->Unload();
@@ -130,10 +320,141 @@ void TextureMgr :: DeleteTexture( HTexture htex )
     }
 }
 
+void TextureMgr :: Update( unsigned int maxCreate )
+{
+    // take what the loaders have finished, up to the limit. cancelled
+    // loads are thrown away here and don't count against it, so a burst
+    // of deletes doesn't hold back the loads that are still wanted.
+    JobVec done;
+    {
+        std::lock_guard <std::mutex> lock( m_Lock );
+        JobVec::iterator i = m_Done.begin();
+        for ( ; ( i != m_Done.end() ) && ( done.size() < maxCreate ) ; ++i )
+        {
+            if ( !(*i)->m_Cancelled )
+            {
+                done.push_back( *i );
+            }
+        }
+        m_Done.erase( m_Done.begin(), i );
+    }
+
+    // publish them - this is the only place pending textures change
+    for ( JobVec::iterator i = done.begin() ; i != done.end() ; ++i )
+    {
+        LoadJob& job = **i;
+        Texture* tex = m_Textures.Dereference( job.m_Handle );
+        if ( job.m_Success && tex->Create( job.m_Name, job.m_Image ) )
+        {
+            tex->m_State = STATE_READY;
+        }
+        else
+        {
+            tex->m_State = STATE_FAILED;
+        }
+        tex->m_Job.reset();
+    }
+
+    // room may have opened up in the queue
+    Pump();
+}
+
+void TextureMgr :: Submit( const LoadJobPtr& job, ePriority priority )
+{
+    QueueEntry entry;
+    entry.m_Priority = priority;
+    entry.m_Serial   = m_NextSerial++;
+    entry.m_Job      = job;
+    m_Backlog.push( entry );
+
+    Pump();
+}
+
+void TextureMgr :: Pump( void )
+{
+    // move requests from the backlog to the loaders while there's room
+    if ( m_Backlog.empty() )
+    {
+        return;
+    }
+
+    bool moved = false;
+    {
+        std::lock_guard <std::mutex> lock( m_Lock );
+        while ( !m_Backlog.empty() && ( m_Queue.size() < MAX_QUEUED_JOBS ) )
+        {
+            const QueueEntry& top = m_Backlog.top();
+            if ( !top.m_Job->m_Claimed && !top.m_Job->m_Cancelled )
+            {
+                m_Queue.push( top );
+                moved = true;
+            }
+            m_Backlog.pop();
+        }
+    }
+    if ( moved )
+    {
+        m_Wake.notify_all();
+    }
+}
+
+void TextureMgr :: WorkerProc( void )
+{
+    std::unique_lock <std::mutex> lock( m_Lock );
+    for ( ; ; )
+    {
+        while ( !m_Quit && m_Queue.empty() )
+        {
+            m_Wake.wait( lock );
+        }
+        if ( m_Quit )
+        {
+            break;
+        }
+
+        LoadJobPtr job = m_Queue.top().m_Job;
+        m_Queue.pop();
+
+        // a duplicate entry for a job someone already took, or one nobody
+        // wants any more
+        if ( job->m_Claimed.exchange( true ) || job->m_Cancelled )
+        {
+            continue;
+        }
+
+        // decode without the lock held
+        lock.unlock();
+        job->m_Success = Texture::Decode( job->m_Name, job->m_Image );
+        lock.lock();
+
+        m_Done.push_back( job );
+    }
+}
+
 bool TextureMgr::Texture :: Load( const std::string& name )
 {
-    m_Name = name;
-    // ... [ load texture from file system, return false on failure ]
+    // synchronous load - both halves right here
+    Image image;
+    if ( !Decode( name, image ) || !Create( name, image ) )
+    {
+        return ( false );
+    }
+    m_State = STATE_READY;
+    return ( true );
+}
+
+bool TextureMgr::Texture :: Decode( const std::string& name, Image& image )
+{
+    // ... [ load texture from file system into image, return false on failure ]
+    return ( true /* or false on error */ );
+}
+
+bool TextureMgr::Texture :: Create( const std::string& name, const Image& image )
+{
+    m_Name   = name;
+    m_Width  = image.m_Width;
+    m_Height = image.m_Height;
+    // ... [ create a surface for each of image.m_Mips, return false on failure ]
     return ( true /* or false on error */ );
 }
 
@@ -143,4 +464,3 @@ void TextureMgr::Texture :: Unload( void )
     // ... [ free up mip surfaces ]
     m_Handles.clear();
 }
-
@@ -85,10 +85,18 @@ LINK32=link.exe
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=.\ConcurrentResManager.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\main.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\PackFile.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\ResourceManager.cpp
 # End Source File
 # End Group
@@ -97,6 +105,14 @@ SOURCE=.\ResourceManager.cpp
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=.\ConcurrentResManager.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\PackFile.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\ResourceManager.h
 # End Source File
 # End Group
@@ -0,0 +1,489 @@
+/* Copyright (C) James Boer, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) James Boer, 2000"
+ */
+//=============================================================================
+//
+// 	ConcurrentResManager.cpp - thread-safe resource manager
+//
+//=============================================================================
+
+#include "ConcurrentResManager.h"
+
+using namespace std;
+
+
+void ConcurrentResManager::Clear()
+{
+	for(int i = 0; i < NUM_SHARDS; i++)
+	{
+		m_Shards[i].Map.clear();
+		for(int j = 0; j < NUM_PRIORITIES; j++)
+		{
+			m_Shards[i].pLRUHead[j] = 0;
+			m_Shards[i].pLRUTail[j] = 0;
+		}
+	}
+	m_rhNextResHandle = INVALID_RHANDLE;
+	m_nCurrentUsedMemory = 0;
+	m_nMaximumMemory = 0;
+	m_nTrimShard = 0;
+}
+
+
+bool ConcurrentResManager::Create(size_t nMaxSize)
+{
+	Clear();
+	SetMaximumMemory(nMaxSize);
+	return true;
+}
+
+
+void ConcurrentResManager::Destroy()
+{
+	for(int i = 0; i < NUM_SHARDS; i++)
+	{
+		for(ResMapItor itor = m_Shards[i].Map.begin(); itor != m_Shards[i].Map.end(); ++itor)
+		{
+			if(!itor->second->IsLocked())
+				delete itor->second;
+		}
+	}
+	Clear();
+}
+
+
+bool ConcurrentResManager::SetMaximumMemory(size_t nMem)
+{
+	m_nMaximumMemory = nMem;
+	return CheckForOverallocation();
+}
+
+
+bool ConcurrentResManager::ReserveMemory(size_t nMem)
+{
+	AddMemory(nMem);
+	if(!CheckForOverallocation())
+	{
+		RemoveMemory(nMem);
+		return false;
+	}
+	return true;
+}
+
+
+// Iteration
+
+bool ConcurrentResManager::GetFirst(ResCursor& Cursor, RHANDLE* prhUniqueID, BaseResource** ppResource)
+{
+	Cursor.nShard = 0;
+	Cursor.rhLast = 0;
+	Cursor.bStarted = false;
+	return GetNext(Cursor, prhUniqueID, ppResource);
+}
+
+
+bool ConcurrentResManager::GetNext(ResCursor& Cursor, RHANDLE* prhUniqueID, BaseResource** ppResource)
+{
+	// the cursor remembers the last handle rather than an iterator, so it
+	// stays good whatever happens to the map between calls
+	for(; Cursor.nShard < NUM_SHARDS; Cursor.nShard++, Cursor.bStarted = false)
+	{
+		Shard& shard = m_Shards[Cursor.nShard];
+		lock_guard<mutex> lock(shard.Lock);
+		ResMapItor itor = Cursor.bStarted ? shard.Map.upper_bound(Cursor.rhLast) : shard.Map.begin();
+		if(itor != shard.Map.end())
+		{
+			Cursor.rhLast = itor->first;
+			Cursor.bStarted = true;
+			if(prhUniqueID)
+				*prhUniqueID = itor->first;
+			if(ppResource)
+				*ppResource = itor->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool ConcurrentResManager::ForEach(ResVisitor pVisitor, void* pContext)
+{
+	for(int i = 0; i < NUM_SHARDS; i++)
+	{
+		lock_guard<mutex> lock(m_Shards[i].Lock);
+		for(ResMapItor itor = m_Shards[i].Map.begin(); itor != m_Shards[i].Map.end(); ++itor)
+		{
+			if(!pVisitor(itor->first, itor->second, pContext))
+				return false;
+		}
+	}
+	return true;
+}
+
+
+UINT ConcurrentResManager::GetNumResources()
+{
+	UINT nCount = 0;
+	for(int i = 0; i < NUM_SHARDS; i++)
+	{
+		lock_guard<mutex> lock(m_Shards[i].Lock);
+		nCount += m_Shards[i].Map.size();
+	}
+	return nCount;
+}
+
+
+// object access
+bool ConcurrentResManager::InsertResource(RHANDLE* rhUniqueID, BaseResource* pResource, bool bReserved)
+{
+	// handles count down from the top, so they only clash with ones the
+	// application picked itself - skip those
+	while(true)
+	{
+		RHANDLE rh = GetNextResHandle();
+		if(IS_INVALID_RHANDLE(rh))
+			continue;
+		Shard& shard = GetShard(rh);
+		{
+			lock_guard<mutex> lock(shard.Lock);
+			if(shard.Map.find(rh) != shard.Map.end())
+				continue;
+			shard.Map.insert(ResMapPair(rh, pResource));
+			UpdateLRU(shard, pResource);
+			// count it before another thread can swap it out
+			if(!bReserved)
+				AddMemory(pResource->GetSize());
+		}
+		*rhUniqueID = rh;
+		break;
+	}
+
+	return bReserved ? true : CheckForOverallocation();
+}
+
+
+bool ConcurrentResManager::InsertResource(RHANDLE rhUniqueID, BaseResource* pResource, bool bReserved)
+{
+	Shard& shard = GetShard(rhUniqueID);
+	{
+		lock_guard<mutex> lock(shard.Lock);
+		if(shard.Map.find(rhUniqueID) != shard.Map.end())
+			// ID has already been allocated as a resource
+			return false;
+		shard.Map.insert(ResMapPair(rhUniqueID, pResource));
+		UpdateLRU(shard, pResource);
+		// count it before another thread can swap it out
+		if(!bReserved)
+			AddMemory(pResource->GetSize());
+	}
+
+	return bReserved ? true : CheckForOverallocation();
+}
+
+
+bool ConcurrentResManager::RemoveResource(RHANDLE rhUniqueID)
+{
+	Shard& shard = GetShard(rhUniqueID);
+	lock_guard<mutex> lock(shard.Lock);
+	ResMapItor itor = shard.Map.find(rhUniqueID);
+	if(itor == shard.Map.end())
+		return false;
+	// Can't remove a locked resource
+	if(itor->second->IsLocked())
+		return false;
+	RemoveMemory(itor->second->GetSize());
+	UnlinkLRU(shard, itor->second);
+	shard.Map.erase(itor);
+	return true;
+}
+
+
+bool ConcurrentResManager::RemoveResource(BaseResource* pResource)
+{
+	RHANDLE rh = FindResourceHandle(pResource);
+	if(IS_INVALID_RHANDLE(rh))
+		return false;
+
+	Shard& shard = GetShard(rh);
+	lock_guard<mutex> lock(shard.Lock);
+	ResMapItor itor = shard.Map.find(rh);
+	// somebody else got there first
+	if((itor == shard.Map.end()) || (itor->second != pResource))
+		return false;
+	if(pResource->IsLocked())
+		return false;
+	RemoveMemory(pResource->GetSize());
+	UnlinkLRU(shard, pResource);
+	shard.Map.erase(itor);
+	return true;
+}
+
+
+bool ConcurrentResManager::DestroyResource(BaseResource* pResource)
+{
+	if(!RemoveResource(pResource))
+		return false;
+	delete pResource;
+	return true;
+}
+
+
+bool ConcurrentResManager::DestroyResource(RHANDLE rhUniqueID)
+{
+	BaseResource* pResource;
+	{
+		Shard& shard = GetShard(rhUniqueID);
+		lock_guard<mutex> lock(shard.Lock);
+		ResMapItor itor = shard.Map.find(rhUniqueID);
+		if((itor == shard.Map.end()) || itor->second->IsLocked())
+			return false;
+		pResource = itor->second;
+		RemoveMemory(pResource->GetSize());
+		UnlinkLRU(shard, pResource);
+		shard.Map.erase(itor);
+	}
+	// it's out of the map, so nobody else can reach it
+	delete pResource;
+	return true;
+}
+
+
+BaseResource* ConcurrentResManager::GetResource(RHANDLE rhUniqueID)
+{
+	Shard& shard = GetShard(rhUniqueID);
+	BaseResource* pResource;
+	{
+		lock_guard<mutex> lock(shard.Lock);
+		ResMapItor itor = shard.Map.find(rhUniqueID);
+		if(itor == shard.Map.end())
+			return NULL;
+		pResource = itor->second;
+		pResource->SetLastAccess(time(0));
+
+		if(!pResource->IsDisposed())
+		{
+			TouchLRU(shard, pResource);
+			return pResource;
+		}
+
+		// recreate it, and hold a lock on it while we make room so we
+		// don't swap out the same resource
+		pResource->Recreate();
+		AddMemory(pResource->GetSize());
+		pResource->SetReferenceCount(pResource->GetReferenceCount() + 1);
+		UnlinkLRU(shard, pResource);
+	}
+
+	CheckForOverallocation();
+
+	lock_guard<mutex> lock(shard.Lock);
+	pResource->SetReferenceCount(pResource->GetReferenceCount() - 1);
+	UpdateLRU(shard, pResource);
+	return pResource;
+}
+
+
+BaseResource* ConcurrentResManager::Lock(RHANDLE rhUniqueID)
+{
+	Shard& shard = GetShard(rhUniqueID);
+	BaseResource* pResource;
+	{
+		lock_guard<mutex> lock(shard.Lock);
+		ResMapItor itor = shard.Map.find(rhUniqueID);
+		if(itor == shard.Map.end())
+			return NULL;
+		pResource = itor->second;
+
+		// increment the object's count, which takes it out of the running
+		// for being swapped out
+		pResource->SetReferenceCount(pResource->GetReferenceCount() + 1);
+		UnlinkLRU(shard, pResource);
+
+		if(!pResource->IsDisposed())
+			return pResource;
+
+		pResource->Recreate();
+		AddMemory(pResource->GetSize());
+	}
+
+	CheckForOverallocation();
+	return pResource;
+}
+
+
+int ConcurrentResManager::Unlock(RHANDLE rhUniqueID)
+{
+	Shard& shard = GetShard(rhUniqueID);
+	lock_guard<mutex> lock(shard.Lock);
+	ResMapItor itor = shard.Map.find(rhUniqueID);
+	if(itor == shard.Map.end())
+		return -1;
+
+	if(itor->second->GetReferenceCount() > 0)
+	{
+		itor->second->SetReferenceCount(itor->second->GetReferenceCount() - 1);
+		UpdateLRU(shard, itor->second);
+	}
+	return itor->second->GetReferenceCount();
+}
+
+
+int ConcurrentResManager::Unlock(BaseResource* pResource)
+{
+	RHANDLE rhResource = FindResourceHandle(pResource);
+	if IS_INVALID_RHANDLE(rhResource)
+		return -1;
+	return Unlock(rhResource);
+}
+
+
+RHANDLE ConcurrentResManager::FindResourceHandle(BaseResource* pResource)
+{
+	for(int i = 0; i < NUM_SHARDS; i++)
+	{
+		lock_guard<mutex> lock(m_Shards[i].Lock);
+		for(ResMapItor itor = m_Shards[i].Map.begin(); itor != m_Shards[i].Map.end(); ++itor)
+		{
+			if(itor->second == pResource)
+				return itor->first;
+		}
+	}
+	return INVALID_RHANDLE;
+}
+
+
+int ConcurrentResManager::GetLRUList(BaseResource* pResource)
+{
+	int iList = pResource->GetPriority();
+	if(iList < 0)
+		return 0;
+	if(iList >= NUM_PRIORITIES)
+		return NUM_PRIORITIES - 1;
+	return iList;
+}
+
+
+void ConcurrentResManager::LinkLRU(Shard& shard, BaseResource* pResource)
+{
+	if(pResource->m_iLRUList >= 0)
+		return;
+
+	// add to the most recently used end of the list for its priority
+	int iList = GetLRUList(pResource);
+	pResource->m_iLRUList = iList;
+	pResource->m_pLRUPrev = shard.pLRUTail[iList];
+	pResource->m_pLRUNext = 0;
+	if(shard.pLRUTail[iList])
+		shard.pLRUTail[iList]->m_pLRUNext = pResource;
+	else
+		shard.pLRUHead[iList] = pResource;
+	shard.pLRUTail[iList] = pResource;
+}
+
+
+void ConcurrentResManager::UnlinkLRU(Shard& shard, BaseResource* pResource)
+{
+	int iList = pResource->m_iLRUList;
+	if(iList < 0)
+		return;
+
+	if(pResource->m_pLRUPrev)
+		pResource->m_pLRUPrev->m_pLRUNext = pResource->m_pLRUNext;
+	else
+		shard.pLRUHead[iList] = pResource->m_pLRUNext;
+	if(pResource->m_pLRUNext)
+		pResource->m_pLRUNext->m_pLRUPrev = pResource->m_pLRUPrev;
+	else
+		shard.pLRUTail[iList] = pResource->m_pLRUPrev;
+
+	pResource->m_pLRUPrev = 0;
+	pResource->m_pLRUNext = 0;
+	pResource->m_iLRUList = -1;
+}
+
+
+void ConcurrentResManager::UpdateLRU(Shard& shard, BaseResource* pResource)
+{
+	if(!pResource->IsLocked() && !pResource->IsDisposed())
+		LinkLRU(shard, pResource);
+	else
+		UnlinkLRU(shard, pResource);
+}
+
+
+void ConcurrentResManager::TouchLRU(Shard& shard, BaseResource* pResource)
+{
+	if(pResource->m_iLRUList < 0)
+		return;
+	UnlinkLRU(shard, pResource);
+	LinkLRU(shard, pResource);
+}
+
+
+bool ConcurrentResManager::CheckForOverallocation()
+{
+	if(m_nCurrentUsedMemory.load() <= m_nMaximumMemory.load())
+		return true;
+
+	// Lowest priority first across every shard, then the next.  Each pass
+	// starts at a different shard so no one shard's resources take all the
+	// evictions, and only one shard is locked at a time.
+	UINT nStart = m_nTrimShard.fetch_add(1);
+	for(int iList = 0; iList < NUM_PRIORITIES; iList++)
+	{
+		for(UINT n = 0; n < NUM_SHARDS; n++)
+		{
+			Shard& shard = m_Shards[(nStart + n) & (NUM_SHARDS - 1)];
+			lock_guard<mutex> lock(shard.Lock);
+
+			// resources whose Dispose() didn't take
+			BaseResource* pKept = 0;
+
+			while(shard.pLRUHead[iList] && (m_nCurrentUsedMemory.load() > m_nMaximumMemory.load()))
+			{
+				BaseResource* pRes = shard.pLRUHead[iList];
+				UnlinkLRU(shard, pRes);
+
+				// its priority was changed after it was listed
+				if(GetLRUList(pRes) != iList)
+				{
+					LinkLRU(shard, pRes);
+					continue;
+				}
+
+				if(pRes->IsDisposed())
+					continue;
+
+				size_t nDisposalSize = pRes->GetSize();
+				pRes->Dispose();
+				if(pRes->IsDisposed())
+					RemoveMemory(nDisposalSize);
+				else
+				{
+					pRes->m_pLRUNext = pKept;
+					pKept = pRes;
+				}
+			}
+
+			while(pKept)
+			{
+				BaseResource* pRes = pKept;
+				pKept = pRes->m_pLRUNext;
+				pRes->m_pLRUNext = 0;
+				LinkLRU(shard, pRes);
+			}
+
+			if(m_nCurrentUsedMemory.load() <= m_nMaximumMemory.load())
+				return true;
+		}
+	}
+
+	// everything left is locked, or bigger than the maximum
+	return false;
+}
@@ -0,0 +1,166 @@
+/* Copyright (C) James Boer, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) James Boer, 2000"
+ */
+//=============================================================================
+//
+// 	ConcurrentResManager.h - thread-safe resource manager
+//
+//	The same job as ResManager, but any thread may call it at any time.
+//	Resources are spread over NUM_SHARDS shards by a hash of their handle,
+//	and each shard has its own map, eviction lists and lock, so threads
+//	working on different resources rarely wait for each other.  Memory use
+//	is an atomic counter shared by all the shards.
+//
+//	Differences from ResManager:
+//
+//	- Eviction is least recently used within a shard, not across the whole
+//	  manager.  Lower priorities still always go first.
+//	- A resource is loaded and its memory counted before room is made for
+//	  it, so while loads are running the total can briefly pass the
+//	  maximum.  It's back under by the time the call that loaded returns.
+//	- The pointer GetResource() returns can be swapped out by another thread
+//	  at any time.  Lock() anything you're going to use.
+//	- There's no shared iterator.  Each caller keeps its own ResCursor, or
+//	  uses ForEach().
+//
+//=============================================================================
+
+
+#ifndef __CONCURRENTRESMANAGER_H
+#define __CONCURRENTRESMANAGER_H
+
+#include <atomic>
+#include <mutex>
+#include "ResourceManager.h"
+
+
+// Iteration state, owned by the caller.  Walking with a cursor while other
+// threads add and remove resources is safe: each resource present for the
+// whole walk is visited once, others may or may not be.
+struct ResCursor
+{
+	UINT	nShard;
+	RHANDLE	rhLast;
+	bool	bStarted;
+};
+
+// Called for each resource by ForEach() with the resource's shard locked.
+// Return false to stop.  Don't call back into the manager from it.
+typedef bool (*ResVisitor)(RHANDLE rhUniqueID, BaseResource* pResource, void* pContext);
+
+
+class ConcurrentResManager
+{
+public:
+
+	ConcurrentResManager()			{  Clear();  }
+	virtual ~ConcurrentResManager()	{  Destroy();  }
+
+	// Create, Destroy and Clear must not run alongside anything else
+	void Clear();
+
+	bool Create(size_t nMaxSize);
+	void Destroy();
+
+	// --------------------------------------------------------------------------
+	// Memory management routines
+
+	bool SetMaximumMemory(size_t nMem);
+	size_t GetMaximumMemory()		{  return m_nMaximumMemory.load();  }
+	size_t GetUsedMemory()			{  return m_nCurrentUsedMemory.load();  }
+
+	// Makes room for nMem bytes and counts them as used.  Pass bReserved to
+	// InsertResource() for the resource they were reserved for, and it
+	// won't be counted again.
+	bool ReserveMemory(size_t nMem);
+
+
+	// --------------------------------------------------------------------------
+	// Resource map iteration
+
+	// Fills in the first or next resource and returns true, or returns false
+	// at the end.  The pointer isn't locked; see the notes above.
+	bool GetFirst(ResCursor& Cursor, RHANDLE* prhUniqueID, BaseResource** ppResource);
+	bool GetNext(ResCursor& Cursor, RHANDLE* prhUniqueID, BaseResource** ppResource);
+
+	// Visits every resource, one shard at a time.  Returns false if the
+	// visitor stopped it.
+	bool ForEach(ResVisitor pVisitor, void* pContext);
+
+	UINT GetNumResources();
+
+
+	// -----------------------------------------------------------------------
+	// General resource access
+
+	bool InsertResource(RHANDLE* rhUniqueID, BaseResource* pResource, bool bReserved = false);
+	bool InsertResource(RHANDLE rhUniqueID, BaseResource* pResource, bool bReserved = false);
+
+	bool RemoveResource(BaseResource* pResource);
+	bool RemoveResource(RHANDLE rhUniqueID);
+
+	bool DestroyResource(BaseResource* pResource);
+	bool DestroyResource(RHANDLE rhUniqueID);
+
+	BaseResource* GetResource(RHANDLE rhUniqueID);
+
+	BaseResource* Lock(RHANDLE rhUniqueID);
+
+	int Unlock(RHANDLE rhUniqueID);
+	int Unlock(BaseResource* pResource);
+
+	RHANDLE FindResourceHandle(BaseResource* pResource);
+
+protected:
+
+	enum
+	{
+		SHARD_BITS = 4,
+		NUM_SHARDS = 1 << SHARD_BITS,
+		NUM_PRIORITIES = BaseResource::RES_HIGH_PRIORITY + 1
+	};
+
+	// Everything in a shard is guarded by its Lock.  Shards are kept on
+	// separate cache lines so their locks don't fight.
+	struct alignas(64) Shard
+	{
+		std::mutex		Lock;
+		ResMap			Map;
+		BaseResource*	pLRUHead[NUM_PRIORITIES];
+		BaseResource*	pLRUTail[NUM_PRIORITIES];
+	};
+
+	inline Shard& GetShard(RHANDLE rhUniqueID)
+	{  return m_Shards[(rhUniqueID * 2654435761u) >> (32 - SHARD_BITS)];  }
+
+	inline void AddMemory(size_t nMem)		{  m_nCurrentUsedMemory.fetch_add(nMem);  }
+	inline void RemoveMemory(size_t nMem)	{  m_nCurrentUsedMemory.fetch_sub(nMem);  }
+	RHANDLE GetNextResHandle()				{  return m_rhNextResHandle.fetch_sub(1) - 1;  }
+
+	// Eviction lists, as in ResManager.  The shard must be locked.
+	int GetLRUList(BaseResource* pResource);
+	void LinkLRU(Shard& shard, BaseResource* pResource);
+	void UnlinkLRU(Shard& shard, BaseResource* pResource);
+	void UpdateLRU(Shard& shard, BaseResource* pResource);
+	void TouchLRU(Shard& shard, BaseResource* pResource);
+
+	// Swaps resources out until memory use is under the maximum, going
+	// through the shards one at a time.  Call it with no shard locked.
+	bool CheckForOverallocation();
+
+protected:
+	Shard					m_Shards[NUM_SHARDS];
+	std::atomic<RHANDLE>	m_rhNextResHandle;
+	std::atomic<size_t>		m_nCurrentUsedMemory;
+	std::atomic<size_t>		m_nMaximumMemory;
+	std::atomic<UINT>		m_nTrimShard;	// where the next eviction pass starts
+};
+
+
+#endif  // __CONCURRENTRESMANAGER_H
@@ -0,0 +1,493 @@
+/* Copyright (C) James Boer, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) James Boer, 2000"
+ */
+//=============================================================================
+//
+// 	PackFile.cpp - memory mapped resource archives
+//
+//=============================================================================
+
+#include "PackFile.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+PACKHASH PackHashName(const char* pName)
+{
+	PACKHASH nHash = 14695981039346656037ULL;
+	for(; *pName; pName++)
+	{
+		unsigned char c = (unsigned char)*pName;
+		if((c >= 'A') && (c <= 'Z'))
+			c += 'a' - 'A';
+		nHash = (nHash ^ c) * 1099511628211ULL;
+	}
+	return nHash;
+}
+
+
+static bool SameName(const char* pLeft, const char* pRight)
+{
+	for(; *pLeft && *pRight; pLeft++, pRight++)
+	{
+		char l = ((*pLeft >= 'A') && (*pLeft <= 'Z')) ? (char)(*pLeft + 'a' - 'A') : *pLeft;
+		char r = ((*pRight >= 'A') && (*pRight <= 'Z')) ? (char)(*pRight + 'a' - 'A') : *pRight;
+		if(l != r)
+			return false;
+	}
+	return (*pLeft == *pRight) ? true : false;
+}
+
+
+// true if nSize bytes at nOffset lie inside the file, without overflowing
+static bool InFile(unsigned long long nOffset, unsigned long long nSize, size_t nFileSize)
+{
+	return (nOffset <= nFileSize) && (nSize <= nFileSize - nOffset);
+}
+
+
+// PackFile implementation
+
+void PackFile::Clear()
+{
+	m_pBase = 0;
+	m_nMapSize = 0;
+	m_pHeader = 0;
+	m_pEntries = 0;
+	m_pDir = 0;
+	m_pNames = 0;
+	m_nPageSize = 4096;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = 0;
+#endif
+}
+
+
+bool PackFile::Open(const char* pFileName)
+{
+	Close();
+
+#ifdef _WIN32
+	SYSTEM_INFO Info;
+	GetSystemInfo(&Info);
+	m_nPageSize = Info.dwPageSize;
+
+	m_hFile = CreateFile(pFileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_FLAG_RANDOM_ACCESS, 0);
+	if(m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+	m_nMapSize = GetFileSize(m_hFile, 0);
+	m_hMapping = CreateFileMapping(m_hFile, 0, PAGE_READONLY, 0, 0, 0);
+	if(m_hMapping)
+		m_pBase = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if(!m_pBase)
+	{
+		Close();
+		return false;
+	}
+#else
+	m_nPageSize = sysconf(_SC_PAGESIZE);
+
+	int fd = open(pFileName, O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(PackHeader)))
+	{
+		close(fd);
+		return false;
+	}
+	m_nMapSize = st.st_size;
+	void* pMap = mmap(0, m_nMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file alive
+	close(fd);
+	if(pMap == MAP_FAILED)
+	{
+		m_nMapSize = 0;
+		return false;
+	}
+	m_pBase = (const unsigned char*)pMap;
+	// entries are read in any order
+	madvise(pMap, m_nMapSize, MADV_RANDOM);
+#endif
+
+	// check the header and that the tables fit in the file
+	m_pHeader = (const PackHeader*)m_pBase;
+	if((m_nMapSize < sizeof(PackHeader)) ||
+		(m_pHeader->nMagic != PACK_MAGIC) ||
+		(m_pHeader->nVersion != PACK_VERSION) ||
+		(m_pHeader->nFileSize != m_nMapSize) ||
+		(m_pHeader->nDirSlots == 0) ||
+		(m_pHeader->nDirSlots & (m_pHeader->nDirSlots - 1)) ||
+		(m_pHeader->nEntryOffset % sizeof(unsigned long long)) ||
+		(m_pHeader->nDirOffset % sizeof(UINT)) ||
+		!InFile(m_pHeader->nEntryOffset, (unsigned long long)m_pHeader->nEntries * sizeof(PackEntry), m_nMapSize) ||
+		!InFile(m_pHeader->nDirOffset, (unsigned long long)m_pHeader->nDirSlots * sizeof(UINT), m_nMapSize) ||
+		!InFile(m_pHeader->nNameOffset, 0, m_nMapSize))
+	{
+		Close();
+		return false;
+	}
+
+	m_pEntries = (const PackEntry*)(m_pBase + m_pHeader->nEntryOffset);
+	m_pDir = (const UINT*)(m_pBase + m_pHeader->nDirOffset);
+	m_pNames = (const char*)(m_pBase + m_pHeader->nNameOffset);
+
+	// every entry's data and name must be inside the file, and the name
+	// terminated before the end of it
+	UINT i;
+	for(i = 0; i < m_pHeader->nEntries; i++)
+	{
+		unsigned long long nName = m_pHeader->nNameOffset + m_pEntries[i].nNameOffset;
+		if(!InFile(m_pEntries[i].nOffset, m_pEntries[i].nSize, m_nMapSize) ||
+			(nName >= m_nMapSize) ||
+			!memchr(m_pBase + nName, 0, m_nMapSize - (size_t)nName))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	// every directory slot must be empty or name a real entry, and at least
+	// one must be empty or a probe for a missing name would never stop
+	bool bEmptySlot = false;
+	for(i = 0; i < m_pHeader->nDirSlots; i++)
+	{
+		if(m_pDir[i] == 0)
+			bEmptySlot = true;
+		else if(m_pDir[i] > m_pHeader->nEntries)
+			break;
+	}
+	if((i < m_pHeader->nDirSlots) || !bEmptySlot)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+
+void PackFile::Close()
+{
+#ifdef _WIN32
+	if(m_pBase)
+		UnmapViewOfFile(m_pBase);
+	if(m_hMapping)
+		CloseHandle(m_hMapping);
+	if(m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+#else
+	if(m_pBase)
+		munmap((void*)m_pBase, m_nMapSize);
+#endif
+	Clear();
+}
+
+
+int PackFile::Find(const char* pName)
+{
+	return Find(PackHashName(pName), pName);
+}
+
+
+int PackFile::Find(PACKHASH nNameHash, const char* pName)
+{
+	if(!m_pBase)
+		return -1;
+
+	// probe from the home slot to the entry or an empty slot
+	UINT nMask = m_pHeader->nDirSlots - 1;
+	for(UINT nSlot = (UINT)nNameHash & nMask; m_pDir[nSlot] != 0; nSlot = (nSlot + 1) & nMask)
+	{
+		int iEntry = m_pDir[nSlot] - 1;
+		if(m_pEntries[iEntry].nNameHash != nNameHash)
+			continue;
+		if(pName && !SameName(GetName(iEntry), pName))
+			continue;
+		return iEntry;
+	}
+	return -1;
+}
+
+
+const char* PackFile::GetName(int iEntry)
+{
+	return m_pNames + m_pEntries[iEntry].nNameOffset;
+}
+
+
+void PackFile::Prefetch(int iEntry)
+{
+#ifndef _WIN32
+	// round out to whole pages
+	size_t nStart = (size_t)m_pEntries[iEntry].nOffset & ~(m_nPageSize - 1);
+	size_t nEnd = (size_t)(m_pEntries[iEntry].nOffset + m_pEntries[iEntry].nSize);
+	if(nEnd > nStart)
+		madvise((void*)(m_pBase + nStart), nEnd - nStart, MADV_WILLNEED);
+#endif
+}
+
+
+void PackFile::Release(int iEntry)
+{
+	// round in to whole pages
+	size_t nStart = ((size_t)m_pEntries[iEntry].nOffset + m_nPageSize - 1) & ~(m_nPageSize - 1);
+	size_t nEnd = (size_t)(m_pEntries[iEntry].nOffset + m_pEntries[iEntry].nSize) & ~(m_nPageSize - 1);
+	// the last entry owns the tail of its final page
+	if(m_pEntries[iEntry].nOffset + m_pEntries[iEntry].nSize == m_nMapSize)
+		nEnd = (m_nMapSize + m_nPageSize - 1) & ~(m_nPageSize - 1);
+	if(nEnd <= nStart)
+		return;
+#ifdef _WIN32
+	// takes the pages out of the working set; windows drops them when it
+	// needs the memory
+	VirtualUnlock((void*)(m_pBase + nStart), nEnd - nStart);
+#else
+	madvise((void*)(m_pBase + nStart), nEnd - nStart, MADV_DONTNEED);
+#endif
+}
+
+
+// PackFileWriter implementation
+
+bool PackFileWriter::AddData(const char* pName, const void* pData, size_t nSize, bool bRaw)
+{
+	Item item;
+	item.Name = pName;
+	item.Data.assign((const char*)pData, (const char*)pData + nSize);
+	item.nFlags = bRaw ? PACK_ENTRY_RAW : 0;
+	m_Entries.push_back(item);
+	return true;
+}
+
+
+bool PackFileWriter::AddFile(const char* pName, const char* pFileName, bool bRaw)
+{
+	FILE* pFile = fopen(pFileName, "rb");
+	if(!pFile)
+		return false;
+	vector<char> Data;
+	char Buffer[16384];
+	size_t nRead;
+	while((nRead = fread(Buffer, 1, sizeof(Buffer), pFile)) > 0)
+		Data.insert(Data.end(), Buffer, Buffer + nRead);
+	fclose(pFile);
+	return AddData(pName, Data.empty() ? "" : &Data[0], Data.size(), bRaw);
+}
+
+
+static unsigned long long AlignUp(unsigned long long nOffset, UINT nAlignment)
+{
+	return (nOffset + nAlignment - 1) & ~(unsigned long long)(nAlignment - 1);
+}
+
+
+bool PackFileWriter::Write(const char* pFileName, UINT nAlignment)
+{
+	if((nAlignment == 0) || (nAlignment & (nAlignment - 1)))
+		return false;
+
+	// directory at most half full
+	UINT nDirSlots = 16;
+	while(nDirSlots < m_Entries.size() * 2)
+		nDirSlots <<= 1;
+
+	PackHeader Header;
+	memset(&Header, 0, sizeof(Header));
+	Header.nMagic = PACK_MAGIC;
+	Header.nVersion = PACK_VERSION;
+	Header.nEntries = m_Entries.size();
+	Header.nDirSlots = nDirSlots;
+	Header.nAlignment = nAlignment;
+	Header.nEntryOffset = sizeof(PackHeader);
+	Header.nDirOffset = Header.nEntryOffset + Header.nEntries * sizeof(PackEntry);
+	Header.nNameOffset = Header.nDirOffset + nDirSlots * sizeof(UINT);
+
+	// lay out the names and the data
+	vector<PackEntry> Entries(m_Entries.size());
+	vector<UINT> Dir(nDirSlots, 0);
+	string Names;
+	UINT i;
+	for(i = 0; i < m_Entries.size(); i++)
+	{
+		Entries[i].nNameHash = PackHashName(m_Entries[i].Name.c_str());
+		Entries[i].nNameOffset = Names.size();
+		Entries[i].nFlags = m_Entries[i].nFlags;
+		Entries[i].nSize = m_Entries[i].Data.size();
+		Names += m_Entries[i].Name;
+		Names += '\0';
+
+		UINT nSlot = (UINT)Entries[i].nNameHash & (nDirSlots - 1);
+		while(Dir[nSlot] != 0)
+		{
+			// duplicate names aren't allowed
+			if((Entries[Dir[nSlot] - 1].nNameHash == Entries[i].nNameHash) &&
+				SameName(m_Entries[Dir[nSlot] - 1].Name.c_str(), m_Entries[i].Name.c_str()))
+				return false;
+			nSlot = (nSlot + 1) & (nDirSlots - 1);
+		}
+		Dir[nSlot] = i + 1;
+	}
+
+	unsigned long long nOffset = Header.nNameOffset + Names.size();
+	for(i = 0; i < m_Entries.size(); i++)
+	{
+		nOffset = AlignUp(nOffset, nAlignment);
+		Entries[i].nOffset = nOffset;
+		nOffset += Entries[i].nSize;
+	}
+	Header.nFileSize = nOffset;
+
+	FILE* pFile = fopen(pFileName, "wb");
+	if(!pFile)
+		return false;
+
+	bool bOK = (fwrite(&Header, sizeof(Header), 1, pFile) == 1);
+	if(bOK && !Entries.empty())
+		bOK = (fwrite(&Entries[0], sizeof(PackEntry), Entries.size(), pFile) == Entries.size());
+	if(bOK)
+		bOK = (fwrite(&Dir[0], sizeof(UINT), Dir.size(), pFile) == Dir.size());
+	if(bOK)
+		bOK = (fwrite(Names.data(), 1, Names.size(), pFile) == Names.size());
+
+	// pad each entry out to its offset
+	static const char Zeros[4096] = { 0 };
+	unsigned long long nWritten = Header.nNameOffset + Names.size();
+	for(i = 0; bOK && (i < m_Entries.size()); i++)
+	{
+		while(bOK && (nWritten < Entries[i].nOffset))
+		{
+			size_t nPad = (size_t)min<unsigned long long>(Entries[i].nOffset - nWritten, sizeof(Zeros));
+			bOK = (fwrite(Zeros, 1, nPad, pFile) == nPad);
+			nWritten += nPad;
+		}
+		if(bOK && Entries[i].nSize)
+			bOK = (fwrite(&m_Entries[i].Data[0], 1, (size_t)Entries[i].nSize, pFile) == Entries[i].nSize);
+		nWritten += Entries[i].nSize;
+	}
+
+	if(fclose(pFile) != 0)
+		bOK = false;
+	return bOK;
+}
+
+
+// PackResource implementation
+
+void PackResource::Clear()
+{
+	BaseResource::Clear();
+	m_pPack = 0;
+	m_iEntry = -1;
+	m_pData = 0;
+	m_nSize = 0;
+	m_bOwned = false;
+	m_Buffer.clear();
+}
+
+
+bool PackResource::Create(PackFile* pPack, const char* pName)
+{
+	return Create(pPack, pPack->Find(pName));
+}
+
+
+bool PackResource::Create(PackFile* pPack, int iEntry)
+{
+	// only let go of the data - the resource may already be in a manager,
+	// whose priority and reference count must survive
+	Dispose();
+	vector<unsigned char>().swap(m_Buffer);
+	m_pPack = 0;
+	m_iEntry = -1;
+	m_nSize = 0;
+	m_bOwned = false;
+	if((iEntry < 0) || ((UINT)iEntry >= pPack->GetNumEntries()))
+		return false;
+	m_pPack = pPack;
+	m_iEntry = iEntry;
+	return Recreate();
+}
+
+
+void PackResource::Destroy()
+{
+	Dispose();
+	Clear();
+}
+
+
+bool PackResource::Recreate()
+{
+	if(!m_pPack || (m_iEntry < 0))
+		return false;
+	if(m_pData)
+		return true;
+
+	const void* pStored = m_pPack->GetData(m_iEntry);
+	size_t nStored = m_pPack->GetSize(m_iEntry);
+
+	if(m_pPack->GetEntry(m_iEntry)->nFlags & PACK_ENTRY_RAW)
+	{
+		// zero-copy - point straight into the mapping, and ask for the
+		// pages now so the first touch doesn't fault them in one at a time
+		m_pPack->Prefetch(m_iEntry);
+		m_pData = pStored;
+		m_nSize = nStored;
+		m_bOwned = false;
+		return true;
+	}
+
+	if(!Transform(pStored, nStored, m_Buffer))
+	{
+		m_Buffer.clear();
+		return false;
+	}
+	// the stored copy isn't needed now we have our own
+	m_pPack->Release(m_iEntry);
+	// an empty result still counts as loaded
+	if(m_Buffer.empty())
+		m_Buffer.reserve(1);
+	m_nSize = m_Buffer.size();
+	m_pData = m_Buffer.data();
+	m_bOwned = true;
+	return true;
+}
+
+
+void PackResource::Dispose()
+{
+	if(!m_pData)
+		return;
+	if(m_bOwned)
+		vector<unsigned char>().swap(m_Buffer);
+	else
+		m_pPack->Release(m_iEntry);
+	m_pData = 0;
+}
+
+
+bool PackResource::Transform(const void* pData, size_t nSize, vector<unsigned char>& Out)
+{
+	Out.assign((const unsigned char*)pData, (const unsigned char*)pData + nSize);
+	return true;
+}
@@ -0,0 +1,197 @@
+/* Copyright (C) James Boer, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) James Boer, 2000"
+ */
+//=============================================================================
+//
+// 	PackFile.h - memory mapped resource archives
+//
+//	A pack file holds many resources in one archive, so loading one costs a
+//	hash lookup instead of an open, a seek and a read.  The whole archive is
+//	memory mapped once; data that needs no processing is used right where it
+//	sits in the mapping.
+//
+//	Layout:
+//
+//		PackHeader
+//		PackEntry[nEntries]			offset table
+//		UINT[nDirSlots]				hashed directory, entry index + 1 or 0
+//		names						zero terminated, referenced by the entries
+//		entry data					each entry starts on an nAlignment boundary
+//
+//	All offsets are from the start of the file.  The directory is an open
+//	addressed table, probed linearly from (name hash & (nDirSlots - 1)).
+//	Names are hashed case-insensitively.
+//
+//=============================================================================
+
+
+#ifndef __PACKFILE_H
+#define __PACKFILE_H
+
+#include <string>
+#include <vector>
+#include "ResourceManager.h"
+
+
+typedef unsigned long long PACKHASH;
+
+// case-insensitive 64 bit FNV-1a, as stored in the directory
+PACKHASH PackHashName(const char* pName);
+
+
+#define PACK_MAGIC		0x4b434150		// "PACK"
+#define PACK_VERSION	1
+
+// Entry flags
+#define PACK_ENTRY_RAW	0x0001			// data can be used as it is stored
+
+
+struct PackHeader
+{
+	UINT				nMagic;
+	UINT				nVersion;
+	UINT				nEntries;
+	UINT				nDirSlots;		// always a power of two
+	UINT				nAlignment;
+	UINT				nReserved;
+	unsigned long long	nEntryOffset;
+	unsigned long long	nDirOffset;
+	unsigned long long	nNameOffset;
+	unsigned long long	nFileSize;
+};
+
+struct PackEntry
+{
+	PACKHASH			nNameHash;
+	unsigned long long	nOffset;
+	unsigned long long	nSize;
+	UINT				nNameOffset;	// from PackHeader::nNameOffset
+	UINT				nFlags;
+};
+
+
+// A memory mapped, read-only pack file.  Once it's open, any number of
+// threads can look entries up and read them.
+class PackFile
+{
+public:
+	PackFile()				{  Clear();  }
+	virtual ~PackFile()		{  Close();  }
+
+	void Clear();
+
+	bool Open(const char* pFileName);
+	void Close();
+	bool IsOpen()			{  return (m_pBase != 0) ? true : false;  }
+
+	// Returns the entry's index, or -1 if it isn't in the archive
+	int Find(const char* pName);
+	int Find(PACKHASH nNameHash, const char* pName = 0);
+
+	UINT GetNumEntries()						{  return m_pHeader ? m_pHeader->nEntries : 0;  }
+	const PackEntry* GetEntry(int iEntry)		{  return m_pEntries + iEntry;  }
+	const char* GetName(int iEntry);
+
+	// A pointer into the mapping - no copy is made
+	const void* GetData(int iEntry)				{  return m_pBase + m_pEntries[iEntry].nOffset;  }
+	size_t GetSize(int iEntry)					{  return (size_t)m_pEntries[iEntry].nSize;  }
+
+	// Hints to the OS.  Prefetch asks for the entry's pages to be read in
+	// ahead of use; Release drops them from memory (they're read back from
+	// the file if touched again).  Only pages wholly inside the entry are
+	// released, so neighbouring entries are never affected.
+	void Prefetch(int iEntry);
+	void Release(int iEntry);
+
+protected:
+	const unsigned char*	m_pBase;
+	size_t					m_nMapSize;
+	const PackHeader*		m_pHeader;
+	const PackEntry*		m_pEntries;
+	const UINT*				m_pDir;
+	const char*				m_pNames;
+	size_t					m_nPageSize;
+
+#ifdef _WIN32
+	void*					m_hFile;
+	void*					m_hMapping;
+#endif
+};
+
+
+// Builds a pack file.  Add everything, then Write() it out.
+class PackFileWriter
+{
+public:
+	PackFileWriter()		{}
+	virtual ~PackFileWriter()	{}
+
+	// The data is copied.  bRaw marks data that can be used straight from
+	// the mapping.
+	bool AddData(const char* pName, const void* pData, size_t nSize, bool bRaw = true);
+	bool AddFile(const char* pName, const char* pFileName, bool bRaw = true);
+
+	// nAlignment must be a power of two.  Aligning to the page size (the
+	// default) lets a disposed entry give its memory back.
+	bool Write(const char* pFileName, UINT nAlignment = 4096);
+
+	UINT GetNumEntries()	{  return m_Entries.size();  }
+
+protected:
+	struct Item
+	{
+		std::string			Name;
+		std::vector<char>	Data;
+		UINT				nFlags;
+	};
+	std::vector<Item>	m_Entries;
+};
+
+
+// A resource served from a pack file.  Raw entries are used in place:
+// Recreate() just points at the mapping and Dispose() tells the OS to drop
+// the pages.  Entries that need work done on them are passed to Transform(),
+// which a derived class overrides to build its own copy.
+class PackResource : public BaseResource
+{
+public:
+	PackResource()			{  Clear();  }
+	virtual ~PackResource()	{  Destroy();  }
+
+	virtual void Clear();
+
+	// Creating a resource that's already in a manager only replaces its
+	// data; its priority and reference count are left alone.
+	bool Create(PackFile* pPack, const char* pName);
+	bool Create(PackFile* pPack, int iEntry);
+	virtual void Destroy();
+
+	virtual bool Recreate();
+	virtual void Dispose();
+
+	virtual size_t GetSize()		{  return m_pData ? m_nSize : 0;  }
+	virtual bool IsDisposed()		{  return (m_pData == 0) ? true : false;  }
+
+	const void* GetData()			{  return m_pData;  }
+	bool IsZeroCopy()				{  return (m_pData && !m_bOwned) ? true : false;  }
+
+protected:
+	// Turns stored data into the form it's used in.  The default copies it.
+	virtual bool Transform(const void* pData, size_t nSize, std::vector<unsigned char>& Out);
+
+	PackFile*					m_pPack;
+	int							m_iEntry;
+	const void*					m_pData;
+	size_t						m_nSize;
+	bool						m_bOwned;	// m_pData is m_Buffer, not the mapping
+	std::vector<unsigned char>	m_Buffer;
+};
+
+
+#endif  // __PACKFILE_H
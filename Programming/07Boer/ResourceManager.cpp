@@ -16,7 +16,6 @@
 //=============================================================================
 
 #include "ResourceManager.h"
-#include <queue>
 
 using namespace std;
 
@@ -56,12 +55,26 @@ bool BaseResource::operator < (BaseResource& container)
 
 void ResManager::Clear()
 {
+	// nothing may still be loading into resources we're about to forget,
+	// and their callbacks can't be made any more
+	if(!m_StreamThreads.empty() || !m_StreamJobs.empty())
+		StopStreaming();
+	m_StreamCalls.clear();
+
 	m_ResourceMap.clear();
 	m_rhNextResHandle = INVALID_RHANDLE;
 	m_nCurrentUsedMemory = 0;
 	m_nMaximumMemory = 0;
 	m_bResourceReserved = false;
 	m_CurrentResource = m_ResourceMap.end();
+	for(int i = 0; i < NUM_PRIORITIES; i++)
+	{
+		m_pLRUHead[i] = 0;
+		m_pLRUTail[i] = 0;
+	}
+	m_StreamJobs.clear();
+	m_nStreamSequence = 0;
+	m_bStreamQuit = false;
 }
 
 
@@ -75,6 +88,9 @@ bool ResManager::Create(UINT nMaxSize)
 
 void ResManager::Destroy()
 {
+	// no loads may be running while we delete things
+	StopStreaming();
+
 	for(ResMapItor itor = m_ResourceMap.begin(); itor != m_ResourceMap.end(); ++itor)
 	{
 		if(!((*itor).second)->IsLocked())
@@ -111,6 +127,9 @@ bool ResManager::InsertResource(RHANDLE* rhUniqueID, BaseResource* pResource)
 	*rhUniqueID = GetNextResHandle();
 	// Insert the resource into the current catalog's map
 	m_ResourceMap.insert(ResMapPair(*rhUniqueID, pResource));
+	UpdateLRU(pResource);
+	if(!pResource->IsDisposed())
+		pResource->m_nStreamSize = pResource->GetSize();
 	// Get the memory and add it to the catalog total.  Note that we only have
 	// to check for memory overallocation if we haven't preallocated memory
 	if(!m_bResourceReserved)
@@ -136,6 +155,9 @@ bool ResManager::InsertResource(RHANDLE rhUniqueID, BaseResource* pResource)
 		return false;
 	// Insert the resource into the current catalog's map
 	m_ResourceMap.insert(ResMapPair(rhUniqueID, pResource));
+	UpdateLRU(pResource);
+	if(!pResource->IsDisposed())
+		pResource->m_nStreamSize = pResource->GetSize();
 	// Get the memory and add it to the catalog total.  Note that we only have
 	// to check for memory overallocation if we haven't preallocated memory
 	if(!m_bResourceReserved)
@@ -155,6 +177,10 @@ bool ResManager::InsertResource(RHANDLE rhUniqueID, BaseResource* pResource)
 
 bool ResManager::RemoveResource(RHANDLE rhUniqueID)
 {
+	// let any background load finish first
+	if(!m_StreamJobs.empty())
+		WaitForStream(rhUniqueID);
+
 	// try to find the resource with the specified id
 	ResMapItor itor = m_ResourceMap.find(rhUniqueID);
 	if(itor == m_ResourceMap.end())
@@ -167,7 +193,9 @@ bool ResManager::RemoveResource(RHANDLE rhUniqueID)
 	// Get the memory and subtract it from the manager total
 	RemoveMemory(((*itor).second)->GetSize());
 	// remove the requested resource
+	UnlinkLRU(itor->second);
 	m_ResourceMap.erase(itor);
+	CancelCallbacks(rhUniqueID);
 
 	return true;
 }
@@ -175,6 +203,9 @@ bool ResManager::RemoveResource(RHANDLE rhUniqueID)
 
 bool ResManager::RemoveResource(BaseResource* pResource)
 {
+	// let any background load finish first
+	if(pResource->m_bStreaming)
+		WaitForStream(FindResourceHandle(pResource));
 
 	// try to find the resource with the specified resource
         ResMapItor itor;
@@ -193,6 +224,8 @@ bool ResManager::RemoveResource(BaseResource* pResource)
 	// Get the memory and subtract it from the manager total
 	RemoveMemory(pResource->GetSize());
 	// remove the requested resource
+	UnlinkLRU(pResource);
+	CancelCallbacks(itor->first);
 	m_ResourceMap.erase(itor);
 
 	return true;
@@ -222,6 +255,10 @@ bool ResManager::DestroyResource(RHANDLE rhUniqueID)
 
 BaseResource* ResManager::GetResource(RHANDLE rhUniqueID)
 {
+	// if it's on its way in the background, wait for it
+	if(!m_StreamJobs.empty())
+		WaitForStream(rhUniqueID);
+
 	ResMapItor itor = m_ResourceMap.find(rhUniqueID);
 
 	if(itor == m_ResourceMap.end())
@@ -245,6 +282,9 @@ BaseResource* ResManager::GetResource(RHANDLE rhUniqueID)
 		CheckForOverallocation();
 		Unlock(rhUniqueID);
 	}
+	else
+		// move it to the most recently used end of its list
+		TouchLRU(itor->second);
 
  
 	// return the object pointer
@@ -254,12 +294,18 @@ BaseResource* ResManager::GetResource(RHANDLE rhUniqueID)
 
 BaseResource* ResManager::Lock(RHANDLE rhUniqueID)
 {
+	// if it's on its way in the background, wait for it
+	if(!m_StreamJobs.empty())
+		WaitForStream(rhUniqueID);
+
 	ResMapItor itor = m_ResourceMap.find(rhUniqueID);
 	if(itor == m_ResourceMap.end())
 		return NULL;
 	
-	// increment the object's count
+	// increment the object's count, which takes it out of the running
+	// for being swapped out
 	itor->second->SetReferenceCount(itor->second->GetReferenceCount() + 1);
+	UnlinkLRU(itor->second);
 
 	// recreate the object before giving it to the application
 	if(itor->second->IsDisposed())
@@ -281,9 +327,13 @@ int ResManager::Unlock(RHANDLE rhUniqueID)
 	if(itor == m_ResourceMap.end())
 		return -1;
 	
-	// decrement the object's count
+	// decrement the object's count, and once nobody has it locked it can be
+	// swapped out again
 	if(itor->second->GetReferenceCount() > 0)
+	{
 		itor->second->SetReferenceCount(itor->second->GetReferenceCount() - 1);
+		UpdateLRU(itor->second);
+	}
 
 	return itor->second->GetReferenceCount();
 }
@@ -297,6 +347,23 @@ int ResManager::Unlock(BaseResource* pResource)
 }
 
 
+bool ResManager::SetPriority(RHANDLE rhUniqueID, BaseResource::PriorityType priority)
+{
+	ResMapItor itor = m_ResourceMap.find(rhUniqueID);
+	if(itor == m_ResourceMap.end())
+		return false;
+
+	BaseResource* pResource = itor->second;
+	pResource->SetPriority(priority);
+	if((pResource->m_iLRUList >= 0) && (pResource->m_iLRUList != GetLRUList(pResource)))
+	{
+		UnlinkLRU(pResource);
+		LinkLRU(pResource);
+	}
+	return true;
+}
+
+
 RHANDLE ResManager::FindResourceHandle(BaseResource* pResource)
 {
 	// try to find the resource with the specified resource
@@ -312,37 +379,127 @@ RHANDLE ResManager::FindResourceHandle(BaseResource* pResource)
 }
 
 
+void ResManager::LinkLRU(BaseResource* pResource)
+{
+	if(pResource->m_iLRUList >= 0)
+		return;
+
+	// add to the most recently used end of the list for its priority
+	int iList = GetLRUList(pResource);
+	pResource->m_iLRUList = iList;
+	pResource->m_pLRUPrev = m_pLRUTail[iList];
+	pResource->m_pLRUNext = 0;
+	if(m_pLRUTail[iList])
+		m_pLRUTail[iList]->m_pLRUNext = pResource;
+	else
+		m_pLRUHead[iList] = pResource;
+	m_pLRUTail[iList] = pResource;
+}
+
+
+void ResManager::UnlinkLRU(BaseResource* pResource)
+{
+	int iList = pResource->m_iLRUList;
+	if(iList < 0)
+		return;
+
+	if(pResource->m_pLRUPrev)
+		pResource->m_pLRUPrev->m_pLRUNext = pResource->m_pLRUNext;
+	else
+		m_pLRUHead[iList] = pResource->m_pLRUNext;
+	if(pResource->m_pLRUNext)
+		pResource->m_pLRUNext->m_pLRUPrev = pResource->m_pLRUPrev;
+	else
+		m_pLRUTail[iList] = pResource->m_pLRUPrev;
+
+	pResource->m_pLRUPrev = 0;
+	pResource->m_pLRUNext = 0;
+	pResource->m_iLRUList = -1;
+}
+
+
+void ResManager::UpdateLRU(BaseResource* pResource)
+{
+	if(!pResource->m_bStreaming && !pResource->IsLocked() && !pResource->IsDisposed())
+		LinkLRU(pResource);
+	else
+		UnlinkLRU(pResource);
+}
+
+
+void ResManager::TouchLRU(BaseResource* pResource)
+{
+	if(pResource->m_iLRUList < 0)
+		return;
+	UnlinkLRU(pResource);
+	LinkLRU(pResource);
+}
+
+
 bool ResManager::CheckForOverallocation()
 {
 	if(m_nCurrentUsedMemory > m_nMaximumMemory)
 	{
-		// Attempt to remove iMemToPurge bytes from the managed resource
-		int iMemToPurge = m_nCurrentUsedMemory - m_nMaximumMemory;
-
-		// create a temporary priority queue to store the managed items
-		priority_queue<BaseResource*, vector<BaseResource*>, ptr_greater<BaseResource*> > PriQueue;
-
-		// insert copies of all the resource pointers into the priority queue, but
-		// exclude those that are current disposed or are locked
-		for(ResMapItor itor = m_ResourceMap.begin(); itor != m_ResourceMap.end(); ++itor)
+		// resources whose Dispose() didn't take; they go back on their lists
+		// afterwards so we don't keep trying them in this pass
+		BaseResource* pKept = 0;
+
+		// Discard from the head of each list, lowest priority first.  Only
+		// unlocked, undisposed resources are on the lists, so every head is
+		// a candidate and each one costs O(1) to find.
+		for(int iList = 0; iList < NUM_PRIORITIES; iList++)
 		{
-			if(!itor->second->IsDisposed() && !itor->second->IsLocked())
-				PriQueue.push(itor->second);
+			while(m_pLRUHead[iList] && (m_nCurrentUsedMemory > m_nMaximumMemory))
+			{
+				BaseResource* pRes = m_pLRUHead[iList];
+				UnlinkLRU(pRes);
+
+				// its priority was changed after it was listed, so move it
+				// to the right list.  If that's one we've already been
+				// through, go back to it, or it'd outlive higher priorities.
+				if(GetLRUList(pRes) != iList)
+				{
+					LinkLRU(pRes);
+					if(GetLRUList(pRes) < iList)
+					{
+						iList = GetLRUList(pRes) - 1;
+						break;
+					}
+					continue;
+				}
+
+				// disposed behind our back - it had no memory to give
+				if(pRes->IsDisposed())
+					continue;
+
+				size_t nDisposalSize = pRes->GetSize();
+				pRes->Dispose();
+				if(pRes->IsDisposed())
+				{
+					RemoveMemory(nDisposalSize);
+					// what a background reload will need to reserve
+					pRes->m_nStreamSize = nDisposalSize;
+				}
+				else
+				{
+					pRes->m_pLRUNext = pKept;
+					pKept = pRes;
+				}
+			}
 		}
 
-		while((!PriQueue.empty()) && (m_nCurrentUsedMemory > m_nMaximumMemory))
+		while(pKept)
 		{
-			UINT nDisposalSize = PriQueue.top()->GetSize();
-			PriQueue.top()->Dispose();
-			if(PriQueue.top()->IsDisposed())
-				RemoveMemory(nDisposalSize);
-			PriQueue.pop();
+			BaseResource* pRes = pKept;
+			pKept = pRes->m_pLRUNext;
+			pRes->m_pLRUNext = 0;
+			LinkLRU(pRes);
 		}
 
-		// If the resource queue is empty and we still have too much memory allocated,
+		// If the lists are empty and we still have too much memory allocated,
 		// then we return failure.  This could happen if too many resources were locked
 		// or if a resource larger than the requested maximum memory was inserted.
-		if(PriQueue.empty() && (m_nCurrentUsedMemory > m_nMaximumMemory))
+		if(m_nCurrentUsedMemory > m_nMaximumMemory)
 			return false;
 	}
 	return true;
@@ -350,3 +507,326 @@ bool ResManager::CheckForOverallocation()
 
 
 
+// Background streaming
+
+bool ResManager::StartStreaming(UINT nThreads)
+{
+	if(!m_StreamThreads.empty() || (nThreads == 0))
+		return false;
+	m_bStreamQuit = false;
+	for(UINT i = 0; i < nThreads; i++)
+		m_StreamThreads.push_back(std::thread(&ResManager::StreamThread, this));
+	return true;
+}
+
+
+void ResManager::StopStreaming()
+{
+	// let the workers finish whatever they're loading, then stop them
+	{
+		std::lock_guard<std::mutex> lock(m_StreamLock);
+		m_bStreamQuit = true;
+	}
+	m_StreamWake.notify_all();
+	for(UINT i = 0; i < m_StreamThreads.size(); i++)
+		m_StreamThreads[i].join();
+	m_StreamThreads.clear();
+	m_bStreamQuit = false;
+
+	// finish off the loads that completed; their callbacks wait for Update()
+	FinishStreams();
+
+	// and cancel the ones nobody started
+	while(!m_StreamQueue.empty())
+	{
+		StreamJob* pJob = m_StreamQueue.top();
+		m_StreamQueue.pop();
+		if(pJob->bOrphaned)
+		{
+			delete pJob;
+			continue;
+		}
+		pJob->bInQueue = false;
+		pJob->bClaimed = true;
+		pJob->bDone = true;
+		pJob->bSuccess = false;
+		FinishStream(pJob);
+	}
+}
+
+
+bool ResManager::Prefetch(RHANDLE rhUniqueID, StreamCallback pCallback, void* pContext,
+	size_t nExpectedSize)
+{
+	ResMapItor itor = m_ResourceMap.find(rhUniqueID);
+	if(itor == m_ResourceMap.end())
+		return false;
+	BaseResource* pResource = itor->second;
+
+	StreamRequest Request;
+	Request.pCallback = pCallback;
+	Request.pContext = pContext;
+
+	// already on its way - just add the callback
+	StreamJobMap::iterator job = m_StreamJobs.find(rhUniqueID);
+	if(job != m_StreamJobs.end())
+	{
+		if(pCallback)
+			job->second->Requests.push_back(Request);
+		return true;
+	}
+
+	// already here
+	if(!pResource->IsDisposed())
+	{
+		if(pCallback)
+			QueueCallback(rhUniqueID, pResource, true, Request);
+		return true;
+	}
+
+	// reserve the memory now, so the load can't overshoot the limit later.
+	// without any idea of the size there's nothing to reserve, and the load
+	// could take the manager over its limit behind its back.
+	size_t nReserve = nExpectedSize;
+	if(nReserve == 0)
+		nReserve = pResource->GetSize();
+	if(nReserve == 0)
+		nReserve = pResource->m_nStreamSize;
+	if(nReserve == 0)
+		return false;
+	AddMemory(nReserve);
+	if(!CheckForOverallocation())
+	{
+		RemoveMemory(nReserve);
+		return false;
+	}
+
+	StreamJob* pJob = new StreamJob;
+	pJob->rhUniqueID = rhUniqueID;
+	pJob->pResource = pResource;
+	pJob->iPriority = pResource->GetPriority();
+	pJob->nSequence = m_nStreamSequence++;
+	pJob->nReserved = nReserve;
+	pJob->bInQueue = false;
+	pJob->bOrphaned = false;
+	pJob->bClaimed = false;
+	pJob->bDone = false;
+	pJob->bSuccess = false;
+	if(pCallback)
+		pJob->Requests.push_back(Request);
+
+	pResource->m_bStreaming = true;
+	m_StreamJobs.insert(StreamJobMap::value_type(rhUniqueID, pJob));
+
+	if(m_StreamThreads.empty())
+	{
+		// no workers, so load it right here
+		pJob->bClaimed = true;
+		pJob->bSuccess = pResource->Recreate();
+		pJob->bDone = true;
+		FinishStream(pJob);
+		return true;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_StreamLock);
+		pJob->bInQueue = true;
+		m_StreamQueue.push(pJob);
+	}
+	m_StreamWake.notify_one();
+	return true;
+}
+
+
+BaseResource* ResManager::TryLock(RHANDLE rhUniqueID, size_t nExpectedSize)
+{
+	ResMapItor itor = m_ResourceMap.find(rhUniqueID);
+	if(itor == m_ResourceMap.end())
+		return NULL;
+	BaseResource* pResource = itor->second;
+
+	// start it loading if it isn't already (with no workers this loads it)
+	if(!pResource->m_bStreaming && pResource->IsDisposed())
+		Prefetch(rhUniqueID, 0, 0, nExpectedSize);
+
+	if(pResource->m_bStreaming || pResource->IsDisposed())
+		return NULL;
+
+	return Lock(rhUniqueID);
+}
+
+
+bool ResManager::IsStreaming(RHANDLE rhUniqueID)
+{
+	return (m_StreamJobs.find(rhUniqueID) != m_StreamJobs.end()) ? true : false;
+}
+
+
+UINT ResManager::Update()
+{
+	UINT nFinished = FinishStreams();
+
+	// Make the callbacks, which only ever happens here.  A callback may call
+	// back into the manager: the ones it queues wait for the next Update(),
+	// and one it cancels by removing a resource is made with a NULL pointer.
+	if(!m_bInCallbacks)
+	{
+		m_bInCallbacks = true;
+		UINT nCalls = m_StreamCalls.size();
+		for(UINT i = 0; (i < nCalls) && (i < m_StreamCalls.size()); i++)
+		{
+			StreamCall Call = m_StreamCalls[i];
+			Call.pCallback(Call.rhUniqueID, Call.pResource, Call.bSuccess, Call.pContext);
+		}
+		m_StreamCalls.erase(m_StreamCalls.begin(),
+			m_StreamCalls.begin() + min(nCalls, (UINT)m_StreamCalls.size()));
+		m_bInCallbacks = false;
+	}
+
+	return nFinished;
+}
+
+
+UINT ResManager::FinishStreams()
+{
+	std::vector<StreamJob*> Finished;
+	{
+		std::lock_guard<std::mutex> lock(m_StreamLock);
+		Finished.swap(m_StreamFinished);
+	}
+
+	for(UINT i = 0; i < Finished.size(); i++)
+		FinishStream(Finished[i]);
+
+	return Finished.size();
+}
+
+
+void ResManager::StreamThread()
+{
+	std::unique_lock<std::mutex> lock(m_StreamLock);
+	while(true)
+	{
+		while(!m_bStreamQuit && m_StreamQueue.empty())
+			m_StreamWake.wait(lock);
+		if(m_bStreamQuit)
+			return;
+
+		StreamJob* pJob = m_StreamQueue.top();
+		m_StreamQueue.pop();
+		pJob->bInQueue = false;
+
+		// finished and forgotten while it sat in the queue
+		if(pJob->bOrphaned)
+		{
+			delete pJob;
+			continue;
+		}
+		// the main thread is loading it itself
+		if(pJob->bClaimed)
+			continue;
+		pJob->bClaimed = true;
+
+		// the slow part, without the lock
+		lock.unlock();
+		bool bSuccess = pJob->pResource->Recreate();
+		lock.lock();
+
+		pJob->bSuccess = bSuccess;
+		pJob->bDone = true;
+		m_StreamFinished.push_back(pJob);
+		m_StreamDone.notify_all();
+	}
+}
+
+
+void ResManager::WaitForStream(RHANDLE rhUniqueID)
+{
+	StreamJobMap::iterator job = m_StreamJobs.find(rhUniqueID);
+	if(job == m_StreamJobs.end())
+		return;
+	StreamJob* pJob = job->second;
+
+	std::unique_lock<std::mutex> lock(m_StreamLock);
+	if(!pJob->bClaimed)
+	{
+		// no worker has got to it yet, so do it here rather than wait
+		pJob->bClaimed = true;
+		lock.unlock();
+		pJob->bSuccess = pJob->pResource->Recreate();
+		pJob->bDone = true;
+		FinishStream(pJob);
+		return;
+	}
+
+	while(!pJob->bDone)
+		m_StreamDone.wait(lock);
+	lock.unlock();
+
+	FinishStreams();
+}
+
+
+void ResManager::FinishStream(StreamJob* pJob)
+{
+	BaseResource* pResource = pJob->pResource;
+
+	pResource->m_bStreaming = false;
+	m_StreamJobs.erase(pJob->rhUniqueID);
+
+	// swap the reservation for what it really takes
+	RemoveMemory(pJob->nReserved);
+	if(pJob->bSuccess && !pResource->IsDisposed())
+	{
+		AddMemory(pResource->GetSize());
+		pResource->m_nStreamSize = pResource->GetSize();
+		pResource->SetLastAccess(time(0));
+		UpdateLRU(pResource);
+		CheckForOverallocation();
+	}
+
+	for(UINT i = 0; i < pJob->Requests.size(); i++)
+		QueueCallback(pJob->rhUniqueID, pResource, pJob->bSuccess, pJob->Requests[i]);
+
+	// a worker may still have to pop it off the queue, in which case it
+	// deletes it then
+	bool bDelete = true;
+	if(!m_StreamThreads.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_StreamLock);
+		if(pJob->bInQueue)
+		{
+			pJob->bOrphaned = true;
+			bDelete = false;
+		}
+	}
+	if(bDelete)
+		delete pJob;
+}
+
+
+void ResManager::QueueCallback(RHANDLE rhUniqueID, BaseResource* pResource, bool bSuccess,
+	const StreamRequest& Request)
+{
+	StreamCall Call;
+	Call.rhUniqueID = rhUniqueID;
+	Call.pResource = pResource;
+	Call.bSuccess = bSuccess;
+	Call.pCallback = Request.pCallback;
+	Call.pContext = Request.pContext;
+	m_StreamCalls.push_back(Call);
+}
+
+
+void ResManager::CancelCallbacks(RHANDLE rhUniqueID)
+{
+	// the resource is gone, so its callbacks mustn't see it
+	for(UINT i = 0; i < m_StreamCalls.size(); i++)
+	{
+		if(m_StreamCalls[i].rhUniqueID == rhUniqueID)
+		{
+			m_StreamCalls[i].pResource = 0;
+			m_StreamCalls[i].bSuccess = false;
+		}
+	}
+}
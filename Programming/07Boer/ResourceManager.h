@@ -27,6 +27,11 @@
 #include <ctime>
 #include <map>
 #include <stack>
+#include <queue>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 
 
@@ -57,7 +62,8 @@ public:
 		RES_HIGH_PRIORITY
 	};
 
-	BaseResource()			{  Clear();  }
+	BaseResource() : m_pLRUPrev(0), m_pLRUNext(0), m_iLRUList(-1),
+		m_nStreamSize(0), m_bStreaming(false)	{  Clear();  }
 	virtual ~BaseResource()	{  Destroy();  }
 
 	// Clears the class data
@@ -99,6 +105,22 @@ protected:
 	UINT			m_nRefCount;
 	time_t			m_LastAccess;
 
+private:
+	// Links for the resource manager's eviction lists.  A resource sits on
+	// the list for its priority while it's managed, unlocked and not disposed.
+	friend class ResManager;
+	friend class ConcurrentResManager;
+	BaseResource*	m_pLRUPrev;
+	BaseResource*	m_pLRUNext;
+	int				m_iLRUList;		// list it's on, or -1 if none
+
+	// Streaming state.  m_nStreamSize is the size the resource had when the
+	// manager last saw it loaded, which a background reload reserves if
+	// nothing better is known.
+	// While m_bStreaming is set a worker thread may be inside Recreate().
+	size_t			m_nStreamSize;
+	bool			m_bStreaming;
+
 };
 
 // This class allows an STL object to compare the objects instead of
@@ -129,12 +151,19 @@ typedef ResMap::iterator ResMapItor;
 typedef ResMap::value_type ResMapPair;
 
 
+// Called on the main thread, from ResManager::Update() and nowhere else, once
+// a background load has finished.  bSuccess is false if Recreate() failed or
+// the load was cancelled; pResource is NULL if the resource was removed
+// before the callback could be made.
+typedef void (*StreamCallback)(RHANDLE rhUniqueID, BaseResource* pResource, bool bSuccess, void* pContext);
+
+
 class ResManager 
 {
 
 public:
 	
-	ResManager()			{  Clear();  }
+	ResManager() : m_bInCallbacks(false)	{  Clear();  }
 	virtual ~ResManager()	{  Destroy();  }
 
 	void Clear();
@@ -147,6 +176,7 @@ public:
 
 	bool SetMaximumMemory(size_t nMem);
 	size_t GetMaximumMemory()		{  return m_nMaximumMemory;  }
+	size_t GetUsedMemory()			{  return m_nCurrentUsedMemory;  }
 
 	
 	// --------------------------------------------------------------------------
@@ -209,6 +239,52 @@ public:
 	// first match found.
 	RHANDLE FindResourceHandle(BaseResource* pResource);
 
+	// Changes the priority of a resource the manager holds, and moves it to
+	// the eviction list for its new priority straight away.  Calling
+	// BaseResource::SetPriority directly leaves it where it was until the
+	// manager next comes across it.
+	bool SetPriority(RHANDLE rhUniqueID, BaseResource::PriorityType priority);
+
+
+	// -----------------------------------------------------------------------
+	// Background streaming
+
+	// Starts worker threads that call Recreate() for disposed resources off
+	// the main thread.  Without them, Prefetch and TryLock load synchronously.
+	bool StartStreaming(UINT nThreads = 1);
+	void StopStreaming();
+
+	// Asks for a disposed resource to be loaded in the background.  Loads
+	// are queued by the resource's priority, highest first.  The memory it
+	// will need is reserved against the maximum up front (swapping other
+	// resources out to make room), so loads in flight can never push the
+	// manager over its limit; if the room can't be made, Prefetch fails.
+	// The reservation is nExpectedSize if given, else GetSize() if the
+	// disposed resource knows it, else the size it had when the manager
+	// last saw it loaded.  If none of those is known Prefetch fails, since
+	// it couldn't keep to the limit.  The callback, if any, is made from the
+	// next Update(), even if the resource is already loaded.
+	bool Prefetch(RHANDLE rhUniqueID, StreamCallback pCallback = 0, void* pContext = 0,
+		size_t nExpectedSize = 0);
+
+	// Locks the resource if it's loaded and returns it; otherwise starts a
+	// background load (as with Prefetch) and returns NULL without waiting.
+	BaseResource* TryLock(RHANDLE rhUniqueID, size_t nExpectedSize = 0);
+
+	// True while a background load of the resource is queued or running.
+	bool IsStreaming(RHANDLE rhUniqueID);
+
+	// Finishes off completed background loads: fixes up the memory totals,
+	// makes the resources available and makes the callbacks.  Call it once
+	// a frame from the main thread.  Returns the number of loads finished.
+	UINT Update();
+
+	// GetResource, Lock, RemoveResource and DestroyResource on a resource
+	// that is streaming wait for its load to finish (or do it themselves if
+	// no worker has started on it yet).  Callbacks for loads finished that
+	// way still wait for Update(), so they never run inside another call.
+	// StopStreaming() and Clear() cancel the loads nobody has started.
+
 protected:
 
 	// Internal functions
@@ -216,20 +292,109 @@ protected:
 	inline void RemoveMemory(size_t nMem)	{  m_nCurrentUsedMemory -= nMem;  }
 	UINT GetNextResHandle()					{  return --m_rhNextResHandle;  }
 
+	// Eviction list maintenance.  UpdateLRU puts a resource on or takes it
+	// off its list to match its current state, TouchLRU moves it to the
+	// most recently used end.
+	inline int GetLRUList(BaseResource* pResource)
+	{  int i = pResource->GetPriority();  return (i < 0) ? 0 : ((i >= NUM_PRIORITIES) ? NUM_PRIORITIES - 1 : i);  }
+	void LinkLRU(BaseResource* pResource);
+	void UnlinkLRU(BaseResource* pResource);
+	void UpdateLRU(BaseResource* pResource);
+	void TouchLRU(BaseResource* pResource);
+
 	// This must be called when you wish the manager to check for discardable
 	// resources.  Resources will only be swapped out if the maximum allowable
 	// limit has been reached, and it will discard them from lowest to highest
-	// priority, determined by the resource class's < operator.  Function will
+	// priority, least recently used first within a priority.  Function will
 	// fail if requested memory cannot be freed.
 	bool CheckForOverallocation();
 
+	// Streaming internals
+	struct StreamRequest
+	{
+		StreamCallback	pCallback;
+		void*			pContext;
+	};
+
+	struct StreamJob
+	{
+		RHANDLE			rhUniqueID;
+		BaseResource*	pResource;
+		int				iPriority;
+		UINT			nSequence;		// first come first served within a priority
+		size_t			nReserved;		// memory counted for it while in flight
+		bool			bInQueue;		// still in m_StreamQueue
+		bool			bOrphaned;		// finished while in the queue, whoever pops it deletes it
+		bool			bClaimed;		// a thread has started on it
+		bool			bDone;			// Recreate() has returned
+		bool			bSuccess;
+		std::vector<StreamRequest> Requests;
+	};
+
+	// orders the I/O queue: highest priority, then oldest, on top
+	struct StreamJobLess
+	{
+		bool operator ()(const StreamJob* left, const StreamJob* right) const
+		{
+			if(left->iPriority != right->iPriority)
+				return left->iPriority < right->iPriority;
+			return left->nSequence > right->nSequence;
+		}
+	};
+
+	// a callback waiting for Update()
+	struct StreamCall
+	{
+		RHANDLE			rhUniqueID;
+		BaseResource*	pResource;		// NULL once the resource is removed
+		bool			bSuccess;
+		StreamCallback	pCallback;
+		void*			pContext;
+	};
+
+	typedef std::map<RHANDLE, StreamJob*> StreamJobMap;
+	typedef std::priority_queue<StreamJob*, std::vector<StreamJob*>, StreamJobLess> StreamQueue;
+
+	void StreamThread();
+	void WaitForStream(RHANDLE rhUniqueID);
+	UINT FinishStreams();
+	void FinishStream(StreamJob* pJob);
+	void QueueCallback(RHANDLE rhUniqueID, BaseResource* pResource, bool bSuccess,
+		const StreamRequest& Request);
+	void CancelCallbacks(RHANDLE rhUniqueID);
+
 protected:
+	enum { NUM_PRIORITIES = BaseResource::RES_HIGH_PRIORITY + 1 };
+
+	// One list per priority of the resources that can be swapped out, in
+	// order of use: the head is the least recently used.  Kept up to date
+	// by Insert, Remove, Lock, Unlock and GetResource, so finding the next
+	// resource to discard never takes a search.
+	BaseResource*	m_pLRUHead[NUM_PRIORITIES];
+	BaseResource*	m_pLRUTail[NUM_PRIORITIES];
+
 	RHANDLE			m_rhNextResHandle;
 	size_t			m_nCurrentUsedMemory;
 	size_t			m_nMaximumMemory;
 	bool			m_bResourceReserved;
 	ResMapItor		m_CurrentResource;
 	ResMap			m_ResourceMap;
+
+	// streaming - the job map is only touched by the main thread, the rest
+	// is shared with the workers under m_StreamLock
+	StreamJobMap				m_StreamJobs;
+	UINT						m_nStreamSequence;
+	std::vector<std::thread>	m_StreamThreads;
+	std::mutex					m_StreamLock;
+	std::condition_variable		m_StreamWake;
+	std::condition_variable		m_StreamDone;
+	StreamQueue					m_StreamQueue;
+	std::vector<StreamJob*>		m_StreamFinished;
+	bool						m_bStreamQuit;
+
+	// callbacks for Update() to make; main thread only
+	std::vector<StreamCall>		m_StreamCalls;
+	bool						m_bInCallbacks;
 };
 
 
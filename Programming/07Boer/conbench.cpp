@@ -0,0 +1,228 @@
+/* Copyright (C) James Boer, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) James Boer, 2000"
+ */
+//=============================================================================
+//
+// 	conbench.cpp - concurrent resource manager benchmark
+//
+//	Several threads churn one manager at once: fetching, locking and
+//	unlocking, and destroying and replacing resources, with the memory limit
+//	well below the total so swapping goes on all the time.  Another thread
+//	walks all the resources every few milliseconds.  The same work is then
+//	done through a plain ResManager behind one big lock for comparison.  At
+//	the end the books are checked: the resources' sizes must add up to the
+//	manager's count, and that must be within the limit.
+//
+//	usage: conbench [threads] [resources] [operations per thread]
+//
+//=============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include "ConcurrentResManager.h"
+
+using namespace std;
+
+
+class BenchResource : public BaseResource
+{
+public:
+	BenchResource(size_t nSize) : m_nSize(nSize), m_bLoaded(true)	{}
+
+	virtual void Dispose()			{  m_bLoaded = false;  }
+	virtual bool Recreate()			{  m_bLoaded = true;  return true;  }
+	virtual size_t GetSize()		{  return m_bLoaded ? m_nSize : 0;  }
+	virtual bool IsDisposed()		{  return !m_bLoaded;  }
+
+protected:
+	size_t	m_nSize;
+	bool	m_bLoaded;
+};
+
+
+// per thread random numbers
+static UINT Random(unsigned int& nSeed, UINT nRange)
+{
+	nSeed = nSeed * 1103515245 + 12345;
+	return ((nSeed >> 8) & 0xffffff) % nRange;
+}
+
+
+// the plain manager and its one lock, set up the same way
+struct LockedResManager
+{
+	mutex		Lock;
+	ResManager	Manager;
+};
+
+
+template <class MANAGER>
+static void Churn(MANAGER& rm, UINT nResources, UINT nOperations, unsigned int nSeed)
+{
+	for(UINT i = 0; i < nOperations; i++)
+	{
+		RHANDLE rh = (Random(nSeed, 100) < 80) ? 1 + Random(nSeed, nResources / 5) : 1 + Random(nSeed, nResources);
+		UINT nAction = Random(nSeed, 100);
+		if(nAction < 70)
+			rm.GetResource(rh);
+		else if(nAction < 90)
+		{
+			if(rm.Lock(rh))
+				rm.Unlock(rh);
+		}
+		else if(rm.DestroyResource(rh))
+		{
+			BenchResource* pRes = new BenchResource(256 + Random(nSeed, 8192));
+			pRes->SetPriority((BaseResource::PriorityType)Random(nSeed, 3));
+			rm.InsertResource(rh, pRes);
+		}
+	}
+}
+
+
+// ResManager wrapped up to look the same as the concurrent one
+struct BigLock
+{
+	LockedResManager& l;
+	BigLock(LockedResManager& locked) : l(locked)	{}
+	BaseResource* GetResource(RHANDLE rh)		{  lock_guard<mutex> g(l.Lock);  return l.Manager.GetResource(rh);  }
+	BaseResource* Lock(RHANDLE rh)				{  lock_guard<mutex> g(l.Lock);  return l.Manager.Lock(rh);  }
+	int Unlock(RHANDLE rh)						{  lock_guard<mutex> g(l.Lock);  return l.Manager.Unlock(rh);  }
+	bool DestroyResource(RHANDLE rh)			{  lock_guard<mutex> g(l.Lock);  return l.Manager.DestroyResource(rh);  }
+	bool InsertResource(RHANDLE rh, BaseResource* p)	{  lock_guard<mutex> g(l.Lock);  return l.Manager.InsertResource(rh, p);  }
+
+	// its iterator is shared, so the walk holds the lock all the way
+	void Walk()
+	{
+		lock_guard<mutex> g(l.Lock);
+		for(l.Manager.GotoBegin(); l.Manager.IsValid(); l.Manager.GotoNext())
+			{}
+	}
+};
+
+
+static void Walk(ConcurrentResManager& rm)
+{
+	ResCursor Cursor;
+	RHANDLE rh;
+	for(bool b = rm.GetFirst(Cursor, &rh, 0); b; b = rm.GetNext(Cursor, &rh, 0))
+		{}
+}
+
+static void Walk(BigLock& rm)
+{
+	rm.Walk();
+}
+
+
+// walks everything every few milliseconds, like a debug display would
+template <class MANAGER>
+static void Walker(MANAGER& rm, atomic<bool>& bWalking, UINT& nWalks)
+{
+	while(bWalking)
+	{
+		Walk(rm);
+		nWalks++;
+		this_thread::sleep_for(chrono::milliseconds(5));
+	}
+}
+
+
+static bool AddSize(RHANDLE /*rhUniqueID*/, BaseResource* pResource, void* pContext)
+{
+	*(size_t*)pContext += pResource->GetSize();
+	return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+	UINT nThreads = (argc > 1) ? atoi(argv[1]) : 4;
+	UINT nResources = (argc > 2) ? atoi(argv[2]) : 50000;
+	UINT nOperations = (argc > 3) ? atoi(argv[3]) : 250000;
+	if(nThreads < 1)
+		nThreads = 1;
+	if(nResources < 16)
+		nResources = 16;
+
+	size_t nLimit = (size_t)nResources * (256 + 8192 / 2) / 4;
+	UINT i;
+
+	printf("%u threads (%u hardware), %u resources, limit %u bytes, %u operations per thread\n\n",
+		nThreads, thread::hardware_concurrency(), nResources, (UINT)nLimit, nOperations);
+
+	// the concurrent manager
+	ConcurrentResManager crm;
+	crm.Create(nLimit);
+	unsigned int nSeed = 1;
+	for(i = 1; i <= nResources; i++)
+	{
+		BenchResource* pRes = new BenchResource(256 + Random(nSeed, 8192));
+		pRes->SetPriority((BaseResource::PriorityType)Random(nSeed, 3));
+		crm.InsertResource(i, pRes);
+	}
+
+	vector<thread> Threads;
+	atomic<bool> bWalking(true);
+	UINT nWalks = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(i = 0; i < nThreads; i++)
+		Threads.push_back(thread(Churn<ConcurrentResManager>, ref(crm), nResources, nOperations, i + 1));
+	thread WalkThread(Walker<ConcurrentResManager>, ref(crm), ref(bWalking), ref(nWalks));
+	for(i = 0; i < nThreads; i++)
+		Threads[i].join();
+	double fConcurrentMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	bWalking = false;
+	WalkThread.join();
+	Threads.clear();
+
+	// the plain manager behind one lock
+	LockedResManager locked;
+	locked.Manager.Create(nLimit);
+	nSeed = 1;
+	for(i = 1; i <= nResources; i++)
+	{
+		BenchResource* pRes = new BenchResource(256 + Random(nSeed, 8192));
+		pRes->SetPriority((BaseResource::PriorityType)Random(nSeed, 3));
+		locked.Manager.InsertResource(i, pRes);
+	}
+	BigLock big(locked);
+	UINT nLockedWalks = 0;
+	bWalking = true;
+	start = chrono::steady_clock::now();
+	for(i = 0; i < nThreads; i++)
+		Threads.push_back(thread(Churn<BigLock>, ref(big), nResources, nOperations, i + 1));
+	WalkThread = thread(Walker<BigLock>, ref(big), ref(bWalking), ref(nLockedWalks));
+	for(i = 0; i < nThreads; i++)
+		Threads[i].join();
+	double fLockedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	bWalking = false;
+	WalkThread.join();
+
+	double fTotal = (double)nThreads * nOperations;
+	printf("sharded      %10.1f ms  %10.1f ops/ms  (%u walks alongside)\n", fConcurrentMs, fTotal / fConcurrentMs, nWalks);
+	printf("one lock     %10.1f ms  %10.1f ops/ms  (%u walks alongside)\n", fLockedMs, fTotal / fLockedMs, nLockedWalks);
+
+	// check the books
+	size_t nSum = 0;
+	crm.ForEach(AddSize, &nSum);
+	UINT nCount = 0;
+	ResCursor Cursor;
+	for(bool b = crm.GetFirst(Cursor, 0, 0); b; b = crm.GetNext(Cursor, 0, 0))
+		nCount++;
+
+	bool bOK = (nSum == crm.GetUsedMemory()) && (nSum <= nLimit) && (nCount == crm.GetNumResources()) && (nCount == nResources);
+	printf("\nresident     %10u bytes (manager says %u)  %u resources  %s\n",
+		(UINT)nSum, (UINT)crm.GetUsedMemory(), nCount, bOK ? "ok" : "MISMATCH");
+
+	return bOK ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+/* Copyright (C) James Boer, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) James Boer, 2000"
+ */
+//=============================================================================
+//
+// 	packbench.cpp - loose files vs. pack file loading benchmark
+//
+//	Writes a set of resource files to a scratch directory and packs the same
+//	data into one archive, then loads every resource (in a shuffled order)
+//	both ways: fopen/fread/fclose per file into its own buffer, and a hash
+//	lookup plus zero-copy PackResource from the mapped archive.  Both are
+//	checksummed to make sure they saw the same bytes.  Finally the packed
+//	resources are run through a ResManager with a tight limit, so Dispose()
+//	drops pages with madvise and Recreate() maps them back in.
+//
+//	usage: packbench [resources] [passes]
+//
+//=============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "PackFile.h"
+
+using namespace std;
+
+#define SCRATCH_DIR		"packbench.tmp"
+#define PACK_NAME		"packbench.pak"
+
+
+static unsigned int s_nSeed = 1;
+
+static UINT Random(UINT nRange)
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return ((s_nSeed >> 8) & 0xffffff) % nRange;
+}
+
+static unsigned int Checksum(const void* pData, size_t nSize)
+{
+	const unsigned char* p = (const unsigned char*)pData;
+	unsigned int nSum = 0;
+	for(size_t i = 0; i < nSize; i++)
+		nSum = nSum * 31 + p[i];
+	return nSum;
+}
+
+static double Elapsed(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char* argv[])
+{
+	UINT nResources = (argc > 1) ? atoi(argv[1]) : 2000;
+	UINT nPasses = (argc > 2) ? atoi(argv[2]) : 5;
+	if(nResources < 1)
+		nResources = 1;
+
+	// make the data - sizes from 1k to 64k
+	mkdir(SCRATCH_DIR, 0777);
+	vector<string> Names;
+	vector<string> Paths;
+	size_t nTotal = 0;
+	PackFileWriter Writer;
+	UINT i, nPass;
+	char Name[256];
+	for(i = 0; i < nResources; i++)
+	{
+		sprintf(Name, "textures/set%02u/tile%05u.raw", i % 32, i);
+		Names.push_back(Name);
+		sprintf(Name, SCRATCH_DIR "/tile%05u.raw", i);
+		Paths.push_back(Name);
+
+		vector<unsigned char> Data(1024 + Random(63 * 1024));
+		for(size_t j = 0; j < Data.size(); j++)
+			Data[j] = (unsigned char)Random(256);
+		nTotal += Data.size();
+
+		FILE* pFile = fopen(Paths[i].c_str(), "wb");
+		if(!pFile || (fwrite(&Data[0], 1, Data.size(), pFile) != Data.size()))
+		{
+			printf("can't write %s\n", Paths[i].c_str());
+			return 1;
+		}
+		fclose(pFile);
+		Writer.AddData(Names[i].c_str(), &Data[0], Data.size());
+	}
+	if(!Writer.Write(PACK_NAME))
+	{
+		printf("can't write " PACK_NAME "\n");
+		return 1;
+	}
+
+	vector<UINT> Order(nResources);
+	for(i = 0; i < nResources; i++)
+		Order[i] = i;
+	for(i = nResources; i > 1; i--)
+		swap(Order[i - 1], Order[Random(i)]);
+
+	printf("%u resources, %.1f MB, %u passes (files are in the page cache for both)\n\n",
+		nResources, nTotal / (1024.0 * 1024.0), nPasses);
+
+	// loose files
+	unsigned int nFileSum = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(nPass = 0; nPass < nPasses; nPass++)
+	{
+		for(i = 0; i < nResources; i++)
+		{
+			FILE* pFile = fopen(Paths[Order[i]].c_str(), "rb");
+			fseek(pFile, 0, SEEK_END);
+			long nSize = ftell(pFile);
+			fseek(pFile, 0, SEEK_SET);
+			vector<unsigned char> Data(nSize);
+			fread(&Data[0], 1, nSize, pFile);
+			fclose(pFile);
+			nFileSum += Checksum(&Data[0], 64) + nSize;
+		}
+	}
+	double fFileMs = Elapsed(start);
+
+	// pack file - opening it is part of the cost
+	unsigned int nPackSum = 0;
+	UINT nZeroCopy = 0;
+	start = chrono::steady_clock::now();
+	for(nPass = 0; nPass < nPasses; nPass++)
+	{
+		PackFile Pack;
+		Pack.Open(PACK_NAME);
+		for(i = 0; i < nResources; i++)
+		{
+			PackResource Res;
+			if(!Res.Create(&Pack, Names[Order[i]].c_str()))
+				continue;
+			if(Res.IsZeroCopy())
+				nZeroCopy++;
+			nPackSum += Checksum(Res.GetData(), 64) + Res.GetSize();
+		}
+	}
+	double fPackMs = Elapsed(start);
+
+	printf("loose files  %10.1f ms  %8.2f us/resource\n", fFileMs, fFileMs * 1000.0 / (nResources * nPasses));
+	printf("pack file    %10.1f ms  %8.2f us/resource  (%u zero-copy)\n", fPackMs, fPackMs * 1000.0 / (nResources * nPasses), nZeroCopy);
+	printf("checksums    %s\n", (nFileSum == nPackSum) ? "match" : "DIFFER");
+
+	// the same resources under the resource manager, with room for a
+	// quarter of them, so they're swapped in and out all the time
+	PackFile Pack;
+	Pack.Open(PACK_NAME);
+	ResManager rm;
+	rm.Create(nTotal / 4);
+	for(i = 0; i < nResources; i++)
+	{
+		PackResource* pRes = new PackResource;
+		pRes->Create(&Pack, Names[i].c_str());
+		rm.InsertResource(i + 1, pRes);
+	}
+
+	bool bOK = (nFileSum == nPackSum);
+	UINT nOps = nResources * nPasses * 4;
+	start = chrono::steady_clock::now();
+	for(i = 0; i < nOps; i++)
+	{
+		UINT n = (Random(100) < 80) ? Random(nResources / 5 + 1) : Random(nResources);
+		PackResource* pRes = (PackResource*)rm.GetResource(n + 1);
+		if(!pRes || (pRes->GetSize() != Pack.GetSize(n)) || (*(const unsigned char*)pRes->GetData() != *(const unsigned char*)Pack.GetData(n)))
+			bOK = false;
+	}
+	double fManagedMs = Elapsed(start);
+
+	printf("managed      %10.1f ms  %8.2f us/access  (limit %.1f MB, %.1f MB in use)\n",
+		fManagedMs, fManagedMs * 1000.0 / nOps, rm.GetMaximumMemory() / (1024.0 * 1024.0),
+		rm.GetUsedMemory() / (1024.0 * 1024.0));
+	if(!bOK)
+		printf("DATA MISMATCH\n");
+
+	rm.Destroy();
+	Pack.Close();
+
+	// clean up
+	for(i = 0; i < nResources; i++)
+		remove(Paths[i].c_str());
+	rmdir(SCRATCH_DIR);
+	remove(PACK_NAME);
+
+	return bOK ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/* Copyright (C) James Boer, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) James Boer, 2000"
+ */
+//=============================================================================
+//
+// 	resbench.cpp - resource manager eviction benchmark
+//
+//	Fills the manager with many resources, sets the memory limit well below
+//	their total size and then churns: resources are fetched (mostly from a
+//	hot set), locked and unlocked, and destroyed and replaced, so nearly
+//	every operation runs at the limit and has to swap something out.
+//
+//	Then it does the same with background streaming: a few worker threads
+//	reload resources asked for with TryLock() and Prefetch(), the main loop
+//	calls Update() every "frame", and the benchmark checks that the memory
+//	in use (including loads in flight) never goes over the limit.
+//
+//	usage: resbench [resources] [operations] [seed] [stream threads]
+//
+//=============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "ResourceManager.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// A resource that only pretends to hold data, so the benchmark measures the
+// manager and not the heap.  It counts how often it gets swapped in and out.
+
+class BenchResource : public BaseResource
+{
+public:
+	BenchResource(size_t nSize) : m_nSize(nSize), m_bLoaded(true)	{}
+
+	virtual void Dispose()			{  m_bLoaded = false;  s_nDisposals++;  }
+	virtual bool Recreate()
+	{
+		// pretend to read it from disk
+		if(s_nLoadMicroseconds)
+			std::this_thread::sleep_for(std::chrono::microseconds(s_nLoadMicroseconds));
+		m_bLoaded = true;
+		s_nRecreates++;
+		return true;
+	}
+	virtual size_t GetSize()		{  return m_bLoaded ? m_nSize : 0;  }
+	virtual bool IsDisposed()		{  return !m_bLoaded;  }
+
+	static UINT s_nDisposals;
+	static std::atomic<UINT> s_nRecreates;
+	static UINT s_nLoadMicroseconds;
+
+protected:
+	size_t	m_nSize;
+	bool	m_bLoaded;
+};
+
+UINT BenchResource::s_nDisposals = 0;
+std::atomic<UINT> BenchResource::s_nRecreates(0);
+UINT BenchResource::s_nLoadMicroseconds = 0;
+
+
+// simple repeatable random numbers
+static unsigned int s_nSeed = 1;
+
+static UINT Random(UINT nRange)
+{
+	s_nSeed = s_nSeed * 1103515245 + 12345;
+	return ((s_nSeed >> 8) & 0xffffff) % nRange;
+}
+
+// counts the callbacks from streamed loads
+static void StreamDone(RHANDLE /*rhUniqueID*/, BaseResource* /*pResource*/, bool bSuccess, void* pContext)
+{
+	if(bSuccess)
+		(*(UINT*)pContext)++;
+}
+
+static BenchResource* NewResource()
+{
+	BenchResource* pRes = new BenchResource(256 + Random(8192));
+	pRes->SetPriority((BaseResource::PriorityType)Random(3));
+	return pRes;
+}
+
+
+int main(int argc, char* argv[])
+{
+	UINT nResources = (argc > 1) ? atoi(argv[1]) : 100000;
+	UINT nOperations = (argc > 2) ? atoi(argv[2]) : 1000000;
+	s_nSeed = (argc > 3) ? atoi(argv[3]) : 1;
+	UINT nThreads = (argc > 4) ? atoi(argv[4]) : 2;
+
+	if(nResources < 16)
+		nResources = 16;
+
+	// a quarter of the average total fits
+	size_t nLimit = (size_t)nResources * (256 + 8192 / 2) / 4;
+
+	ResManager rm;
+	rm.Create(nLimit);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// fill it - handles are 1..nResources
+	UINT i;
+	for(i = 1; i <= nResources; i++)
+		rm.InsertResource(i, NewResource());
+
+	double fFillMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// churn.  a few resources stay locked at any time, the oldest lock is
+	// released when a new one is taken
+	const UINT nMaxLocks = 64;
+	RHANDLE Locked[nMaxLocks];
+	UINT nLockCount = 0, nLockNext = 0;
+	UINT nGets = 0, nLocks = 0, nReplaces = 0;
+
+	start = std::chrono::steady_clock::now();
+
+	for(i = 0; i < nOperations; i++)
+	{
+		// 80% of accesses go to the first 20% of handles
+		RHANDLE rh = (Random(100) < 80) ? 1 + Random(nResources / 5) : 1 + Random(nResources);
+		UINT nAction = Random(100);
+
+		if(nAction < 70)
+		{
+			rm.GetResource(rh);
+			nGets++;
+		}
+		else if(nAction < 85)
+		{
+			if(nLockCount == nMaxLocks)
+				rm.Unlock(Locked[nLockNext]);
+			else
+				nLockCount++;
+			Locked[nLockNext] = rh;
+			nLockNext = (nLockNext + 1) % nMaxLocks;
+			rm.Lock(rh);
+			nLocks++;
+		}
+		else
+		{
+			// replace it, unless it's locked
+			if(rm.DestroyResource(rh))
+			{
+				rm.InsertResource(rh, NewResource());
+				nReplaces++;
+			}
+		}
+	}
+
+	double fChurnMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// release the locks and check the budget held
+	for(i = 0; i < nLockCount; i++)
+		rm.Unlock(Locked[i]);
+
+	size_t nUsed = 0;
+	UINT nLoaded = 0;
+	for(rm.GotoBegin(); rm.IsValid(); rm.GotoNext())
+	{
+		nUsed += rm.GetCurrentResource()->GetSize();
+		if(!rm.GetCurrentResource()->IsDisposed())
+			nLoaded++;
+	}
+
+	printf("%u resources, limit %u bytes, %u operations\n\n", nResources, (UINT)nLimit, nOperations);
+	printf("fill         %10.1f ms\n", fFillMs);
+	printf("churn        %10.1f ms  %10.1f ops/ms  (%u gets, %u locks, %u replaces)\n",
+		fChurnMs, nOperations / fChurnMs, nGets, nLocks, nReplaces);
+	printf("swapped      %10u out  %10u in\n", BenchResource::s_nDisposals, (UINT)BenchResource::s_nRecreates);
+	printf("resident     %10u resources, %u bytes%s\n", nLoaded, (UINT)nUsed,
+		(nUsed <= nLimit) ? "" : "  OVER LIMIT");
+
+	bool bOK = (nUsed <= nLimit);
+
+	// streaming.  each frame asks for a handful of resources with TryLock
+	// (a miss starts a background load and the frame moves on), prefetches
+	// a few it expects to want soon, and unlocks what it locked last frame.
+	// loads take a while, as if they came off disk, and so does the rest of
+	// the frame, which is when the workers get their time.
+	if(nThreads)
+	{
+		BenchResource::s_nLoadMicroseconds = 50;
+		rm.StartStreaming(nThreads);
+
+		const UINT nPerFrame = 16;
+		RHANDLE FrameLocks[nPerFrame];
+		UINT nFrameLocks = 0;
+		const UINT nFrameMicroseconds = 500;
+		UINT nFrames = nOperations / nPerFrame / 50;
+		UINT nHits = 0, nMisses = 0, nPrefetches = 0, nCallbacks = 0, nFinished = 0;
+		size_t nPeak = 0;
+		UINT nRecreates = BenchResource::s_nRecreates;
+
+		start = std::chrono::steady_clock::now();
+
+		for(UINT nFrame = 0; nFrame < nFrames; nFrame++)
+		{
+			for(i = 0; i < nFrameLocks; i++)
+				rm.Unlock(FrameLocks[i]);
+			nFrameLocks = 0;
+
+			for(i = 0; i < nPerFrame; i++)
+			{
+				RHANDLE rh = (Random(100) < 80) ? 1 + Random(nResources / 5) : 1 + Random(nResources);
+				if(Random(4) == 0)
+				{
+					if(rm.Prefetch(rh, StreamDone, &nCallbacks))
+						nPrefetches++;
+				}
+				else if(rm.TryLock(rh))
+				{
+					FrameLocks[nFrameLocks++] = rh;
+					nHits++;
+				}
+				else
+					nMisses++;
+
+				if(rm.GetUsedMemory() > nPeak)
+					nPeak = rm.GetUsedMemory();
+			}
+
+			std::this_thread::sleep_for(std::chrono::microseconds(nFrameMicroseconds));
+			nFinished += rm.Update();
+		}
+
+		for(i = 0; i < nFrameLocks; i++)
+			rm.Unlock(FrameLocks[i]);
+		rm.StopStreaming();
+		nFinished += rm.Update();	// the callbacks for what StopStreaming finished
+
+		double fStreamMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		nUsed = 0;
+		for(rm.GotoBegin(); rm.IsValid(); rm.GotoNext())
+			nUsed += rm.GetCurrentResource()->GetSize();
+
+		printf("\nstreaming with %u thread%s, %u frames of %u requests\n\n", nThreads, (nThreads == 1) ? "" : "s", nFrames, nPerFrame);
+		printf("frames       %10.1f ms  %10.2f ms/frame\n", fStreamMs, fStreamMs / nFrames);
+		printf("trylock      %10u hits  %10u misses\n", nHits, nMisses);
+		printf("loads        %10u done  %10u finished by Update  (%u prefetches, %u callbacks)\n",
+			(UINT)BenchResource::s_nRecreates - nRecreates, nFinished, nPrefetches, nCallbacks);
+		printf("peak         %10u bytes%s\n", (UINT)nPeak, (nPeak <= nLimit) ? "" : "  OVER LIMIT");
+		printf("resident     %10u bytes%s\n", (UINT)nUsed, (nUsed <= nLimit) ? "" : "  OVER LIMIT");
+
+		bOK = bOK && (nPeak <= nLimit) && (nUsed <= nLimit) && (nUsed == rm.GetUsedMemory());
+	}
+
+	return bOK ? 0 : 1;
+}
@@ -9,6 +9,7 @@
  */
 #include <stdio.h>
 #include <memory.h>
+#include "inflatereader.h"
 
 #ifndef TRUE
 #define TRUE 1
@@ -23,11 +24,14 @@ public:
 	bool Save(char *fileName);
 	bool Load(char *fileName);
 	bool BufferedLoad(char *fileName);
+	bool CompressedLoad(char *fileName);
 	// Add accessors to get to your game data.
 private:
 	// Only open one file at a time.
 	static FILE *fileDescriptor;
-	// Game data goes here.
+	// Game data goes here. It has to be flat, with no pointers, since
+	// it is read straight in. For data with pointers use a game image
+	// (gameimage.h), which is fixed up after it is loaded.
 	int data[1000]; // Replace this with your data format.
 };
 
@@ -102,3 +106,18 @@ bool GameData::BufferedLoad(char *fileName)
 	}
 }
 
+// Loads a zlib compressed save. The data is inflated straight into the
+// object as it is read, so there is no full size staging buffer.
+bool GameData::CompressedLoad(char *fileName)
+{
+	InflateReader reader;
+	if(!reader.Open(fileName))
+	{
+		// Report an error reading the file.
+		return FALSE;
+	}
+	bool ok = reader.Read(this, sizeof(GameData)) == sizeof(GameData);
+	reader.Close();
+	// Report whether it all came through.
+	return ok;
+}
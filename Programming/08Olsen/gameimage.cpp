@@ -0,0 +1,279 @@
+/* Copyright (C) John Olsen, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) John Olsen, 2000"
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "gameimage.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+
+GameImageWriter::GameImageWriter()
+{
+	buffer = 0;
+	size = 0;
+	capacity = 0;
+	fixups = 0;
+	fixupCount = 0;
+	fixupCapacity = 0;
+}
+
+GameImageWriter::~GameImageWriter()
+{
+	free(buffer);
+	free(fixups);
+}
+
+unsigned int GameImageWriter::Alloc(unsigned int blockSize, unsigned int align)
+{
+	unsigned int offset = (size + align - 1) & ~(align - 1);
+	if(offset + blockSize > capacity)
+	{
+		// Grow by doubling so building a big image stays cheap. The new
+		// space is zeroed, so pointers nobody sets stay null.
+		unsigned int newCapacity = capacity ? capacity * 2 : 4096;
+		while(newCapacity < offset + blockSize)
+		{
+			newCapacity *= 2;
+		}
+		buffer = (char *)realloc(buffer, newCapacity);
+		memset(buffer + capacity, 0, newCapacity - capacity);
+		capacity = newCapacity;
+	}
+	size = offset + blockSize;
+	return offset;
+}
+
+unsigned int GameImageWriter::AllocString(const char *string)
+{
+	unsigned int length = strlen(string) + 1;
+	unsigned int offset = Alloc(length, 1);
+	memcpy(buffer + offset, string, length);
+	return offset;
+}
+
+void GameImageWriter::SetPointer(unsigned int pointerAt, unsigned int target)
+{
+	// Store the distance from the pointer to its target.
+	ptrdiff_t relative = (ptrdiff_t)target - (ptrdiff_t)pointerAt;
+	memcpy(buffer + pointerAt, &relative, sizeof(relative));
+
+	if(fixupCount == fixupCapacity)
+	{
+		fixupCapacity = fixupCapacity ? fixupCapacity * 2 : 256;
+		fixups = (unsigned int *)realloc(fixups, fixupCapacity * sizeof(unsigned int));
+	}
+	fixups[fixupCount++] = pointerAt;
+}
+
+void GameImageWriter::SetNull(unsigned int pointerAt)
+{
+	// Null pointers are stored as 0 and need no fixup.
+	memset(buffer + pointerAt, 0, sizeof(void *));
+}
+
+bool GameImageWriter::Save(char *fileName)
+{
+	// Pad the image so the fixup table after it is aligned.
+	Alloc(0, 8);
+
+	GameImageHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = GAMEIMAGE_MAGIC;
+	header.version = GAMEIMAGE_VERSION;
+	header.pointerSize = sizeof(void *);
+	header.imageSize = size;
+	header.fixupCount = fixupCount;
+
+	FILE *file = fopen(fileName, "wb");
+	if(!file)
+	{
+		// Report an error writing the file.
+		return FALSE;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	if(ok && size)
+	{
+		ok = fwrite(buffer, size, 1, file) == 1;
+	}
+	if(ok && fixupCount)
+	{
+		ok = fwrite(fixups, sizeof(unsigned int), fixupCount, file) == fixupCount;
+	}
+	if(fclose(file) != 0)
+	{
+		ok = FALSE;
+	}
+	return ok;
+}
+
+
+GameImage::GameImage()
+{
+	root = 0;
+	imageSize = 0;
+	mapping = 0;
+	mappingSize = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = 0;
+#endif
+}
+
+GameImage::~GameImage()
+{
+	Unload();
+}
+
+bool GameImage::Load(char *fileName)
+{
+	Unload();
+
+#ifdef _WIN32
+	fileHandle = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if(fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return FALSE;
+	}
+	mappingSize = GetFileSize(fileHandle, 0);
+	// Copy-on-write, so fixing up pointers doesn't touch the file.
+	mappingHandle = CreateFileMapping(fileHandle, 0, PAGE_WRITECOPY, 0, 0, 0);
+	if(mappingHandle)
+	{
+		mapping = MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+	}
+	if(!mapping)
+	{
+		Unload();
+		return FALSE;
+	}
+#else
+	int file = open(fileName, O_RDONLY);
+	if(file < 0)
+	{
+		return FALSE;
+	}
+	struct stat info;
+	if(fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(GameImageHeader))
+	{
+		close(file);
+		return FALSE;
+	}
+	mappingSize = info.st_size;
+	// Copy-on-write, so fixing up pointers doesn't touch the file.
+	mapping = mmap(0, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	close(file);
+	if(mapping == MAP_FAILED)
+	{
+		mapping = 0;
+		mappingSize = 0;
+		return FALSE;
+	}
+#endif
+
+	if(!Relocate((char *)mapping, mappingSize))
+	{
+		Unload();
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool GameImage::Attach(void *fileData, unsigned int fileSize)
+{
+	Unload();
+	return Relocate((char *)fileData, fileSize);
+}
+
+void GameImage::Unload()
+{
+#ifdef _WIN32
+	if(mapping)
+	{
+		UnmapViewOfFile(mapping);
+	}
+	if(mappingHandle)
+	{
+		CloseHandle(mappingHandle);
+	}
+	if(fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+	}
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = 0;
+#else
+	if(mapping)
+	{
+		munmap(mapping, mappingSize);
+	}
+#endif
+	mapping = 0;
+	mappingSize = 0;
+	root = 0;
+	imageSize = 0;
+}
+
+bool GameImage::Relocate(char *fileData, unsigned int fileSize)
+{
+	// Check the header and that everything it describes is in the file.
+	GameImageHeader *header = (GameImageHeader *)fileData;
+	if(fileSize < sizeof(GameImageHeader) ||
+		header->magic != GAMEIMAGE_MAGIC ||
+		header->version != GAMEIMAGE_VERSION ||
+		header->pointerSize != sizeof(void *) ||
+		(unsigned long long)sizeof(GameImageHeader) + header->imageSize +
+			(unsigned long long)header->fixupCount * sizeof(unsigned int) > fileSize)
+	{
+		return FALSE;
+	}
+
+	char *image = fileData + sizeof(GameImageHeader);
+	unsigned int *fixups = (unsigned int *)(image + header->imageSize);
+
+	// The one pass: each pointer holds the distance to its target, so add
+	// its own address to it. Anything that would point outside the image
+	// means the file is bad.
+	for(unsigned int i = 0; i < header->fixupCount; i++)
+	{
+		unsigned int at = fixups[i];
+		if(at % sizeof(void *) != 0 || at + sizeof(void *) > header->imageSize)
+		{
+			return FALSE;
+		}
+		ptrdiff_t relative = *(ptrdiff_t *)(image + at);
+		ptrdiff_t target = (ptrdiff_t)at + relative;
+		if(target < 0 || target > (ptrdiff_t)header->imageSize)
+		{
+			return FALSE;
+		}
+		*(char **)(image + at) = image + target;
+	}
+
+	root = image;
+	imageSize = header->imageSize;
+	return TRUE;
+}
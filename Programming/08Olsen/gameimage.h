@@ -0,0 +1,115 @@
+/* Copyright (C) John Olsen, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) John Olsen, 2000"
+ */
+#ifndef GAMEIMAGE_H
+#define GAMEIMAGE_H
+
+// Relocatable game data images.
+//
+// GameData::Load reads an object straight into memory, which only works
+// when the object has no pointers in it. A game image can hold any mix of
+// structures, arrays and strings that point at each other. In the file each
+// pointer is stored as an offset from the pointer itself, and a fixup table
+// lists where every pointer is. Loading maps the file into memory and makes
+// one pass over the fixup table, turning the offsets back into real
+// pointers. After that the data is used right where it is, with no copying.
+//
+// The mapping is copy-on-write, so only the pages that have pointers on
+// them get copied when they are fixed up. The rest is shared with the
+// file cache.
+//
+// File layout:
+//
+//	GameImageHeader
+//	image data (the root object is first)
+//	fixup table, one unsigned int image offset per pointer
+
+#define GAMEIMAGE_MAGIC 0x474d4947 // "GIMG"
+#define GAMEIMAGE_VERSION 1
+
+struct GameImageHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int pointerSize; // Images only load where pointers are this size.
+	unsigned int imageSize;
+	unsigned int fixupCount;
+	unsigned int reserved[3]; // Keeps the image 8 byte aligned.
+};
+
+
+// Builds an image. Allocate space for each object, fill it in through At(),
+// and use SetPointer() for every pointer field.
+class GameImageWriter
+{
+public:
+	GameImageWriter();
+	~GameImageWriter();
+
+	// Returns the offset of a new zeroed block. The first block allocated
+	// is the root.
+	unsigned int Alloc(unsigned int size, unsigned int align = 8);
+	// Copies a string into the image and returns its offset.
+	unsigned int AllocString(const char *string);
+
+	// Where an offset is in the image being built. This moves when Alloc
+	// is called, so don't hold on to it.
+	void *At(unsigned int offset) { return buffer + offset; }
+
+	// Makes the pointer at offset pointerAt point to offset target.
+	void SetPointer(unsigned int pointerAt, unsigned int target);
+	// Leaves the pointer at pointerAt null.
+	void SetNull(unsigned int pointerAt);
+
+	bool Save(char *fileName);
+
+private:
+	char *buffer;
+	unsigned int size;
+	unsigned int capacity;
+	unsigned int *fixups;
+	unsigned int fixupCount;
+	unsigned int fixupCapacity;
+};
+
+
+// A loaded image.
+class GameImage
+{
+public:
+	GameImage();
+	~GameImage();
+
+	// Maps the file and relocates it in place.
+	bool Load(char *fileName);
+
+	// Relocates a whole image file that is already in memory, for example
+	// one read with fread. The memory must stay around while the image is
+	// used, and it is changed by the relocation.
+	bool Attach(void *fileData, unsigned int fileSize);
+
+	void Unload();
+
+	void *GetRoot() { return root; }
+	unsigned int GetSize() { return imageSize; }
+
+private:
+	bool Relocate(char *fileData, unsigned int fileSize);
+
+	char *root;
+	unsigned int imageSize;
+	void *mapping;
+	unsigned int mappingSize;
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#endif
+};
+
+#endif
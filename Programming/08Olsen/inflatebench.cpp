@@ -0,0 +1,303 @@
+/* Copyright (C) John Olsen, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) John Olsen, 2000"
+ */
+// Compressed loading benchmark.
+//
+// Makes some game data, saves it both raw and zlib compressed, then loads
+// it four ways:
+//
+//	raw	fread the uncompressed file, for comparison
+//	staged	fread the whole compressed file into a staging buffer, then
+//		inflate it in one go
+//	stream	InflateReader, with its reading thread
+//	stream1	InflateReader, reading each chunk itself when it needs it
+//
+// The libpng zlib only inflates, so this has its own small compressor
+// (LZ77 with the fixed Huffman codes). It doesn't compress as well as
+// real zlib, but the output is a proper zlib stream.
+//
+//	g++ -O2 -I../../Polygonal/05Kaiser/libpng/src/zlib inflatebench.cpp
+//		inflatereader.cpp ../../Polygonal/05Kaiser/libpng/src/zlib/*.c
+//	inflatebench [megabytes] [loads] [chunk size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "inflatereader.h"
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+
+// Writes bits to a buffer, lowest bit first, the way deflate wants.
+struct BitWriter
+{
+	unsigned char *out;
+	unsigned int length;
+	unsigned int bits;
+	int bitCount;
+
+	void Put(unsigned int value, int count)
+	{
+		bits |= value << bitCount;
+		bitCount += count;
+		while(bitCount >= 8)
+		{
+			out[length++] = (unsigned char)bits;
+			bits >>= 8;
+			bitCount -= 8;
+		}
+	}
+
+	// Huffman codes go in highest bit first.
+	void PutCode(unsigned int code, int count)
+	{
+		unsigned int reversed = 0;
+		for(int i = 0; i < count; i++)
+		{
+			reversed = (reversed << 1) | ((code >> i) & 1);
+		}
+		Put(reversed, count);
+	}
+};
+
+static const unsigned int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const int distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static void PutSymbol(BitWriter &writer, unsigned int symbol)
+{
+	// The fixed literal/length code.
+	if(symbol < 144)
+	{
+		writer.PutCode(0x30 + symbol, 8);
+	}
+	else if(symbol < 256)
+	{
+		writer.PutCode(0x190 + symbol - 144, 9);
+	}
+	else if(symbol < 280)
+	{
+		writer.PutCode(symbol - 256, 7);
+	}
+	else
+	{
+		writer.PutCode(0xc0 + symbol - 280, 8);
+	}
+}
+
+// Compresses data into a zlib stream. out needs room for size * 9 / 8
+// plus a little.
+static unsigned int Compress(const unsigned char *data, unsigned int size, unsigned char *out)
+{
+	const int hashBits = 15;
+	unsigned int *head = new unsigned int[1 << hashBits];
+	memset(head, 0xff, sizeof(unsigned int) << hashBits);
+
+	BitWriter writer = { out, 0, 0, 0 };
+	writer.Put(0x78, 8);
+	writer.Put(0x01, 8);
+	writer.Put(1, 1); // Last block.
+	writer.Put(1, 2); // Fixed Huffman codes.
+
+	unsigned int i = 0;
+	while(i < size)
+	{
+		unsigned int matchLength = 0;
+		unsigned int matchDistance = 0;
+		if(i + 3 <= size)
+		{
+			unsigned int hash = ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - hashBits);
+			unsigned int candidate = head[hash];
+			head[hash] = i;
+			if(candidate != 0xffffffff && i - candidate <= 32768)
+			{
+				unsigned int limit = size - i < 258 ? size - i : 258;
+				while(matchLength < limit && data[candidate + matchLength] == data[i + matchLength])
+				{
+					matchLength++;
+				}
+				matchDistance = i - candidate;
+			}
+		}
+
+		if(matchLength < 3)
+		{
+			PutSymbol(writer, data[i]);
+			i++;
+			continue;
+		}
+
+		int code = 28;
+		while(lengthBase[code] > matchLength)
+		{
+			code--;
+		}
+		PutSymbol(writer, 257 + code);
+		writer.Put(matchLength - lengthBase[code], lengthExtra[code]);
+
+		code = 29;
+		while(distanceBase[code] > matchDistance)
+		{
+			code--;
+		}
+		writer.PutCode(code, 5);
+		writer.Put(matchDistance - distanceBase[code], distanceExtra[code]);
+
+		i += matchLength;
+	}
+
+	PutSymbol(writer, 256); // End of block.
+	writer.Put(0, 7); // Flush to a byte.
+	writer.bitCount = 0;
+
+	unsigned int check = adler32(adler32(0, Z_NULL, 0), data, size);
+	out[writer.length++] = (unsigned char)(check >> 24);
+	out[writer.length++] = (unsigned char)(check >> 16);
+	out[writer.length++] = (unsigned char)(check >> 8);
+	out[writer.length++] = (unsigned char)check;
+
+	delete [] head;
+	return writer.length;
+}
+
+// Something like a level: records with ids, positions, flags and names,
+// which repeat a lot but not exactly.
+static void MakeGameData(unsigned char *data, unsigned int size)
+{
+	unsigned int seed = 1;
+	unsigned int i = 0;
+	char record[64];
+	while(i < size)
+	{
+		seed = seed * 1103515245 + 12345;
+		int length = sprintf(record, "obj%05u pos %4u %4u %3u hp %3u flags %02x ",
+			i / 48, (seed >> 8) % 4096, (seed >> 12) % 4096, (seed >> 4) % 256,
+			100 + (seed >> 16) % 4, (seed >> 20) & 3);
+		for(int j = 0; j < length && i < size; j++)
+		{
+			data[i++] = record[j];
+		}
+	}
+}
+
+static double Elapsed(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool WriteFile(char *fileName, const void *data, unsigned int size)
+{
+	FILE *file = fopen(fileName, "wb");
+	if(!file)
+	{
+		return FALSE;
+	}
+	bool ok = fwrite(data, 1, size, file) == size;
+	return fclose(file) == 0 && ok;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int size = (argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+	unsigned int loads = argc > 2 ? atoi(argv[2]) : 5;
+	unsigned int chunkSize = argc > 3 ? atoi(argv[3]) : 65536;
+	char rawName[] = "inflatebench.raw";
+	char packedName[] = "inflatebench.z";
+
+	unsigned char *data = new unsigned char[size];
+	MakeGameData(data, size);
+	unsigned char *packed = new unsigned char[size + size / 8 + 64];
+	unsigned int packedSize = Compress(data, size, packed);
+	if(!WriteFile(rawName, data, size) || !WriteFile(packedName, packed, packedSize))
+	{
+		printf("Could not write the test files.\n");
+		return 1;
+	}
+	delete [] packed;
+
+	printf("%.1f MB of data, %.1f MB compressed, %u loads, %u byte chunks (files are in the cache)\n\n",
+		size / (1024.0 * 1024.0), packedSize / (1024.0 * 1024.0), loads, chunkSize);
+
+	unsigned char *destination = new unsigned char[size];
+	double times[4] = { 0, 0, 0, 0 };
+	bool ok = TRUE;
+
+	for(unsigned int pass = 0; pass < loads; pass++)
+	{
+		// Raw.
+		memset(destination, 0, size);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		FILE *file = fopen(rawName, "rb");
+		ok = fread(destination, 1, size, file) == size && ok;
+		fclose(file);
+		times[0] += Elapsed(start);
+		ok = memcmp(destination, data, size) == 0 && ok;
+
+		// Staged.
+		memset(destination, 0, size);
+		start = std::chrono::steady_clock::now();
+		unsigned char *staging = new unsigned char[packedSize];
+		file = fopen(packedName, "rb");
+		ok = fread(staging, 1, packedSize, file) == packedSize && ok;
+		fclose(file);
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		inflateInit(&stream);
+		stream.next_in = staging;
+		stream.avail_in = packedSize;
+		stream.next_out = destination;
+		stream.avail_out = size;
+		ok = inflate(&stream, Z_FINISH) == Z_STREAM_END && ok;
+		inflateEnd(&stream);
+		delete [] staging;
+		times[1] += Elapsed(start);
+		ok = memcmp(destination, data, size) == 0 && ok;
+
+		// Streamed, with and without the reading thread.
+		for(int threaded = 1; threaded >= 0; threaded--)
+		{
+			memset(destination, 0, size);
+			start = std::chrono::steady_clock::now();
+			InflateReader reader;
+			ok = reader.Open(packedName, chunkSize, threaded != 0) && ok;
+			ok = reader.Read(destination, size) == size && ok;
+			// One more byte to reach the end of the stream.
+			unsigned char extra;
+			ok = reader.Read(&extra, 1) == 0 && reader.IsEnd() && ok;
+			reader.Close();
+			times[3 - threaded] += Elapsed(start);
+			ok = memcmp(destination, data, size) == 0 && ok;
+		}
+	}
+
+	const char *names[4] = { "raw", "staged", "stream", "stream1" };
+	for(int i = 0; i < 4; i++)
+	{
+		printf("%-8s %9.2f ms  %7.1f MB/s\n", names[i], times[i] / loads,
+			size / (1024.0 * 1024.0) / (times[i] / loads / 1000.0));
+	}
+	printf("\n%s\n", ok ? "All loads match." : "LOADS DIFFER");
+
+	delete [] destination;
+	delete [] data;
+	remove(rawName);
+	remove(packedName);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/* Copyright (C) John Olsen, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) John Olsen, 2000"
+ */
+#include <string.h>
+#include "inflatereader.h"
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+
+InflateReader::InflateReader()
+{
+	file = 0;
+	state = STATE_CLOSED;
+	chunkSize = 0;
+	for(int i = 0; i < CHUNK_COUNT; i++)
+	{
+		chunks[i].data = 0;
+		chunks[i].size = 0;
+		chunks[i].last = FALSE;
+		chunks[i].error = FALSE;
+	}
+	useThread = FALSE;
+	readIndex = 0;
+	filled = 0;
+	holding = FALSE;
+	quit = FALSE;
+	inputDone = FALSE;
+	readError = FALSE;
+}
+
+InflateReader::~InflateReader()
+{
+	Close();
+}
+
+bool InflateReader::Open(char *fileName, unsigned int size, bool threaded)
+{
+	Close();
+
+	file = fopen(fileName, "rb");
+	if(!file)
+	{
+		return FALSE;
+	}
+
+	memset(&stream, 0, sizeof(stream));
+	if(inflateInit(&stream) != Z_OK)
+	{
+		fclose(file);
+		file = 0;
+		return FALSE;
+	}
+
+	chunkSize = size;
+	for(int i = 0; i < CHUNK_COUNT; i++)
+	{
+		chunks[i].data = new unsigned char[chunkSize];
+		chunks[i].size = 0;
+		chunks[i].last = FALSE;
+	}
+	readIndex = 0;
+	filled = 0;
+	holding = FALSE;
+	quit = FALSE;
+	inputDone = FALSE;
+	readError = FALSE;
+	state = STATE_OK;
+
+	// Start reading ahead right away.
+	useThread = threaded;
+	if(useThread)
+	{
+		thread = std::thread(&InflateReader::ReadThread, this);
+	}
+	return TRUE;
+}
+
+void InflateReader::Close()
+{
+	if(state == STATE_CLOSED)
+	{
+		return;
+	}
+
+	if(useThread)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			quit = TRUE;
+		}
+		chunkFree.notify_one();
+		thread.join();
+	}
+
+	inflateEnd(&stream);
+	fclose(file);
+	file = 0;
+	for(int i = 0; i < CHUNK_COUNT; i++)
+	{
+		delete [] chunks[i].data;
+		chunks[i].data = 0;
+	}
+	state = STATE_CLOSED;
+}
+
+unsigned int InflateReader::ReadChunk(Chunk *chunk)
+{
+	chunk->size = fread(chunk->data, 1, chunkSize, file);
+	chunk->last = chunk->size < chunkSize;
+	chunk->error = ferror(file) != 0;
+	return chunk->size;
+}
+
+void InflateReader::ReadThread()
+{
+	unsigned int writeIndex = 0;
+	for(;;)
+	{
+		// Wait for a free chunk.
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while(!quit && filled == CHUNK_COUNT)
+			{
+				chunkFree.wait(guard);
+			}
+			if(quit)
+			{
+				return;
+			}
+		}
+
+		// The chunk is ours until it's counted as filled.
+		Chunk *chunk = &chunks[writeIndex];
+		ReadChunk(chunk);
+		writeIndex = (writeIndex + 1) % CHUNK_COUNT;
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			filled++;
+		}
+		chunkReady.notify_one();
+
+		if(chunk->last)
+		{
+			return;
+		}
+	}
+}
+
+bool InflateReader::NextChunk()
+{
+	Chunk *chunk;
+
+	if(!useThread)
+	{
+		// Read it ourselves, into the one chunk.
+		chunk = &chunks[0];
+		ReadChunk(chunk);
+	}
+	else
+	{
+		std::unique_lock<std::mutex> guard(lock);
+
+		// Give back the chunk inflate just finished with.
+		if(holding)
+		{
+			holding = FALSE;
+			readIndex = (readIndex + 1) % CHUNK_COUNT;
+			filled--;
+			chunkFree.notify_one();
+		}
+
+		while(filled == 0)
+		{
+			chunkReady.wait(guard);
+		}
+		holding = TRUE;
+		chunk = &chunks[readIndex];
+	}
+
+	stream.next_in = chunk->data;
+	stream.avail_in = chunk->size;
+	readError = chunk->error;
+	return !chunk->last;
+}
+
+unsigned int InflateReader::Read(void *destination, unsigned int size)
+{
+	if(state != STATE_OK)
+	{
+		return 0;
+	}
+
+	// Inflate straight into the caller's buffer.
+	stream.next_out = (Bytef *)destination;
+	stream.avail_out = size;
+
+	while(stream.avail_out > 0)
+	{
+		if(stream.avail_in == 0 && !inputDone)
+		{
+			inputDone = !NextChunk();
+		}
+
+		int result = inflate(&stream, Z_NO_FLUSH);
+		if(result == Z_STREAM_END)
+		{
+			state = STATE_END;
+			break;
+		}
+		if(result == Z_BUF_ERROR && stream.avail_in == 0 && !inputDone)
+		{
+			// It needs more input.
+			continue;
+		}
+		if(result != Z_OK || readError)
+		{
+			// Bad data, a read error, or the file ended too soon.
+			state = STATE_ERROR;
+			break;
+		}
+	}
+
+	return size - stream.avail_out;
+}
@@ -0,0 +1,96 @@
+/* Copyright (C) John Olsen, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) John Olsen, 2000"
+ */
+#ifndef INFLATEREADER_H
+#define INFLATEREADER_H
+
+// Streaming loader for compressed game data.
+//
+// Reads a zlib compressed file and inflates it straight into the caller's
+// buffers, a fixed size chunk of the file at a time. A second thread reads
+// the next chunks from disk while this one inflates, so reading and
+// decompressing overlap, and the compressed file is never held in memory
+// all at once.
+//
+// This uses the zlib inflater that comes with libpng, in
+// Polygonal/05Kaiser/libpng/src/zlib. Put that directory on the include
+// path and build its .c files in with the game.
+
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "zlib.h"
+
+class InflateReader
+{
+public:
+	InflateReader();
+	~InflateReader();
+
+	// Opens a zlib format file. chunkSize is how much is read at a time.
+	// Without the reading thread, chunks are read when they are needed.
+	bool Open(char *fileName, unsigned int chunkSize = 65536, bool threaded = true);
+	void Close();
+
+	// Inflates up to size bytes into destination and returns how many it
+	// got. That is only less than size at the end of the data or on an
+	// error, and IsEnd() or IsError() says which.
+	unsigned int Read(void *destination, unsigned int size);
+
+	bool IsEnd() { return state == STATE_END; }
+	bool IsError() { return state == STATE_ERROR; }
+
+private:
+	enum
+	{
+		CHUNK_COUNT = 4 // Chunks the reading thread can get ahead by.
+	};
+	enum
+	{
+		STATE_CLOSED,
+		STATE_OK,
+		STATE_END,
+		STATE_ERROR
+	};
+
+	struct Chunk
+	{
+		unsigned char *data;
+		unsigned int size;
+		bool last; // End of the file, or a read error.
+		bool error;
+	};
+
+	void ReadThread();
+	unsigned int ReadChunk(Chunk *chunk);
+	bool NextChunk();
+
+	FILE *file;
+	z_stream stream;
+	int state;
+	unsigned int chunkSize;
+	Chunk chunks[CHUNK_COUNT];
+	bool inputDone; // Every chunk has been handed to inflate.
+	bool readError;
+
+	// Shared with the reading thread. Chunks from readIndex for filled
+	// chunks are ready, the rest are the reading thread's to fill.
+	bool useThread;
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable chunkReady;
+	std::condition_variable chunkFree;
+	unsigned int readIndex;
+	unsigned int filled;
+	bool holding; // Inflate is using chunks[readIndex].
+	bool quit;
+};
+
+#endif
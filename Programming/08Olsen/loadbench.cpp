@@ -0,0 +1,228 @@
+/* Copyright (C) John Olsen, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) John Olsen, 2000"
+ */
+// Loader benchmark.
+//
+// Builds a level full of pointers (entities with names, paths and targets)
+// as a game image, then loads it over and over three ways:
+//
+//	fread	read the whole file into a new buffer, like GameData::Load
+//	memcpy	read it into a temporary buffer and copy it into place, like
+//		GameData::BufferedLoad
+//	mmap	map the file and relocate it in place
+//
+// All three relocate and then walk the whole level, so each one's data is
+// really used. The walk sums everything so we know they all saw the same
+// level.
+//
+//	loadbench [entities] [loads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <chrono>
+#include "gameimage.h"
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define READ_GRANULARITY 2048
+
+struct Waypoint
+{
+	float x, y, z;
+};
+
+struct Entity
+{
+	char *name;
+	Waypoint *path;
+	Entity *target; // Null if it isn't after anything.
+	unsigned int pathLength;
+	int health;
+};
+
+struct Level
+{
+	char *name;
+	Entity *entities;
+	unsigned int entityCount;
+};
+
+static unsigned int seed = 1;
+
+static unsigned int Random(unsigned int range)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) & 0xffffff) % range;
+}
+
+static bool BuildLevel(char *fileName, unsigned int entityCount)
+{
+	GameImageWriter writer;
+	char name[64];
+
+	unsigned int level = writer.Alloc(sizeof(Level));
+	writer.SetPointer(level + offsetof(Level, name), writer.AllocString("benchmark level"));
+	unsigned int entities = writer.Alloc(entityCount * sizeof(Entity));
+	writer.SetPointer(level + offsetof(Level, entities), entities);
+	((Level *)writer.At(level))->entityCount = entityCount;
+
+	for(unsigned int i = 0; i < entityCount; i++)
+	{
+		unsigned int entity = entities + i * sizeof(Entity);
+		sprintf(name, "entity_%u", i);
+		writer.SetPointer(entity + offsetof(Entity, name), writer.AllocString(name));
+
+		unsigned int pathLength = Random(17);
+		unsigned int path = writer.Alloc(pathLength * sizeof(Waypoint), 4);
+		for(unsigned int j = 0; j < pathLength; j++)
+		{
+			Waypoint *waypoint = (Waypoint *)writer.At(path) + j;
+			waypoint->x = (float)Random(1000);
+			waypoint->y = (float)Random(1000);
+			waypoint->z = (float)Random(100);
+		}
+		writer.SetPointer(entity + offsetof(Entity, path), path);
+
+		if(Random(4) == 0)
+		{
+			writer.SetNull(entity + offsetof(Entity, target));
+		}
+		else
+		{
+			writer.SetPointer(entity + offsetof(Entity, target), entities + Random(entityCount) * sizeof(Entity));
+		}
+
+		Entity *e = (Entity *)writer.At(entity);
+		e->pathLength = pathLength;
+		e->health = 100 + Random(900);
+	}
+
+	return writer.Save(fileName);
+}
+
+// Touches everything in the level.
+static double WalkLevel(Level *level)
+{
+	double sum = strlen(level->name);
+	for(unsigned int i = 0; i < level->entityCount; i++)
+	{
+		Entity *entity = level->entities + i;
+		sum += strlen(entity->name) + entity->health;
+		for(unsigned int j = 0; j < entity->pathLength; j++)
+		{
+			sum += entity->path[j].x + entity->path[j].y + entity->path[j].z;
+		}
+		if(entity->target)
+		{
+			sum += entity->target->health;
+		}
+	}
+	return sum;
+}
+
+static double Elapsed(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static unsigned int FileSize(char *fileName)
+{
+	FILE *file = fopen(fileName, "rb");
+	fseek(file, 0, SEEK_END);
+	unsigned int size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int entityCount = argc > 1 ? atoi(argv[1]) : 100000;
+	unsigned int loads = argc > 2 ? atoi(argv[2]) : 20;
+	char fileName[] = "loadbench.img";
+
+	if(!BuildLevel(fileName, entityCount))
+	{
+		printf("Could not write %s\n", fileName);
+		return 1;
+	}
+	unsigned int fileSize = FileSize(fileName);
+	printf("%u entities, %.1f MB image, %u loads (the file is in the cache)\n\n",
+		entityCount, fileSize / (1024.0 * 1024.0), loads);
+
+	double loadTime[3] = { 0, 0, 0 };
+	double walkTime[3] = { 0, 0, 0 };
+	double sums[3] = { 0, 0, 0 };
+	bool ok = TRUE;
+
+	for(unsigned int pass = 0; pass < loads; pass++)
+	{
+		GameImage image;
+
+		// fread into a new buffer.
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		char *data = new char[fileSize];
+		FILE *file = fopen(fileName, "rb");
+		fread(data, fileSize, 1, file);
+		fclose(file);
+		ok = image.Attach(data, fileSize) && ok;
+		loadTime[0] += Elapsed(start);
+		start = std::chrono::steady_clock::now();
+		sums[0] = WalkLevel((Level *)image.GetRoot());
+		walkTime[0] += Elapsed(start);
+		image.Unload();
+		delete [] data;
+
+		// fread into a temporary buffer, then copy.
+		start = std::chrono::steady_clock::now();
+		char *tempBuffer = new char[fileSize + READ_GRANULARITY];
+		data = new char[fileSize];
+		file = fopen(fileName, "rb");
+		fread(tempBuffer, fileSize, 1, file);
+		fclose(file);
+		memcpy(data, tempBuffer, fileSize);
+		delete [] tempBuffer;
+		ok = image.Attach(data, fileSize) && ok;
+		loadTime[1] += Elapsed(start);
+		start = std::chrono::steady_clock::now();
+		sums[1] = WalkLevel((Level *)image.GetRoot());
+		walkTime[1] += Elapsed(start);
+		image.Unload();
+		delete [] data;
+
+		// mmap and relocate in place.
+		start = std::chrono::steady_clock::now();
+		ok = image.Load(fileName) && ok;
+		loadTime[2] += Elapsed(start);
+		start = std::chrono::steady_clock::now();
+		sums[2] = WalkLevel((Level *)image.GetRoot());
+		walkTime[2] += Elapsed(start);
+		image.Unload();
+	}
+
+	const char *names[3] = { "fread", "memcpy", "mmap" };
+	printf("         load+fixup ms   walk ms   total ms\n");
+	for(int i = 0; i < 3; i++)
+	{
+		printf("%-8s %13.3f %9.3f %10.3f\n", names[i], loadTime[i] / loads,
+			walkTime[i] / loads, (loadTime[i] + walkTime[i]) / loads);
+	}
+
+	ok = ok && sums[0] == sums[1] && sums[1] == sums[2];
+	printf("\n%s\n", ok ? "All loads saw the same level." : "LOADS DIFFER");
+
+	remove(fileName);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,398 @@
+/* Copyright (C) Steven Ranck, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Steven Ranck, 2000"
+ */
+
+// frametest: exercises the frame memory system and exits non-zero if
+// anything is wrong. It checks the global heaps, gives several threads
+// their own arenas and has them allocate, fill and release frames at
+// the same time, rotates the game frame buffers across BeginGameFrame()
+// and runs frame blocks out of memory.
+//
+// Built with FRAME_INSTRUMENT it also damages guards on purpose, makes
+// allocations that don't fit, and checks that DumpFrameMemoryStats()
+// reports all of it along with the right high-water marks.
+//
+//   g++ -O2 -pthread -o frametest frametest.cpp FRAME.CPP
+//   g++ -O2 -pthread -DFRAME_INSTRUMENT -o frametest frametest.cpp FRAME.CPP
+//   frametest [threads] [frames per thread]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "FRAME.H"
+
+#define _ALIGNMENT			16
+#define _HEAP_BYTES			4096	// Global heaps
+#define _THREAD_HEAP_BYTES	16384	// Each worker's heaps
+#define _THREAD_GAME_BYTES	4096	// Each worker's game frame buffers
+#define _MAIN_HEAP_BYTES	1024	// The main thread's heaps
+#define _MAIN_GAME_BYTES	1024	// The main thread's game frame buffers
+#define _MAX_ALLOCS			32		// Allocations per worker frame
+#define _GUARD_BYTES		16
+#define _GAME_FRAMES		7		// BeginGameFrame() calls the tests make
+#define _FAILED_ALLOCS		2		// Global heap allocations that don't fit
+
+static std::atomic<int> _nErrors;
+
+
+static void _Check( int bOk, const char *pszWhat ) {
+	if( !bOk ) {
+		if( _nErrors.fetch_add( 1 ) < 20 ) {
+			printf( "error: %s\n", pszWhat );
+		}
+	}
+}
+
+
+static int _IsAligned( void *pMem ) {
+	return ( (size_t)pMem & (_ALIGNMENT-1) ) == 0;
+}
+
+
+// Returns 1 if all nBytes at pMem are still nFill.
+static int _IsFilled( void *pMem, int nBytes, int nFill ) {
+	u8 *pByte = (u8 *)pMem;
+	int i;
+
+	for( i=0; i<nBytes; i++ ) {
+		if( pByte[i] != (u8)nFill ) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+// The global heaps: both ends fill towards each other, and releasing
+// the frames gives all of it back.
+static void _TestGlobalHeaps( void ) {
+	Frame_t LowerFrame, UpperFrame;
+	void *pLower, *pUpper, *pMem;
+
+	LowerFrame = GetFrame( 0 );
+	pLower = AllocFrameMemory( 1000, 0 );
+	UpperFrame = GetFrame( 1 );
+	pUpper = AllocFrameMemory( 1000, 1 );
+	_Check( pLower && pUpper && _IsAligned( pLower ) && _IsAligned( pUpper ), "global heap allocations" );
+	_Check( pLower && pUpper && (u8 *)pLower+1008 <= (u8 *)pUpper, "global heaps overlap" );
+
+	// 2016 bytes are in use, so 3008 more don't fit but 2080 do:
+	_Check( AllocFrameMemory( 3000, 0 ) == 0, "global heap allocation past the other heap" );
+	pMem = AllocFrameMemory( 2080, 0 );
+	_Check( pMem != 0, "global heap allocation that just fits" );
+	_Check( AllocFrameMemory( 1, 1 ) == 0, "allocation from a full global heap" );
+
+	ReleaseFrame( UpperFrame );
+	ReleaseFrame( LowerFrame );
+	_Check( AllocFrameMemory( _HEAP_BYTES, 0 ) == pLower, "releasing the global frames" );
+	ReleaseFrame( LowerFrame );
+}
+
+
+// What each worker found.
+typedef struct {
+	int nFrames;
+	int nFailures;		// Allocations that correctly didn't fit
+	int nHighWater;		// Most bytes it had in its heaps at once
+} Worker_t;
+
+// Allocates, fills and releases frames from this thread's arena. Every
+// allocation must fit exactly when the bytes in use say it should.
+static void _Worker( int nThread, int nFrames, Worker_t *pResult ) {
+	void *apMem[_MAX_ALLOCS];
+	int anBytes[_MAX_ALLOCS];
+	u8 *pKeep;
+	uint nSeed = nThread * 7919 + 1;
+	int nUsed, nFill, nAllocs, nHeapNum, nBytes, i, j;
+	Frame_t Frame;
+
+	memset( pResult, 0, sizeof(Worker_t) );
+
+	if( InitThreadFrameMemory( _THREAD_HEAP_BYTES, _THREAD_GAME_BYTES, _ALIGNMENT ) ) {
+		_Check( 0, "InitThreadFrameMemory" );
+		return;
+	}
+
+	// Something that stays in the lower heap the whole time:
+	pKeep = (u8 *)AllocThreadFrameMemory( 256, 0 );
+	_Check( pKeep != 0, "thread heap allocation" );
+	if( pKeep == 0 ) {
+		ShutdownThreadFrameMemory();
+		return;
+	}
+	memset( pKeep, nThread, 256 );
+	pResult->nHighWater = 256;
+
+	for( i=0; i<nFrames; i++ ) {
+		nHeapNum = i & 1;
+		nFill = ( nThread * 31 + i ) & 0xff;
+		Frame = GetThreadFrame( nHeapNum );
+		nUsed = 256;
+
+		for( nAllocs=0; nAllocs<_MAX_ALLOCS; ) {
+			nSeed = nSeed * 1103515245 + 12345;
+			nBytes = 1 + (int)( ( nSeed >> 8 ) % 1024 );
+
+			apMem[nAllocs] = AllocThreadFrameMemory( nBytes, nHeapNum );
+			if( nUsed + (int)ALIGNUP( nBytes, _ALIGNMENT ) > _THREAD_HEAP_BYTES ) {
+				_Check( apMem[nAllocs] == 0, "thread heap allocation past the end" );
+				pResult->nFailures++;
+				break;
+			}
+
+			_Check( apMem[nAllocs] != 0, "thread heap allocation that fits" );
+			if( apMem[nAllocs] == 0 ) {
+				break;
+			}
+			_Check( _IsAligned( apMem[nAllocs] ), "thread heap alignment" );
+			memset( apMem[nAllocs], nFill, nBytes );
+			anBytes[nAllocs++] = nBytes;
+			nUsed += ALIGNUP( nBytes, _ALIGNMENT );
+		}
+
+		if( nUsed > pResult->nHighWater ) {
+			pResult->nHighWater = nUsed;
+		}
+
+		// Nothing written over anything else:
+		for( j=0; j<nAllocs; j++ ) {
+			_Check( _IsFilled( apMem[j], anBytes[j], nFill ), "thread heap allocation overwritten" );
+		}
+
+		ReleaseThreadFrame( Frame );
+		pResult->nFrames++;
+	}
+
+	_Check( _IsFilled( pKeep, 256, nThread ), "kept thread heap allocation overwritten" );
+
+	// Game frame memory runs out at exactly the buffer size:
+	for( nUsed=0; AllocGameFrameMemory( 64 ); nUsed+=64 ) {
+	}
+	_Check( nUsed == _THREAD_GAME_BYTES, "filling a thread's game frame buffer" );
+
+	ShutdownThreadFrameMemory();
+}
+
+
+// The main thread's game frame buffers take turns, and memory from one
+// game frame survives the next.
+static void _TestGameFrames( void ) {
+	u8 *pFirst, *pSecond, *pThird, *pMem;
+	int nUsed;
+
+	BeginGameFrame();
+	pFirst = (u8 *)AllocGameFrameMemory( 100 );
+	_Check( pFirst && _IsAligned( pFirst ), "game frame allocation" );
+	_Check( AllocGameFrameMemory( _MAIN_GAME_BYTES ) == 0, "game frame allocation past the end" );
+	if( pFirst == 0 ) {
+		return;
+	}
+	memset( pFirst, 0xa1, 100 );
+
+	// The next game frame uses the other buffer:
+	BeginGameFrame();
+	pSecond = (u8 *)AllocGameFrameMemory( 100 );
+	_Check( pSecond && ( pSecond+112 <= pFirst || pSecond >= pFirst+112 ), "game frame buffers overlap" );
+	if( pSecond == 0 ) {
+		return;
+	}
+	memset( pSecond, 0xb2, 100 );
+	_Check( _IsFilled( pFirst, 100, 0xa1 ), "last game frame's memory overwritten" );
+
+	// And the one after that reuses the first buffer from its start:
+	BeginGameFrame();
+	pThird = (u8 *)AllocGameFrameMemory( 100 );
+	_Check( pThird == pFirst, "game frame buffer not reused" );
+	if( pThird ) {
+		memset( pThird, 0xc3, 100 );
+	}
+	_Check( _IsFilled( pSecond, 100, 0xb2 ), "last game frame's memory overwritten" );
+
+	// A thread that skips game frames catches up, with an empty buffer:
+	BeginGameFrame();
+	BeginGameFrame();
+	BeginGameFrame();
+	for( nUsed=0; ( pMem = (u8 *)AllocGameFrameMemory( 16 ) ) != 0; nUsed+=16 ) {
+	}
+	_Check( nUsed == _MAIN_GAME_BYTES, "game frame buffer not emptied" );
+}
+
+
+// Blocks hand out memory until they're used up, and never more.
+static void _TestBlocks( void ) {
+	FrameBlock_t Block;
+	void *pMem, *pFirst;
+	int i;
+
+	BeginGameFrame();
+
+	// 100 bytes hold two 40 byte allocations, aligned to 48, and no more:
+	_Check( GetGameFrameBlock( &Block, 100 ) == 0, "GetGameFrameBlock" );
+	pFirst = AllocFromFrameBlock( &Block, 40 );
+	pMem = AllocFromFrameBlock( &Block, 40 );
+	_Check( pFirst && _IsAligned( pFirst ) && (u8 *)pMem == (u8 *)pFirst+48, "frame block allocations" );
+	_Check( AllocFromFrameBlock( &Block, 1 ) == 0, "allocation from a used up frame block" );
+
+	// One too big for the game frame buffer comes back empty:
+	_Check( GetGameFrameBlock( &Block, _MAIN_GAME_BYTES ) == 1, "GetGameFrameBlock too big" );
+	_Check( AllocFromFrameBlock( &Block, 1 ) == 0, "allocation from an empty frame block" );
+
+	// Blocks can be made out of other frame memory:
+	pMem = AllocThreadFrameMemory( 64, 0 );
+	_Check( pMem != 0, "thread heap allocation for a block" );
+	InitFrameBlock( &Block, pMem, 64, _ALIGNMENT );
+	for( i=0; i<4; i++ ) {
+		_Check( AllocFromFrameBlock( &Block, 16 ) == (u8 *)pMem + i*16, "frame block allocation" );
+	}
+	_Check( AllocFromFrameBlock( &Block, 1 ) == 0, "allocation from a used up frame block" );
+}
+
+
+#ifdef FRAME_INSTRUMENT
+
+// Writes just past each end of an allocation, over the guard next to it.
+// Both must be caught, one by CheckFrameGuards() and one by ReleaseFrame().
+static void _TestGuards( void ) {
+	Frame_t Frame;
+	u8 *pMem;
+
+	SetFrameGuardBytes( _GUARD_BYTES );
+
+	// The lower heap's guard sits just below the frame's allocations:
+	Frame = GetFrame( 0 );
+	pMem = (u8 *)AllocFrameMemory( 32, 0 );
+	_Check( pMem != 0, "allocation after a guard" );
+	if( pMem ) {
+		pMem[-1] = 0;
+	}
+	_Check( CheckFrameGuards() == 1, "CheckFrameGuards missed a damaged guard" );
+	_Check( CheckFrameGuards() == 0, "CheckFrameGuards reported the same damage twice" );
+	ReleaseFrame( Frame );
+
+	// The upper heap's guard sits just above them:
+	Frame = GetFrame( 1 );
+	pMem = (u8 *)AllocFrameMemory( 32, 1 );
+	_Check( pMem != 0, "allocation after a guard" );
+	if( pMem ) {
+		pMem[32] = 0;
+	}
+	ReleaseFrame( Frame );
+
+	// And a frame that stays inside its allocations does no damage:
+	Frame = GetFrame( 0 );
+	pMem = (u8 *)AllocFrameMemory( 32, 0 );
+	if( pMem ) {
+		memset( pMem, 0, 32 );
+	}
+	_Check( CheckFrameGuards() == 0, "CheckFrameGuards reported an intact guard" );
+	ReleaseFrame( Frame );
+
+	SetFrameGuardBytes( 0 );
+}
+
+
+// Dumps the stats to stdout, and checks the numbers in them.
+static void _CheckStats( int nThreadHighWater, int nGameFrameHighWater ) {
+	FILE *pFile = tmpfile();
+	char szLine[256];
+	int nLower = -1, nUpper = -1, nBoth = -1, nFailed = -1, nGuardBytes, nDamaged = -1;
+	int nThreadHeap = -1, nThreadGame = -1, nCallsites = 0;
+	uint nGameFrames = 0;
+
+	if( pFile == 0 ) {
+		_Check( 0, "tmpfile" );
+		return;
+	}
+	DumpFrameMemoryStats( pFile );
+	rewind( pFile );
+
+	while( fgets( szLine, sizeof(szLine), pFile ) ) {
+		fputs( szLine, stdout );
+		sscanf( szLine, "High-water: lower heap %d, upper heap %d, both %d", &nLower, &nUpper, &nBoth );
+		sscanf( szLine, "Failed allocations: %d", &nFailed );
+		sscanf( szLine, "Guards: %d bytes, %d overwritten", &nGuardBytes, &nDamaged );
+		sscanf( szLine, "Thread arenas: heaps up to %d bytes, game frame buffers up to %d bytes", &nThreadHeap, &nThreadGame );
+		sscanf( szLine, "Peak use per game frame, %u game frames", &nGameFrames );
+		if( strstr( szLine, "frametest.cpp(" ) ) {
+			nCallsites++;
+		}
+	}
+	fclose( pFile );
+	printf( "\n" );
+
+	// _TestGlobalHeaps() filled the heaps exactly:
+	_Check( nLower == _HEAP_BYTES && nUpper == 1008 && nBoth == _HEAP_BYTES, "global high-water marks" );
+	_Check( nFailed == _FAILED_ALLOCS, "failed allocation count" );
+	_Check( nDamaged == 2, "overwritten guard count" );
+	_Check( nThreadHeap == nThreadHighWater, "thread heap high-water mark" );
+	_Check( nThreadGame == nGameFrameHighWater, "game frame buffer high-water mark" );
+	_Check( nGameFrames == _GAME_FRAMES, "game frames in the histogram" );
+	_Check( nCallsites > 0, "callsites" );
+}
+
+#endif
+
+
+int main( int argc, char *argv[] ) {
+	int nThreads = ( argc > 1 ) ? atoi( argv[1] ) : 8;
+	int nFrames = ( argc > 2 ) ? atoi( argv[2] ) : 20000;
+	std::vector<std::thread> Threads;
+	std::vector<Worker_t> Results( nThreads );
+	int nTotalFrames, nFailures, nHighWater, i;
+
+	if( InitFrameMemorySystem( _HEAP_BYTES, _ALIGNMENT ) ) {
+		printf( "error: InitFrameMemorySystem\n" );
+		return 1;
+	}
+	_TestGlobalHeaps();
+#ifdef FRAME_INSTRUMENT
+	_TestGuards();
+#endif
+
+	if( InitThreadFrameMemory( _MAIN_HEAP_BYTES, _MAIN_GAME_BYTES, _ALIGNMENT ) ) {
+		printf( "error: InitThreadFrameMemory\n" );
+		return 1;
+	}
+	_TestGameFrames();
+	_TestBlocks();
+
+	// The workers allocate from their own arenas at the same time:
+	for( i=0; i<nThreads; i++ ) {
+		Threads.push_back( std::thread( _Worker, i, nFrames, &Results[i] ) );
+	}
+	nTotalFrames = nFailures = 0;
+	nHighWater = 64;	// The main thread's, from _TestBlocks()
+	for( i=0; i<nThreads; i++ ) {
+		Threads[i].join();
+		nTotalFrames += Results[i].nFrames;
+		nFailures += Results[i].nFailures;
+		if( Results[i].nHighWater > nHighWater ) {
+			nHighWater = Results[i].nHighWater;
+		}
+	}
+	_Check( nTotalFrames == nThreads * nFrames, "workers finished early" );
+
+#ifdef FRAME_INSTRUMENT
+	// Every worker filled its game frame buffer, and the main thread its own:
+	_CheckStats( nHighWater, nThreads ? _THREAD_GAME_BYTES : _MAIN_GAME_BYTES );
+#else
+	(void)nHighWater;
+#endif
+
+	ShutdownThreadFrameMemory();
+	ShutdownFrameMemorySystem();
+
+	printf( "%d threads, %d frames, %d full heaps: %d errors\n",
+		nThreads, nTotalFrames, nFailures, _nErrors.load() );
+	return _nErrors.load() ? 1 : 0;
+}
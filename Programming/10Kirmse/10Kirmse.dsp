@@ -101,6 +101,10 @@ SOURCE=.\bitarray2d.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\sparsebitarray.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\twobitarray.h
 # End Source File
 # End Group
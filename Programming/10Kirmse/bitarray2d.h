@@ -4,11 +4,16 @@
 //
 // Permission is granted to use this code for any purpose, as long as this
 // copyright message remains intact.
+//
+// Each row starts on a word boundary, so the block operations (FillRect,
+// CountRect, Blit, FloodFill and so on) can work on whole words of a row
+// at a time.  The unused bits at the end of each row are always false.
 
 #ifndef _BITARRAY2D_H
 #define _BITARRAY2D_H
 
-#include "bitarray.h"
+#include "BITARRAY.H"
+#include <vector>
 
 class BitArray2D : private BitArray
 {
@@ -20,14 +25,20 @@ public:
    // Constructors
    //
 
-   BitArray2D(unsigned dim1, unsigned dim2) : super(dim1 * dim2)
+   // All bits start out false.
+   BitArray2D(unsigned dim1, unsigned dim2) : super(dim1 * RowBits(dim2))
    {
+      mHeight = dim1;
       mWidth = dim2;
+      mRowBits = RowBits(dim2);
+      super::Clear();
    }
 
    BitArray2D(const BitArray2D &that) : super(that)
    {
+      mHeight = that.mHeight;
       mWidth = that.mWidth;
+      mRowBits = that.mRowBits;
    }
 
    //
@@ -39,7 +50,9 @@ public:
    BitArray2D &operator=(const BitArray2D &that)
    {
       super::operator=(that);
+      mHeight = that.mHeight;
       mWidth = that.mWidth;
+      mRowBits = that.mRowBits;
       return *this;
    }
 
@@ -69,13 +82,13 @@ public:
       return *this;
    }
 
-   BitArray2D operator|=(const BitArray2D &that)
+   BitArray2D &operator|=(const BitArray2D &that)
    {
       super::operator|=(that);
       return *this;
    }
 
-   BitArray2D operator^=(const BitArray2D &that)
+   BitArray2D &operator^=(const BitArray2D &that)
    {
       super::operator^=(that);
       return *this;
@@ -114,19 +127,19 @@ public:
    // Set the bit at position pos to true.
    void SetBit(unsigned pos1, unsigned pos2)
    {
-      super::SetBit(pos1 * mWidth + pos2);
+      super::SetBit(pos1 * mRowBits + pos2);
    }
 
    // Set the bit at position pos to false.
    void ClearBit(unsigned pos1, unsigned pos2)
    { 
-      super::ClearBit(pos1 * mWidth + pos2);
+      super::ClearBit(pos1 * mRowBits + pos2);
    }
 
    // Toggle the bit at position pos.
    void FlipBit(unsigned pos1, unsigned pos2)
    { 
-      super::FlipBit(pos1 * mWidth + pos2);
+      super::FlipBit(pos1 * mRowBits + pos2);
    }
 
    // Set the bit at position pos to the given value.
@@ -138,7 +151,7 @@ public:
    // Returns true iff the bit at position pos is true.
    bool IsBitSet(unsigned pos1, unsigned pos2) const
    {
-      return super::IsBitSet(pos1 * mWidth + pos2);
+      return super::IsBitSet(pos1 * mRowBits + pos2);
    }
 
    // Returns true iff all bits are false.
@@ -151,9 +164,121 @@ public:
    BitArray2D &FlipAllBits()
    {
       super::FlipAllBits();
+
+      // Put the unused bits back to false
+      if (mWidth % cell_size != 0)
+         for (unsigned row = 0; row < mHeight; row++)
+            SetRange(GetRow(row), mWidth, mRowBits - mWidth, false);
       return *this;
    }
 
+   // Returns the number of bits that are true.
+   unsigned Count() const
+   {
+      return super::Count();
+   }
+
+   //
+   // Block operations
+   //
+   // Rectangles are given as first row, first column, number of rows and
+   // number of columns, and must lie inside the array.
+   //
+
+   // Set all bits in a rectangle to true.
+   void FillRect(unsigned pos1, unsigned pos2, unsigned rows, unsigned columns)
+   {
+      assert(pos1 + rows <= mHeight && pos2 + columns <= mWidth);
+      for (unsigned row = pos1; row < pos1 + rows; row++)
+         SetRange(GetRow(row), pos2, columns, true);
+   }
+
+   // Set all bits in a rectangle to false.
+   void ClearRect(unsigned pos1, unsigned pos2, unsigned rows, unsigned columns)
+   {
+      assert(pos1 + rows <= mHeight && pos2 + columns <= mWidth);
+      for (unsigned row = pos1; row < pos1 + rows; row++)
+         SetRange(GetRow(row), pos2, columns, false);
+   }
+
+   // Returns the number of true bits in a rectangle.
+   unsigned CountRect(unsigned pos1, unsigned pos2, unsigned rows, unsigned columns) const
+   {
+      assert(pos1 + rows <= mHeight && pos2 + columns <= mWidth);
+      unsigned count = 0;
+      for (unsigned row = pos1; row < pos1 + rows; row++)
+      {
+         const store_type *words = GetRow(row);
+         for (unsigned col = pos2; col < pos2 + columns; )
+         {
+            unsigned n = WordSpan(col, pos2 + columns);
+            count += CountBits(GetBits(words, col, n));
+            col += n;
+         }
+      }
+      return count;
+   }
+
+   // Copy all of source into this array with its top left corner at
+   // (pos1, pos2).  Parts that fall outside this array are left out, so the
+   // position may be negative.
+   void Blit(const BitArray2D &source, int pos1, int pos2)
+   {
+      Combine(source, pos1, pos2, false);
+   }
+
+   // Like Blit, but only sets bits: each bit becomes itself or the source bit.
+   void OrBlit(const BitArray2D &source, int pos1, int pos2)
+   {
+      Combine(source, pos1, pos2, true);
+   }
+
+   // Set to true the false bit at (pos1, pos2) and every false bit connected
+   // to it through false bits above, below, left or right.  Returns the
+   // number of bits set, which is 0 if (pos1, pos2) was already true.
+   unsigned FloodFill(unsigned pos1, unsigned pos2)
+   {
+      assert(pos1 < mHeight && pos2 < mWidth);
+      unsigned count = 0;
+      std::vector<unsigned> seeds;  // Row and column pairs
+      seeds.push_back(pos1);
+      seeds.push_back(pos2);
+
+      while (!seeds.empty())
+      {
+         unsigned col = seeds.back();
+         seeds.pop_back();
+         unsigned row = seeds.back();
+         seeds.pop_back();
+
+         if (IsBitSet(row, col))
+            continue;
+         store_type *words = GetRow(row);
+
+         // Fill the whole span of false bits around the seed at once
+         unsigned left = FindPrev(words, col, true) + 1;
+         unsigned right = FindNext(words, col, mWidth, true);
+         SetRange(words, left, right - left, true);
+         count += right - left;
+
+         // Each span of false bits touching it in the rows above and below
+         // needs filling too
+         for (int next = (int) row - 1; next <= (int) row + 1; next += 2)
+         {
+            if (next < 0 || next >= (int) mHeight)
+               continue;
+            const store_type *next_words = GetRow(next);
+            for (unsigned x = FindNext(next_words, left, right, false); x < right;
+                 x = FindNext(next_words, FindNext(next_words, x, right, true), right, false))
+            {
+               seeds.push_back(next);
+               seeds.push_back(x);
+            }
+         }
+      }
+      return count;
+   }
+
    //
    // Array proxy (for operator[])
    //
@@ -169,7 +294,7 @@ public:
 
       BitProxy operator[](unsigned pos) const
       {
-         return BitProxy(mArray, mPos * mArray.mWidth + pos);
+         return BitProxy(mArray, mPos * mArray.mRowBits + pos);
       }
 
    private:
@@ -178,7 +303,138 @@ public:
    };
 
 private:
+   unsigned mHeight;
    unsigned mWidth;
+   unsigned mRowBits;  // Width rounded up to whole words
+
+   static unsigned RowBits(unsigned width)
+   {
+      return (width + cell_size - 1) / cell_size * cell_size;
+   }
+
+   store_type *GetRow(unsigned row) const
+   {
+      return GetStore() + row * (mRowBits / cell_size);
+   }
+
+   // A word with the low n bits true, for n from 0 to cell_size.
+   static store_type LowBits(unsigned n)
+   {
+      return n >= cell_size ? ~(store_type) 0 : ((store_type) 1 << n) - 1;
+   }
+
+   // Number of bits from col to the end of its word, or to end if that's
+   // sooner.
+   static unsigned WordSpan(unsigned col, unsigned end)
+   {
+      unsigned n = cell_size - col % cell_size;
+      return n < end - col ? n : end - col;
+   }
+
+   // Returns n (at most cell_size) bits of a row starting at col, in the low
+   // bits of a word.
+   static store_type GetBits(const store_type *words, unsigned col, unsigned n)
+   {
+      unsigned index = col / cell_size, offset = col % cell_size;
+      store_type bits = words[index] >> offset;
+      if (offset + n > cell_size)
+         bits |= words[index + 1] << (cell_size - offset);
+      return bits & LowBits(n);
+   }
+
+   // Set n bits of a row starting at col.
+   static void SetRange(store_type *words, unsigned col, unsigned n, bool value)
+   {
+      unsigned end = col + n;
+      while (col < end)
+      {
+         unsigned span = WordSpan(col, end);
+         store_type mask = LowBits(span) << (col % cell_size);
+         if (value)
+            words[col / cell_size] |= mask;
+         else
+            words[col / cell_size] &= ~mask;
+         col += span;
+      }
+   }
+
+   // Position of the first bit at or after col, and before end, that has the
+   // given value, or end if there isn't one.
+   static unsigned FindNext(const store_type *words, unsigned col, unsigned end, bool value)
+   {
+      if (col >= end)
+         return end;
+
+      unsigned index = col / cell_size;
+      store_type word = (value ? words[index] : ~words[index]) & ((~(store_type) 0) << (col % cell_size));
+      for (;;)
+      {
+         if (word != 0)
+         {
+            unsigned found = index * cell_size + LowestBit(word);
+            return found < end ? found : end;
+         }
+         if (++index * cell_size >= end)
+            return end;
+         word = value ? words[index] : ~words[index];
+      }
+   }
+
+   // Position of the last bit at or before col with the given value, or -1
+   // if there isn't one.
+   static int FindPrev(const store_type *words, unsigned col, bool value)
+   {
+      int index = col / cell_size;
+      store_type word = (value ? words[index] : ~words[index]) & LowBits(col % cell_size + 1);
+      for (;;)
+      {
+         if (word != 0)
+            return index * cell_size + HighestBit(word);
+         if (--index < 0)
+            return -1;
+         word = value ? words[index] : ~words[index];
+      }
+   }
+
+   // Blit or OrBlit source to (pos1, pos2), a word of each row at a time.
+   void Combine(const BitArray2D &source, int pos1, int pos2, bool or_bits)
+   {
+      assert(&source != this);
+
+      // Clip the source rectangle to this array
+      int first_row = pos1 < 0 ? -pos1 : 0;
+      int first_col = pos2 < 0 ? -pos2 : 0;
+      int end_row = (int) source.mHeight;
+      int end_col = (int) source.mWidth;
+      if (pos1 + end_row > (int) mHeight)
+         end_row = (int) mHeight - pos1;
+      if (pos2 + end_col > (int) mWidth)
+         end_col = (int) mWidth - pos2;
+      if (first_row >= end_row || first_col >= end_col)
+         return;
+
+      for (int row = first_row; row < end_row; row++)
+      {
+         const store_type *from = source.GetRow(row);
+         store_type *to = GetRow(row + pos1);
+
+         // Work along the destination words, shifting the source into place
+         unsigned col = first_col + pos2, end = end_col + pos2;
+         unsigned source_col = first_col;
+         while (col < end)
+         {
+            unsigned n = WordSpan(col, end);
+            store_type bits = GetBits(from, source_col, n) << (col % cell_size);
+            store_type &word = to[col / cell_size];
+            if (or_bits)
+               word |= bits;
+            else
+               word = (word & ~(LowBits(n) << (col % cell_size))) | bits;
+            col += n;
+            source_col += n;
+         }
+      }
+   }
 };
 
 #endif
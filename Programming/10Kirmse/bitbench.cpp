@@ -0,0 +1,192 @@
+/* Copyright (C) Andrew Kirmse, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Andrew Kirmse, 2000"
+ */
+
+// Compares BitArray with SparseBitArray at several densities: memory,
+// building with SetBit, random IsBitSet, &, | and visiting every true bit.
+//
+//    bitbench [bits]
+
+#include "BITARRAY.H"
+#include "sparsebitarray.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static double Elapsed(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static unsigned seed = 1;
+
+static unsigned Random()
+{
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+// Positions to set: about density out of a million start a run of
+// run_length true bits.
+static unsigned MakePositions(unsigned *positions, unsigned size,
+                              unsigned density, unsigned run_length)
+{
+   unsigned count = 0;
+   for (unsigned i = 0; i < size; i++)
+   {
+      if (Random() % 1000000 >= density)
+         continue;
+      for (unsigned j = i; j < i + run_length && j < size; j++)
+         positions[count++] = j;
+      i += run_length;
+   }
+   return count;
+}
+
+struct Results
+{
+   double build, lookup, and_time, or_time, visit;
+   unsigned memory;
+   unsigned sum;  // So the work can't be optimized away
+};
+
+template <class Array>
+static void Visit(const Array &a, unsigned &sum)
+{
+   for (typename Array::SetBitIterator it = a.BeginSetBits(); it != a.EndSetBits(); ++it)
+      sum += *it;
+}
+
+static unsigned Memory(const BitArray &, unsigned size)
+{
+   return sizeof(BitArray) + (size + 7) / 8;
+}
+
+static unsigned Memory(const SparseBitArray &a, unsigned)
+{
+   return a.MemoryUsed();
+}
+
+static void Prepare(BitArray &a)
+{
+   a.Clear();
+}
+
+static void Prepare(SparseBitArray &)
+{
+}
+
+static void Finish(BitArray &)
+{
+}
+
+static void Finish(SparseBitArray &a)
+{
+   a.Optimize();
+}
+
+template <class Array>
+static Results Run(unsigned size, const unsigned *positions1, unsigned count1,
+                   const unsigned *positions2, unsigned count2,
+                   const unsigned *lookups, unsigned num_lookups)
+{
+   Results r;
+   r.sum = 0;
+
+   Clock::time_point start = Clock::now();
+   Array a(size), b(size);
+   Prepare(a);
+   Prepare(b);
+   unsigned i;
+   for (i = 0; i < count1; i++)
+      a.SetBit(positions1[i]);
+   for (i = 0; i < count2; i++)
+      b.SetBit(positions2[i]);
+   Finish(a);
+   Finish(b);
+   r.build = Elapsed(start);
+   r.memory = Memory(a, size);
+
+   start = Clock::now();
+   for (i = 0; i < num_lookups; i++)
+      r.sum += a.IsBitSet(lookups[i]);
+   r.lookup = Elapsed(start);
+
+   start = Clock::now();
+   Array c = a & b;
+   r.and_time = Elapsed(start);
+   r.sum += c.Count();
+
+   start = Clock::now();
+   Array d = a | b;
+   r.or_time = Elapsed(start);
+   r.sum += d.Count();
+
+   start = Clock::now();
+   Visit(a, r.sum);
+   r.visit = Elapsed(start);
+
+   return r;
+}
+
+int main(int argc, char **argv)
+{
+   unsigned size = argc > 1 ? atoi(argv[1]) : 1 << 24;
+   const unsigned num_lookups = 1000000;
+
+   struct
+   {
+      const char *name;
+      unsigned density;     // Runs per million bits
+      unsigned run_length;
+   } cases[] =
+   {
+      { "0.01%",       100,    1 },
+      { "0.1%",       1000,    1 },
+      { "1%",        10000,    1 },
+      { "10%",      100000,    1 },
+      { "50%",      500000,    1 },
+      { "runs 1%",     100,  100 },
+      { "runs 30%",    300, 1000 },
+   };
+
+   unsigned *positions1 = new unsigned[size];
+   unsigned *positions2 = new unsigned[size];
+   unsigned *lookups = new unsigned[num_lookups];
+   unsigned i;
+   for (i = 0; i < num_lookups; i++)
+      lookups[i] = Random() % size;
+
+   printf("%u bits, %u lookups; times in ms\n\n", size, num_lookups);
+   printf("%-9s %-6s %10s %8s %8s %8s %8s %8s\n",
+          "density", "type", "memory KB", "build", "lookup", "and", "or", "visit");
+
+   for (unsigned c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+   {
+      unsigned count1 = MakePositions(positions1, size, cases[c].density, cases[c].run_length);
+      unsigned count2 = MakePositions(positions2, size, cases[c].density, cases[c].run_length);
+
+      Results dense = Run<BitArray>(size, positions1, count1, positions2, count2, lookups, num_lookups);
+      Results sparse = Run<SparseBitArray>(size, positions1, count1, positions2, count2, lookups, num_lookups);
+
+      printf("%-9s %-6s %10.1f %8.2f %8.2f %8.3f %8.3f %8.2f\n", cases[c].name, "dense",
+             dense.memory / 1024.0, dense.build, dense.lookup, dense.and_time, dense.or_time, dense.visit);
+      printf("%-9s %-6s %10.1f %8.2f %8.2f %8.3f %8.3f %8.2f%s\n", "", "sparse",
+             sparse.memory / 1024.0, sparse.build, sparse.lookup, sparse.and_time, sparse.or_time, sparse.visit,
+             sparse.sum == dense.sum ? "" : "  RESULTS DIFFER");
+   }
+
+   delete [] positions1;
+   delete [] positions2;
+   delete [] lookups;
+   return 0;
+}
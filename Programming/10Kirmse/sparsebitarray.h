@@ -0,0 +1,900 @@
+// A one-dimensional array of bits, compressed for sparse sets.
+//
+// Copyright 2000 Andrew Kirmse.  All rights reserved.
+//
+// Permission is granted to use this code for any purpose, as long as this
+// copyright message remains intact.
+//
+// Works like BitArray, but stores each 64K-bit chunk of the array in
+// whichever of three forms is smallest for it:
+//
+//    array   - sorted list of the true positions, 2 bytes each; for
+//              chunks with at most 4096 true bits
+//    bitmap  - 8K of plain bits; for busy chunks
+//    run     - list of (start, length - 1) pairs, 4 bytes each; for
+//              chunks made of long stretches of true bits
+//
+// Chunks with no true bits take no memory at all.  SetBit and ClearBit
+// switch between array and bitmap as the count crosses 4096; the bulk
+// operators and Optimize() also consider runs.
+
+#ifndef _SPARSEBITARRAY_H
+#define _SPARSEBITARRAY_H
+
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+class SparseBitArray
+{
+public:
+
+   //
+   // Constructors and destructor
+   //
+
+   // All bits start out false.
+   explicit SparseBitArray(unsigned size)
+   {
+      mNumBits = size;
+      mDirectory.resize(size == 0 ? 0 : ((size - 1) >> chunk_bits) + 1);
+   }
+
+   //
+   // Operators
+   //
+
+   bool operator==(const SparseBitArray &that) const
+   {
+      if (mNumBits != that.mNumBits || mContainers.size() != that.mContainers.size())
+         return false;
+
+      for (unsigned i = 0; i < mContainers.size(); i++)
+         if (!SameBits(mContainers[i], that.mContainers[i]))
+            return false;
+      return true;
+   }
+
+   bool operator!=(const SparseBitArray &that) const
+   {
+      return !(*this == that);
+   }
+
+   SparseBitArray &operator&=(const SparseBitArray &that)
+   {
+      assert(mNumBits == that.mNumBits);
+      Combine<AndOp>(that);
+      return *this;
+   }
+
+   SparseBitArray &operator|=(const SparseBitArray &that)
+   {
+      assert(mNumBits == that.mNumBits);
+      Combine<OrOp>(that);
+      return *this;
+   }
+
+   SparseBitArray &operator^=(const SparseBitArray &that)
+   {
+      assert(mNumBits == that.mNumBits);
+      Combine<XorOp>(that);
+      return *this;
+   }
+
+   friend SparseBitArray operator&(const SparseBitArray &a1, const SparseBitArray &a2)
+   {
+      return SparseBitArray(a1) &= a2;
+   }
+
+   friend SparseBitArray operator|(const SparseBitArray &a1, const SparseBitArray &a2)
+   {
+      return SparseBitArray(a1) |= a2;
+   }
+
+   friend SparseBitArray operator^(const SparseBitArray &a1, const SparseBitArray &a2)
+   {
+      return SparseBitArray(a1) ^= a2;
+   }
+
+   //
+   // Plain English interface
+   //
+
+   // Set all bits to false.
+   void Clear()
+   {
+      mContainers.clear();
+      std::fill(mDirectory.begin(), mDirectory.end(), 0);
+   }
+
+   // Set the bit at position pos to true.
+   void SetBit(unsigned pos)
+   {
+      assert(pos < mNumBits);
+      Container &c = GetContainer(pos >> chunk_bits);
+      unsigned short low = (unsigned short) pos;
+
+      if (c.mType == array_type)
+      {
+         std::vector<unsigned short>::iterator it =
+            std::lower_bound(c.mValues.begin(), c.mValues.end(), low);
+         if (it != c.mValues.end() && *it == low)
+            return;
+
+         if (c.mCount < max_array_count)
+         {
+            c.mValues.insert(it, low);
+            c.mCount++;
+            return;
+         }
+         ToBitmap(c);
+      }
+
+      word_type &word = c.mWords[low / word_bits];
+      word_type mask = (word_type) 1 << (low % word_bits);
+      if ((word & mask) == 0)
+      {
+         word |= mask;
+         c.mCount++;
+      }
+   }
+
+   // Set the bit at position pos to false.
+   void ClearBit(unsigned pos)
+   {
+      assert(pos < mNumBits);
+      unsigned i = FindContainer(pos >> chunk_bits);
+      if (i == mContainers.size())
+         return;
+
+      // Don't unpack a run container for a bit that's already false
+      Container &c = mContainers[i];
+      unsigned short low = (unsigned short) pos;
+      if (!ContainerHas(c, low))
+         return;
+      MakeWritable(c);
+
+      if (c.mType == array_type)
+      {
+         std::vector<unsigned short>::iterator it =
+            std::lower_bound(c.mValues.begin(), c.mValues.end(), low);
+         c.mValues.erase(it);
+         c.mCount--;
+      }
+      else
+      {
+         word_type &word = c.mWords[low / word_bits];
+         word_type mask = (word_type) 1 << (low % word_bits);
+         word &= ~mask;
+         if (--c.mCount == max_array_count)
+            ToArray(c);
+      }
+
+      if (c.mCount == 0)
+      {
+         mDirectory[c.mKey] = 0;
+         mContainers.erase(mContainers.begin() + i);
+         UpdateDirectory(i);
+      }
+   }
+
+   // Toggle the bit at position pos.
+   void FlipBit(unsigned pos)
+   {
+      IsBitSet(pos) ? ClearBit(pos) : SetBit(pos);
+   }
+
+   // Set the bit at position pos to the given value.
+   void Set(unsigned pos, bool val)
+   {
+      val ? SetBit(pos) : ClearBit(pos);
+   }
+
+   // Returns true iff the bit at position pos is true.
+   bool IsBitSet(unsigned pos) const
+   {
+      assert(pos < mNumBits);
+      unsigned i = FindContainer(pos >> chunk_bits);
+      if (i == mContainers.size())
+         return false;
+      return ContainerHas(mContainers[i], (unsigned short) pos);
+   }
+
+   // Returns true iff all bits are false.
+   bool AllBitsFalse() const
+   {
+      // Empty containers are always removed
+      return mContainers.empty();
+   }
+
+   // Returns the number of bits that are true.
+   unsigned Count() const
+   {
+      unsigned count = 0;
+      for (unsigned i = 0; i < mContainers.size(); i++)
+         count += mContainers[i].mCount;
+      return count;
+   }
+
+   // Returned by the Find functions when there are no more true bits.
+   enum { npos = ~0u };
+
+   // Returns the position of the first true bit, or npos if there are none.
+   unsigned FindFirstSet() const
+   {
+      return FindFrom(0);
+   }
+
+   // Returns the position of the first true bit after position pos, or npos
+   // if there are none.
+   unsigned FindNextSet(unsigned pos) const
+   {
+      return FindFrom(pos + 1);
+   }
+
+   //
+   // Set bit iterator, used the same way as BitArray's
+   //
+
+   class SetBitIterator;
+
+   SetBitIterator BeginSetBits() const;
+   SetBitIterator EndSetBits() const;
+
+   friend class SetBitIterator;
+
+   // Convert every chunk to its smallest form.  Worth calling once a set
+   // built with SetBit is finished, since SetBit never makes runs.
+   void Optimize()
+   {
+      for (unsigned i = 0; i < mContainers.size(); i++)
+         Shrink(mContainers[i]);
+   }
+
+   // Returns roughly how many bytes the bits take up.
+   unsigned MemoryUsed() const
+   {
+      unsigned bytes = sizeof(*this) + mContainers.capacity() * sizeof(Container) +
+         mDirectory.capacity() * sizeof(unsigned);
+      for (unsigned i = 0; i < mContainers.size(); i++)
+         bytes += mContainers[i].mValues.capacity() * sizeof(unsigned short) +
+            mContainers[i].mWords.capacity() * sizeof(word_type);
+      return bytes;
+   }
+
+private:
+
+   typedef unsigned long long word_type;
+   enum
+   {
+      chunk_bits      = 16,                       // Positions per chunk is 2^chunk_bits
+      chunk_size      = 1 << chunk_bits,
+      word_bits       = 64,
+      bitmap_words    = chunk_size / word_bits,
+      max_array_count = 4096,                     // Above this a bitmap is smaller
+
+      array_type = 0,
+      bitmap_type,
+      run_type
+   };
+
+   struct Container
+   {
+      unsigned                    mKey;    // Position >> chunk_bits of every bit in here
+      int                         mType;   // array_type, bitmap_type or run_type
+      unsigned                    mCount;  // Number of true bits
+      std::vector<unsigned short> mValues; // Array: sorted positions, run: start, length - 1
+      std::vector<word_type>      mWords;  // Bitmap: the bits
+   };
+
+   std::vector<Container> mContainers;     // Non-empty chunks, sorted by mKey
+   std::vector<unsigned>  mDirectory;      // For each chunk, 1 + index of its container, or 0
+   unsigned               mNumBits;
+
+   //
+   // Bit twiddling
+   //
+
+   static unsigned CountBits(word_type word)
+   {
+#if defined(__GNUC__)
+      return __builtin_popcountll(word);
+#else
+      word = word - ((word >> 1) & 0x5555555555555555ULL);
+      word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+      word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+      return (unsigned) ((word * 0x0101010101010101ULL) >> 56);
+#endif
+   }
+
+   // Position of the lowest true bit in a word, which must not be 0.
+   static unsigned LowestBit(word_type word)
+   {
+#if defined(__GNUC__)
+      return __builtin_ctzll(word);
+#elif defined(_MSC_VER) && defined(_M_X64)
+      unsigned long bit;
+      _BitScanForward64(&bit, word);
+      return bit;
+#else
+      unsigned bit = 0;
+      while ((word & 1) == 0)
+      {
+         word >>= 1;
+         bit++;
+      }
+      return bit;
+#endif
+   }
+
+   //
+   // Finding containers
+   //
+
+   struct KeyLess
+   {
+      bool operator()(const Container &c, unsigned key) const { return c.mKey < key; }
+   };
+
+   // Index of the first container with mKey >= key.
+   unsigned LowerBound(unsigned key) const
+   {
+      return std::lower_bound(mContainers.begin(), mContainers.end(), key, KeyLess()) -
+         mContainers.begin();
+   }
+
+   // Index of the container for key, or mContainers.size() if there isn't one.
+   // The directory makes this one lookup instead of a binary search, which
+   // matters for random IsBitSet calls.
+   unsigned FindContainer(unsigned key) const
+   {
+      return mDirectory[key] ? mDirectory[key] - 1 : mContainers.size();
+   }
+
+   // Fix the directory entries of containers from index first on, after
+   // adding or removing a container.
+   void UpdateDirectory(unsigned first)
+   {
+      for (unsigned i = first; i < mContainers.size(); i++)
+         mDirectory[mContainers[i].mKey] = i + 1;
+   }
+
+   // The container for key, after adding an empty one if need be.  The
+   // container is an array or a bitmap, never runs.
+   Container &GetContainer(unsigned key)
+   {
+      unsigned i = FindContainer(key);
+      if (i == mContainers.size())
+      {
+         Container c;
+         c.mKey = key;
+         c.mType = array_type;
+         c.mCount = 0;
+         i = LowerBound(key);
+         mContainers.insert(mContainers.begin() + i, c);
+         UpdateDirectory(i);
+      }
+      MakeWritable(mContainers[i]);
+      return mContainers[i];
+   }
+
+   //
+   // Single containers
+   //
+
+   static bool ContainerHas(const Container &c, unsigned short low)
+   {
+      switch (c.mType)
+      {
+      case array_type:
+      {
+         unsigned i = CountLess(c, 1, c.mValues.size(), low);
+         return i < c.mValues.size() && c.mValues[i] == low;
+      }
+
+      case bitmap_type:
+         return (c.mWords[low / word_bits] >> (low % word_bits)) & 1;
+
+      default:
+      {
+         unsigned run = RunsBefore(c, low);
+         return run > 0 && low <= RunEnd(c, run - 1);
+      }
+      }
+   }
+
+   // Number of runs that start at or before low.
+   static unsigned RunsBefore(const Container &c, unsigned low)
+   {
+      return CountLess(c, 2, c.mValues.size() / 2, low + 1);
+   }
+
+   // Number of mValues[0], mValues[stride], ... mValues[(n - 1) * stride]
+   // that are less than key.  A binary search written so the compiler can
+   // use conditional moves; random lookups would mispredict about half of
+   // the branches in an ordinary one.
+   static unsigned CountLess(const Container &c, unsigned stride, unsigned n, unsigned key)
+   {
+      if (n == 0)
+         return 0;
+
+      const unsigned short *values = &c.mValues[0];
+      const unsigned short *base = values;
+      while (n > 1)
+      {
+         unsigned half = n / 2;
+         base = base[half * stride] < key ? base + half * stride : base;
+         n -= half;
+      }
+      return (base - values) / stride + (*base < key);
+   }
+
+   // Last position in a run.
+   static unsigned RunEnd(const Container &c, unsigned run)
+   {
+      return c.mValues[2 * run] + c.mValues[2 * run + 1];
+   }
+
+   // Position of the first true bit at or after low in the container, or
+   // -1 if there isn't one.
+   static int ContainerFind(const Container &c, unsigned low)
+   {
+      switch (c.mType)
+      {
+      case array_type:
+      {
+         unsigned i = CountLess(c, 1, c.mValues.size(), low);
+         return i < c.mValues.size() ? c.mValues[i] : -1;
+      }
+
+      case bitmap_type:
+      {
+         unsigned index = low / word_bits;
+         word_type word = c.mWords[index] & ((~(word_type) 0) << (low % word_bits));
+         while (word == 0)
+         {
+            if (++index == bitmap_words)
+               return -1;
+            word = c.mWords[index];
+         }
+         return index * word_bits + LowestBit(word);
+      }
+
+      default:
+      {
+         unsigned run = RunsBefore(c, low);
+         if (run > 0 && low <= RunEnd(c, run - 1))
+            return low;
+         return run < c.mValues.size() / 2 ? c.mValues[2 * run] : -1;
+      }
+      }
+   }
+
+   // Fill words with the bits of a container.
+   static void GetWords(const Container &c, word_type *words)
+   {
+      if (c.mType == bitmap_type)
+      {
+         std::copy(c.mWords.begin(), c.mWords.end(), words);
+         return;
+      }
+
+      std::fill(words, words + bitmap_words, 0);
+      if (c.mType == array_type)
+      {
+         for (unsigned i = 0; i < c.mValues.size(); i++)
+            words[c.mValues[i] / word_bits] |= (word_type) 1 << (c.mValues[i] % word_bits);
+      }
+      else
+      {
+         // Fill each run a word at a time
+         for (unsigned i = 0; i < c.mValues.size(); i += 2)
+         {
+            unsigned start = c.mValues[i], end = start + c.mValues[i + 1] + 1;
+            unsigned first = start / word_bits, last = (end - 1) / word_bits;
+            word_type first_mask = (~(word_type) 0) << (start % word_bits);
+            word_type last_mask = (~(word_type) 0) >> (word_bits - 1 - (end - 1) % word_bits);
+            if (first == last)
+               words[first] |= first_mask & last_mask;
+            else
+            {
+               words[first] |= first_mask;
+               std::fill(words + first + 1, words + last, ~(word_type) 0);
+               words[last] |= last_mask;
+            }
+         }
+      }
+   }
+
+   static void ToBitmap(Container &c)
+   {
+      std::vector<word_type> words(bitmap_words);
+      GetWords(c, &words[0]);
+      c.mWords.swap(words);
+      std::vector<unsigned short>().swap(c.mValues);
+      c.mType = bitmap_type;
+   }
+
+   static void ToArray(Container &c)
+   {
+      std::vector<unsigned short> values;
+      values.reserve(c.mCount);
+      if (c.mType == bitmap_type)
+      {
+         for (unsigned i = 0; i < bitmap_words; i++)
+            for (word_type word = c.mWords[i]; word != 0; word &= word - 1)
+               values.push_back((unsigned short) (i * word_bits + LowestBit(word)));
+      }
+      else if (c.mType == run_type)
+      {
+         for (unsigned i = 0; i < c.mValues.size(); i += 2)
+            for (unsigned pos = c.mValues[i]; pos <= (unsigned) c.mValues[i] + c.mValues[i + 1]; pos++)
+               values.push_back((unsigned short) pos);
+      }
+      else
+         return;
+      c.mValues.swap(values);
+      std::vector<word_type>().swap(c.mWords);
+      c.mType = array_type;
+   }
+
+   // Count the stretches of true bits in a container.
+   static unsigned CountRuns(const Container &c)
+   {
+      if (c.mType == run_type)
+         return c.mValues.size() / 2;
+
+      unsigned runs = 0;
+      if (c.mType == array_type)
+      {
+         for (unsigned i = 0; i < c.mValues.size(); i++)
+            if (i == 0 || c.mValues[i] != c.mValues[i - 1] + 1)
+               runs++;
+      }
+      else
+      {
+         // A run starts at each true bit whose lower neighbor is false
+         word_type carry = 0;
+         for (unsigned i = 0; i < bitmap_words; i++)
+         {
+            word_type word = c.mWords[i];
+            runs += CountBits(word & ~((word << 1) | carry));
+            carry = word >> (word_bits - 1);
+         }
+      }
+      return runs;
+   }
+
+   static void ToRuns(Container &c)
+   {
+      std::vector<unsigned short> runs;
+      if (c.mType == array_type)
+      {
+         for (unsigned i = 0; i < c.mValues.size(); i++)
+         {
+            if (i > 0 && c.mValues[i] == c.mValues[i - 1] + 1)
+               runs.back()++;
+            else
+            {
+               runs.push_back(c.mValues[i]);
+               runs.push_back(0);
+            }
+         }
+      }
+      else if (c.mType == bitmap_type)
+      {
+         int pos = ContainerFind(c, 0);
+         while (pos >= 0)
+         {
+            // The run ends just before the next false bit
+            unsigned index = pos / word_bits;
+            word_type word = ~c.mWords[index] & ((~(word_type) 0) << (pos % word_bits));
+            while (word == 0 && ++index < bitmap_words)
+               word = ~c.mWords[index];
+            unsigned end = word == 0 ? (unsigned) chunk_size : index * word_bits + LowestBit(word);
+
+            runs.push_back((unsigned short) pos);
+            runs.push_back((unsigned short) (end - 1 - pos));
+            pos = end < chunk_size ? ContainerFind(c, end) : -1;
+         }
+      }
+      else
+         return;
+      c.mValues.swap(runs);
+      std::vector<word_type>().swap(c.mWords);
+      c.mType = run_type;
+   }
+
+   // Runs can't be changed a bit at a time; make them an array or bitmap.
+   static void MakeWritable(Container &c)
+   {
+      if (c.mType != run_type)
+         return;
+      if (c.mCount <= max_array_count)
+         ToArray(c);
+      else
+         ToBitmap(c);
+   }
+
+   // Convert a container to its smallest form.
+   static void Shrink(Container &c)
+   {
+      unsigned run_bytes = 4 * CountRuns(c);
+      unsigned array_bytes = c.mCount <= (unsigned) max_array_count ? 2 * c.mCount : ~0u;
+      unsigned bitmap_bytes = chunk_size / 8;
+
+      if (run_bytes < array_bytes && run_bytes < bitmap_bytes)
+         ToRuns(c);
+      else if (array_bytes <= bitmap_bytes)
+         ToArray(c);
+      else
+         ToBitmap(c);
+   }
+
+   static bool SameBits(const Container &c1, const Container &c2)
+   {
+      if (c1.mKey != c2.mKey || c1.mCount != c2.mCount)
+         return false;
+      if (c1.mType == c2.mType)
+         return c1.mValues == c2.mValues && c1.mWords == c2.mWords;
+
+      word_type words1[bitmap_words], words2[bitmap_words];
+      GetWords(c1, words1);
+      GetWords(c2, words2);
+      return std::equal(words1, words1 + bitmap_words, words2);
+   }
+
+   //
+   // Bulk operations
+   //
+
+   // keep_unmatched says whether a chunk in only one of the arrays stays
+   // as it is; Keep says whether a bit stays given whether it's in each.
+   struct AndOp
+   {
+      enum { keep_unmatched = false };
+      static bool Keep(bool in1, bool in2) { return in1 && in2; }
+      static word_type Word(word_type a, word_type b) { return a & b; }
+   };
+
+   struct OrOp
+   {
+      enum { keep_unmatched = true };
+      static bool Keep(bool in1, bool in2) { return in1 || in2; }
+      static word_type Word(word_type a, word_type b) { return a | b; }
+   };
+
+   struct XorOp
+   {
+      enum { keep_unmatched = true };
+      static bool Keep(bool in1, bool in2) { return in1 != in2; }
+      static word_type Word(word_type a, word_type b) { return a ^ b; }
+   };
+
+   // c1 = c1 Op c2, for two containers with the same key.
+   template <class Op>
+   static void CombineContainers(Container &c1, const Container &c2)
+   {
+      if (c1.mType == array_type && c2.mType == array_type)
+      {
+         // Merge the two sorted lists
+         std::vector<unsigned short> values;
+         values.reserve(Op::keep_unmatched ? c1.mCount + c2.mCount : std::min(c1.mCount, c2.mCount));
+         unsigned i = 0, j = 0;
+         while (i < c1.mValues.size() || j < c2.mValues.size())
+         {
+            bool in1 = i < c1.mValues.size() && (j == c2.mValues.size() || c1.mValues[i] <= c2.mValues[j]);
+            bool in2 = j < c2.mValues.size() && (i == c1.mValues.size() || c2.mValues[j] <= c1.mValues[i]);
+            unsigned short value = in1 ? c1.mValues[i] : c2.mValues[j];
+            if (Op::Keep(in1, in2))
+               values.push_back(value);
+            i += in1;
+            j += in2;
+         }
+         c1.mValues.swap(values);
+         c1.mCount = c1.mValues.size();
+      }
+      else if (!Op::keep_unmatched && (c1.mType == array_type || c2.mType == array_type))
+      {
+         // A small list and-ed with anything: keep the listed bits that are
+         // in the other one
+         const Container &list = c1.mType == array_type ? c1 : c2;
+         const Container &other = c1.mType == array_type ? c2 : c1;
+         std::vector<unsigned short> values;
+         for (unsigned i = 0; i < list.mValues.size(); i++)
+            if (ContainerHas(other, list.mValues[i]))
+               values.push_back(list.mValues[i]);
+         c1.mValues.swap(values);
+         std::vector<word_type>().swap(c1.mWords);
+         c1.mType = array_type;
+         c1.mCount = c1.mValues.size();
+      }
+      else
+      {
+         // A word at a time
+         word_type words2[bitmap_words];
+         GetWords(c2, words2);
+         if (c1.mType != bitmap_type)
+            ToBitmap(c1);
+
+         unsigned count = 0;
+         for (unsigned i = 0; i < bitmap_words; i++)
+         {
+            c1.mWords[i] = Op::Word(c1.mWords[i], words2[i]);
+            count += CountBits(c1.mWords[i]);
+         }
+         c1.mCount = count;
+      }
+
+      if (c1.mCount != 0)
+         Shrink(c1);
+   }
+
+   template <class Op>
+   void Combine(const SparseBitArray &that)
+   {
+      std::vector<Container> result;
+      result.reserve(mContainers.size() + (Op::keep_unmatched ? that.mContainers.size() : 0));
+
+      unsigned i = 0, j = 0;
+      while (i < mContainers.size() || j < that.mContainers.size())
+      {
+         if (j == that.mContainers.size() ||
+             (i < mContainers.size() && mContainers[i].mKey < that.mContainers[j].mKey))
+         {
+            // Only in this one
+            if (Op::keep_unmatched)
+               result.push_back(std::move(mContainers[i]));
+            i++;
+         }
+         else if (i == mContainers.size() || that.mContainers[j].mKey < mContainers[i].mKey)
+         {
+            // Only in that one
+            if (Op::keep_unmatched)
+               result.push_back(that.mContainers[j]);
+            j++;
+         }
+         else
+         {
+            CombineContainers<Op>(mContainers[i], that.mContainers[j]);
+            if (mContainers[i].mCount != 0)
+               result.push_back(std::move(mContainers[i]));
+            i++;
+            j++;
+         }
+      }
+
+      mContainers.swap(result);
+      std::fill(mDirectory.begin(), mDirectory.end(), 0);
+      UpdateDirectory(0);
+   }
+
+   // Position of the first true bit at or after position pos, or npos.
+   unsigned FindFrom(unsigned pos) const
+   {
+      if (pos >= mNumBits)
+         return npos;
+
+      unsigned key = pos >> chunk_bits;
+      for (unsigned i = LowerBound(key); i < mContainers.size(); i++)
+      {
+         const Container &c = mContainers[i];
+         int low = ContainerFind(c, c.mKey == key ? pos & (chunk_size - 1) : 0);
+         if (low >= 0)
+            return (c.mKey << chunk_bits) | low;
+      }
+      return npos;
+   }
+};
+
+class SparseBitArray::SetBitIterator
+{
+public:
+   SetBitIterator(const SparseBitArray &array, unsigned container):
+         mpArray(&array), mContainer(container), mIndex(0), mWord(0), mValue(0)
+   {
+      StartContainer();
+   }
+
+   unsigned operator*() const
+   {
+      return (mpArray->mContainers[mContainer].mKey << chunk_bits) | mValue;
+   }
+
+   SetBitIterator &operator++()
+   {
+      const Container &c = mpArray->mContainers[mContainer];
+      switch (c.mType)
+      {
+      case array_type:
+         if (++mIndex < c.mValues.size())
+         {
+            mValue = c.mValues[mIndex];
+            return *this;
+         }
+         break;
+
+      case bitmap_type:
+         // Clear the lowest true bit
+         mWord &= mWord - 1;
+         while (mWord == 0 && ++mIndex < bitmap_words)
+            mWord = c.mWords[mIndex];
+         if (mWord != 0)
+         {
+            mValue = mIndex * word_bits + LowestBit(mWord);
+            return *this;
+         }
+         break;
+
+      default:
+         if (mValue < RunEnd(c, mIndex))
+         {
+            mValue++;
+            return *this;
+         }
+         if (++mIndex < c.mValues.size() / 2)
+         {
+            mValue = c.mValues[2 * mIndex];
+            return *this;
+         }
+         break;
+      }
+
+      mContainer++;
+      StartContainer();
+      return *this;
+   }
+
+   bool operator==(const SetBitIterator &that) const
+   {
+      return mContainer == that.mContainer && mValue == that.mValue;
+   }
+
+   bool operator!=(const SetBitIterator &that) const
+   {
+      return !(*this == that);
+   }
+
+private:
+   const SparseBitArray *mpArray;
+   unsigned              mContainer;  // Container we're in
+   unsigned              mIndex;      // Array: value, bitmap: word, run: run we're at
+   word_type             mWord;       // Bitmap: true bits of that word not visited yet
+   unsigned              mValue;      // Low bits of the current position
+
+   // Go to the first true bit of mContainer.  Containers are never empty.
+   void StartContainer()
+   {
+      mIndex = 0;
+      mValue = 0;
+      if (mContainer == mpArray->mContainers.size())
+         return;
+
+      const Container &c = mpArray->mContainers[mContainer];
+      if (c.mType == bitmap_type)
+      {
+         while ((mWord = c.mWords[mIndex]) == 0)
+            mIndex++;
+         mValue = mIndex * word_bits + LowestBit(mWord);
+      }
+      else
+         mValue = c.mValues[0];
+   }
+};
+
+inline SparseBitArray::SetBitIterator SparseBitArray::BeginSetBits() const
+{
+   return SetBitIterator(*this, 0);
+}
+
+inline SparseBitArray::SetBitIterator SparseBitArray::EndSetBits() const
+{
+   return SetBitIterator(*this, mContainers.size());
+}
+
+#endif
@@ -8,7 +8,7 @@
 #ifndef _TWOBITARRAY_H
 #define _TWOBITARRAY_H
 
-#include "bitarray.h"
+#include "BITARRAY.H"
 
 class TwoBitArray : private BitArray
 {
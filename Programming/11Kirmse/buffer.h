@@ -19,6 +19,7 @@
 // operate on the list contain List in their names.
 
 #include "defs.h"
+#include <string.h>
 #include <string>
 
 class BufferPool;
@@ -8,32 +8,28 @@
  * "Portions Copyright (C) Andrew Kirmse, 2000"
  */
 #include <stdio.h>
+#include <assert.h>
 #include "bufferpool.h"
 
+/***************************************************************/
+BufferPool::BufferPool(int32 new_buffer_size)
+{
+   assert(new_buffer_size <= Buffer::MAX_SIZE && new_buffer_size > 0);
+
+   buffer_size = new_buffer_size;
+}
 /***************************************************************/
 Buffer * BufferPool::GetBuffer(int32 min_size)
 {
-   store_type::iterator it;
    Buffer *b;
 
-   /* look for a big enough buffer in the store */
-   for (it = store.begin(); it != store.end(); it++)
-   {
-      b = *it;
-      if (b->GetSize() >= min_size)
-      {
-	 store.erase(it);
-   
-	 return b;
-      }
-   }
+   if (min_size <= buffer_size)
+      return Pool<Buffer>::Get();
 
-   /* no available buffers big enough; create a new one */
+   /* too big for the pool; create a buffer just for this */
 
    b = new Buffer(this,min_size);
-   if (b->GetSize() >= min_size)
-      allocated_count++;
-   else
+   if (b->GetSize() < min_size)
    {
       delete b;
       b = NULL;
@@ -48,6 +44,14 @@ void BufferPool::Release(Buffer *b)
       printf("Freeing buffer with reference count != 0\n");
    
    b->ResetData();
-   
-   store.push_front(b);
+
+   if (b->GetSize() != buffer_size)
+      delete b;
+   else
+      Pool<Buffer>::Release(b);
+}
+/***************************************************************/
+Buffer * BufferPool::Create(void *memory)
+{
+   return new (memory) Buffer(this,buffer_size);
 }
@@ -16,17 +16,30 @@
 
 typedef list<Buffer *> buffer_store_type;
 
+// Every buffer in a BufferPool is the same size, so any free one will do.
+// A request for a bigger buffer gets one made just for it, which is
+// deleted when it's released.
+
 class BufferPool : public Pool<Buffer>
 {
 public:
 
+   BufferPool(int32 new_buffer_size = Buffer::MAX_SIZE);
+
    Buffer * GetBuffer(int32 min_size);
    Buffer * Get()  { return GetBuffer(Buffer::MAX_SIZE); }
 
    void Release(Buffer *b);
 
+   int32 GetBufferSize() { return buffer_size; }
+
+protected:
+
+   Buffer *Create(void *memory);
+
 private:
 
+   int32 buffer_size;
 };
 
 #endif
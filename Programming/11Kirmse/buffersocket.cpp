@@ -0,0 +1,312 @@
+/* Copyright (C) Andrew Kirmse, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Andrew Kirmse, 2000"
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   // for sendmmsg and recvmmsg
+#endif
+
+#include <stdio.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "buffersocket.h"
+
+/***************************************************************/
+void IOVecList::Clear()
+{
+   num_messages = 0;
+   length = 0;
+   message_start[0] = 0;
+}
+/***************************************************************/
+bool IOVecList::StartMessage()
+{
+   return num_messages < MAX_MESSAGES && message_start[num_messages] < MAX_VECS;
+}
+/***************************************************************/
+void IOVecList::EndMessage(int32 message_bytes)
+{
+   message_length[num_messages] = message_bytes;
+   length += message_bytes;
+   num_messages++;
+}
+/***************************************************************/
+int32 IOVecList::AddData(Buffer *blist, int32 max_bytes, int32 skip)
+{
+   if (!StartMessage())
+      return 0;
+
+   int32 n = message_start[num_messages];
+   int32 added = 0;
+   Buffer *b;
+
+   for (b = blist; b != NULL && added < max_bytes && n < MAX_VECS; b = b->GetNext())
+   {
+      int32 len = b->GetDataLength();
+      byte *start = b->GetDataStart();
+
+      if (skip >= len)
+      {
+	 skip -= len;
+	 continue;
+      }
+      start += skip;
+      len -= skip;
+      skip = 0;
+
+      len = min(len, max_bytes - added);
+      vecs[n].iov_base = start;
+      vecs[n].iov_len = len;
+      n++;
+      added += len;
+   }
+
+   message_start[num_messages + 1] = n;
+   EndMessage(added);
+   return added;
+}
+/***************************************************************/
+int32 IOVecList::AddSpace(Buffer **buffers, int32 count)
+{
+   if (!StartMessage())
+      return 0;
+
+   int32 n = message_start[num_messages];
+   int32 space = 0;
+
+   for (int32 i = 0; i < count && n < MAX_VECS; i++)
+   {
+      Buffer *b = buffers[i];
+      int32 len = b->GetMaxDataLength() - b->GetDataLength();
+
+      vecs[n].iov_base = b->GetDataStart() + b->GetDataLength();
+      vecs[n].iov_len = len;
+      n++;
+      space += len;
+   }
+
+   message_start[num_messages + 1] = n;
+   EndMessage(space);
+   return space;
+}
+/***************************************************************/
+void IOVecList::RemoveLastMessage()
+{
+   assert(num_messages > 0);
+
+   num_messages--;
+   length -= message_length[num_messages];
+}
+
+/***************************************************************/
+BufferSocket::BufferSocket(BufferPool *new_pool)
+{
+   assert(new_pool != NULL);
+
+   pool = new_pool;
+   fd = -1;
+   datagram = false;
+
+   for (int32 i = 0; i < RECEIVE_DATAGRAMS * DATAGRAM_BUFFERS; i++)
+      spare[i] = NULL;
+}
+/***************************************************************/
+BufferSocket::~BufferSocket()
+{
+   Close();
+
+   for (int32 i = 0; i < RECEIVE_DATAGRAMS * DATAGRAM_BUFFERS; i++)
+      if (spare[i] != NULL)
+	 spare[i]->Release();
+}
+/***************************************************************/
+bool BufferSocket::Attach(int new_fd)
+{
+   int type;
+   socklen_t len_type = sizeof(type);
+
+   Close();
+
+   if (getsockopt(new_fd, SOL_SOCKET, SO_TYPE, &type, &len_type) != 0)
+      return false;
+
+   int flags = fcntl(new_fd, F_GETFL, 0);
+   if (flags < 0 || fcntl(new_fd, F_SETFL, flags | O_NONBLOCK) < 0)
+      return false;
+
+   fd = new_fd;
+   datagram = (type == SOCK_DGRAM);
+   return true;
+}
+/***************************************************************/
+void BufferSocket::Close()
+{
+   if (fd >= 0)
+      close(fd);
+   fd = -1;
+}
+/***************************************************************/
+int32 BufferSocket::Write(IOVecList *vecs)
+{
+   assert(!datagram);
+
+   if (vecs->GetVecCount() == 0)
+      return 0;
+
+   struct msghdr msg;
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov = vecs->GetVecs();
+   msg.msg_iovlen = vecs->GetVecCount();
+
+   // MSG_NOSIGNAL: a closed connection is an error, not a SIGPIPE.
+   ssize_t written;
+   do
+      written = sendmsg(fd, &msg, MSG_NOSIGNAL);
+   while (written < 0 && errno == EINTR);
+
+   if (written < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+   return (int32) written;
+}
+/***************************************************************/
+int32 BufferSocket::SendMessages(IOVecList *vecs)
+{
+   assert(datagram);
+
+   struct mmsghdr msgs[IOVecList::MAX_MESSAGES];
+   int32 count = vecs->GetMessageCount();
+
+   if (count == 0)
+      return 0;
+
+   memset(msgs, 0, sizeof(msgs[0]) * count);
+   for (int32 i = 0; i < count; i++)
+   {
+      msgs[i].msg_hdr.msg_iov = vecs->GetVecs(i);
+      msgs[i].msg_hdr.msg_iovlen = vecs->GetVecCount(i);
+   }
+
+   int sent;
+   do
+      sent = sendmmsg(fd, msgs, count, MSG_NOSIGNAL);
+   while (sent < 0 && errno == EINTR);
+
+   if (sent < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+   return sent;
+}
+/***************************************************************/
+bool BufferSocket::FillSpares(int32 count)
+{
+   for (int32 i = 0; i < count; i++)
+      if (spare[i] == NULL)
+      {
+	 spare[i] = pool->Get();
+	 if (spare[i] == NULL)
+	    return false;
+      }
+
+   return true;
+}
+/***************************************************************/
+Buffer *BufferSocket::TakeSpares(int32 first, int32 count, int32 len)
+{
+   Buffer *blist = NULL;
+   Buffer *last = NULL;
+
+   for (int32 i = first; i < first + count && len > 0; i++)
+   {
+      Buffer *b = spare[i];
+      int32 len_now = min(len, b->GetMaxDataLength() - b->GetDataLength());
+
+      b->AddDataLength(len_now);
+      len -= len_now;
+
+      if (last == NULL)
+	 blist = b;
+      else
+	 last->SetNext(b);
+      last = b;
+      spare[i] = NULL;
+   }
+
+   return blist;
+}
+/***************************************************************/
+Buffer *BufferSocket::Read(int32 *len)
+{
+   assert(!datagram);
+
+   if (!FillSpares(RECEIVE_BUFFERS))
+   {
+      *len = NO_BUFFERS;
+      return NULL;
+   }
+
+   receive_vecs.Clear();
+   receive_vecs.AddSpace(spare, RECEIVE_BUFFERS);
+
+   ssize_t got;
+   do
+      got = readv(fd, receive_vecs.GetVecs(), receive_vecs.GetVecCount());
+   while (got < 0 && errno == EINTR);
+
+   if (got <= 0)
+   {
+      // 0 means the other end closed the connection
+      *len = (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) ? 0 : -1;
+      return NULL;
+   }
+
+   *len = (int32) got;
+   return TakeSpares(0, RECEIVE_BUFFERS, (int32) got);
+}
+/***************************************************************/
+int32 BufferSocket::ReceiveMessages(Buffer **lists, int32 max_lists)
+{
+   assert(datagram);
+
+   struct mmsghdr msgs[RECEIVE_DATAGRAMS];
+   int32 count = min(max_lists, (int32) RECEIVE_DATAGRAMS);
+   int32 i;
+
+   if (!FillSpares(count * DATAGRAM_BUFFERS))
+      return NO_BUFFERS;
+
+   receive_vecs.Clear();
+   memset(msgs, 0, sizeof(msgs[0]) * count);
+   for (i = 0; i < count; i++)
+   {
+      receive_vecs.AddSpace(spare + i * DATAGRAM_BUFFERS, DATAGRAM_BUFFERS);
+      msgs[i].msg_hdr.msg_iov = receive_vecs.GetVecs(i);
+      msgs[i].msg_hdr.msg_iovlen = receive_vecs.GetVecCount(i);
+   }
+
+   int got;
+   do
+      got = recvmmsg(fd, msgs, count, MSG_DONTWAIT, NULL);
+   while (got < 0 && errno == EINTR);
+
+   if (got < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+   for (i = 0; i < got; i++)
+   {
+      // A datagram that was too big is no use, and an empty one has
+      // nothing to hand out.  Their buffers stay spares.
+      if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) || msgs[i].msg_len == 0)
+	 lists[i] = NULL;
+      else
+	 lists[i] = TakeSpares(i * DATAGRAM_BUFFERS, DATAGRAM_BUFFERS, msgs[i].msg_len);
+   }
+
+   return got;
+}
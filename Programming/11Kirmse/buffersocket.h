@@ -0,0 +1,160 @@
+/* Copyright (C) Andrew Kirmse, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Andrew Kirmse, 2000"
+ */
+#ifndef _BUFFERSOCKET_H
+#define _BUFFERSOCKET_H
+
+// A BufferSocket moves Buffer lists to and from a non-blocking socket
+// without copying them.  Sends hand the kernel an iovec pointing at each
+// buffer's data where it is; receives read straight into buffers from a
+// BufferPool, which are then handed out as a buffer list.
+//
+// A stream socket sends with one sendmsg (writev, plus flags) per call and
+// receives with one readv.  A datagram socket sends a batch of messages,
+// one buffer list each, with a single sendmmsg, and receives a batch with
+// recvmmsg.
+//
+// This uses the POSIX socket calls, and sendmmsg and recvmmsg are Linux
+// only.
+
+#include "defs.h"
+#include "bufferpool.h"
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// An iovec view of buffer lists.  Each entry points into a Buffer; nothing
+// is copied.  The entries are grouped into messages, one per list added,
+// so a batch of datagrams can be described at once.
+class IOVecList
+{
+public:
+
+   enum
+   {
+      MAX_VECS = 1024,      // IOV_MAX on Linux
+      MAX_MESSAGES = 64,
+   };
+
+   IOVecList() { Clear(); }
+   void Clear();
+
+   // Start a new message with up to max_bytes of the data in blist,
+   // skipping the first skip bytes.  Empty buffers are left out.
+   // Returns the number of bytes added, which is short if the list ran out
+   // of entries or messages.
+   int32 AddData(Buffer *blist, int32 max_bytes, int32 skip = 0);
+
+   // Start a new message with the unused space at the end of each of
+   // count buffers, for receiving into.  Returns the number of bytes of
+   // space.
+   int32 AddSpace(Buffer **buffers, int32 count);
+
+   // Drop the most recently added message.
+   void RemoveLastMessage();
+
+   int32 GetMessageCount() { return num_messages; }
+   struct iovec *GetVecs(int32 message) { return vecs + message_start[message]; }
+   int32 GetVecCount(int32 message)
+   { return message_start[message + 1] - message_start[message]; }
+   int32 GetMessageLength(int32 message) { return message_length[message]; }
+
+   // All messages together
+   struct iovec *GetVecs() { return vecs; }
+   int32 GetVecCount() { return message_start[num_messages]; }
+   int32 GetLength() { return length; }
+
+private:
+
+   struct iovec vecs[MAX_VECS];
+   int32 message_start[MAX_MESSAGES + 1];
+   int32 message_length[MAX_MESSAGES];
+   int32 num_messages;
+   int32 length;
+
+   bool StartMessage();
+   void EndMessage(int32 message_bytes);
+};
+
+class BufferSocket
+{
+public:
+
+   enum
+   {
+      RECEIVE_BUFFERS = 64,        // Buffers a stream read can fill at once
+      DATAGRAM_BUFFERS = 16,       // Buffers for each received datagram
+      RECEIVE_DATAGRAMS = 16,      // Datagrams received at once
+
+      NO_BUFFERS = -2,             // Read and ReceiveMessages: the pool ran out
+   };
+
+   // Received data goes into buffers from pool.
+   BufferSocket(BufferPool *new_pool);
+   ~BufferSocket();
+
+   // Take over a socket descriptor, which should already be connected
+   // (or bound, for a datagram socket), and make it non-blocking.
+   bool Attach(int new_fd);
+   void Close();
+
+   int GetDescriptor() { return fd; }
+   bool IsOpen() { return fd >= 0; }
+   bool IsDatagram() { return datagram; }
+
+   // Stream sockets: write as much of vecs as the kernel will take.
+   // Returns the number of bytes written, 0 if the socket can't take any
+   // now, or -1 on an error.
+   int32 Write(IOVecList *vecs);
+
+   // Datagram sockets: send each message of vecs as a datagram.  Returns
+   // the number of datagrams sent, 0 if the socket can't take any now,
+   // or -1 on an error.
+   int32 SendMessages(IOVecList *vecs);
+
+   // Stream sockets: read whatever is waiting.  Returns a list of filled
+   // buffers, with no references, and sets len to the number of bytes.
+   // len is 0 if nothing was waiting, -1 if the connection was closed
+   // or failed, and NO_BUFFERS if the pool couldn't supply buffers to read
+   // into, in which case nothing was read; the list is NULL then.
+   Buffer *Read(int32 *len);
+
+   // Datagram sockets: receive up to max_lists datagrams, each into a list
+   // of buffers with no references.  Returns the number received, 0 if
+   // none were waiting, -1 on an error, or NO_BUFFERS if the pool couldn't
+   // supply buffers and nothing was read.  A datagram too big for
+   // DATAGRAM_BUFFERS buffers is dropped, and its list is NULL.
+   int32 ReceiveMessages(Buffer **lists, int32 max_lists);
+
+private:
+
+   int fd;
+   bool datagram;
+   BufferPool *pool;
+
+   // Empty buffers waiting to be read into; NULL where one was used.
+   // Only the ones that get data are replaced, so a read usually takes
+   // few buffers from the pool.  The price is that every open socket holds
+   // its spares out of the pool between reads: RECEIVE_BUFFERS for a
+   // stream socket and RECEIVE_DATAGRAMS * DATAGRAM_BUFFERS for a datagram
+   // socket.  With the default pool that's about 11K and 45K (each Buffer is
+   // 64 bytes plus its 100 bytes of data), on top of the data in flight.
+   Buffer *spare[RECEIVE_DATAGRAMS * DATAGRAM_BUFFERS];
+
+   IOVecList receive_vecs;
+
+   // Make sure the first count spares have buffers.
+   bool FillSpares(int32 count);
+
+   // len bytes were read into count spares starting at first.  Set their
+   // data lengths, and link the ones that got data into a list, taking
+   // them out of the spares.
+   Buffer *TakeSpares(int32 first, int32 count, int32 len);
+};
+
+#endif
@@ -12,6 +12,7 @@
 
 // Typedefs for Windows machines; change as needed for your architecture
 
+typedef unsigned long long uint64;
 typedef unsigned short uint16;
 typedef short          int16;
 typedef unsigned int   uint32;
@@ -19,7 +20,9 @@ typedef int            int32;
 typedef char           int8;
 typedef unsigned char  byte;
 
-#define min(x, y) ((x) < (y) ? (x) : (y))
+// std::min rather than a min macro, which breaks the standard headers
+#include <algorithm>
+using std::min;
 
 
 #endif
@@ -0,0 +1,127 @@
+/* Copyright (C) Andrew Kirmse, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Andrew Kirmse, 2000"
+ */
+#include <stdio.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "eventloop.h"
+#include "buffersocket.h"
+
+static const uint32 WATCH_EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+
+/***************************************************************/
+EventLoop::EventLoop()
+{
+   num_transports = 0;
+
+   epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   if (epoll_fd < 0)
+      printf("Unable to create epoll descriptor\n");
+}
+/***************************************************************/
+EventLoop::~EventLoop()
+{
+   if (epoll_fd >= 0)
+      close(epoll_fd);
+}
+/***************************************************************/
+bool EventLoop::Add(Transport *t)
+{
+   assert(t != NULL);
+
+   BufferSocket *socket = t->GetSocket();
+   if (epoll_fd < 0 || socket == NULL || !socket->IsOpen())
+      return false;
+
+   struct epoll_event event;
+   event.events = WATCH_EVENTS;
+   event.data.ptr = t;
+
+   if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket->GetDescriptor(), &event) != 0)
+   {
+      printf("Unable to add socket %d to epoll\n", socket->GetDescriptor());
+      return false;
+   }
+
+   num_transports++;
+   return true;
+}
+/***************************************************************/
+void EventLoop::Remove(Transport *t)
+{
+   assert(t != NULL);
+
+   BufferSocket *socket = t->GetSocket();
+   if (epoll_fd < 0 || socket == NULL || !socket->IsOpen())
+      return;
+
+   // Old kernels want an event even though it's ignored
+   struct epoll_event event;
+   if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, socket->GetDescriptor(), &event) == 0)
+      num_transports--;
+}
+/***************************************************************/
+int32 EventLoop::Poll(int32 timeout_ms)
+{
+   struct epoll_event events[MAX_EVENTS];
+   int got;
+
+   if (epoll_fd < 0)
+      return -1;
+
+   do
+      got = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+   while (got < 0 && errno == EINTR);
+
+   if (got < 0)
+      return -1;
+
+   for (int i = 0; i < got; i++)
+   {
+      Transport *t = (Transport *) events[i].data.ptr;
+      uint32 ready = events[i].events;
+      bool ok = true;
+
+      // Read first, so what arrived before a close or error is parsed.
+      // ReceiveFromSocket finds out about the close itself.
+      if (ready & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+	 ok = t->ReceiveFromSocket();
+
+      if (ok && (ready & EPOLLOUT))
+	 ok = t->FlushSend();
+
+      // Data left behind for want of buffers gets no new edge
+      if (ok && t->IsReceiveStalled())
+	 ok = Rearm(t);
+
+      if (!ok)
+      {
+	 Remove(t);
+	 Closed(t);
+      }
+   }
+
+   return got;
+}
+/***************************************************************/
+bool EventLoop::Rearm(Transport *t)
+{
+   struct epoll_event event;
+   event.events = WATCH_EVENTS;
+   event.data.ptr = t;
+
+   return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, t->GetSocket()->GetDescriptor(), &event) == 0;
+}
+/***************************************************************/
+void EventLoop::Closed(Transport *t)
+{
+   t->GetSocket()->Close();
+}
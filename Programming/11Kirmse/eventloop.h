@@ -0,0 +1,80 @@
+/* Copyright (C) Andrew Kirmse, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Andrew Kirmse, 2000"
+ */
+#ifndef _EVENTLOOP_H
+#define _EVENTLOOP_H
+
+// An EventLoop drives the sockets of many Transports with epoll.  Each
+// Transport's BufferSocket, stream or datagram, is watched edge-triggered
+// for both reading and writing, so a connection costs nothing until
+// something happens on it.
+//
+// Edge-triggered means epoll only says when a socket becomes readable,
+// so each read has to take everything waiting.  Transport::ReceiveFromSocket
+// does: it reads into pooled buffers until the socket would block, then
+// calls ParseReceiveList for all the complete messages in one batch.
+// Likewise a writable socket gets FlushSend, which sends everything queued
+// that the kernel will take.
+//
+// If the buffer pool runs dry partway through a read, what's left on the
+// socket would never be reported again.  Such a socket is re-armed, so the
+// next Poll tries it again without waiting; Poll doesn't block while any
+// socket is stalled like that, until buffers come back to the pool.
+//
+// This is Linux only.
+
+#include "defs.h"
+#include "transport.h"
+
+class EventLoop
+{
+public:
+
+   enum
+   {
+      MAX_EVENTS = 256,   // Sockets handled per epoll_wait
+   };
+
+   EventLoop();
+   virtual ~EventLoop();
+
+   bool IsOpen() { return epoll_fd >= 0; }
+
+   // Start watching t's socket, which must be set and open.  Anything
+   // already waiting on it is picked up by the next Poll.
+   bool Add(Transport *t);
+
+   // Stop watching t's socket.  The transport and its socket are left alone.
+   void Remove(Transport *t);
+
+   int32 GetTransportCount() { return num_transports; }
+
+   // Wait up to timeout_ms milliseconds (-1 for ever) for sockets to be
+   // ready, and service them.  Returns the number of sockets serviced, or
+   // -1 on an error.
+   int32 Poll(int32 timeout_ms);
+
+protected:
+
+   // Called for a transport whose connection closed or failed.  It has
+   // already been removed from the loop.  By default this closes its
+   // socket.
+   virtual void Closed(Transport *t);
+
+private:
+
+   int epoll_fd;
+
+   // Have epoll report t's socket again if it's still ready
+   bool Rearm(Transport *t);
+
+   int32 num_transports;
+};
+
+#endif
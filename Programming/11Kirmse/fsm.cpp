@@ -16,10 +16,3 @@ FSM::FSM(int32 new_adder,int32 new_multiplier)
    adder = new_adder; 
    multiplier = new_multiplier; 
 }
-
-/***************************************************************/
-void FSM::UpdateState()
-{
-   state = ((~state) + adder) * multiplier;
-   state = state ^ (state >> 16);
-}
@@ -19,7 +19,14 @@ public:
    FSM(int32 new_adder,int32 new_multiplier);
    void SetState(int32 new_state) { state = new_state; }
    int32 GetState() { return state; }
-   void UpdateState();
+
+   // Inline, since the cipher in SecureTransport calls this for every 4
+   // bytes.  The arithmetic is unsigned so that it wraps.
+   void UpdateState()
+   {
+      state = (int32) (((uint32) ~state + (uint32) adder) * (uint32) multiplier);
+      state = state ^ (state >> 16);
+   }
 
 private:
 
@@ -0,0 +1,318 @@
+/* Copyright (C) Andrew Kirmse, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Andrew Kirmse, 2000"
+ */
+
+// Load generator for Transport over localhost.  A server thread echoes
+// every message back on its own EventLoop; the main thread's EventLoop
+// drives the client end of each connection.  Each connection keeps a
+// fixed number of messages in flight, sending a new one as each echo
+// comes back, and the time for the round trip is recorded.
+//
+// Messages are framed with a 4 byte length, then the time they were sent.
+// With udp each connection is a pair of connected datagram sockets, and
+// each message is one datagram; one that's lost just isn't echoed.
+//
+//    g++ -O2 -std=c++11 -pthread loadgen.cpp eventloop.cpp transport.cpp
+//        buffersocket.cpp buffer.cpp bufferpool.cpp
+//    loadgen [connections] [message bytes] [seconds] [tcp|udp] [in flight]
+
+#include "eventloop.h"
+#include "buffersocket.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+enum
+{
+   LEN_HEADER = 12,       // length and send time
+   MAX_MESSAGE = 4096,
+};
+
+static uint64 Now()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now().time_since_epoch()).count();
+}
+
+// What the client end of every connection shares
+struct Stats
+{
+   bool sending;
+   int32 message_bytes;
+   uint64 sent;
+   vector<uint32> latencies;   // nanoseconds
+};
+
+// The server end echoes each message; the client end times it and sends
+// another while stats->sending.
+class LoadTransport : public Transport
+{
+public:
+
+   LoadTransport(BufferPool *new_pool, Stats *new_stats)
+   {
+      pool = new_pool;
+      stats = new_stats;
+   }
+
+   bool SendMessage(byte *message, int32 len)
+   {
+      Buffer *b = pool->Get();
+      if (b == NULL)
+	 return false;
+      b->Add(message, len);
+      return Send(b, len);
+   }
+
+   bool SendTimed()
+   {
+      byte message[MAX_MESSAGE];
+      int32 len = stats->message_bytes;
+      uint64 now = Now();
+
+      memset(message, 0, len);
+      memcpy(message, &len, 4);
+      memcpy(message + 4, &now, 8);
+      stats->sent++;
+      return SendMessage(message, len);
+   }
+
+protected:
+
+   bool ParseReceiveList()
+   {
+      int32 len_message;
+
+      receive_list->InitRead();
+      if (!receive_list->Read(&len_message))
+	 return false;
+
+      if (len_message < LEN_HEADER || len_message > MAX_MESSAGE)
+      {
+	 receive_list = Buffer::RemoveDataFromList(receive_list, receive_list->GetListReadableLength() + 4);
+	 printf("Invalid message length %d\n", len_message);
+	 return false;
+      }
+
+      if (receive_list->GetListReadableLength() + 4 < len_message)
+	 return false;
+
+      byte message[MAX_MESSAGE];
+      receive_list->InitRead();
+      receive_list->Read(message, len_message);
+      receive_list = Buffer::RemoveDataFromList(receive_list, len_message);
+
+      if (stats == NULL)
+	 return SendMessage(message, len_message);
+
+      uint64 sent;
+      memcpy(&sent, message + 4, 8);
+      stats->latencies.push_back((uint32) min(Now() - sent, (uint64) 0xffffffff));
+
+      if (stats->sending)
+	 SendTimed();
+      return true;
+   }
+
+private:
+
+   BufferPool *pool;
+   Stats *stats;
+};
+
+// Make count connected pairs of sockets, client end first
+static bool Connect(bool udp, int32 count, vector<int> *fds)
+{
+   sockaddr_in addr;
+   socklen_t len_addr = sizeof(addr);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if (udp)
+   {
+      for (int32 i = 0; i < count; i++)
+      {
+	 int ends[2];
+	 sockaddr_in bound[2];
+
+	 for (int32 j = 0; j < 2; j++)
+	 {
+	    len_addr = sizeof(addr);
+	    ends[j] = socket(AF_INET, SOCK_DGRAM, 0);
+	    if (ends[j] < 0 || bind(ends[j], (sockaddr *) &addr, sizeof(addr)) != 0)
+	       return false;
+	    getsockname(ends[j], (sockaddr *) &bound[j], &len_addr);
+	 }
+	 if (connect(ends[0], (sockaddr *) &bound[1], sizeof(addr)) != 0 ||
+	     connect(ends[1], (sockaddr *) &bound[0], sizeof(addr)) != 0)
+	    return false;
+
+	 fds->push_back(ends[0]);
+	 fds->push_back(ends[1]);
+      }
+      return true;
+   }
+
+   int listener = socket(AF_INET, SOCK_STREAM, 0);
+   if (listener < 0 || bind(listener, (sockaddr *) &addr, sizeof(addr)) != 0 ||
+       listen(listener, 128) != 0)
+      return false;
+   getsockname(listener, (sockaddr *) &addr, &len_addr);
+
+   // The kernel finishes each connect before it's accepted, so one at a
+   // time needs no backlog.
+   for (int32 i = 0; i < count; i++)
+   {
+      int client = socket(AF_INET, SOCK_STREAM, 0);
+      if (client < 0 || connect(client, (sockaddr *) &addr, sizeof(addr)) != 0)
+	 return false;
+      int server = accept(listener, NULL, NULL);
+      if (server < 0)
+	 return false;
+
+      int one = 1;
+      setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      fds->push_back(client);
+      fds->push_back(server);
+   }
+
+   close(listener);
+   return true;
+}
+
+static void Serve(EventLoop *loop, atomic<bool> *stop)
+{
+   while (!stop->load())
+      loop->Poll(10);
+}
+
+static double Percentile(vector<uint32> &sorted, double p)
+{
+   if (sorted.empty())
+      return 0;
+   size_t i = (size_t) (p / 100 * (sorted.size() - 1) + 0.5);
+   return sorted[i] / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+   int32 connections = argc > 1 ? atoi(argv[1]) : 2000;
+   int32 message_bytes = argc > 2 ? atoi(argv[2]) : 64;
+   double seconds = argc > 3 ? atof(argv[3]) : 5;
+   bool udp = argc > 4 && strcmp(argv[4], "udp") == 0;
+   int32 in_flight = argc > 5 ? atoi(argv[5]) : 1;
+   int32 i, j;
+
+   message_bytes = min(max(message_bytes, (int32) LEN_HEADER), (int32) MAX_MESSAGE);
+
+   // Two descriptors a connection, plus a few
+   struct rlimit limit;
+   getrlimit(RLIMIT_NOFILE, &limit);
+   limit.rlim_cur = limit.rlim_max;
+   setrlimit(RLIMIT_NOFILE, &limit);
+   if ((rlim_t) connections * 2 + 16 > limit.rlim_cur)
+   {
+      connections = (int32) (limit.rlim_cur - 16) / 2;
+      printf("Only %d connections; raise the descriptor limit for more\n", connections);
+   }
+
+   vector<int> fds;
+   if (!Connect(udp, connections, &fds))
+   {
+      printf("Unable to make connection %d\n", (int32) fds.size() / 2);
+      return 1;
+   }
+
+   BufferPool pool;
+   Stats stats;
+   stats.sending = true;
+   stats.message_bytes = message_bytes;
+   stats.sent = 0;
+
+   EventLoop client_loop, server_loop;
+   vector<BufferSocket *> sockets;
+   vector<LoadTransport *> clients, servers;
+
+   for (i = 0; i < connections; i++)
+      for (j = 0; j < 2; j++)
+      {
+	 BufferSocket *socket = new BufferSocket(&pool);
+	 LoadTransport *t = new LoadTransport(&pool, j == 0 ? &stats : NULL);
+
+	 socket->Attach(fds[i * 2 + j]);
+	 t->SetSocket(socket);
+	 sockets.push_back(socket);
+	 (j == 0 ? clients : servers).push_back(t);
+	 (j == 0 ? client_loop : server_loop).Add(t);
+      }
+
+   printf("%d %s connections, %d byte messages, %d in flight on each\n",
+	  connections, udp ? "udp" : "tcp", message_bytes, in_flight);
+
+   atomic<bool> stop(false);
+   thread server(Serve, &server_loop, &stop);
+
+   Clock::time_point start = Clock::now();
+   for (i = 0; i < connections; i++)
+      for (j = 0; j < in_flight; j++)
+	 clients[i]->SendTimed();
+
+   while (chrono::duration<double>(Clock::now() - start).count() < seconds)
+      client_loop.Poll(10);
+   double elapsed = chrono::duration<double>(Clock::now() - start).count();
+   uint64 received = stats.latencies.size();
+
+   // Let what's in flight come back, so nothing is left in the sockets
+   stats.sending = false;
+   Clock::time_point drain = Clock::now();
+   while (stats.latencies.size() < stats.sent &&
+	  chrono::duration<double>(Clock::now() - drain).count() < 1)
+      client_loop.Poll(10);
+   uint64 lost = stats.sent - stats.latencies.size();
+
+   stop.store(true);
+   server.join();
+
+   stats.latencies.resize(received);
+   sort(stats.latencies.begin(), stats.latencies.end());
+
+   printf("\n%.0f messages/s round trip\n", received / elapsed);
+   printf("latency us:  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+	  Percentile(stats.latencies, 50), Percentile(stats.latencies, 90),
+	  Percentile(stats.latencies, 99), Percentile(stats.latencies, 99.9),
+	  Percentile(stats.latencies, 100));
+   if (lost > 0)
+      printf("%llu messages lost\n", lost);
+
+   for (i = 0; i < connections; i++)
+   {
+      delete clients[i];
+      delete servers[i];
+   }
+   for (i = 0; i < (int32) sockets.size(); i++)
+      delete sockets[i];
+
+   return 0;
+}
@@ -1,4 +1,4 @@
-/* Copyright (C) Andrew Kirmse, 2000. 
+/* Copyright (C) Andrew Kirmse, 2000.
  * All rights reserved worldwide.
  *
  * This software is provided "as is" without express or implied
@@ -11,83 +11,580 @@
 #ifndef _POOL_H
 #define _POOL_H
 
-// A Pool keeps a list of previously allocated objects, so that frequently
-// reused objects don't have to be continually freed and reallocated.
-// The class that the Pool tracks must have a no-argument constructor; it
-// works best for simple structures.
+// A Pool keeps previously allocated objects, so that frequently reused
+// objects don't have to be continually freed and reallocated.  The class
+// that the Pool tracks must have a no-argument constructor, unless a
+// derived pool overrides Create.
 //
-// Objects are added to the Pool's free list when they are released; to avoid
-// memory leaks, all outstanding allocated objects should be released, so
-// that will ultimately be freed when the Pool is deleted.  FreeAll can
-// be called anytime to reset the pool of released objects.
+// Objects are kept constructed while they are in the pool; Get hands back
+// a released object as it was left.  To avoid memory leaks, all
+// outstanding allocated objects should be released; anything still in the
+// pool is destroyed when the pool is deleted.  FreeAll can be called
+// anytime to destroy the released objects.
+//
+// Get and Release may be called from any number of threads at once.
+// Each object's storage carries the pool's links, so moving an object in
+// and out of the pool never allocates.  Each thread keeps up to two
+// "magazines" of MAGAZINE_SIZE free objects per pool, so most calls touch
+// no shared memory at all.  Whole magazines move to and from a shared
+// store, a lock-free stack, with a single compare-and-swap.
+//
+// The stack's head holds a node index and a tag that changes on every
+// update, so a thread that was preempted between reading the head and
+// swapping it can't be fooled by the same node coming back (the ABA
+// problem).  Nodes live in slabs that aren't freed until the pool is, so
+// it's always safe to look at a node, even one another thread just took.
 //
 // The code for the template is in the .h file because Microsoft Visual C++
 // can only instantiate template classes in the file where they're defined.
 // Thus, if the code were in a .cpp file, all uses of the Pool would have to
 // appear here.
 
+#include "defs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <new>
 #include <list>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
 using namespace std;
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Alignment for a pool node of the given size: the next power of two up
+// to a cache line, so that a small node never straddles two lines.
+template<size_t size, size_t min_align>
+struct PoolNodeAlignment
+{
+   enum
+   {
+      line_align = size > 32 ? 64 : size > 16 ? 32 : 16,
+      value = line_align > min_align ? line_align : min_align
+   };
+};
+
 template<class T>
-class Pool 
+class Pool
 {
 public:
 
-   Pool() { allocated_count = 0; }
-   ~Pool()  {  FreeAll(); }
+   enum
+   {
+      MAGAZINE_SIZE = 32,  // Objects a thread moves to or from the shared store at once
+      CACHE_LINE = 64,
+   };
+
+   Pool();
+   virtual ~Pool();
 
    // Get an object from the free store if possible; allocate it if not.
+   // Returns NULL only if memory runs out.
    virtual T* Get()
    {
-      if (store.begin() != store.end())
+      ThreadSlot *slot = GetSlot();
+
+      if (slot->loaded.count == 0)
       {
-	 T *t = *store.begin();
-	 store.erase(store.begin());
-	 
-	 return t;
+	 if (slot->previous.count != 0)
+	    swap(slot->loaded, slot->previous);
+	 else if (!Refill(&slot->loaded))
+	    return NULL;
       }
-      
-      /* no available structures */
-      allocated_count++;
-      return new T;
+
+      Node *node = slot->loaded.top;
+      slot->loaded.top = node->next;
+      slot->loaded.count--;
+      return node->Object();
    }
 
-   virtual void Release(T *t) { store.push_front(t); }
-   void FreeAll()
+   virtual void Release(T *t)
    {
-      store_type::iterator it;
-      
-      it = store.begin();
-      while (it != store.end())
+      Node *node = reinterpret_cast<Node *>(t);
+      ThreadSlot *slot = GetSlot();
+
+      if (slot->loaded.count == MAGAZINE_SIZE)
       {
-	 allocated_count--;
-	 
-	 delete *it;
-	 
-	 it = store.erase(it);
+	 // previous is always either empty or full
+	 if (slot->previous.count != 0)
+	    PushMagazine(&objects, slot->previous);
+	 slot->previous = slot->loaded;
+	 slot->loaded.top = NULL;
+	 slot->loaded.count = 0;
       }
-   }
 
-   int32 GetAvailableCount()
-   {
-      store_type::iterator it;
-      int32 count = 0;
-      
-      for (it = store.begin();it != store.end();it++)
-	 count++;
-      
-      return count;
+      node->next = slot->loaded.top;
+      slot->loaded.top = node;
+      slot->loaded.count++;
    }
 
-   int32 GetAllocatedCount() { return allocated_count; }
+   // Destroy the released objects in the shared store and in this thread's
+   // magazines.  Their memory is kept for reuse, since other threads may
+   // still be looking at the store.
+   void FreeAll();
+
+   // Return this thread's magazines to the shared store, e.g. before the
+   // thread goes idle.  It happens automatically when a thread exits.
+   void Flush();
+
+   // Objects released to the shared store or this thread's magazines.
+   // Objects cached by other threads aren't counted.
+   int32 GetAvailableCount();
+   int32 GetAllocatedCount() { return allocated_count.load(memory_order_relaxed); }
    int32 GetTotalCount() { return GetAvailableCount() + GetAllocatedCount(); }
 
 protected:
-   
-   typedef list<T *> store_type;
-   store_type store;
-   int32 allocated_count;
+
+   // Construct an object in memory.  Derived pools can override this to
+   // use a different constructor.
+   virtual T *Create(void *memory) { return new (memory) T; }
+
+private:
+
+   enum { NO_NODE = 0xffffffff };
+
+   enum
+   {
+      FIRST_SLAB_SIZE = 64,   // Slab k holds FIRST_SLAB_SIZE << k nodes
+      MAX_SLABS = 24,
+      THREAD_SLOTS = 8,       // Pools of this type a thread keeps magazines for
+   };
+
+   struct Node
+   {
+      // The object must come first, so that a T * is also a Node *.
+      typename aligned_storage<sizeof(T), alignof(T)>::type object;
+      Node *next;                    // Next node in the same magazine
+      atomic<uint32> next_magazine;  // First node of the next magazine in a shared stack
+      uint32 index;
+      int32 count;                   // Size of the magazine this node heads
+      bool constructed;
+
+      T *Object() { return reinterpret_cast<T *>(&object); }
+   };
+
+   struct alignas(PoolNodeAlignment<sizeof(Node), alignof(Node)>::value) AlignedNode : Node
+   {
+   };
+
+   // A chain of free nodes linked by next.
+   struct Magazine
+   {
+      Node *top;
+      int32 count;
+   };
+
+   struct ThreadSlot
+   {
+      uint32 pool_id;   // 0 if unused
+      Pool *pool;
+      Magazine loaded;
+      Magazine previous;
+   };
+
+   // Plain data, so that getting at it is just an offset from the thread
+   // pointer; a thread_local with a constructor or destructor is reached
+   // through a function call on some compilers.
+   struct ThreadCache
+   {
+      ThreadSlot slots[THREAD_SLOTS];
+      int32 last;       // Slot used most recently
+      int32 next_evict;
+   };
+
+   // Returns a thread's magazines when it exits.
+   struct CacheFlusher
+   {
+      bool armed;
+      ~CacheFlusher();
+   };
+
+   static thread_local ThreadCache cache;
+
+   static void ArmFlusher() { static thread_local CacheFlusher flusher; flusher.armed = true; }
+
+   // Pools that are still alive, so a thread never flushes its magazines
+   // into a deleted pool.
+   static mutex &RegistryLock() { static mutex lock; return lock; }
+   static map<uint32, Pool *> &Registry() { static map<uint32, Pool *> registry; return registry; }
+
+   ThreadSlot *GetSlot()
+   {
+      ThreadSlot *slot = &cache.slots[cache.last];
+      if (slot->pool_id == pool_id)
+	 return slot;
+      return FindSlot();
+   }
+
+   ThreadSlot *FindSlot();
+   static void FlushSlot(ThreadSlot *slot);
+
+   bool Refill(Magazine *m);
+   Node *Grow();
+   Node *GetNode(uint32 index);
+   Node *AddSlab(int32 k);
+
+   static int32 GetSlabNumber(uint32 index, uint32 *first);
+   void PushMagazine(atomic<uint64> *stack, Magazine m);
+   Node *PopMagazine(atomic<uint64> *stack);
+
+   // Not copyable
+   Pool(const Pool &);
+   Pool &operator=(const Pool &);
+
+   // The shared store of free objects, with its count, on a cache line of
+   // its own; the padding keeps it there however the pool is aligned.
+   char pad0[CACHE_LINE];
+   atomic<uint64> objects;        // Tag in the high 32 bits, node index in the low
+   atomic<int32> objects_count;
+   char pad1[CACHE_LINE];
+
+   // Rarely written: nodes whose objects FreeAll destroyed, and the count
+   // of nodes taken from the slabs.
+   atomic<uint64> memory;
+   atomic<uint32> next_unused;
+   atomic<int32> allocated_count;
+   char pad2[CACHE_LINE];
+
+   // Read-mostly
+   uint32 pool_id;
+   atomic<AlignedNode *> slabs[MAX_SLABS];
 };
 
+template<class T>
+thread_local typename Pool<T>::ThreadCache Pool<T>::cache;
+
+/***************************************************************/
+template<class T>
+Pool<T>::Pool()
+{
+   static atomic<uint32> last_pool_id(0);
+
+   objects.store(NO_NODE);
+   objects_count.store(0);
+   memory.store(NO_NODE);
+   next_unused.store(0);
+   allocated_count.store(0);
+   for (int32 k = 0; k < MAX_SLABS; k++)
+      slabs[k].store(NULL);
+
+   pool_id = ++last_pool_id;
+   if (pool_id == 0)
+      pool_id = ++last_pool_id;
+
+   lock_guard<mutex> guard(RegistryLock());
+   Registry()[pool_id] = this;
+}
+/***************************************************************/
+template<class T>
+Pool<T>::~Pool()
+{
+   {
+      lock_guard<mutex> guard(RegistryLock());
+      Registry().erase(pool_id);
+   }
+
+   // Other threads' slots for this pool are left to go stale; they're
+   // checked against the registry before they're used again.
+   for (int32 i = 0; i < THREAD_SLOTS; i++)
+      if (cache.slots[i].pool_id == pool_id)
+	 cache.slots[i].pool_id = 0;
+
+   for (int32 k = 0; k < MAX_SLABS; k++)
+   {
+      AlignedNode *slab = slabs[k].load();
+      if (slab == NULL)
+	 continue;
+
+      for (uint32 i = 0; i < ((uint32) FIRST_SLAB_SIZE << k); i++)
+	 if (slab[i].constructed)
+	    slab[i].Object()->~T();
+
+      free(((void **) slab)[-1]);
+   }
+}
+/***************************************************************/
+template<class T>
+void Pool<T>::FreeAll()
+{
+   Flush();
+
+   Node *top;
+   while ((top = PopMagazine(&objects)) != NULL)
+   {
+      objects_count -= top->count;
+
+      Magazine m;
+      m.top = top;
+      m.count = 0;
+      for (Node *node = top; node != NULL; node = node->next)
+      {
+	 node->Object()->~T();
+	 node->constructed = false;
+	 m.count++;
+      }
+
+      allocated_count -= m.count;
+      PushMagazine(&memory, m);
+   }
+}
+/***************************************************************/
+template<class T>
+void Pool<T>::Flush()
+{
+   lock_guard<mutex> guard(RegistryLock());
+   for (int32 i = 0; i < THREAD_SLOTS; i++)
+      if (cache.slots[i].pool_id == pool_id)
+	 FlushSlot(&cache.slots[i]);
+}
+/***************************************************************/
+template<class T>
+int32 Pool<T>::GetAvailableCount()
+{
+   int32 count = objects_count.load(memory_order_relaxed);
+
+   for (int32 i = 0; i < THREAD_SLOTS; i++)
+      if (cache.slots[i].pool_id == pool_id)
+	 count += cache.slots[i].loaded.count + cache.slots[i].previous.count;
+
+   return count;
+}
+/***************************************************************/
+template<class T>
+typename Pool<T>::ThreadSlot *Pool<T>::FindSlot()
+{
+   int32 i;
+   ThreadSlot *slot;
+
+   for (i = 0; i < THREAD_SLOTS; i++)
+      if (cache.slots[i].pool_id == pool_id)
+      {
+	 cache.last = i;
+	 return &cache.slots[i];
+      }
+
+   for (i = 0; i < THREAD_SLOTS; i++)
+      if (cache.slots[i].pool_id == 0)
+	 break;
+
+   if (i == THREAD_SLOTS)
+   {
+      // Every slot is taken; give one back.
+      i = cache.next_evict;
+      cache.next_evict = (cache.next_evict + 1) % THREAD_SLOTS;
+
+      lock_guard<mutex> guard(RegistryLock());
+      FlushSlot(&cache.slots[i]);
+   }
+
+   ArmFlusher();
+
+   slot = &cache.slots[i];
+   memset(slot, 0, sizeof(*slot));
+   slot->pool_id = pool_id;
+   slot->pool = this;
+   cache.last = i;
+   return slot;
+}
+/***************************************************************/
+// Return a slot's magazines to its pool.  A slot for another thread's pool
+// may only be flushed with the registry lock held.
+template<class T>
+void Pool<T>::FlushSlot(ThreadSlot *slot)
+{
+   typename map<uint32, Pool *>::iterator it = Registry().find(slot->pool_id);
+
+   // The pool was deleted; its nodes went with it.
+   if (it == Registry().end() || it->second != slot->pool)
+   {
+      slot->pool_id = 0;
+      return;
+   }
+
+   Pool *pool = slot->pool;
+   if (slot->loaded.count != 0)
+      pool->PushMagazine(&pool->objects, slot->loaded);
+   if (slot->previous.count != 0)
+      pool->PushMagazine(&pool->objects, slot->previous);
+   slot->loaded.count = slot->previous.count = 0;
+   slot->loaded.top = slot->previous.top = NULL;
+   slot->pool_id = 0;
+}
+/***************************************************************/
+template<class T>
+Pool<T>::CacheFlusher::~CacheFlusher()
+{
+   lock_guard<mutex> guard(RegistryLock());
+   for (int32 i = 0; i < THREAD_SLOTS; i++)
+      if (cache.slots[i].pool_id != 0)
+	 FlushSlot(&cache.slots[i]);
+}
+/***************************************************************/
+// Fill an empty magazine, from the shared store if it has any objects,
+// otherwise by constructing new ones.
+template<class T>
+bool Pool<T>::Refill(Magazine *m)
+{
+   Node *top = PopMagazine(&objects);
+   if (top != NULL)
+   {
+      objects_count -= top->count;
+      m->top = top;
+      m->count = top->count;
+      return true;
+   }
+
+   top = PopMagazine(&memory);
+   if (top == NULL)
+      top = Grow();
+   if (top == NULL)
+      return false;
+
+   m->top = top;
+   m->count = 0;
+   for (Node *node = top; node != NULL; node = node->next)
+   {
+      Create(node->Object());
+      node->constructed = true;
+      m->count++;
+   }
+   allocated_count += m->count;
+
+   return true;
+}
+/***************************************************************/
+// Take up to MAGAZINE_SIZE unused nodes from the slabs and link them into
+// a magazine.
+template<class T>
+typename Pool<T>::Node *Pool<T>::Grow()
+{
+   const uint32 max_nodes = (uint32) FIRST_SLAB_SIZE * ((1u << MAX_SLABS) - 1);
+   uint32 first = next_unused.load(memory_order_relaxed);
+   uint32 count;
+
+   do
+   {
+      if (first >= max_nodes)
+	 return NULL;
+      count = min((uint32) MAGAZINE_SIZE, max_nodes - first);
+   } while (!next_unused.compare_exchange_weak(first, first + count, memory_order_relaxed));
+
+   Node *top = NULL;
+   for (uint32 i = first + count; i-- > first; )
+   {
+      uint32 slab_first;
+      int32 k = GetSlabNumber(i, &slab_first);
+      Node *node = AddSlab(k);
+      if (node == NULL)
+	 return top;  // Out of memory; the rest of the nodes are lost
+      node = static_cast<AlignedNode *>(node) + (i - slab_first);
+      node->next = top;
+      top = node;
+   }
+   return top;
+}
+/***************************************************************/
+// Which slab holds a node index, and the index of that slab's first node
+template<class T>
+int32 Pool<T>::GetSlabNumber(uint32 index, uint32 *first)
+{
+   uint64 v = (uint64) index + FIRST_SLAB_SIZE;
+   unsigned long high;
+#ifdef _MSC_VER
+   _BitScanReverse64(&high, v);
+#else
+   high = 63 - __builtin_clzll(v);
+#endif
+   *first = (uint32) ((1ull << high) - FIRST_SLAB_SIZE);
+   return (int32) high - 6;  // log2(FIRST_SLAB_SIZE)
+}
+/***************************************************************/
+template<class T>
+typename Pool<T>::Node *Pool<T>::GetNode(uint32 index)
+{
+   uint32 first;
+   int32 k = GetSlabNumber(index, &first);
+   return slabs[k].load(memory_order_acquire) + (index - first);
+}
+/***************************************************************/
+// Returns slab k, allocating it if no thread has yet.
+template<class T>
+typename Pool<T>::Node *Pool<T>::AddSlab(int32 k)
+{
+   AlignedNode *slab = slabs[k].load(memory_order_acquire);
+   if (slab != NULL)
+      return slab;
+
+   uint32 size = (uint32) FIRST_SLAB_SIZE << k;
+   uint32 first = (uint32) FIRST_SLAB_SIZE * ((1u << k) - 1);
+
+   // Cache line aligned, with the pointer to free just before it
+   void *block = malloc(sizeof(AlignedNode) * size + CACHE_LINE + sizeof(void *));
+   if (block == NULL)
+      return NULL;
+   size_t start = ((size_t) block + sizeof(void *) + CACHE_LINE - 1) & ~((size_t) CACHE_LINE - 1);
+   slab = (AlignedNode *) start;
+   ((void **) slab)[-1] = block;
+
+   for (uint32 i = 0; i < size; i++)
+   {
+      AlignedNode *node = new (&slab[i]) AlignedNode;
+      node->next = NULL;
+      node->next_magazine.store(NO_NODE, memory_order_relaxed);
+      node->index = first + i;
+      node->count = 0;
+      node->constructed = false;
+   }
+
+   AlignedNode *expected = NULL;
+   if (!slabs[k].compare_exchange_strong(expected, slab, memory_order_acq_rel, memory_order_acquire))
+   {
+      // Another thread got there first
+      free(block);
+      return expected;
+   }
+   return slab;
+}
+/***************************************************************/
+template<class T>
+void Pool<T>::PushMagazine(atomic<uint64> *stack, Magazine m)
+{
+   Node *top = m.top;
+   top->count = m.count;
+   if (stack == &objects)
+      objects_count += m.count;
+
+   uint64 old_head = stack->load(memory_order_relaxed);
+   uint64 new_head;
+   do
+   {
+      top->next_magazine.store((uint32) old_head, memory_order_relaxed);
+      new_head = (((old_head >> 32) + 1) << 32) | top->index;
+   } while (!stack->compare_exchange_weak(old_head, new_head,
+					  memory_order_release, memory_order_relaxed));
+}
+/***************************************************************/
+template<class T>
+typename Pool<T>::Node *Pool<T>::PopMagazine(atomic<uint64> *stack)
+{
+   uint64 old_head = stack->load(memory_order_acquire);
+   uint64 new_head;
+   Node *top;
+   do
+   {
+      if ((uint32) old_head == NO_NODE)
+	 return NULL;
+
+      // top may be taken by another thread as we look at it; then the
+      // tag will have changed and the swap fails.
+      top = GetNode((uint32) old_head);
+      new_head = (((old_head >> 32) + 1) << 32) | top->next_magazine.load(memory_order_relaxed);
+   } while (!stack->compare_exchange_weak(old_head, new_head,
+					  memory_order_acquire, memory_order_acquire));
+   return top;
+}
+
 #endif
@@ -0,0 +1,215 @@
+/* Copyright (C) Andrew Kirmse, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Andrew Kirmse, 2000"
+ */
+
+// Pool contention benchmark.  Each thread repeatedly gets a batch of
+// objects and releases them again, with three ways of pooling:
+//
+//    new       plain new and delete
+//    list      the old Pool: a list<T *> free store, behind a mutex
+//    pool      Pool, with its per-thread magazines and lock-free store
+//
+// In the "local" test each thread releases its own objects.  In the
+// "handoff" test threads swap batches through shared mailboxes, so most
+// objects are released by a different thread than got them, the way
+// network buffers are.
+//
+//    g++ -O2 -std=c++11 -pthread poolbench.cpp -o poolbench
+//    poolbench [max threads] [batch size] [seconds per test]
+
+#include "pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+// Something the size of a small network buffer header
+struct Packet
+{
+   int32 id;
+   int32 length;
+   byte data[56];
+};
+
+class NewAllocator
+{
+public:
+   Packet *Get() { return new Packet; }
+   void Release(Packet *p) { delete p; }
+};
+
+// The free store the Pool used to have, made safe for threads the
+// simple way.
+class ListAllocator
+{
+public:
+   ~ListAllocator()
+   {
+      for (list<Packet *>::iterator it = store.begin(); it != store.end(); it++)
+	 delete *it;
+   }
+
+   Packet *Get()
+   {
+      lock_guard<mutex> guard(lock);
+      if (store.begin() != store.end())
+      {
+	 Packet *p = *store.begin();
+	 store.erase(store.begin());
+	 return p;
+      }
+      return new Packet;
+   }
+
+   void Release(Packet *p)
+   {
+      lock_guard<mutex> guard(lock);
+      store.push_front(p);
+   }
+
+private:
+   list<Packet *> store;
+   mutex lock;
+};
+
+class PoolAllocator
+{
+public:
+   Packet *Get() { return pool.Get(); }
+   void Release(Packet *p) { pool.Release(p); }
+
+private:
+   Pool<Packet> pool;
+};
+
+enum
+{
+   MAILBOXES = 16,
+};
+
+struct Batch
+{
+   vector<Packet *> packets;
+};
+
+template<class Allocator>
+static void Worker(Allocator *allocator, int32 thread_num, int32 batch_size, bool handoff,
+		   atomic<Batch *> *mailboxes, atomic<bool> *stop, uint64 *operations)
+{
+   Batch *batch = new Batch;
+   uint64 count = 0;
+   uint32 seed = thread_num + 1;
+   int32 i;
+
+   while (!stop->load(memory_order_relaxed))
+   {
+      batch->packets.resize(batch_size);
+      for (i = 0; i < batch_size; i++)
+      {
+	 Packet *p = allocator->Get();
+	 p->id = thread_num;
+	 batch->packets[i] = p;
+      }
+
+      if (handoff)
+      {
+	 // Leave our batch and take whatever was in the mailbox
+	 seed = seed * 1103515245 + 12345;
+	 Batch *other = mailboxes[(seed >> 8) % MAILBOXES].exchange(batch);
+	 if (other == NULL)
+	 {
+	    batch = new Batch;
+	    continue;
+	 }
+	 batch = other;
+      }
+
+      for (i = 0; i < (int32) batch->packets.size(); i++)
+	 allocator->Release(batch->packets[i]);
+      count += batch->packets.size();
+      batch->packets.clear();
+   }
+
+   for (i = 0; i < (int32) batch->packets.size(); i++)
+      allocator->Release(batch->packets[i]);
+   delete batch;
+
+   *operations = count;
+}
+
+// Returns millions of get/release pairs per second.
+template<class Allocator>
+static double Run(int32 num_threads, int32 batch_size, bool handoff, double seconds)
+{
+   Allocator *allocator = new Allocator;
+   atomic<Batch *> mailboxes[MAILBOXES];
+   atomic<bool> stop(false);
+   vector<uint64> operations(num_threads);
+   vector<thread> threads;
+   int32 i;
+
+   for (i = 0; i < MAILBOXES; i++)
+      mailboxes[i].store(NULL);
+
+   Clock::time_point start = Clock::now();
+   for (i = 0; i < num_threads; i++)
+      threads.push_back(thread(Worker<Allocator>, allocator, i, batch_size, handoff,
+			       mailboxes, &stop, &operations[i]));
+
+   this_thread::sleep_for(chrono::duration<double>(seconds));
+   stop.store(true);
+   for (i = 0; i < num_threads; i++)
+      threads[i].join();
+   double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+   uint64 total = 0;
+   for (i = 0; i < num_threads; i++)
+      total += operations[i];
+
+   for (i = 0; i < MAILBOXES; i++)
+   {
+      Batch *batch = mailboxes[i].load();
+      if (batch == NULL)
+	 continue;
+      for (uint32 j = 0; j < batch->packets.size(); j++)
+	 allocator->Release(batch->packets[j]);
+      delete batch;
+   }
+   delete allocator;
+
+   return total / elapsed / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+   int32 max_threads = argc > 1 ? atoi(argv[1]) : 8;
+   int32 batch_size = argc > 2 ? atoi(argv[2]) : 16;
+   double seconds = argc > 3 ? atof(argv[3]) : 0.5;
+
+   printf("%u hardware threads, batches of %i; millions of get/release pairs per second\n\n",
+	  thread::hardware_concurrency(), batch_size);
+   printf("%-8s %7s %9s %9s %9s\n", "test", "threads", "new", "list", "pool");
+
+   for (int32 handoff = 0; handoff <= 1; handoff++)
+      for (int32 threads = 1; threads <= max_threads; threads *= 2)
+      {
+	 double new_rate = Run<NewAllocator>(threads, batch_size, handoff != 0, seconds);
+	 double list_rate = Run<ListAllocator>(threads, batch_size, handoff != 0, seconds);
+	 double pool_rate = Run<PoolAllocator>(threads, batch_size, handoff != 0, seconds);
+
+	 printf("%-8s %7i %9.1f %9.1f %9.1f\n", handoff ? "handoff" : "local", threads,
+		new_rate, list_rate, pool_rate);
+      }
+
+   return 0;
+}
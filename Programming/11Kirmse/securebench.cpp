@@ -0,0 +1,287 @@
+/* Copyright (C) Andrew Kirmse, 2000.
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright (C) Andrew Kirmse, 2000"
+ */
+
+// SecureTransport throughput over a TCP connection to localhost.
+//
+//    byte   the cipher as it was: one byte at a time, then a separate
+//           pass over the message for the digest
+//    word   SecureTransport: 8 bytes at a time, with the digest taken in
+//           the same pass over each buffer
+//
+// The two formats are the same on the wire, so each kind of transport
+// also receives from the other, to check.
+//
+//    g++ -O2 -std=c++11 securebench.cpp securetransport.cpp transport.cpp
+//        buffersocket.cpp buffer.cpp bufferpool.cpp fsm.cpp md5.cpp random.cpp
+//    securebench [message bytes] [megabytes]
+
+#include "securetransport.h"
+#include "buffersocket.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+// SecureTransport's Send and ParseReceiveList as they were
+class ByteSecureTransport : public SecureTransport
+{
+public:
+
+   bool Send(Buffer *blist, int32 max_bytes)
+   {
+      Buffer *b = header_pool->GetBuffer(MAX_LEN_HEADER);
+      if (b == NULL)
+	 return false;
+
+      byte *digest_ptr;
+      int32 len_data = AddHeader(b, blist, max_bytes, &digest_ptr);
+
+      b->SetNext(blist);
+      b->Set(digest_ptr, GetBufferListDigest(b, len_data));
+
+      int32 processed = 0;
+      uint32 key = 0;
+      Buffer *walk_buf = b;
+      while (processed < len_data)
+      {
+	 int32 process_now = min(walk_buf->GetDataLength(), len_data - processed);
+	 byte *ptr = walk_buf->GetDataStart();
+
+	 for (int32 i=0; i < process_now; i++)
+	 {
+	    if ((processed & 3) == 0)
+	    {
+	       send_fsm4->UpdateState();
+	       key = send_fsm4->GetState();
+	    }
+
+	    if (processed >= 8)
+	    {
+	       int32 byte_num = processed & 3;
+	       *ptr = *ptr ^ ((key & (0xffu << (byte_num * 8))) >> (byte_num * 8));
+	    }
+
+	    processed++;
+	    ptr++;
+	 }
+
+	 walk_buf = walk_buf->GetNext();
+      }
+
+      bool retval = Transport::Send(b,len_data);
+
+      send_fsm1->UpdateState();
+      send_fsm2->UpdateState();
+      send_fsm3->UpdateState();
+      send_fsm4->UpdateState();
+      return retval;
+   }
+
+protected:
+
+   bool ParseReceiveList()
+   {
+      int32 len_message;
+      int32 state2;
+
+      receive_list->InitRead();
+      if (!receive_list->Read(&len_message) || !receive_list->Read(&state2))
+	 return false;
+
+      state2 ^= len_message;
+      if (state2 != receive_fsm2->GetState())
+      {
+	 receive_list = Buffer::RemoveDataFromList(receive_list, receive_list->GetListReadableLength());
+	 return false;
+      }
+
+      len_message = (~(len_message ^ receive_fsm1->GetState())) & 0x7fffffff;
+      if (receive_list->GetListReadableLength() + 8 < len_message)
+	 return false;
+
+      int32 i, processed = 0;
+      uint32 key = 0;
+      Buffer *b = receive_list;
+      while (processed < len_message)
+      {
+	 int32 process_now = min(b->GetDataLength(), len_message - processed);
+	 byte *ptr = b->GetDataStart();
+
+	 for (i=0; i < process_now; i++)
+	 {
+	    if ((processed & 3) == 0)
+	    {
+	       receive_fsm4->UpdateState();
+	       key = receive_fsm4->GetState();
+	    }
+
+	    if (processed >= 8)
+	    {
+	       int32 byte_num = processed & 3;
+	       *ptr = *ptr ^ ((key & (0xffu << (byte_num * 8))) >> (byte_num * 8));
+	    }
+	    ptr++;
+	    processed++;
+	 }
+	 b = b->GetNext();
+      }
+
+      int32 digest;
+      byte *digest_ptr = receive_list->GetListReadPointer();
+      if (!receive_list->Read(&digest))
+	 return false;
+
+      receive_list->Set(digest_ptr,(int32)0);
+      if (digest != GetBufferListDigest(receive_list,len_message))
+      {
+	 receive_list = Buffer::RemoveDataFromList(receive_list, len_message);
+	 return false;
+      }
+
+      int32 len_pad = 1 + receive_fsm3->GetState() % 11;
+
+      receive_fsm1->UpdateState();
+      receive_fsm2->UpdateState();
+      receive_fsm3->UpdateState();
+      receive_fsm4->UpdateState();
+
+      int32 len_header = MIN_LEN_HEADER + len_pad;
+      receive_list = Buffer::RemoveDataFromList(receive_list, len_header);
+      if (receive_list != NULL)
+	 receive_list = Buffer::RemoveDataFromList(receive_list, len_message - len_header);
+      return true;
+   }
+};
+
+// Counts the messages that arrive intact
+template<class Base>
+class Counting : public Base
+{
+public:
+   Counting() { received = 0; }
+   int32 received;
+
+protected:
+   bool ParseReceiveList()
+   {
+      if (!Base::ParseReceiveList())
+	 return false;
+      received++;
+      return true;
+   }
+};
+
+static void MakeConnection(int *client, int *server)
+{
+   int listener = socket(AF_INET, SOCK_STREAM, 0);
+   sockaddr_in addr;
+   socklen_t len_addr = sizeof(addr);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   bind(listener, (sockaddr *) &addr, sizeof(addr));
+   listen(listener, 1);
+   getsockname(listener, (sockaddr *) &addr, &len_addr);
+
+   *client = socket(AF_INET, SOCK_STREAM, 0);
+   connect(*client, (sockaddr *) &addr, sizeof(addr));
+   *server = accept(listener, NULL, NULL);
+   close(listener);
+
+   int one = 1;
+   setsockopt(*client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Returns MB/s of payload, or 0 if any message didn't arrive intact.
+template<class Sender, class Receiver>
+static double Run(BufferPool *pool, int32 message_bytes, int32 count)
+{
+   int client, server;
+   MakeConnection(&client, &server);
+
+   BufferSocket send_socket(pool), receive_socket(pool);
+   send_socket.Attach(client);
+   receive_socket.Attach(server);
+
+   Sender sender;
+   Counting<Receiver> receiver;
+   sender.SetSocket(&send_socket);
+   receiver.SetSocket(&receive_socket);
+
+   byte payload[256];
+   int32 i;
+   for (i = 0; i < (int32) sizeof(payload); i++)
+      payload[i] = (byte) (i * 7);
+
+   Clock::time_point start = Clock::now();
+   for (i = 0; i < count; i++)
+   {
+      Buffer *b = pool->Get();
+      for (int32 added = 0; added < message_bytes; added += sizeof(payload))
+	 b->Add(payload, min((int32) sizeof(payload), message_bytes - added));
+      sender.Send(b, message_bytes);
+
+      // Keep the send queue short, as a game would
+      while (sender.GetSendQueueLength() > 256 * 1024)
+      {
+	 sender.FlushSend();
+	 receiver.ReceiveFromSocket();
+      }
+      if ((i & 15) == 15)
+	 receiver.ReceiveFromSocket();
+   }
+   while (receiver.received < count && send_socket.IsOpen())
+   {
+      sender.FlushSend();
+      if (!receiver.ReceiveFromSocket())
+	 break;
+   }
+   double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+   if (receiver.received != count)
+      return 0;
+   return (double) message_bytes * count / (1024 * 1024) / seconds;
+}
+
+int main(int argc, char **argv)
+{
+   int32 message_bytes = argc > 1 ? atoi(argv[1]) : 1000;
+   int32 megabytes = argc > 2 ? atoi(argv[2]) : 64;
+   int32 count = (int32) ((double) megabytes * 1024 * 1024 / message_bytes);
+
+   Random random(1);
+   BufferPool pool;
+   SecureTransport::Begin(&random);
+
+   printf("%i messages of %i bytes over TCP to localhost; MB/s of payload\n\n",
+	  count, message_bytes);
+
+   double byte_rate = Run<ByteSecureTransport, ByteSecureTransport>(&pool, message_bytes, count);
+   double word_rate = Run<SecureTransport, SecureTransport>(&pool, message_bytes, count);
+   printf("byte    %8.1f\n", byte_rate);
+   printf("word    %8.1f  (%.2fx)\n", word_rate, byte_rate > 0 ? word_rate / byte_rate : 0);
+
+   // Same format both ways
+   int32 check = count < 2000 ? count : 2000;
+   bool ok = Run<ByteSecureTransport, SecureTransport>(&pool, message_bytes, check) > 0 &&
+      Run<SecureTransport, ByteSecureTransport>(&pool, message_bytes, check) > 0;
+   printf("\n%s\n", ok && byte_rate > 0 && word_rate > 0 ? "All messages arrived intact." : "MESSAGES LOST OR CORRUPTED");
+
+   SecureTransport::End();
+   return ok ? 0 : 1;
+}
@@ -13,11 +13,71 @@
 
 BufferPool   *SecureTransport::header_pool = NULL;
 Random       *SecureTransport::random = NULL;
+
+/***************************************************************/
+// XOR the key stream from fsm into len bytes at ptr, which are bytes pos
+// on of the message.  Each 4 bytes of the message use the next state of
+// fsm as the key, low byte first; key holds the key for pos's group.
+// Bytes before first_crypted are left alone.  The key for bytes 8-11 is
+// saved in digest_key.
+//
+// Whole groups of 8 bytes are done a word at a time.  This is inline, so
+// there's still no one function to patch to get at the plain text.
+static inline void Crypt(FSM *fsm, uint32 *key, uint32 *digest_key,
+			 byte *ptr, int32 pos, int32 len, int32 first_crypted)
+{
+   int32 end = pos + len;
+
+   while (pos < end)
+   {
+      if ((pos & 3) == 0)
+      {
+	 if (pos >= 16 && end - pos >= 8)
+	 {
+	    uint32 key0, key1;
+	    do
+	    {
+	       fsm->UpdateState();
+	       key0 = fsm->GetState();
+	       fsm->UpdateState();
+	       key1 = fsm->GetState();
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	       uint64 word_key = ((uint64) __builtin_bswap32(key0) << 32) | __builtin_bswap32(key1);
+#else
+	       uint64 word_key = ((uint64) key1 << 32) | key0;
+#endif
+	       uint64 word;
+	       memcpy(&word, ptr, 8);
+	       word ^= word_key;
+	       memcpy(ptr, &word, 8);
+
+	       ptr += 8;
+	       pos += 8;
+	    } while (end - pos >= 8);
+
+	    *key = key1;
+	    continue;
+	 }
+
+	 fsm->UpdateState();
+	 *key = fsm->GetState();
+	 if (pos == 8)
+	    *digest_key = *key;
+      }
+
+      if (pos >= first_crypted)
+	 *ptr ^= (byte) (*key >> ((pos & 3) * 8));
+
+      ptr++;
+      pos++;
+   }
+}
 /***************************************************************/
 void SecureTransport::Begin(Random *new_random)
 {
    random = new_random;
-   header_pool = new BufferPool();
+   header_pool = new BufferPool(MAX_LEN_HEADER);
 }
 /***************************************************************/
 void SecureTransport::End()
@@ -68,40 +128,45 @@ bool SecureTransport::Send(Buffer *blist, int32 max_bytes)
       return false;
    }
 
-   int32 len_data = AddHeader(b, blist, max_bytes);
+   byte *digest_ptr;
+   int32 len_data = AddHeader(b, blist, max_bytes, &digest_ptr);
 
    b->SetNext(blist);
 
-   // encrypt starting 8 bytes in (don't encrypt the length or fsm2)
+   // One pass over each buffer: add it to the digest, then encrypt it in
+   // place.  Don't encrypt the length or fsm2, and leave the digest until
+   // it's known; it's digested as 0.
+   MD5Context context;
    int32 processed = 0;
-   uint32 key;
+   uint32 key = 0, digest_key = 0;
    Buffer *walk_buf = b;
+
+   MD5Init(&context);
    while (processed < len_data)
    {
       int32 process_now = min(walk_buf->GetDataLength(), len_data - processed);
       byte *ptr = walk_buf->GetDataStart();
 
-      for (int32 i=0; i < process_now; i++)
+      // only update if this buffer has data, because passing in 0 bytes
+      // actually DOES change the state
+      if (process_now > 0)
       {
-	 if ((processed & 3) == 0)
-	 {
-	    send_fsm4->UpdateState();
-	    key = send_fsm4->GetState();
-	 }
-	 
-	 if (processed >= 8)   // Skip length & FSM2 fields
-	 {
-	    int32 byte_num = processed & 3;   // rotate through bytes of key
-	    *ptr = *ptr ^ ((key & (0xff << (byte_num * 8))) >> (byte_num * 8));
-	 }
-	 
-	 processed++;
-	 ptr++;
+	 MD5Update(&context, ptr, process_now);
+	 Crypt(send_fsm4, &key, &digest_key, ptr, processed, process_now, 12);
       }
 
+      processed += process_now;
       walk_buf = walk_buf->GetNext();
    }
 
+   // Patch in the encrypted digest
+   int32 digest[4];
+   MD5Final((byte *)&digest, &context);
+
+   int32 digest_word = digest[0] ^ digest[1] ^ digest[2] ^ digest[3];
+   for (int32 i = 0; i < 4; i++)
+      digest_ptr[i] = ((byte *) &digest_word)[i] ^ (byte) (digest_key >> (i * 8));
+
    bool retval = super::Send(b,len_data);
 
    send_fsm1->UpdateState();
@@ -173,43 +238,45 @@ bool SecureTransport::ParseReceiveList()
    if (len_available < len_message)
       return false;
 
-   // Decrypt message (the length was already read)
-   int32 i, processed = 0;
-   uint32 key;
+   // Decrypt the message (the length was already read) and digest it, in
+   // one pass over each buffer.  The digest field is taken out and
+   // digested as 0.
+   MD5Context context;
+   int32 processed = 0;
+   uint32 key = 0, digest_key;
+   int32 digest = 0,calc_digest;
+   byte *digest_bytes = (byte *) &digest;
    Buffer *b = receive_list;
+
+   MD5Init(&context);
    while (processed < len_message)
    {
       int32 process_now = min(b->GetDataLength(), len_message - processed);
       byte *ptr = b->GetDataStart();
 
-      for (i=0; i < process_now; i++)
+      if (process_now > 0)
       {
-	 if ((processed & 3) == 0)
-	 {
-	    receive_fsm4->UpdateState();
-	    key = receive_fsm4->GetState();
-	 }
+	 // Skip length and FSM2 fields
+	 Crypt(receive_fsm4, &key, &digest_key, ptr, processed, process_now, 8);
 
-	 if (processed >= 8)   // Skip length and FSM2 fields
-	 {
-	    int32 byte_num = processed & 3;   // rotate through bytes of key
-	    *ptr = *ptr ^ ((key & (0xff << (byte_num * 8))) >> (byte_num * 8));
-	 }
-	 ptr++;
-	 processed++;
+	 for (int32 pos = processed; pos < processed + process_now && pos < 12; pos++)
+	    if (pos >= 8)
+	    {
+	       digest_bytes[pos - 8] = ptr[pos - processed];
+	       ptr[pos - processed] = 0;
+	    }
+
+	 MD5Update(&context, ptr, process_now);
       }
+
+      processed += process_now;
       b = b->GetNext();
    }
 
-   int32 digest,calc_digest;
-
-   byte *digest_ptr;
-
-   digest_ptr = receive_list->GetListReadPointer();
-   TRYREAD(&digest);
+   int32 digest_words[4];
+   MD5Final((byte *)&digest_words, &context);
+   calc_digest = digest_words[0] ^ digest_words[1] ^ digest_words[2] ^ digest_words[3];
 
-   receive_list->Set(digest_ptr,(int32)0);
-   calc_digest = GetBufferListDigest(receive_list,len_message);
    if (digest != calc_digest)
    {
       receive_list = Buffer::RemoveDataFromList(receive_list, len_message);
@@ -245,7 +312,8 @@ bool SecureTransport::ParseReceiveList()
 }
 #undef TRYREAD
 /***************************************************************/
-int32 SecureTransport::AddHeader(Buffer *header, Buffer *data, int32 max_bytes)
+int32 SecureTransport::AddHeader(Buffer *header, Buffer *data, int32 max_bytes,
+				 byte **digest_ptr)
 {
    assert(header->GetNext() == NULL);
    assert(random != NULL);
@@ -263,7 +331,7 @@ int32 SecureTransport::AddHeader(Buffer *header, Buffer *data, int32 max_bytes)
 
 //   dprintf("encoding len_message with %i\n",send_fsm1->GetState());
 
-   byte *digest_ptr = header->GetListAddPointer();
+   *digest_ptr = header->GetListAddPointer();
 
    header->Add((int32)0);
    
@@ -279,11 +347,6 @@ int32 SecureTransport::AddHeader(Buffer *header, Buffer *data, int32 max_bytes)
    // we didn't check all the adds, but we're sure we didn't overflow the buffer
    assert(header->GetNext() == NULL);
 
-   // Calculate and patch in the digest of the header AND the data
-   header->SetNext(data);
-   header->Set(digest_ptr, GetBufferListDigest(header, len_data));
-   header->SetNext(NULL);
-
    return len_data;
 }
 /***************************************************************/
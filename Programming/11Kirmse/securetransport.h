@@ -18,7 +18,11 @@
 
 // As an anti-hacking mechanism, the encrypt and decrypt routines are not
 // split out into separate functions.  Unfortunately, this means that
-// their code is duplicated in some places.
+// their code is duplicated in some places.  The cipher loop they share is
+// inline, so it's expanded into each.
+//
+// Each buffer is encrypted or decrypted and added to the digest in one
+// pass, while it's in the cache.
 
 #ifndef _SECURETRANSPORT_H
 #define _SECURETRANSPORT_H
@@ -60,8 +64,9 @@ protected:
    // Add a header for the given data buffer to "header".
    // header must be a single buffer (NOT a buffer list, i.e. next == NULL).
    // max_bytes is the maximum # of data bytes to send.
+   // The digest is left 0; digest_ptr is set to where it goes.
    // Return the TOTAL length of the message (header and data).
-   int32 AddHeader(Buffer *header, Buffer *data, int32 max_bytes);
+   int32 AddHeader(Buffer *header, Buffer *data, int32 max_bytes, byte **digest_ptr);
 
    int32 GetBufferListDigest(Buffer *blist,int32 count);
 
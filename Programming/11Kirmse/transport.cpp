@@ -8,27 +8,34 @@
  * "Portions Copyright (C) Andrew Kirmse, 2000"
  */
 #include "transport.h"
+#include "buffersocket.h"
+#include <stdio.h>
 #include <assert.h>
 
 /***************************************************************/
 Transport::Transport()
 {
+   socket = NULL;
+   receive_stalled = false;
    receive_list = NULL;
    receive_busy_list = NULL;
+   send_offset = 0;
 }
 /***************************************************************/
 Transport::~Transport()
 {
-   receive_list->RemoveListReference();
-   receive_busy_list->RemoveListReference();
+   if (receive_list != NULL)
+      receive_list->RemoveListReference();
+   if (receive_busy_list != NULL)
+      receive_busy_list->RemoveListReference();
 
-   buffer_store_type::iterator it;
+   list<pending_send>::iterator it;
 
    // remove reference from all send_busy_buffers
    it = send_busy_buffers.begin();
    while (it != send_busy_buffers.end())
    {
-      (*it)->RemoveListReference();
+      it->blist->RemoveListReference(it->len);
 
       it = send_busy_buffers.erase(it);
    }
@@ -36,63 +43,187 @@ Transport::~Transport()
 /***************************************************************/
 bool Transport::Send(Buffer *blist,int32 max_bytes)
 {
-   Buffer *ptr;
-   socket_buffer sb[MAX_SEND_BUFFERS];
-   int32 len_sb, list_len;
-   int32 bytes_remaining = max_bytes;
-   int32 bytes_sent = 0;
-
    assert(blist != NULL);
 
-   len_sb = 0;
-   list_len = 0;
-   ptr = blist;
-   // Build up an array of pointers from the buffer list.  Skip empty buffers.
-   while (ptr != NULL && bytes_remaining > 0)
+   pending_send ps;
+   ps.blist = blist;
+   ps.len = min(max_bytes, blist->GetListDataLength());
+
+   assert(ps.len > 0); // if sent only 0 length buffers
+
+   // Add references to all buffers in the list that are sent (including
+   // empty ones); they're removed as the socket takes the data.
+   blist->AddListReference(ps.len);
+
+   send_busy_buffers.push_back(ps);
+
+   if (socket == NULL)
+      return true;
+   return FlushSend();
+}
+/***************************************************************/
+bool Transport::FlushSend()
+{
+   if (socket == NULL || !socket->IsOpen())
+      return false;
+
+   if (socket->IsDatagram())
+      return FlushDatagrams();
+   return FlushStream();
+}
+/***************************************************************/
+bool Transport::FlushStream()
+{
+   IOVecList vecs;
+
+   while (!send_busy_buffers.empty())
    {
-      sb[len_sb].buf = ptr->GetDataStart();
-      sb[len_sb].len = ptr->GetDataLength();
-
-      // list_len counts ALL buffers in the list, so that when we get to SendNotify,
-      // we know how many buffers to remove a reference from (even empty ones).
-      list_len++;
-      
-      if ((int32) sb[len_sb].len > bytes_remaining)
-	 sb[len_sb].len = bytes_remaining;
-      bytes_remaining -= sb[len_sb].len;
-      
-      bytes_sent += sb[len_sb].len;
-
-      if (sb[len_sb].len != 0)
-	 len_sb++;
-
-      if (len_sb == MAX_SEND_BUFFERS)
+      // Gather as many queued lists as fit into one write
+      list<pending_send>::iterator it;
+      int32 skip = send_offset;
+
+      vecs.Clear();
+      for (it = send_busy_buffers.begin(); it != send_busy_buffers.end(); it++)
       {
-         // Pretend that buffers are sent
-         blist->AddListReference(max_bytes);
-         blist->RemoveListReference(max_bytes);
+	 int32 want = it->len - skip;
+	 if (vecs.AddData(it->blist, want, skip) < want)
+	    break;
+	 skip = 0;
+      }
+
+      int32 written = socket->Write(&vecs);
+      if (written < 0)
 	 return false;
+      if (written == 0)
+	 return true;   // The socket is full; try again when it drains
+
+      // Release the lists that were sent completely
+      send_offset += written;
+      while (!send_busy_buffers.empty() && send_busy_buffers.front().len <= send_offset)
+      {
+	 pending_send ps = send_busy_buffers.front();
+	 send_busy_buffers.pop_front();
+	 send_offset -= ps.len;
+	 ps.blist->RemoveListReference(ps.len);
       }
-      ptr = ptr->GetNext();
    }
 
-   assert(bytes_remaining != max_bytes); // if sent only 0 length buffers
+   return true;
+}
+/***************************************************************/
+bool Transport::FlushDatagrams()
+{
+   IOVecList vecs;
 
-   // Add references to all buffers in the list that are sent (including empty ones)
-   Buffer *b = blist;
-   while (b != ptr)
+   while (!send_busy_buffers.empty())
    {
-      b->AddReference();
-      b = b->GetNext();
+      list<pending_send>::iterator it;
+
+      vecs.Clear();
+      for (it = send_busy_buffers.begin(); it != send_busy_buffers.end(); it++)
+	 if (vecs.AddData(it->blist, it->len) < it->len)
+	 {
+	    vecs.RemoveLastMessage();
+	    break;
+	 }
+
+      if (vecs.GetMessageCount() == 0)
+      {
+	 // Too many buffers for one datagram
+	 pending_send ps = send_busy_buffers.front();
+	 send_busy_buffers.pop_front();
+	 ps.blist->RemoveListReference(ps.len);
+	 printf("Buffer list too long to send as a datagram\n");
+	 return false;
+      }
+
+      int32 sent = socket->SendMessages(&vecs);
+      if (sent < 0)
+	 return false;
+      if (sent == 0)
+	 return true;   // The socket is full; try again when it drains
+
+      for (int32 i = 0; i < sent; i++)
+      {
+	 pending_send ps = send_busy_buffers.front();
+	 send_busy_buffers.pop_front();
+	 ps.blist->RemoveListReference(ps.len);
+      }
    }
-   
-   send_busy_buffers.push_back(blist);
 
-   // XXX Actually send buffer list over the socket, e.g.
-   // as->Send(sb, len_sb, blist, list_len);
    return true;
 }
 /***************************************************************/
+int32 Transport::GetSendQueueLength()
+{
+   list<pending_send>::iterator it;
+   int32 length = -send_offset;
+
+   for (it = send_busy_buffers.begin(); it != send_busy_buffers.end(); it++)
+      length += it->len;
+
+   return length;
+}
+/***************************************************************/
+bool Transport::ReceiveFromSocket()
+{
+   if (socket == NULL || !socket->IsOpen())
+      return false;
+
+   bool ok;
+   Buffer *received = NULL;
+   Buffer *received_end = NULL;
+
+   // Take everything that's waiting, then parse it all
+   if (socket->IsDatagram())
+   {
+      Buffer *lists[BufferSocket::RECEIVE_DATAGRAMS];
+      int32 got;
+
+      while ((got = socket->ReceiveMessages(lists, BufferSocket::RECEIVE_DATAGRAMS)) > 0)
+	 for (int32 i = 0; i < got; i++)
+	    if (lists[i] != NULL)
+	       AddReceived(lists[i], received, received_end);
+      ok = (got == 0 || got == BufferSocket::NO_BUFFERS);
+      receive_stalled = (got == BufferSocket::NO_BUFFERS);
+   }
+   else
+   {
+      int32 len;
+      Buffer *blist;
+
+      while ((blist = socket->Read(&len)) != NULL)
+	 AddReceived(blist, received, received_end);
+      ok = (len == 0 || len == BufferSocket::NO_BUFFERS);
+      receive_stalled = (len == BufferSocket::NO_BUFFERS);
+   }
+
+   if (received != NULL)
+   {
+      if (receive_list == NULL)
+	 receive_list = received;
+      else
+	 receive_list->Append(received);
+   }
+
+   while (receive_list != NULL && ParseReceiveList())
+      ;
+
+   return ok;
+}
+/***************************************************************/
+void Transport::AddReceived(Buffer *blist, Buffer *&received, Buffer *&received_end)
+{
+   // receive_list holds a reference to each of its buffers
+   blist->AddListReference();
+
+   if (received == NULL)
+      received = blist;
+   else
+      received_end->SetNext(blist);
+   received_end = blist->GetListEnd();
+}
+/***************************************************************/
 void Transport::Receive(Buffer *b)
 {
    socket_buffer sb[1];
@@ -13,6 +13,8 @@
 #include "defs.h"
 #include "bufferpool.h"
 
+class BufferSocket;
+
 class Transport
 {
 public:
@@ -27,20 +29,55 @@ public:
 
    void Receive(Buffer *b);
 
+   // The socket to send and receive on; the transport doesn't own it.
+   // Without a socket, sent buffer lists stay queued until the transport
+   // is deleted.
+   void SetSocket(BufferSocket *new_socket) { socket = new_socket; }
+   BufferSocket *GetSocket() { return socket; }
+
+   // Send as much of the queued data as the socket will take.  Buffers
+   // are released as the kernel takes them.  Returns false on a socket
+   // error.
+   bool FlushSend();
+
+   // Bytes waiting to be sent
+   int32 GetSendQueueLength();
+
+   // Read everything waiting on the socket into pooled buffers, then parse
+   // the messages that are complete.  Returns false if the connection was
+   // closed or failed.  If the pool runs out of buffers the rest is left
+   // on the socket, and IsReceiveStalled() is true until a later call
+   // reads it all.
+   bool ReceiveFromSocket();
+   bool IsReceiveStalled() { return receive_stalled; }
+
 private:
 
-   enum
+   // A buffer list passed to Send, and how much of it to send
+   struct pending_send
    {
-      MAX_SEND_BUFFERS = 3000,
+      Buffer *blist;
+      int32 len;
    };
 
+   BufferSocket *socket;
+   bool receive_stalled;
+
    // buffers passed to Socket::Receive() that haven't been released in
    // ReceiveNotify yet.
    Buffer *receive_busy_list;
 
-   // buffers passed to Socket::Send() that haven't been released in
-   // SendNotify yet.
-   buffer_store_type send_busy_buffers;
+   // buffers passed to Send() that the socket hasn't taken yet, and how
+   // much of the first one it has.
+   list<pending_send> send_busy_buffers;
+   int32 send_offset;
+
+   bool FlushStream();
+   bool FlushDatagrams();
+
+   // Add a list of received buffers to the end of the list from received
+   // to received_end.
+   void AddReceived(Buffer *blist, Buffer *&received, Buffer *&received_end);
 
 protected:
 
@@ -12,14 +12,16 @@
 #include <time.h>
 #else
 #include <stdio.h>
-#include <sys/timeb.h>
+#include <sys/time.h>
 #endif
 
+#include "custom_time.h"
+
 
 #ifdef _WIN32
 float g_StartTime = -1.0f;
 #else
-struct timeb   g_StartTimeb;
+struct timeval g_StartTimeval;   //gettimeofday() so profiles get microseconds
 #endif
 float g_CurrentTime = -1.0f;
 float g_TimeLastTick = -1.0f;
@@ -30,7 +32,7 @@ void InitTime( void )
 #ifdef _WIN32
 	g_StartTime = ((float)timeGetTime()) / 1000.0f;
 #else
-	ftime(&g_StartTimeb);
+	gettimeofday(&g_StartTimeval, NULL);
 #endif
 	g_CurrentTime = 0.0f;
 	g_TimeLastTick = 0.001f;
@@ -41,12 +43,7 @@ void MarkTimeThisTick( void )
 #ifdef _WIN32
 	float newTime = (((float)timeGetTime()) / 1000.0f) - g_StartTime;
 #else
-	struct timeb tp;
-
-	ftime(&tp);
-
-	float newTime = tp.time - g_StartTimeb.time +
-	  (tp.millitm/1000.0) - (g_StartTimeb.millitm/1000.0);
+	float newTime = GetExactTime();
 
 #endif
 
@@ -70,12 +67,12 @@ float GetExactTime( void )
 #ifdef _WIN32
 	return( ((float)timeGetTime())/1000.0f );
 #else
-	struct timeb tp;
+	struct timeval tp;
 
-	ftime(&tp);
+	gettimeofday(&tp, NULL);
 
-	return tp.time - g_StartTimeb.time +
-	  (tp.millitm/1000.0) - (g_StartTimeb.millitm/1000.0);
+	return (float)( (tp.tv_sec - g_StartTimeval.tv_sec) +
+	  ((tp.tv_usec - g_StartTimeval.tv_usec)/1000000.0) );
 #endif
 }
 
@@ -0,0 +1,87 @@
+//*********************************************************************
+// Name:     flockregress.cpp
+// Purpose:  Headless, deterministic flocking run for regression and
+//           performance tracking.  Builds a population from a seed,
+//           steps it a fixed number of frames at a fixed time step,
+//           prints a checksum of the final state and the per-phase
+//           timings gathered by the profiler.  If an expected checksum
+//           is given the exit code says whether the run matched it.
+//
+//           usage:  flockregress [boids] [frames] [seed]
+//                                [expected checksum]
+//*********************************************************************
+
+//
+// includes
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "headless.h"
+#include "profile.h"
+#include "custom_time.h"
+
+#define GAME_SPEED 40.0f            // same as main.cpp
+#define FRAME_TIME (1.0f/30.0f)     // fixed step, so runs are repeatable
+
+// main
+// Makes it go.
+
+int main (int argc, char *argv[])
+{
+
+   int          num_boids = (argc > 1) ? atoi(argv[1]) : MaxBoids;
+   int          frames    = (argc > 2) ? atoi(argv[2]) : 1000;
+   unsigned int seed      = (argc > 3) ? (unsigned int) atoi(argv[3]) : 1;
+
+   unsigned int sum;
+
+   InitTime();
+   ProfileReset();
+
+   ProfileBegin( "Build World" );
+   BuildWorld(num_boids, seed);
+   ProfileEnd( "Build World" );
+
+   for (int f = 0; f < frames; f++) {
+
+      ProfileBegin( "Flocking Update" );
+      for (int i = 0; i < CFlock::FlockCount; i++) {
+         CFlock::ListOfFlocks[i]->Update(FRAME_TIME * GAME_SPEED);
+      }
+      ProfileEnd( "Flocking Update" );
+   }
+
+   ProfileBegin( "Checksum" );
+   sum = WorldChecksum();
+   ProfileEnd( "Checksum" );
+
+   ProfileBegin( "Destroy World" );
+   DestroyWorld();
+   ProfileEnd( "Destroy World" );
+
+   // report
+
+   printf("boids %d  flocks %d  frames %d  seed %u\n", num_boids, MaxFlocks, frames, seed);
+   printf("checksum %08x\n\n", sum);
+
+   ProfileDumpOutputToFile(stdout);
+
+   // compare against the expected answer, if we were given one
+
+   if (argc > 4) {
+
+      unsigned int expected = (unsigned int) strtoul(argv[4], NULL, 16);
+
+      if (sum != expected) {
+         printf("\nFAILED:  expected checksum %08x\n", expected);
+         return (1);
+      }
+
+      printf("\npassed\n");
+   }
+
+   return (0);
+
+}
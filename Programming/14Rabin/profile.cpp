@@ -47,6 +47,20 @@ TextBox* textBox = 0;
 
 
 void ProfileInit( void )
+{
+   ProfileReset();
+
+   textBox = new TextBox(0, 640, 0, 480);
+   textBox->SetMode(TEXT_NONE);
+
+}
+
+
+
+
+//Forget all samples and history and start timing from now.
+//Doesn't touch the text box, so it is safe to use without a window.
+void ProfileReset( void )
 {
    unsigned int i;
 
@@ -56,11 +70,6 @@ void ProfileInit( void )
    }
 
    g_startProfile = GetExactTime();
-
-
-   textBox = new TextBox(0, 640, 0, 480);
-   textBox->SetMode(TEXT_NONE);
-
 }
 
 
@@ -209,6 +218,52 @@ void ProfileDumpOutputToBuffer( void )
 
 
 
+//Writes every sample gathered since the last dump (or reset) to fp
+//in absolute times rather than per-frame percentages, then resets the
+//samples.  Used by the headless driver, which has no text box.
+void ProfileDumpOutputToFile( FILE* fp )
+{
+   unsigned int i = 0;
+   float totalTime;
+
+   g_endProfile = GetExactTime();
+   totalTime = g_endProfile - g_startProfile;
+
+   fprintf( fp, "  Total ms :    Self ms :     %% :       # : Profile Name\n" );
+   fprintf( fp, "----------------------------------------------------------\n" );
+
+   while( i < NUM_PROFILE_SAMPLES && g_samples[i].bValid == true ) {
+      unsigned int indent;
+      float sampleTime, percentTime;
+
+      assert( g_samples[i].iOpenProfiles == 0 );
+
+      sampleTime = g_samples[i].fAccumulator - g_samples[i].fChildrenSampleTime;
+      percentTime = ( totalTime > 0.0f ) ? ( sampleTime / totalTime ) * 100.0f : 0.0f;
+
+      fprintf( fp, "%10.3f : %10.3f : %5.1f : %7u : ",
+               g_samples[i].fAccumulator * 1000.0f, sampleTime * 1000.0f,
+               percentTime, g_samples[i].iProfileInstances );
+
+      for( indent=0; indent<g_samples[i].iNumParents; indent++ ) {
+         fprintf( fp, "   " );
+      }
+      fprintf( fp, "%s\n", g_samples[i].szName );
+      i++;
+   }
+
+   {  //Reset samples for the next dump
+      unsigned int i;
+      for( i=0; i<NUM_PROFILE_SAMPLES; i++ ) {
+         g_samples[i].bValid = false;
+      }
+      g_startProfile = GetExactTime();
+   }
+}
+
+
+
+
 void StoreProfileInHistory( char* name, float percent )
 {
    unsigned int i = 0;
@@ -11,10 +11,14 @@
 #ifndef _PROFILE_H
 #define _PROFILE_H
 
+#include <stdio.h>
+
 void ProfileInit( void );
+void ProfileReset( void );
 void ProfileBegin( char* name );
 void ProfileEnd( char* name );
 void ProfileDumpOutputToBuffer( void );
+void ProfileDumpOutputToFile( FILE* fp );
 void StoreProfileInHistory( char* name, float percent );
 void GetProfileFromHistory( char* name, float* ave, float* min, float* max );
 void ProfileDraw( void );